@@ -61,6 +61,11 @@
 #define X_EWS_CHANGEKEY "X-EWS-CHANGEKEY"
 #define X_EWS_GAL_SHA1 "X-EWS-GAL-SHA1"
 #define X_EWS_PHOTO_CHECK_DATE "X-EWS-PHOTO-CHECK-DATE" /* YYYYMMDD of the last check for photo */
+#define X_EWS_PHOTO_MISSING "X-EWS-PHOTO-MISSING" /* set when the server said there is no photo */
+/* How many days to wait before checking again for a photo of a user,
+   for whom the server said there is none */
+#define EBB_EWS_PHOTO_MISSING_RECHECK_DAYS 14
+
 #define X_EWS_CERT_KIND "X-EWS-CERT-KIND"
 
 #define E_EWS_CERT_KIND_USER "UserSMIMECertificate"
@@ -241,7 +246,23 @@ ebb_ews_can_check_user_photo (EContact *contact)
 	g_return_val_if_fail (E_IS_CONTACT (contact), FALSE);
 
 	last_check = ebb_ews_get_photo_check_date (contact);
-	if (last_check && *last_check) {
+	if (last_check && *last_check && ebb_ews_get_x_attribute (contact, X_EWS_PHOTO_MISSING)) {
+		GDate last_date, today;
+		gint year = 0, month = 0, day = 0;
+
+		/* The users without photo are checked again only after several days */
+		g_date_clear (&last_date, 1);
+		g_date_clear (&today, 1);
+		g_date_set_time_t (&today, time (NULL));
+
+		if (sscanf (last_check, "%04d%02d%02d", &year, &month, &day) == 3 &&
+		    g_date_valid_dmy (day, month, year)) {
+			g_date_set_dmy (&last_date, day, month, year);
+			can = g_date_days_between (&last_date, &today) >= EBB_EWS_PHOTO_MISSING_RECHECK_DAYS;
+		} else {
+			can = TRUE;
+		}
+	} else if (last_check && *last_check) {
 		gchar *today_str;
 
 		today_str = ebb_ews_get_today_as_string ();
@@ -2612,6 +2633,7 @@ det_sort_func (gconstpointer _a,
 	return a->seq - b->seq;
 }
 
+#ifdef WITH_MSPACK
 static gchar *
 ebb_ews_download_gal_file (EBookBackendEws *bbews,
 			   EwsOALDetails *full,
@@ -2639,10 +2661,19 @@ ebb_ews_download_gal_file (EBookBackendEws *bbews,
 	cache_dir = e_book_backend_get_cache_dir (E_BOOK_BACKEND (bbews));
 	download_path = g_build_filename (cache_dir, full->filename, NULL);
 
-	if (!e_ews_connection_download_oal_file_sync (bbews->priv->cnc, full_url, download_path, NULL, NULL, cancellable, error)) {
+	g_rec_mutex_lock (&bbews->priv->cnc_lock);
+
+	if (!bbews->priv->cnc) {
+		g_propagate_error (error, EC_ERROR_EX (E_CLIENT_ERROR_REPOSITORY_OFFLINE, NULL));
+		g_clear_pointer (&download_path, g_free);
+	} else if (!e_ews_connection_download_oal_file_sync (bbews->priv->cnc, full_url, download_path, NULL, NULL, cancellable, error)) {
 		g_free (download_path);
 		download_path = NULL;
-	} else {
+	}
+
+	g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+
+	if (download_path) {
 		d (printf ("OAL file downloaded %s\n", download_path));
 	}
 
@@ -2651,51 +2682,17 @@ ebb_ews_download_gal_file (EBookBackendEws *bbews,
 
 	return download_path;
 }
+#endif /* WITH_MSPACK */
 
+/* Applies the diff files to the current OAB file, up to the 'full' sequence.
+   Returns NULL, when the full OAB file needs to be downloaded instead. */
 static gchar *
-ebb_ews_download_full_gal (EBookBackendEws *bbews,
-			   EwsOALDetails *full,
-			   GCancellable *cancellable,
-			   GError **error)
-{
-	ESource *source;
-	const gchar *cache_dir;
-	gchar *lzx_path, *oab_file, *oab_path;
-
-	lzx_path = ebb_ews_download_gal_file (bbews, full, cancellable, error);
-	if (!lzx_path)
-		return NULL;
-
-	source = e_backend_get_source (E_BACKEND (bbews));
-	oab_file = g_strdup_printf ("%s-%d.oab", e_source_get_display_name (source), full->seq);
-	cache_dir = e_book_backend_get_cache_dir (E_BOOK_BACKEND (bbews));
-	oab_path = g_build_filename (cache_dir, oab_file, NULL);
-
-	if (!ews_oab_decompress_full (lzx_path, oab_path, error)) {
-		g_free (oab_path);
-		oab_path = NULL;
-	} else {
-		d (printf ("OAL file decompressed %s\n", oab_path));
-	}
-
-	if (lzx_path) {
-		g_unlink (lzx_path);
-		g_free (lzx_path);
-	}
-
-	g_free (oab_file);
-
-	return oab_path;
-}
-
-static gchar *
-ebb_ews_download_gal (EBookBackendEws *bbews,
-		      EBookCache *book_cache,
-		      EwsOALDetails *full,
-		      GSList *deltas,
-		      guint32 seq,
-		      GCancellable *cancellable,
-		      GError **error)
+ebb_ews_download_gal_deltas (EBookBackendEws *bbews,
+			     EBookCache *book_cache,
+			     EwsOALDetails *full,
+			     GSList *deltas,
+			     guint32 seq,
+			     GCancellable *cancellable)
 {
 #ifdef WITH_MSPACK
 	GSList *link;
@@ -2759,79 +2756,359 @@ ebb_ews_download_gal (EBookBackendEws *bbews,
  full:
 #endif /* WITH_MSPACK */
 	d (printf ("Ewsgal: Downloading full gal \n"));
-	return ebb_ews_download_full_gal (bbews, full, cancellable, error);
+	return NULL;
 }
 
-static void
-ebb_ews_remove_old_gal_file (EBookCache *book_cache)
+/* The GAL contact photos are fetched by this many threads; it can be
+   overridden with the EWS_GAL_PHOTO_WORKERS environment variable */
+#define EBB_EWS_GAL_PHOTO_WORKERS 3
+
+/* The rate of the photo requests, in requests per second. It starts at the
+   initial rate, grows slowly with each successful request and halves when
+   the server is busy. */
+#define EBB_EWS_GAL_PHOTO_RATE_INITIAL 2.0
+#define EBB_EWS_GAL_PHOTO_RATE_MIN 0.2
+#define EBB_EWS_GAL_PHOTO_RATE_MAX 10.0
+#define EBB_EWS_GAL_PHOTO_RATE_STEP 0.1
+
+/* How long to pause when the server is busy and did not say for how long */
+#define EBB_EWS_GAL_PHOTO_BUSY_PAUSE_SECONDS 30
+
+/* The fetched photos are stored in the cache in batches of this size */
+#define EBB_EWS_GAL_PHOTO_COMMIT_BATCH 100
+
+/* Newline-separated UIDs of the GAL contacts whose photos are still to be
+   checked, thus the fetching continues after a restart */
+#define EBB_EWS_GAL_PHOTOS_PENDING_KEY "gal-photos-pending"
+
+/* How often the EBB_EWS_GAL_PHOTOS_PENDING_KEY is updated while fetching */
+#define EBB_EWS_GAL_PHOTOS_SAVE_PENDING_SECONDS 60
+
+static guint
+ebb_ews_get_gal_photo_workers (void)
 {
-	gchar *filename;
+	static guint n_workers = 0;
+
+	if (!n_workers) {
+		const gchar *envvar = g_getenv ("EWS_GAL_PHOTO_WORKERS");
+		guint value = 0;
 
-	g_return_if_fail (E_IS_BOOK_CACHE (book_cache));
+		if (envvar && *envvar)
+			value = (guint) g_ascii_strtoull (envvar, NULL, 10);
 
-	filename = e_cache_dup_key (E_CACHE (book_cache), "oab-filename", NULL);
+		if (!value)
+			value = EBB_EWS_GAL_PHOTO_WORKERS;
 
-	if (filename)
-		g_unlink (filename);
-	g_free (filename);
+		n_workers = CLAMP (value, 1, 8);
+	}
+
+	return n_workers;
 }
 
-static gboolean
-ebb_ews_fetch_gal_photo_sync (EBookBackendEws *bbews,
+typedef enum {
+	EBB_EWS_PHOTO_FOUND,
+	EBB_EWS_PHOTO_MISSING,
+	EBB_EWS_PHOTO_FAILED,
+	EBB_EWS_PHOTO_SERVER_BUSY,
+	EBB_EWS_PHOTO_CANCELLED
+} EbbEwsPhotoResult;
+
+static EbbEwsPhotoResult
+ebb_ews_fetch_gal_photo_sync (EEwsConnection *cnc,
 			      EContact *contact,
-			      GCancellable *cancellable,
-			      GError **error)
+			      GCancellable *cancellable)
 {
 	const gchar *email;
-	gboolean success = FALSE;
+	gchar *photo_base64 = NULL;
+	EbbEwsPhotoResult result;
+	GError *local_error = NULL;
 
-	g_return_val_if_fail (E_IS_BOOK_BACKEND_EWS (bbews), FALSE);
-	g_return_val_if_fail (E_IS_CONTACT (contact), FALSE);
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), EBB_EWS_PHOTO_FAILED);
+	g_return_val_if_fail (E_IS_CONTACT (contact), EBB_EWS_PHOTO_FAILED);
 
 	email = e_contact_get_const (contact, E_CONTACT_EMAIL_1);
 	if (!email || !*email)
-		return FALSE;
+		return EBB_EWS_PHOTO_MISSING;
 
-	g_rec_mutex_lock (&bbews->priv->cnc_lock);
+	if (e_ews_connection_get_user_photo_sync (cnc, EWS_PRIORITY_LOW, email,
+	    E_EWS_SIZE_REQUESTED_96X96, &photo_base64, cancellable, &local_error) && photo_base64) {
+		guchar *bytes;
+		gsize nbytes;
 
-	if (bbews->priv->cnc) {
-		gchar *photo_base64 = NULL;
-		gboolean backoff_enabled;
+		bytes = g_base64_decode (photo_base64, &nbytes);
+		if (bytes && nbytes > 0) {
+			EContactPhoto *photo;
 
-		backoff_enabled = e_ews_connection_get_backoff_enabled (bbews->priv->cnc);
-		e_ews_connection_set_backoff_enabled (bbews->priv->cnc, FALSE);
+			photo = e_contact_photo_new ();
+			photo->type = E_CONTACT_PHOTO_TYPE_INLINED;
+			e_contact_photo_set_inlined (photo, bytes, nbytes);
+			e_contact_set (contact, E_CONTACT_PHOTO, photo);
+			e_contact_photo_free (photo);
 
-		if (e_ews_connection_get_user_photo_sync (bbews->priv->cnc, EWS_PRIORITY_MEDIUM, email,
-		    E_EWS_SIZE_REQUESTED_96X96, &photo_base64, cancellable, error) && photo_base64) {
-			guchar *bytes;
-			gsize nbytes;
+			result = EBB_EWS_PHOTO_FOUND;
+		} else {
+			result = EBB_EWS_PHOTO_MISSING;
+		}
 
-			bytes = g_base64_decode (photo_base64, &nbytes);
-			if (bytes && nbytes > 0) {
-				EContactPhoto *photo;
+		g_free (photo_base64);
+		g_free (bytes);
+	} else if (!local_error || g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_ITEMNOTFOUND)) {
+		/* The server answered, the user just does not have any photo */
+		result = EBB_EWS_PHOTO_MISSING;
+	} else if (g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_SERVERBUSY)) {
+		result = EBB_EWS_PHOTO_SERVER_BUSY;
+	} else if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+		   g_cancellable_is_cancelled (cancellable)) {
+		result = EBB_EWS_PHOTO_CANCELLED;
+	} else {
+		result = EBB_EWS_PHOTO_FAILED;
+	}
 
-				photo = e_contact_photo_new ();
-				photo->type = E_CONTACT_PHOTO_TYPE_INLINED;
-				e_contact_photo_set_inlined (photo, bytes, nbytes);
-				e_contact_set (contact, E_CONTACT_PHOTO, photo);
-				e_contact_photo_free (photo);
+	g_clear_error (&local_error);
+
+	return result;
+}
 
-				success = TRUE;
+static EBookMetaBackendInfo *ebb_ews_contact_to_info (EContact *contact, gboolean is_gal);
+
+typedef struct _GalPhotoFetcher {
+	EBookBackendEws *bbews;
+	EBookCache *book_cache;
+	EEwsConnection *cnc;
+	GCancellable *cancellable;
+
+	GMutex lock;
+	GCond cond;
+	GQueue pending; /* gchar *uid, the not checked yet */
+	GHashTable *in_progress; /* gchar *uid, being checked or not committed yet */
+	GSList *modified; /* EBookMetaBackendInfo *, not committed yet */
+	guint n_modified;
+	guint n_checked;
+	guint n_running; /* workers */
+	gboolean stop;
+
+	/* A token bucket limiting the request rate of all the workers */
+	gdouble rate; /* tokens per second */
+	gdouble tokens;
+	gdouble burst;
+	gint64 last_refill;
+	gint64 paused_until;
+} GalPhotoFetcher;
+
+static void
+ebb_ews_photo_fetcher_stop (GalPhotoFetcher *pf)
+{
+	g_mutex_lock (&pf->lock);
+	pf->stop = TRUE;
+	g_cond_broadcast (&pf->cond);
+	g_mutex_unlock (&pf->lock);
+}
+
+static void
+ebb_ews_photo_fetcher_cancelled_cb (GCancellable *cancellable,
+				    gpointer user_data)
+{
+	ebb_ews_photo_fetcher_stop (user_data);
+}
+
+/* Waits until the rate limit allows another request; returns FALSE
+   when the fetching had been stopped meanwhile */
+static gboolean
+ebb_ews_photo_fetcher_acquire (GalPhotoFetcher *pf)
+{
+	gboolean acquired = FALSE;
+
+	g_mutex_lock (&pf->lock);
+
+	while (!pf->stop && !acquired) {
+		gint64 now, busy_until, wait_until;
+
+		now = g_get_monotonic_time ();
+
+		/* Respect also the back off caused by the other requests on the connection */
+		busy_until = e_ews_connection_get_server_busy_until (pf->cnc);
+		if (busy_until > pf->paused_until)
+			pf->paused_until = busy_until;
+
+		if (now < pf->paused_until) {
+			pf->last_refill = now;
+			wait_until = pf->paused_until;
+		} else {
+			pf->tokens = MIN (pf->burst, pf->tokens + pf->rate * (now - pf->last_refill) / G_USEC_PER_SEC);
+			pf->last_refill = now;
+
+			if (pf->tokens >= 1.0) {
+				pf->tokens -= 1.0;
+				acquired = TRUE;
+				break;
 			}
 
-			g_free (photo_base64);
-			g_free (bytes);
+			wait_until = now + (gint64) ((1.0 - pf->tokens) * G_USEC_PER_SEC / pf->rate) + 1;
 		}
 
-		e_ews_connection_set_backoff_enabled (bbews->priv->cnc, backoff_enabled);
+		g_cond_wait_until (&pf->cond, &pf->lock, wait_until);
 	}
 
-	g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+	g_mutex_unlock (&pf->lock);
 
-	return success;
+	return acquired;
 }
 
-static EBookMetaBackendInfo *ebb_ews_contact_to_info (EContact *contact, gboolean is_gal);
+/* Additive increase on success, multiplicative decrease with a pause
+   when the server is busy */
+static void
+ebb_ews_photo_fetcher_feedback (GalPhotoFetcher *pf,
+				gboolean server_busy)
+{
+	g_mutex_lock (&pf->lock);
+
+	if (server_busy) {
+		gint64 now, busy_until;
+
+		now = g_get_monotonic_time ();
+		busy_until = e_ews_connection_get_server_busy_until (pf->cnc);
+		if (busy_until <= now)
+			busy_until = now + (EBB_EWS_GAL_PHOTO_BUSY_PAUSE_SECONDS * G_USEC_PER_SEC);
+
+		pf->rate = MAX (pf->rate / 2.0, EBB_EWS_GAL_PHOTO_RATE_MIN);
+		pf->tokens = 0.0;
+		pf->paused_until = MAX (pf->paused_until, busy_until);
+	} else {
+		pf->rate = MIN (pf->rate + EBB_EWS_GAL_PHOTO_RATE_STEP, EBB_EWS_GAL_PHOTO_RATE_MAX);
+	}
+
+	g_mutex_unlock (&pf->lock);
+}
+
+static gpointer
+ebb_ews_photo_fetcher_thread (gpointer user_data)
+{
+	GalPhotoFetcher *pf = user_data;
+
+	for (;;) {
+		EContact *contact = NULL;
+		EBookMetaBackendInfo *nfo;
+		EbbEwsPhotoResult result;
+		gboolean server_busy = FALSE;
+		gchar *uid;
+
+		g_mutex_lock (&pf->lock);
+		uid = pf->stop ? NULL : g_queue_pop_head (&pf->pending);
+		if (uid)
+			g_hash_table_add (pf->in_progress, g_strdup (uid));
+		g_mutex_unlock (&pf->lock);
+
+		if (!uid)
+			break;
+
+		if (!e_book_cache_get_contact (pf->book_cache, uid, FALSE, &contact, NULL, NULL) ||
+		    !contact || e_vcard_get_attribute (E_VCARD (contact), EVC_PHOTO) ||
+		    !ebb_ews_can_check_user_photo (contact)) {
+			g_clear_object (&contact);
+
+			g_mutex_lock (&pf->lock);
+			g_hash_table_remove (pf->in_progress, uid);
+			pf->n_checked++;
+			g_mutex_unlock (&pf->lock);
+
+			g_free (uid);
+			continue;
+		}
+
+		if (ebb_ews_photo_fetcher_acquire (pf)) {
+			gint64 busy_until;
+
+			busy_until = e_ews_connection_get_server_busy_until (pf->cnc);
+			result = ebb_ews_fetch_gal_photo_sync (pf->cnc, contact, pf->cancellable);
+
+			/* The connection itself waits and repeats the request, when the server
+			   asks for a back off; slow down also then, not only on the failure */
+			server_busy = result == EBB_EWS_PHOTO_SERVER_BUSY ||
+				e_ews_connection_get_server_busy_until (pf->cnc) != busy_until;
+		} else {
+			result = EBB_EWS_PHOTO_CANCELLED;
+		}
+
+		if (result != EBB_EWS_PHOTO_CANCELLED)
+			ebb_ews_photo_fetcher_feedback (pf, server_busy);
+
+		if (result == EBB_EWS_PHOTO_SERVER_BUSY || result == EBB_EWS_PHOTO_CANCELLED) {
+			/* Try again later, or after the restart */
+			g_mutex_lock (&pf->lock);
+			g_hash_table_remove (pf->in_progress, uid);
+			g_queue_push_head (&pf->pending, uid);
+			g_mutex_unlock (&pf->lock);
+
+			g_object_unref (contact);
+			continue;
+		}
+
+		/* Remember the missing photo for longer than the failure */
+		ebb_ews_store_photo_check_date (contact, NULL);
+		if (result == EBB_EWS_PHOTO_MISSING)
+			ebb_ews_store_x_attribute (contact, X_EWS_PHOTO_MISSING, "1");
+		else
+			ebb_ews_remove_x_attribute (contact, X_EWS_PHOTO_MISSING);
+
+		nfo = ebb_ews_contact_to_info (contact, pf->bbews->priv->is_gal);
+
+		g_mutex_lock (&pf->lock);
+		/* The modified stays in progress until committed */
+		if (nfo) {
+			pf->modified = g_slist_prepend (pf->modified, nfo);
+			pf->n_modified++;
+		} else {
+			g_hash_table_remove (pf->in_progress, uid);
+		}
+		pf->n_checked++;
+		g_cond_broadcast (&pf->cond);
+		g_mutex_unlock (&pf->lock);
+
+		g_object_unref (contact);
+		g_free (uid);
+	}
+
+	g_mutex_lock (&pf->lock);
+	pf->n_running--;
+	g_cond_broadcast (&pf->cond);
+	g_mutex_unlock (&pf->lock);
+
+	return NULL;
+}
+
+/* Stores both the not checked and the not committed yet */
+static void
+ebb_ews_photo_fetcher_save_pending (GalPhotoFetcher *pf)
+{
+	GString *pending = NULL;
+	GHashTableIter iter;
+	gpointer key;
+	GList *link;
+
+	g_mutex_lock (&pf->lock);
+
+	g_hash_table_iter_init (&iter, pf->in_progress);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		if (!pending)
+			pending = g_string_new (key);
+		else
+			g_string_append_printf (pending, "\n%s", (const gchar *) key);
+	}
+
+	for (link = pf->pending.head; link; link = g_list_next (link)) {
+		if (!pending)
+			pending = g_string_new (link->data);
+		else
+			g_string_append_printf (pending, "\n%s", (const gchar *) link->data);
+	}
+
+	g_mutex_unlock (&pf->lock);
+
+	e_cache_set_key (E_CACHE (pf->book_cache), EBB_EWS_GAL_PHOTOS_PENDING_KEY, pending ? pending->str : NULL, NULL);
+
+	if (pending)
+		g_string_free (pending, TRUE);
+}
 
 static void
 ebb_ews_fetch_gal_photos_thread (EBookBackend *book_backend,
@@ -2843,6 +3120,7 @@ ebb_ews_fetch_gal_photos_thread (EBookBackend *book_backend,
 	EBookCache *book_cache;
 	ESourceEwsFolder *ews_folder;
 	GSList *uids = user_data;
+	EEwsConnection *cnc = NULL;
 
 	book_cache = e_book_meta_backend_ref_cache (E_BOOK_META_BACKEND (bbews));
 	if (!book_cache)
@@ -2854,89 +3132,165 @@ ebb_ews_fetch_gal_photos_thread (EBookBackend *book_backend,
 
 		if (!bbews->priv->fetching_gal_photos && bbews->priv->cnc &&
 		    e_ews_connection_satisfies_server_version (bbews->priv->cnc, E_EWS_EXCHANGE_2013)) {
-			guint counter = 0, percent;
-			gdouble total_count, current_count;
-			GSList *link, *modified = NULL;
-
 			bbews->priv->fetching_gal_photos = TRUE;
+			cnc = g_object_ref (bbews->priv->cnc);
+		}
 
-			g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+		g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+	}
 
-			percent = (guint) -1;
-			current_count = 0;
-			total_count = g_slist_length (uids);
+	if (cnc) {
+		GalPhotoFetcher pf = { 0, };
+		GHashTable *known;
+		GSList *link, *modified;
+		GPtrArray *threads;
+		gchar *stored;
+		guint ii, n_workers, percent = (guint) -1, total;
+		gulong cancelled_id = 0;
+		gint64 pending_saved;
+
+		pf.bbews = bbews;
+		pf.book_cache = book_cache;
+		pf.cnc = cnc;
+		pf.cancellable = cancellable;
+		pf.rate = EBB_EWS_GAL_PHOTO_RATE_INITIAL;
+		pf.last_refill = g_get_monotonic_time ();
+		g_mutex_init (&pf.lock);
+		g_cond_init (&pf.cond);
+		g_queue_init (&pf.pending);
+		pf.in_progress = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+		/* Continue with what the previous run did not finish */
+		known = g_hash_table_new (g_str_hash, g_str_equal);
+		stored = e_cache_dup_key (E_CACHE (book_cache), EBB_EWS_GAL_PHOTOS_PENDING_KEY, NULL);
+		if (stored && *stored) {
+			gchar **strv;
+
+			strv = g_strsplit (stored, "\n", -1);
+			for (ii = 0; strv[ii]; ii++) {
+				if (*strv[ii] && g_hash_table_add (known, strv[ii]))
+					g_queue_push_tail (&pf.pending, strv[ii]);
+				else
+					g_free (strv[ii]);
+			}
 
-			/* Recheck the fetch-gal-photo property every time, in case the user changed it
-			   while the fetching had been ongoing. */
-			for (link = uids;
-			     link && !g_cancellable_is_cancelled (cancellable) && e_source_ews_folder_get_fetch_gal_photos (ews_folder);
-			     current_count++, link = g_slist_next (link)) {
-				const gchar *uid = link->data;
-				guint new_percent;
-				EContact *contact = NULL;
-				EBookMetaBackendInfo *nfo;
-				GError *local_error = NULL;
+			/* The strings are owned by the queue now */
+			g_free (strv);
+		}
+		g_free (stored);
 
-				new_percent = (guint) ((current_count / total_count) * 100.0);
-				if (new_percent != percent) {
-					percent = new_percent;
-					e_book_backend_foreach_view_notify_progress (book_backend, TRUE, (gint) percent, _("Fetching contact photos…"));
-				}
+		for (link = uids; link; link = g_slist_next (link)) {
+			gchar *uid = link->data;
 
-				if (!e_book_cache_get_contact (book_cache, uid, FALSE, &contact, cancellable, NULL) ||
-				    !contact || e_vcard_get_attribute (E_VCARD (contact), EVC_PHOTO) ||
-				    !ebb_ews_can_check_user_photo (contact)) {
-					g_clear_object (&contact);
-					continue;
-				}
+			if (uid && *uid && g_hash_table_add (known, uid)) {
+				g_queue_push_tail (&pf.pending, uid);
+				link->data = NULL;
+			}
+		}
 
-				if (!ebb_ews_fetch_gal_photo_sync (bbews, contact, cancellable, &local_error))
-					ebb_ews_store_photo_check_date (contact, NULL);
+		g_hash_table_destroy (known);
 
-				nfo = ebb_ews_contact_to_info (contact, bbews->priv->is_gal);
-				if (nfo) {
-					modified = g_slist_prepend (modified, nfo);
-					counter++;
-				}
+		total = g_queue_get_length (&pf.pending);
+		ebb_ews_photo_fetcher_save_pending (&pf);
+		pending_saved = g_get_monotonic_time ();
 
-				g_clear_object (&contact);
+		n_workers = MIN (ebb_ews_get_gal_photo_workers (), MAX (total, 1));
+		pf.burst = n_workers;
+		pf.tokens = 1.0;
 
-				/* Stop immediately when the server is busy */
-				if (g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_SERVERBUSY)) {
-					g_clear_error (&local_error);
-					break;
-				}
+		if (cancellable)
+			cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (ebb_ews_photo_fetcher_cancelled_cb), &pf, NULL);
 
-				g_clear_error (&local_error);
+		threads = g_ptr_array_new ();
+		pf.n_running = n_workers;
 
-				if (counter == 100) {
-					counter = 0;
-					e_book_meta_backend_process_changes_sync (E_BOOK_META_BACKEND (bbews), NULL, modified, NULL, cancellable, NULL);
-					g_slist_free_full (modified, e_book_meta_backend_info_free);
-					modified = NULL;
-				}
+		for (ii = 0; ii < n_workers; ii++) {
+			g_ptr_array_add (threads, g_thread_new ("ews-gal-photos", ebb_ews_photo_fetcher_thread, &pf));
+		}
+
+		g_mutex_lock (&pf.lock);
+
+		while (pf.n_running > 0 || pf.modified) {
+			gboolean running = pf.n_running > 0;
+			guint new_percent;
+
+			if (running && pf.n_modified < EBB_EWS_GAL_PHOTO_COMMIT_BATCH)
+				g_cond_wait_until (&pf.cond, &pf.lock, g_get_monotonic_time () + G_USEC_PER_SEC);
 
-				/* Give a chance to other threads to work with the connection, because the photos
-				   are not that important like the other operations. */
-				g_thread_yield ();
-				g_usleep (G_USEC_PER_SEC / 4);
-				g_thread_yield ();
+			new_percent = total > 0 ? (guint) (pf.n_checked * 100.0 / total) : 0;
+
+			if (pf.n_modified >= EBB_EWS_GAL_PHOTO_COMMIT_BATCH || (!pf.n_running && pf.modified)) {
+				modified = pf.modified;
+				pf.modified = NULL;
+				pf.n_modified = 0;
+			} else {
+				modified = NULL;
 			}
 
+			g_mutex_unlock (&pf.lock);
+
 			if (modified) {
-				e_book_meta_backend_process_changes_sync (E_BOOK_META_BACKEND (bbews), NULL, modified, NULL, cancellable, NULL);
+				GSList *mlink;
+
+				e_book_meta_backend_process_changes_sync (E_BOOK_META_BACKEND (bbews), NULL, modified, NULL, NULL, NULL);
+
+				g_mutex_lock (&pf.lock);
+				for (mlink = modified; mlink; mlink = g_slist_next (mlink)) {
+					EBookMetaBackendInfo *nfo = mlink->data;
+
+					g_hash_table_remove (pf.in_progress, nfo->uid);
+				}
+				g_mutex_unlock (&pf.lock);
+
 				g_slist_free_full (modified, e_book_meta_backend_info_free);
 			}
 
-			g_rec_mutex_lock (&bbews->priv->cnc_lock);
-			bbews->priv->fetching_gal_photos = FALSE;
-			g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+			/* An interrupted fetching continues from here, not from the beginning */
+			if (running && g_get_monotonic_time () - pending_saved >= EBB_EWS_GAL_PHOTOS_SAVE_PENDING_SECONDS * G_USEC_PER_SEC) {
+				ebb_ews_photo_fetcher_save_pending (&pf);
+				pending_saved = g_get_monotonic_time ();
+			}
 
-			if (percent != (guint) -1)
-				e_book_backend_foreach_view_notify_progress (book_backend, TRUE, -1, NULL);
-		} else {
-			g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+			if (new_percent != percent && running) {
+				percent = new_percent;
+				e_book_backend_foreach_view_notify_progress (book_backend, TRUE, (gint) percent, _("Fetching contact photos…"));
+			}
+
+			/* Recheck the fetch-gal-photo property every time, in case the user changed it
+			   while the fetching had been ongoing. */
+			if (!e_source_ews_folder_get_fetch_gal_photos (ews_folder))
+				ebb_ews_photo_fetcher_stop (&pf);
+
+			g_mutex_lock (&pf.lock);
+		}
+
+		g_mutex_unlock (&pf.lock);
+
+		for (ii = 0; ii < threads->len; ii++) {
+			g_thread_join (threads->pdata[ii]);
 		}
+
+		g_ptr_array_free (threads, TRUE);
+
+		if (cancelled_id)
+			g_cancellable_disconnect (cancellable, cancelled_id);
+
+		/* Empty when all had been checked */
+		ebb_ews_photo_fetcher_save_pending (&pf);
+
+		g_queue_clear_full (&pf.pending, g_free);
+		g_hash_table_destroy (pf.in_progress);
+		g_mutex_clear (&pf.lock);
+		g_cond_clear (&pf.cond);
+
+		g_rec_mutex_lock (&bbews->priv->cnc_lock);
+		bbews->priv->fetching_gal_photos = FALSE;
+		g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+
+		if (percent != (guint) -1)
+			e_book_backend_foreach_view_notify_progress (book_backend, TRUE, -1, NULL);
+
+		g_object_unref (cnc);
 	}
 
 	g_object_unref (book_cache);
@@ -2979,6 +3333,34 @@ ebb_ews_maybe_schedule_fetch_gal_photos (EBookBackendEws *bbews,
 	}
 }
 
+/* Schedules the photo fetching left unfinished by the previous run, if any */
+static void
+ebb_ews_maybe_resume_fetch_gal_photos (EBookBackendEws *bbews,
+				       EBookCache *book_cache)
+{
+	GSList *uids = NULL;
+	gchar *stored;
+
+	stored = e_cache_dup_key (E_CACHE (book_cache), EBB_EWS_GAL_PHOTOS_PENDING_KEY, NULL);
+
+	if (stored && *stored) {
+		gchar *ptr;
+
+		/* Just the first of them, the rest is read by the fetching thread itself */
+		ptr = strchr (stored, '\n');
+		if (ptr)
+			*ptr = '\0';
+
+		uids = g_slist_prepend (NULL, stored);
+		stored = NULL;
+
+		ebb_ews_maybe_schedule_fetch_gal_photos (bbews, &uids);
+	}
+
+	g_slist_free_full (uids, g_free);
+	g_free (stored);
+}
+
 struct _db_data {
 	EBookBackendEws *bbews;
 	GHashTable *uids;
@@ -2989,10 +3371,60 @@ struct _db_data {
 	gint percent;
 	gboolean fetch_gal_photos;
 	GSList *fetch_gal_photos_list; /* gchar *uid */
-	GSList *created_objects;
-	GSList *modified_objects;
+	GSList *created_objects; /* not committed yet */
+	GSList *modified_objects; /* not committed yet */
+	guint n_pending; /* how many are in the two above */
+	GSList *unchanged_uids; /* gchar * */
 };
 
+/* The decoded GAL contacts are stored in the cache in batches of this size,
+   instead of keeping all of them in memory until the end of the update */
+#define EBB_EWS_GAL_COMMIT_BATCH 1000
+
+static gboolean
+ebb_ews_gal_commit_pending (struct _db_data *data,
+			    GCancellable *cancellable,
+			    GError **error)
+{
+	gboolean success = TRUE;
+
+	if (data->created_objects || data->modified_objects) {
+		success = e_book_meta_backend_process_changes_sync (E_BOOK_META_BACKEND (data->bbews),
+			data->created_objects, data->modified_objects, NULL, cancellable, error);
+	}
+
+	g_slist_free_full (data->created_objects, e_book_meta_backend_info_free);
+	g_slist_free_full (data->modified_objects, e_book_meta_backend_info_free);
+	data->created_objects = NULL;
+	data->modified_objects = NULL;
+	data->n_pending = 0;
+
+	return success;
+}
+
+/* The GAL records are hashed and decoded by this many threads; it can be
+   overridden with the EWS_GAL_DECODE_WORKERS environment variable */
+static guint
+ebb_ews_get_gal_decode_workers (void)
+{
+	static guint n_workers = 0;
+
+	if (!n_workers) {
+		const gchar *envvar = g_getenv ("EWS_GAL_DECODE_WORKERS");
+		guint value = 0;
+
+		if (envvar && *envvar)
+			value = (guint) g_ascii_strtoull (envvar, NULL, 10);
+
+		if (!value)
+			value = g_get_num_processors ();
+
+		n_workers = CLAMP (value, 1, 32);
+	}
+
+	return n_workers;
+}
+
 static gboolean
 ebb_ews_gal_filter_contact (goffset offset,
 			    const gchar *sha1,
@@ -3007,9 +3439,11 @@ ebb_ews_gal_filter_contact (goffset offset,
 	if (!uid)
 		return TRUE;
 
-	/* Remove it from the hash tables so it doesn't get deleted at the end. */
+	/* Remember it, so it doesn't get deleted at the end. The data->uids is
+	   not changed here, because this can be called from a decoder thread,
+	   ahead of the ebb_ews_gal_store_contact() for the previous records. */
+	data->unchanged_uids = g_slist_prepend (data->unchanged_uids, g_strdup (uid));
 	g_hash_table_remove (data->sha1s, sha1);
-	g_hash_table_remove (data->uids, uid);
 	data->unchanged++;
 
 	/* Don't bother to parse and process this record. */
@@ -3037,7 +3471,7 @@ ebb_ews_gal_store_contact (EContact *contact,
 		if (data->fetch_gal_photos && !g_cancellable_is_cancelled (cancellable))
 			data->fetch_gal_photos_list = g_slist_prepend (data->fetch_gal_photos_list, g_strdup (uid));
 
-		nfo = e_book_meta_backend_info_new (uid, e_contact_get_const (contact, E_CONTACT_REV), NULL, NULL);
+		nfo = e_book_meta_backend_info_new (uid, e_contact_get_const (contact, E_CONTACT_REV), NULL, sha1);
 		nfo->object = e_vcard_to_string (E_VCARD (contact));
 
 		if (g_hash_table_remove (data->uids, uid)) {
@@ -3047,56 +3481,456 @@ ebb_ews_gal_store_contact (EContact *contact,
 			data->added++;
 			data->created_objects = g_slist_prepend (data->created_objects, nfo);
 		}
+
+		data->n_pending++;
+
+		if (data->n_pending >= EBB_EWS_GAL_COMMIT_BATCH)
+			ebb_ews_gal_commit_pending (data, cancellable, error);
 	}
 
 	if (data->percent != percent) {
 		data->percent = percent;
 
+		e_book_backend_foreach_view_notify_progress (E_BOOK_BACKEND (data->bbews), TRUE, (gint) percent, _("Updating Global Address List…"));
+
 		d (printf ("GAL processing contacts, %d%% complete (%d added, %d changed, %d unchanged\n",
 			   percent, data->added, data->changed, data->unchanged));
 	}
 }
 
+static void
+ebb_ews_gal_add_existing_uid (struct _db_data *data,
+			      const gchar *uid,
+			      const gchar *sha1)
+{
+	if (sha1)
+		g_hash_table_insert (data->sha1s, g_strdup (sha1), g_strdup (uid));
+	g_hash_table_insert (data->uids, g_strdup (uid), g_strdup (sha1));
+}
+
+/* Reads the SHA1 of the contacts stored before the SHA1 had been saved
+   in the 'extra' column from their vCard, and saves it there */
+static void
+ebb_ews_gal_migrate_sha1s (struct _db_data *data,
+			   EBookCache *book_cache,
+			   GHashTable *missing,
+			   GCancellable *cancellable)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GError *local_error = NULL;
+
+	e_cache_lock (E_CACHE (book_cache), E_CACHE_LOCK_WRITE);
+
+	g_hash_table_iter_init (&iter, missing);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const gchar *uid = key, *revision = value;
+		EContact *contact = NULL;
+		gchar *sha1 = NULL;
+
+		if (!local_error && e_book_cache_get_contact (book_cache, uid, FALSE, &contact, cancellable, NULL) && contact) {
+			sha1 = e_vcard_util_dup_x_attribute (E_VCARD (contact), X_EWS_GAL_SHA1);
+			if (sha1)
+				e_book_cache_set_contact_extra (book_cache, uid, sha1, cancellable, &local_error);
+		}
+
+		ebb_ews_gal_add_existing_uid (data, uid, sha1 ? sha1 : revision);
+
+		g_clear_object (&contact);
+		g_free (sha1);
+	}
+
+	e_cache_unlock (E_CACHE (book_cache), local_error ? E_CACHE_UNLOCK_ROLLBACK : E_CACHE_UNLOCK_COMMIT);
+
+	if (local_error) {
+		g_warning ("%s: Failed to store GAL SHA1: %s", G_STRFUNC, local_error->message);
+		g_clear_error (&local_error);
+	}
+}
+
+/* The GAL contacts store their SHA1 as the 'extra' data of the book cache,
+   thus the changes can be checked without reading the stored vCards */
 static gboolean
-ebb_ews_gather_existing_uids_cb (EBookCache *book_cache,
-				 const gchar *uid,
-				 const gchar *revision,
-				 const gchar *object,
-				 const gchar *extra,
-				 guint32 custom_flags,
-				 EOfflineState offline_state,
-				 gpointer user_data)
-{
-	struct _db_data *data = user_data;
-	EVCard *vcard;
-	gchar *dup_uid, *dup_sha1 = NULL;
-
-	g_return_val_if_fail (data != NULL, FALSE);
-	g_return_val_if_fail (data->uids != NULL, FALSE);
-	g_return_val_if_fail (data->sha1s != NULL, FALSE);
-	g_return_val_if_fail (object != NULL, FALSE);
+ebb_ews_gather_existing_uids (struct _db_data *data,
+			      EBookCache *book_cache,
+			      GCancellable *cancellable,
+			      GError **error)
+{
+	GHashTable *missing; /* gchar *uid ~> gchar *revision */
+	GSList *uids = NULL, *revisions = NULL, *link, *rlink;
+	GError *local_error = NULL;
+
+	/* Without the existing contacts every GAL contact would be reported
+	   as created and none as removed, thus fail the update instead */
+	if (!e_cache_get_uids (E_CACHE (book_cache), E_CACHE_EXCLUDE_DELETED, &uids, &revisions, cancellable, error))
+		return FALSE;
 
-	vcard = e_vcard_new_from_string (object);
-	if (vcard) {
-		dup_sha1 = e_vcard_util_dup_x_attribute (vcard, X_EWS_GAL_SHA1);
-		g_object_unref (vcard);
+	missing = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	/* One transaction for all the lookups */
+	e_cache_lock (E_CACHE (book_cache), E_CACHE_LOCK_READ);
+
+	for (link = uids, rlink = revisions; link && !local_error; link = g_slist_next (link), rlink = g_slist_next (rlink)) {
+		const gchar *uid = link->data;
+		gchar *sha1 = NULL;
+
+		if (!uid)
+			continue;
+
+		if (!e_book_cache_get_contact_extra (book_cache, uid, &sha1, cancellable, &local_error)) {
+			/* Removed meanwhile */
+			if (g_error_matches (local_error, E_CACHE_ERROR, E_CACHE_ERROR_NOT_FOUND))
+				g_clear_error (&local_error);
+		} else if (sha1 && *sha1) {
+			ebb_ews_gal_add_existing_uid (data, uid, sha1);
+		} else {
+			g_hash_table_insert (missing, g_strdup (uid), g_strdup (rlink ? rlink->data : NULL));
+		}
+
+		g_free (sha1);
 	}
 
-	dup_uid = g_strdup (uid);
-	if (!dup_sha1)
-		dup_sha1 = g_strdup (revision);
+	e_cache_unlock (E_CACHE (book_cache), E_CACHE_UNLOCK_NONE);
+
+	if (!local_error && g_hash_table_size (missing) > 0)
+		ebb_ews_gal_migrate_sha1s (data, book_cache, missing, cancellable);
+
+	g_hash_table_destroy (missing);
+	g_slist_free_full (uids, g_free);
+	g_slist_free_full (revisions, g_free);
 
-	g_hash_table_insert (data->uids, dup_uid, dup_sha1);
-	if (dup_sha1)
-		g_hash_table_insert (data->sha1s, dup_sha1, dup_uid);
+	if (local_error) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
 
 	return TRUE;
 }
 
+/* The full OAB file is downloaded, decompressed and decoded in a single pass:
+   the connection's thread queues the received data, a decode thread
+   decompresses them, writes the result into the .oab file, which is needed
+   for the later diff updates, and decodes the contacts from it. The connection's
+   thread is shared with other requests, thus it never waits for the decode
+   thread; the data, which do not fit into the memory, go to a spool file. */
+
+/* How much downloaded data can wait for the decode thread in the memory */
+#define EBB_EWS_GAL_STREAM_MAX_QUEUED (16 * 1024 * 1024)
+
+typedef struct _GalStreamData {
+	GMutex lock;
+	GCond cond;
+	GQueue chunks; /* GBytes * */
+	gsize queued_bytes;
+	GBytes *current;
+	gsize current_offset;
+
+	/* Used once the 'chunks' are full, until the decode thread reads all of it */
+	FILE *spool;
+	gchar *spool_path;
+	glong spool_written;
+	glong spool_read;
+
+	gboolean download_done;
+	gboolean decode_done;
+	gboolean stopped_by_decode;
+
+	FILE *output;
+	const gchar *oab_path;
+	EwsOabDecoder *eod;
+	GCancellable *cancellable;
+	GError *error; /* from the decode thread */
+} GalStreamData;
+
+static gboolean
+ebb_ews_gal_stream_data_cb (gconstpointer buffer,
+			    gsize length,
+			    gpointer user_data,
+			    GCancellable *cancellable,
+			    GError **error)
+{
+	GalStreamData *gsd = user_data;
+	gboolean success = TRUE;
+
+	g_mutex_lock (&gsd->lock);
+
+	if (gsd->decode_done) {
+		/* Either the data after the end of the OAB file, or the decoding failed */
+		if (gsd->error) {
+			gsd->stopped_by_decode = TRUE;
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "GAL decoding failed");
+			success = FALSE;
+		}
+	} else if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+		success = FALSE;
+	} else if (gsd->spool_written > gsd->spool_read ||
+		   gsd->queued_bytes + length > EBB_EWS_GAL_STREAM_MAX_QUEUED) {
+		/* Keep the order: once spooling, everything goes into the spool,
+		   until the decode thread reads all of it */
+		if (!gsd->spool) {
+			gint fd;
+
+			fd = g_file_open_tmp ("ebb-ews-gal-XXXXXX", &gsd->spool_path, error);
+			if (fd != -1) {
+				gsd->spool = fdopen (fd, "w+b");
+
+				if (!gsd->spool) {
+					g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+						"Failed to open '%s': %s", gsd->spool_path, g_strerror (errno));
+					g_close (fd, NULL);
+				}
+			}
+		}
+
+		if (gsd->spool && fseek (gsd->spool, gsd->spool_written, SEEK_SET) == 0 &&
+		    fwrite (buffer, 1, length, gsd->spool) == length) {
+			gsd->spool_written += length;
+			g_cond_broadcast (&gsd->cond);
+		} else {
+			if (gsd->spool) {
+				g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+					"Failed to write to '%s': %s", gsd->spool_path, g_strerror (errno));
+			}
+
+			success = FALSE;
+		}
+	} else {
+		g_queue_push_tail (&gsd->chunks, g_bytes_new (buffer, length));
+		gsd->queued_bytes += length;
+		g_cond_broadcast (&gsd->cond);
+	}
+
+	g_mutex_unlock (&gsd->lock);
+
+	return success;
+}
+
+static gssize
+ebb_ews_gal_stream_read_cb (gpointer buffer,
+			    gsize size,
+			    gpointer user_data,
+			    GError **error)
+{
+	GalStreamData *gsd = user_data;
+	gconstpointer data;
+	gsize data_len, nread;
+
+	g_mutex_lock (&gsd->lock);
+
+	while (!gsd->current) {
+		gsd->current = g_queue_pop_head (&gsd->chunks);
+		gsd->current_offset = 0;
+
+		if (gsd->current) {
+			gsd->queued_bytes -= g_bytes_get_size (gsd->current);
+			break;
+		}
+
+		/* The spooled data are newer than those in the 'chunks' */
+		if (gsd->spool_read < gsd->spool_written) {
+			nread = MIN (size, (gsize) (gsd->spool_written - gsd->spool_read));
+
+			if (fseek (gsd->spool, gsd->spool_read, SEEK_SET) != 0 ||
+			    fread (buffer, 1, nread, gsd->spool) != nread) {
+				g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+					"Failed to read from '%s': %s", gsd->spool_path, g_strerror (errno));
+				g_mutex_unlock (&gsd->lock);
+				return -1;
+			}
+
+			gsd->spool_read += nread;
+
+			/* Reuse the spool file from its beginning */
+			if (gsd->spool_read == gsd->spool_written)
+				gsd->spool_read = gsd->spool_written = 0;
+
+			g_mutex_unlock (&gsd->lock);
+
+			return nread;
+		}
+
+		if (gsd->download_done) {
+			g_mutex_unlock (&gsd->lock);
+			return 0;
+		}
+
+		g_cond_wait (&gsd->cond, &gsd->lock);
+	}
+
+	g_mutex_unlock (&gsd->lock);
+
+	/* The current chunk is used only by this thread */
+	data = g_bytes_get_data (gsd->current, &data_len);
+	nread = MIN (size, data_len - gsd->current_offset);
+	memcpy (buffer, ((const gchar *) data) + gsd->current_offset, nread);
+	gsd->current_offset += nread;
+
+	if (gsd->current_offset >= data_len)
+		g_clear_pointer (&gsd->current, g_bytes_unref);
+
+	return nread;
+}
+
+static gboolean
+ebb_ews_gal_stream_write_cb (gconstpointer buffer,
+			     gsize size,
+			     gpointer user_data,
+			     GError **error)
+{
+	GalStreamData *gsd = user_data;
+
+	if (fwrite (buffer, 1, size, gsd->output) != size) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			"Failed to write to '%s': %s", gsd->oab_path, g_strerror (errno));
+		return FALSE;
+	}
+
+	return ews_oab_decoder_push (gsd->eod, buffer, size, gsd->cancellable, error);
+}
+
+static gpointer
+ebb_ews_gal_stream_decode_thread (gpointer user_data)
+{
+	GalStreamData *gsd = user_data;
+	GError *local_error = NULL;
+
+	if (ews_oab_decompress_full_stream (ebb_ews_gal_stream_read_cb, ebb_ews_gal_stream_write_cb, gsd, &local_error))
+		ews_oab_decoder_push_finish (gsd->eod, &local_error);
+
+	g_mutex_lock (&gsd->lock);
+	gsd->error = local_error;
+	gsd->decode_done = TRUE;
+	g_cond_broadcast (&gsd->cond);
+	g_mutex_unlock (&gsd->lock);
+
+	return NULL;
+}
+
+static gchar *
+ebb_ews_download_and_decode_full_gal (EBookBackendEws *bbews,
+				      EwsOALDetails *full,
+				      struct _db_data *data,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	GalStreamData gsd;
+	GThread *thread;
+	CamelEwsSettings *ews_settings;
+	ESource *source;
+	const gchar *cache_dir;
+	gchar *oab_url, *full_url, *oab_file, *oab_path;
+	gboolean success;
+	GError *local_error = NULL;
+
+	ews_settings = ebb_ews_get_collection_settings (bbews);
+
+	/* oab url with oab.xml removed from the suffix */
+	oab_url = camel_ews_settings_dup_oaburl (ews_settings);
+	if (!oab_url || !*oab_url) {
+		g_free (oab_url);
+		g_set_error_literal (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_UNKNOWN, "OAB URL not set");
+		return NULL;
+	}
+
+	if (g_str_has_suffix (oab_url, "oab.xml"))
+		oab_url [strlen (oab_url) - 7] = '\0';
+
+	full_url = g_strconcat (oab_url, full->filename, NULL);
+	g_free (oab_url);
+
+	source = e_backend_get_source (E_BACKEND (bbews));
+	oab_file = g_strdup_printf ("%s-%d.oab", e_source_get_display_name (source), full->seq);
+	cache_dir = e_book_backend_get_cache_dir (E_BOOK_BACKEND (bbews));
+	oab_path = g_build_filename (cache_dir, oab_file, NULL);
+	g_free (oab_file);
+
+	memset (&gsd, 0, sizeof (GalStreamData));
+	g_mutex_init (&gsd.lock);
+	g_cond_init (&gsd.cond);
+	g_queue_init (&gsd.chunks);
+	gsd.oab_path = oab_path;
+	gsd.cancellable = cancellable;
+
+	gsd.output = g_fopen (oab_path, "wb");
+	if (!gsd.output) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			"Failed to create '%s': %s", oab_path, g_strerror (errno));
+		g_mutex_clear (&gsd.lock);
+		g_cond_clear (&gsd.cond);
+		g_free (full_url);
+		g_free (oab_path);
+		return NULL;
+	}
+
+	gsd.eod = ews_oab_decoder_new_for_push (bbews->priv->attachments_dir, ebb_ews_gal_filter_contact, ebb_ews_gal_store_contact, data);
+	ews_oab_decoder_set_n_workers (gsd.eod, ebb_ews_get_gal_decode_workers ());
+
+	thread = g_thread_new ("ebb-ews-gal-decode", ebb_ews_gal_stream_decode_thread, &gsd);
+
+	/* The decode thread stores the contacts meanwhile, which does not need the cnc_lock */
+	g_rec_mutex_lock (&bbews->priv->cnc_lock);
+
+	if (bbews->priv->cnc) {
+		success = e_ews_connection_download_oal_data_sync (bbews->priv->cnc, full_url, ebb_ews_gal_stream_data_cb, &gsd, NULL, NULL, cancellable, &local_error);
+	} else {
+		local_error = EC_ERROR_EX (E_CLIENT_ERROR_REPOSITORY_OFFLINE, NULL);
+		success = FALSE;
+	}
+
+	g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+
+	g_mutex_lock (&gsd.lock);
+	gsd.download_done = TRUE;
+	g_cond_broadcast (&gsd.cond);
+	g_mutex_unlock (&gsd.lock);
+
+	g_thread_join (thread);
+
+	/* The download error is only a consequence of the decode error */
+	if (gsd.error && (success || gsd.stopped_by_decode)) {
+		g_clear_error (&local_error);
+		local_error = g_steal_pointer (&gsd.error);
+	}
+
+	if (fclose (gsd.output) != 0 && !local_error) {
+		g_set_error (&local_error, G_IO_ERROR, g_io_error_from_errno (errno),
+			"Failed to write to '%s': %s", oab_path, g_strerror (errno));
+	}
+
+	if (local_error) {
+		g_propagate_error (error, local_error);
+		g_unlink (oab_path);
+		g_clear_pointer (&oab_path, g_free);
+	} else {
+		d (printf ("OAL file downloaded and decoded %s\n", oab_path));
+	}
+
+	if (gsd.spool)
+		fclose (gsd.spool);
+
+	if (gsd.spool_path) {
+		g_unlink (gsd.spool_path);
+		g_free (gsd.spool_path);
+	}
+
+	g_clear_pointer (&gsd.current, g_bytes_unref);
+	g_queue_clear_full (&gsd.chunks, (GDestroyNotify) g_bytes_unref);
+	g_clear_error (&gsd.error);
+	g_clear_object (&gsd.eod);
+	g_mutex_clear (&gsd.lock);
+	g_cond_clear (&gsd.cond);
+	g_free (full_url);
+
+	return oab_path;
+}
+
+/* Decodes the GAL from the 'inout_filename', or, when it points to NULL,
+   downloads the 'full' OAB file and decodes it at once, and sets its path */
 static gboolean
 ebb_ews_check_gal_changes (EBookBackendEws *bbews,
 			   EBookCache *book_cache,
-			   const gchar *filename,
+			   EwsOALDetails *full,
+			   gchar **inout_filename,
 			   GSList **out_created_objects, /*EBookMetaBackendInfo * */
 			   GSList **out_modified_objects, /*EBookMetaBackendInfo * */
 			   GSList **out_removed_objects, /*EBookMetaBackendInfo * */
@@ -3104,7 +3938,7 @@ ebb_ews_check_gal_changes (EBookBackendEws *bbews,
 			   GError **error)
 {
 	ESourceEwsFolder *ews_folder;
-	EwsOabDecoder *eod;
+	EwsOabDecoder *eod = NULL;
 	gboolean success = TRUE;
 	struct _db_data data;
 #if d(1) + 0
@@ -3114,7 +3948,8 @@ ebb_ews_check_gal_changes (EBookBackendEws *bbews,
 
 	g_return_val_if_fail (E_IS_BOOK_BACKEND_EWS (bbews), FALSE);
 	g_return_val_if_fail (E_IS_BOOK_CACHE (book_cache), FALSE);
-	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (inout_filename != NULL, FALSE);
+	g_return_val_if_fail (*inout_filename != NULL || full != NULL, FALSE);
 	g_return_val_if_fail (out_created_objects != NULL, FALSE);
 	g_return_val_if_fail (out_modified_objects != NULL, FALSE);
 	g_return_val_if_fail (out_removed_objects != NULL, FALSE);
@@ -3126,27 +3961,45 @@ ebb_ews_check_gal_changes (EBookBackendEws *bbews,
 	data.fetch_gal_photos_list = NULL;
 	data.created_objects = NULL;
 	data.modified_objects = NULL;
+	data.n_pending = 0;
+	data.unchanged_uids = NULL;
 	data.unchanged = data.changed = data.added = 0;
 	data.percent = 0;
-	data.uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-	data.sha1s = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	data.uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	data.sha1s = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
 	d (t1 = g_get_monotonic_time ());
 
-	e_book_cache_search_with_callback (book_cache, NULL, ebb_ews_gather_existing_uids_cb, &data, cancellable, NULL);
-
-	eod = ews_oab_decoder_new (filename, bbews->priv->attachments_dir, &local_error);
+	if (ebb_ews_gather_existing_uids (&data, book_cache, cancellable, &local_error) && *inout_filename) {
+		eod = ews_oab_decoder_new_mapped (*inout_filename, bbews->priv->attachments_dir, &local_error);
+		if (eod)
+			ews_oab_decoder_set_n_workers (eod, ebb_ews_get_gal_decode_workers ());
+	}
 	if (!local_error) {
 		GHashTableIter iter;
 		gpointer key;
 
-		success = ews_oab_decoder_decode (eod, ebb_ews_gal_filter_contact, ebb_ews_gal_store_contact, &data, cancellable, &local_error);
+		if (eod) {
+			success = ews_oab_decoder_decode (eod, ebb_ews_gal_filter_contact, ebb_ews_gal_store_contact, &data, cancellable, &local_error);
+		} else {
+			*inout_filename = ebb_ews_download_and_decode_full_gal (bbews, full, &data, cancellable, &local_error);
+			success = *inout_filename != NULL;
+		}
+
+		/* The previous batches are already stored */
+		if (success)
+			success = ebb_ews_gal_commit_pending (&data, cancellable, &local_error);
 
 		if (success) {
-			*out_created_objects = data.created_objects;
-			*out_modified_objects = data.modified_objects;
+			GSList *link;
+
+			*out_created_objects = NULL;
+			*out_modified_objects = NULL;
 			*out_removed_objects = NULL;
 
+			for (link = data.unchanged_uids; link; link = g_slist_next (link))
+				g_hash_table_remove (data.uids, link->data);
+
 			g_hash_table_iter_init (&iter, data.uids);
 			while (g_hash_table_iter_next (&iter, &key, NULL)) {
 				const gchar *uid = key;
@@ -3162,6 +4015,8 @@ ebb_ews_check_gal_changes (EBookBackendEws *bbews,
 		}
 
 		g_slist_free_full (data.fetch_gal_photos_list, g_free);
+
+		e_book_backend_foreach_view_notify_progress (E_BOOK_BACKEND (bbews), TRUE, -1, NULL);
 	} else {
 		success = FALSE;
 	}
@@ -3173,6 +4028,7 @@ ebb_ews_check_gal_changes (EBookBackendEws *bbews,
 
 	g_hash_table_destroy (data.sha1s);
 	g_hash_table_destroy (data.uids);
+	g_slist_free_full (data.unchanged_uids, g_free);
 	g_clear_object (&eod);
 
 	if (local_error)
@@ -3561,6 +4417,8 @@ ebb_ews_update_cache_for_expression (EBookBackendEws *bbews,
 						photo_check_date = ebb_ews_get_photo_check_date (old_contact);
 						if (photo_check_date)
 							ebb_ews_store_photo_check_date (contact, photo_check_date);
+						if (ebb_ews_get_x_attribute (old_contact, X_EWS_PHOTO_MISSING))
+							ebb_ews_store_x_attribute (contact, X_EWS_PHOTO_MISSING, "1");
 					}
 
 					g_clear_object (&old_contact);
@@ -3675,6 +4533,10 @@ ebb_ews_contact_to_info (EContact *contact,
 		NULL, NULL);
 	nfo->object = e_vcard_to_string (E_VCARD (contact));
 
+	/* Preserve the GAL record SHA1 in the 'extra' column */
+	if (is_gal)
+		nfo->extra = e_vcard_util_dup_x_attribute (E_VCARD (contact), X_EWS_GAL_SHA1);
+
 	return nfo;
 }
 
@@ -3957,8 +4819,6 @@ ebb_ews_get_changes_sync (EBookMetaBackend *meta_backend,
 	if (sync_tag_stamp_changed)
 		last_sync_tag = NULL;
 
-	g_rec_mutex_lock (&bbews->priv->cnc_lock);
-
 	if (bbews->priv->is_gal) {
 		CamelEwsSettings *ews_settings;
 		gchar *oab_url;
@@ -3978,7 +4838,15 @@ ebb_ews_get_changes_sync (EBookMetaBackend *meta_backend,
 				sequence = 0;
 
 			d (printf ("Ewsgal: Fetching oal full details file\n"));
-			if (!e_ews_connection_get_oal_detail_sync (bbews->priv->cnc, oab_url, bbews->priv->folder_id, NULL, last_sync_tag, &full_l, &etag, cancellable, &local_error)) {
+
+			/* The cnc_lock is held only for the network steps of the GAL update,
+			   thus the other operations do not wait for the whole update */
+			g_rec_mutex_lock (&bbews->priv->cnc_lock);
+
+			if (!bbews->priv->cnc) {
+				local_error = EC_ERROR_EX (E_CLIENT_ERROR_REPOSITORY_OFFLINE, NULL);
+				success = FALSE;
+			} else if (!e_ews_connection_get_oal_detail_sync (bbews->priv->cnc, oab_url, bbews->priv->folder_id, NULL, last_sync_tag, &full_l, &etag, cancellable, &local_error)) {
 				if (g_error_matches (local_error, E_SOUP_SESSION_ERROR, SOUP_STATUS_NOT_MODIFIED)) {
 					g_clear_error (&local_error);
 				} else {
@@ -3986,6 +4854,8 @@ ebb_ews_get_changes_sync (EBookMetaBackend *meta_backend,
 				}
 			}
 
+			g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+
 			if (success && full_l) {
 				guint32 delta_size = 0;
 
@@ -4020,38 +4890,45 @@ ebb_ews_get_changes_sync (EBookMetaBackend *meta_backend,
 			if (full) {
 				gchar *uncompressed_filename;
 
-				uncompressed_filename = ebb_ews_download_gal (bbews, book_cache, full, deltas, sequence, cancellable, &local_error);
-				if (!uncompressed_filename) {
-					success = FALSE;
-				} else {
-					d (printf ("Ewsgal: Removing old gal\n"));
-					/* remove old_gal_file */
-					ebb_ews_remove_old_gal_file (book_cache);
-
-					d (printf ("Ewsgal: Check for changes in GAL\n"));
-					success = ebb_ews_check_gal_changes (bbews, book_cache, uncompressed_filename,
-						out_created_objects, out_modified_objects, out_removed_objects, cancellable, &local_error);
-
-					if (success) {
-						if (e_cache_set_key (E_CACHE (book_cache), "oab-filename", uncompressed_filename, NULL)) {
-							/* Don't let it get deleted */
-							g_free (uncompressed_filename);
-							uncompressed_filename = NULL;
-						}
+				/* The diff files are applied to the current OAB file; the full file
+				   is downloaded and decoded at once in ebb_ews_check_gal_changes() */
+				uncompressed_filename = ebb_ews_download_gal_deltas (bbews, book_cache, full, deltas, sequence, cancellable);
 
-						e_cache_set_key_int (E_CACHE (book_cache), "gal-sequence", full->seq, NULL);
+				d (printf ("Ewsgal: Check for changes in GAL\n"));
+				success = ebb_ews_check_gal_changes (bbews, book_cache, full, &uncompressed_filename,
+					out_created_objects, out_modified_objects, out_removed_objects, cancellable, &local_error);
 
-						d (printf ("Ewsgal: sync successfully completed\n"));
+				if (success) {
+					gchar *old_filename;
+
+					d (printf ("Ewsgal: Removing old gal\n"));
+					/* The old file is kept until the new one is decoded */
+					old_filename = e_cache_dup_key (E_CACHE (book_cache), "oab-filename", NULL);
+					if (old_filename && g_strcmp0 (old_filename, uncompressed_filename) != 0)
+						g_unlink (old_filename);
+					g_free (old_filename);
+
+					if (e_cache_set_key (E_CACHE (book_cache), "oab-filename", uncompressed_filename, NULL)) {
+						/* Don't let it get deleted */
+						g_free (uncompressed_filename);
+						uncompressed_filename = NULL;
 					}
 
-					ews_oal_details_free (full);
+					e_cache_set_key_int (E_CACHE (book_cache), "gal-sequence", full->seq, NULL);
+
+					d (printf ("Ewsgal: sync successfully completed\n"));
 				}
 
+				ews_oal_details_free (full);
+
 				if (uncompressed_filename) {
 					/* preserve  the oab file once we are able to decode the differential updates */
 					g_unlink (uncompressed_filename);
 					g_free (uncompressed_filename);
 				}
+			} else if (success) {
+				/* Nothing changed in the GAL, only finish what the previous run did not */
+				ebb_ews_maybe_resume_fetch_gal_photos (bbews, book_cache);
 			}
 
 			g_slist_free_full (full_l, (GDestroyNotify) ews_oal_details_free);
@@ -4077,6 +4954,8 @@ ebb_ews_get_changes_sync (EBookMetaBackend *meta_backend,
 		GSList *items_created = NULL, *items_modified = NULL, *items_deleted = NULL, *link;
 		gboolean includes_last_item = TRUE;
 
+		g_rec_mutex_lock (&bbews->priv->cnc_lock);
+
 		success = e_ews_connection_sync_folder_items_sync (bbews->priv->cnc, EWS_PRIORITY_MEDIUM,
 			last_sync_tag, bbews->priv->folder_id, "IdOnly", NULL, EWS_MAX_FETCH_COUNT,
 			out_new_sync_tag, &includes_last_item, &items_created, &items_modified, &items_deleted,
@@ -4132,9 +5011,9 @@ ebb_ews_get_changes_sync (EBookMetaBackend *meta_backend,
 		g_slist_free_full (items_created, g_object_unref);
 		g_slist_free_full (items_modified, g_object_unref);
 		g_slist_free_full (items_deleted, g_free);
-	}
 
-	g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+		g_rec_mutex_unlock (&bbews->priv->cnc_lock);
+	}
 
 	ebb_ews_convert_error_to_client_error (error);
 	ebb_ews_maybe_disconnect_sync (bbews, error, cancellable);
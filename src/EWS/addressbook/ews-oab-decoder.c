@@ -6,7 +6,6 @@
 
 #include "evolution-ews-config.h"
 
-#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <glib/gstdio.h>
@@ -25,16 +24,41 @@
 struct _EwsOabDecoderPrivate {
 	gchar *cache_dir;
 	GInputStream *fis;
+	goffset fis_size; /* size of the file behind the 'fis' */
+	GMappedFile *mapped; /* used instead of the 'fis', when set */
 
 	guint32 total_records;
 	GSList *hdr_props;
 	GSList *oab_props;
 
 	GHashTable *prop_index_dict;
+
+	/* For the data passed in with ews_oab_decoder_push() */
+	gint push_state; /* EwsOabPushState */
+	GByteArray *push_buffer;
+	goffset push_offset; /* file offset of the push_buffer start */
+	guint32 push_n_records;
+	GChecksum *push_sum;
+	EwsOabContactFilterCb push_filter_cb;
+	EwsOabContactAddedCb push_cb;
+	gpointer push_user_data;
+	struct _EwsOabDecodeEngine *push_engine;
+
+	guint n_workers;
 };
 
+typedef enum {
+	EWS_OAB_PUSH_HEADER,
+	EWS_OAB_PUSH_METADATA,
+	EWS_OAB_PUSH_HDR_RECORD,
+	EWS_OAB_PUSH_RECORDS,
+	EWS_OAB_PUSH_DONE
+} EwsOabPushState;
+
 G_DEFINE_TYPE_WITH_PRIVATE (EwsOabDecoder, ews_oab_decoder, G_TYPE_OBJECT)
 
+static void ews_oab_decode_engine_free (gpointer ptr);
+
 /* The of properties which will be accumulated and later set in EContact */
 typedef struct {
 	EContactAddress *addr;
@@ -288,9 +312,13 @@ ews_oab_decoder_finalize (GObject *object)
 
 	g_clear_pointer (&eod->priv->cache_dir, g_free);
 	g_clear_object (&eod->priv->fis);
+	g_clear_pointer (&eod->priv->mapped, g_mapped_file_unref);
 	g_clear_pointer (&eod->priv->prop_index_dict, g_hash_table_destroy);
 	g_clear_pointer (&eod->priv->oab_props, g_slist_free);
 	g_clear_pointer (&eod->priv->hdr_props, g_slist_free);
+	g_clear_pointer (&eod->priv->push_buffer, g_byte_array_unref);
+	g_clear_pointer (&eod->priv->push_sum, g_checksum_free);
+	g_clear_pointer (&eod->priv->push_engine, ews_oab_decode_engine_free);
 
 	G_OBJECT_CLASS (ews_oab_decoder_parent_class)->finalize (object);
 }
@@ -309,6 +337,7 @@ ews_oab_decoder_init (EwsOabDecoder *self)
 	gint i;
 
 	self->priv = ews_oab_decoder_get_instance_private (self);
+	self->priv->n_workers = 1;
 
 	self->priv->prop_index_dict = g_hash_table_new (g_direct_hash, g_direct_equal);
 	for (i = 1; i <= G_N_ELEMENTS (prop_map); i++)
@@ -321,6 +350,7 @@ ews_oab_decoder_new (const gchar *oab_filename,
                      GError **error)
 {
 	EwsOabDecoder *eod;
+	GFileInfo *info;
 	GError *err = NULL;
 	GFile *gf = NULL;
 
@@ -331,6 +361,13 @@ ews_oab_decoder_new (const gchar *oab_filename,
 	if (err)
 		goto exit;
 
+	info = g_file_input_stream_query_info (G_FILE_INPUT_STREAM (eod->priv->fis), G_FILE_ATTRIBUTE_STANDARD_SIZE, NULL, &err);
+	if (err)
+		goto exit;
+
+	eod->priv->fis_size = g_file_info_get_size (info);
+	g_object_unref (info);
+
 	eod->priv->cache_dir = g_strdup (cache_dir);
 
  exit:
@@ -345,6 +382,101 @@ ews_oab_decoder_new (const gchar *oab_filename,
 	return eod;
 }
 
+/**
+ * ews_oab_decoder_new_mapped:
+ * @oab_filename: the decompressed OAB file
+ * @cache_dir: where to store the contact photos and such
+ * @error: return location for a #GError, or %NULL
+ *
+ * Creates a decoder like ews_oab_decoder_new(), only the file is mapped
+ * into memory and the records are decoded in place, which avoids reading
+ * and allocating each of the values.
+ *
+ * Returns: (transfer full) (nullable): a new #EwsOabDecoder, or %NULL on error
+ **/
+EwsOabDecoder *
+ews_oab_decoder_new_mapped (const gchar *oab_filename,
+			    const gchar *cache_dir,
+			    GError **error)
+{
+	EwsOabDecoder *eod;
+
+	g_return_val_if_fail (oab_filename != NULL, NULL);
+
+	eod = g_object_new (EWS_TYPE_OAB_DECODER, NULL);
+
+	eod->priv->mapped = g_mapped_file_new (oab_filename, FALSE, error);
+	if (!eod->priv->mapped) {
+		g_object_unref (eod);
+		return NULL;
+	}
+
+	eod->priv->cache_dir = g_strdup (cache_dir);
+
+	return eod;
+}
+
+/**
+ * ews_oab_decoder_new_for_push:
+ * @cache_dir: where to store the contact photos and such
+ * @filter_cb: (nullable): a filter callback, or %NULL
+ * @cb: a callback called for each decoded contact
+ * @user_data: user data for the callbacks
+ *
+ * Creates a decoder, which decodes the decompressed OAB data passed in
+ * by parts with ews_oab_decoder_push(), as they are available, instead
+ * of reading them from a file. The callbacks have the same meaning
+ * as with ews_oab_decoder_decode(), and they are called from within
+ * the ews_oab_decoder_push().
+ *
+ * Returns: (transfer full): a new #EwsOabDecoder
+ **/
+EwsOabDecoder *
+ews_oab_decoder_new_for_push (const gchar *cache_dir,
+			      EwsOabContactFilterCb filter_cb,
+			      EwsOabContactAddedCb cb,
+			      gpointer user_data)
+{
+	EwsOabDecoder *eod;
+
+	g_return_val_if_fail (cb != NULL, NULL);
+
+	eod = g_object_new (EWS_TYPE_OAB_DECODER, NULL);
+	eod->priv->cache_dir = g_strdup (cache_dir);
+	eod->priv->push_state = EWS_OAB_PUSH_HEADER;
+	eod->priv->push_buffer = g_byte_array_new ();
+	eod->priv->push_sum = g_checksum_new (G_CHECKSUM_SHA1);
+	eod->priv->push_filter_cb = filter_cb;
+	eod->priv->push_cb = cb;
+	eod->priv->push_user_data = user_data;
+
+	return eod;
+}
+
+/**
+ * ews_oab_decoder_set_n_workers:
+ * @eod: an #EwsOabDecoder
+ * @n_workers: how many threads can decode the records
+ *
+ * Sets how many threads can hash and decode the records in parallel.
+ * The default is one, which decodes the records in the calling thread.
+ * The callbacks are called in the record order and their results are
+ * the same, only the filter callback is called from the worker threads
+ * and possibly before the contact-added callback of the previous records
+ * is called. The contact-added callback is always called from the thread,
+ * which passes in the data.
+ *
+ * Set it before the decoding starts.
+ **/
+void
+ews_oab_decoder_set_n_workers (EwsOabDecoder *eod,
+			       guint n_workers)
+{
+	g_return_if_fail (EWS_IS_OAB_DECODER (eod));
+
+	eod->priv->n_workers = n_workers;
+}
+
 static GQuark
 ews_oab_decoder_error_quark (void)
 {
@@ -373,97 +505,92 @@ ews_oab_read_uint32 (GInputStream *is,
                      GCancellable *cancellable,
                      GError **error)
 {
-	gchar *str = g_malloc0 (4);
+	guchar str[4];
 	guint32 ret = 0;
 
 	g_input_stream_read (is, str, 4, cancellable, error);
 	if (!*error)
 		ret = EndGetI32 (str);
 
-	g_free (str);
 	return ret;
 }
 
-static guint16
-ews_oab_read_uint16 (GInputStream *is,
-                     GCancellable *cancellable,
-                     GError **error)
-{
-	guchar str[2];
-	guint16 ret = 0;
-
-	g_input_stream_read (is, str, 2, cancellable, error);
-	if (!*error)
-		ret = EndGetI16 (str);
+/* A bounds-checked cursor over a record in memory, either in the mapped
+   file or in a buffer. The values are read in place, without copying them. */
+typedef struct {
+	const guchar *data;
+	gsize len;
+	gsize pos;
+} EwsOabBuffer;
 
-	return ret;
+static void
+ews_oab_buffer_init (EwsOabBuffer *buf,
+		     gconstpointer data,
+		     gsize len)
+{
+	buf->data = data;
+	buf->len = len;
+	buf->pos = 0;
 }
 
-static gint
-get_pos (const gchar *str,
-         gsize len,
-         gchar stop)
+static gboolean
+ews_oab_buffer_ensure (EwsOabBuffer *buf,
+		       gsize size,
+		       GError **error)
 {
-	gsize i = 0;
+	if (buf->len - buf->pos < size) {
+		g_set_error_literal (error, EOD_ERROR, 1, "OAB record is truncated");
+		return FALSE;
+	}
 
-	while (i < len && str[i] != stop)
-		i++;
-	return i;
+	return TRUE;
 }
 
-/* Read upto the stop char include the same */
-static gchar *
-ews_oab_read_upto (GInputStream *is,
-                   gchar stop,
-                   GCancellable *cancellable,
-                   GError **error)
+static gboolean
+ews_oab_buffer_read_uint8 (EwsOabBuffer *buf,
+			   guint8 *out_value,
+			   GError **error)
 {
-	gsize size = 50;
-	GString *str;
-
-	str = g_string_sized_new (size);
-	while (1) {
-		gsize len;
-		gsize bytes_read;
-		gchar *c;
-
-		/* Prevent unbounded memory growth from malformed input */
-		if (str->len > 1024 * 1024 * 1024) {
-			g_set_error_literal (error, EOD_ERROR, 1, "OAB string exceeds maximum allowed size");
-			g_string_free (str, TRUE);
-
-			return NULL;
-		}
+	if (!ews_oab_buffer_ensure (buf, 1, error))
+		return FALSE;
 
-		c = g_malloc0 (size);
+	*out_value = buf->data[buf->pos];
+	buf->pos++;
 
-		if (!g_input_stream_read_all (is, c, size, &bytes_read,
-					      cancellable, error)) {
-			g_free (c);
-			break;
-		}
-
-		if (bytes_read != size)
-			size = bytes_read;
+	return TRUE;
+}
 
-		len = get_pos (c, size, stop);
-		if (len)
-			g_string_append_len (str, c, len);
+static gboolean
+ews_oab_buffer_read_uint32 (EwsOabBuffer *buf,
+			    guint32 *out_value,
+			    GError **error)
+{
+	if (!ews_oab_buffer_ensure (buf, 4, error))
+		return FALSE;
 
-		g_free (c);
+	*out_value = EndGetI32 (buf->data + buf->pos);
+	buf->pos += 4;
 
-		if (len == 0 || len < size) {
-			goffset seek = (goffset) len + 1 - (goffset) size;
+	return TRUE;
+}
 
-			/* seek back */
-			g_seekable_seek ((GSeekable *) is, seek, G_SEEK_CUR, cancellable, error);
-			break;
-		}
+/* Returns the NUL-terminated string in place */
+static const gchar *
+ews_oab_buffer_read_string (EwsOabBuffer *buf,
+			    GError **error)
+{
+	const guchar *str, *end;
 
-		size *= 2;
+	str = buf->data + buf->pos;
+	end = buf->pos < buf->len ? memchr (str, '\0', buf->len - buf->pos) : NULL;
+	if (!end) {
+		g_set_error_literal (error, EOD_ERROR, 1, "OAB string is not terminated");
+		return NULL;
 	}
 
-	return g_string_free (str, FALSE);
+	buf->pos += end - str + 1;
+
+	return (const gchar *) str;
 }
 
 typedef struct {
@@ -578,7 +705,7 @@ ews_decode_metadata (EwsOabDecoder *eod, GInputStream *stream,
 }
 
 static gboolean
-ews_is_bit_set (const gchar *str,
+ews_is_bit_set (const guchar *str,
                 guint32 pos)
 {
 	guint32 index, bit_pos;
@@ -592,91 +719,80 @@ ews_is_bit_set (const gchar *str,
 		return FALSE;
 }
 
-static guint32
-ews_decode_uint32 (EwsOabDecoder *eod, GInputStream *stream,
-                   GCancellable *cancellable,
-                   GError **error)
+/* The first byte is either the value itself, or the count of
+   the following little-endian bytes, with the high bit set */
+static gboolean
+ews_decode_uint32 (EwsOabBuffer *buf,
+		   guint32 *out_value,
+		   GError **error)
 {
 	guint8 first;
-	guint32 ret = 0, num;
+	guint32 ret = 0, num, i;
 
-	g_input_stream_read (stream, &first, 1, cancellable, error);
-	if (*error)
-		return ret;
-
-	if (first & 0x80)
-		num = first & 0x0F;
-	else
-		return (guint32) first;
+	if (!ews_oab_buffer_read_uint8 (buf, &first, error))
+		return FALSE;
 
-	if (num == 1) {
-		g_input_stream_read (stream, &first, 1, cancellable, error);
-		return (guint32) first;
+	if (!(first & 0x80)) {
+		*out_value = first;
+		return TRUE;
 	}
 
-	if (num == 2)
-		ret = ews_oab_read_uint16 (stream, cancellable, error);
-	if (num == 3) {
-		gchar *tmp, *str = g_malloc0 (num + 1);
+	num = first & 0x0F;
+	if (num < 1 || num > 4) {
+		g_set_error (error, EOD_ERROR, 1, "invalid encoded integer 0x%x", first);
+		return FALSE;
+	}
 
-		g_input_stream_read (stream, str, num, cancellable, error);
-		/* not sure if its the right way to do, test it */
-		tmp = g_strconcat ("0", str, NULL);
+	if (!ews_oab_buffer_ensure (buf, num, error))
+		return FALSE;
 
-		sscanf (tmp, "%"G_GUINT32_FORMAT, &ret);
-		ret = GUINT32_SWAP_LE_BE (ret);
+	for (i = 0; i < num; i++)
+		ret |= ((guint32) buf->data[buf->pos + i]) << (8 * i);
 
-		g_free (str);
-		g_free (tmp);
-	} else if (num == 4)
-		ret = ews_oab_read_uint32 (stream, cancellable, error);
+	buf->pos += num;
+	*out_value = ret;
 
-	return ret;
+	return TRUE;
 }
 
+/* The returned bytes point into the buffer */
 static GBytes *
-ews_decode_binary (EwsOabDecoder *eod, GInputStream *stream,
-                   GCancellable *cancellable,
-                   GError **error)
+ews_decode_binary (EwsOabBuffer *buf,
+		   GError **error)
 {
+	GBytes *val;
 	guint32 len;
-	gchar *binary;
-	GBytes *val = NULL;
 
-	len = ews_decode_uint32 (eod, stream, cancellable, error);
-	if (*error)
+	if (!ews_decode_uint32 (buf, &len, error) ||
+	    !ews_oab_buffer_ensure (buf, len, error))
 		return NULL;
-	binary = g_malloc (len);
-	g_input_stream_read (stream, binary, len, cancellable, error);
-	if (*error) {
-		g_free (binary);
-		goto exit;
-	}
 
-	val = g_bytes_new_take (binary, len);
-	binary = NULL;
+	val = g_bytes_new_static (buf->data + buf->pos, len);
+	buf->pos += len;
 
-exit:
 	return val;
 }
 
-static gpointer
-ews_decode_oab_prop (EwsOabDecoder *eod, GInputStream *stream,
-                     guint32 prop_id,
-                     GCancellable *cancellable,
-                     GError **error)
+/* The strings in the returned value point into the buffer; free
+   the value with ews_destroy_oab_prop() */
+static gboolean
+ews_decode_oab_prop (EwsOabBuffer *buf,
+		     guint32 prop_id,
+		     gpointer *out_value,
+		     GError **error)
 {
 	guint32 prop_type;
 	gpointer ret_val = NULL;
+	gboolean success = TRUE;
 
 	prop_type = prop_id & 0x0000FFFF;
 
 	switch (prop_type) {
 		case EWS_PTYP_INTEGER32:
 		{
-			guint32 val;
+			guint32 val = 0;
 
-			val = ews_decode_uint32 (eod, stream, cancellable, error);
+			success = ews_decode_uint32 (buf, &val, error);
 			ret_val = GUINT_TO_POINTER (val);
 
 			d (g_print ("prop id %X prop type: int32 value %d \n", prop_id, val);)
@@ -685,9 +801,9 @@ ews_decode_oab_prop (EwsOabDecoder *eod, GInputStream *stream,
 		}
 		case EWS_PTYP_BOOLEAN:
 		{
-			guchar val;
+			guint8 val = 0;
 
-			g_input_stream_read (stream, &val, 1, cancellable, error);
+			success = ews_oab_buffer_read_uint8 (buf, &val, error);
 			ret_val = GUINT_TO_POINTER ((guint) val);
 			d (g_print ("prop id %X prop type: bool value %d \n", prop_id, val);)
 
@@ -696,9 +812,10 @@ ews_decode_oab_prop (EwsOabDecoder *eod, GInputStream *stream,
 		case EWS_PTYP_STRING8:
 		case EWS_PTYP_STRING:
 		{
-			gchar *val;
+			const gchar *val;
 
-			val = ews_oab_read_upto (stream, '\0', cancellable, error);
+			val = ews_oab_buffer_read_string (buf, error);
+			success = val != NULL;
 			ret_val = (gpointer) val;
 
 			d (g_print ("prop id %X prop type: string value %s \n", prop_id, val);)
@@ -706,8 +823,9 @@ ews_decode_oab_prop (EwsOabDecoder *eod, GInputStream *stream,
 		}
 		case EWS_PTYP_BINARY:
 		{
-			ret_val = ews_decode_binary (eod, stream, cancellable, error);
-			d (g_print ("prop id %X prop type: binary size %zd \n", prop_id, g_bytes_get_size ((GBytes *)ret_val)));
+			ret_val = ews_decode_binary (buf, error);
+			success = ret_val != NULL;
+			d (g_print ("prop id %X prop type: binary size %zd \n", prop_id, ret_val ? g_bytes_get_size ((GBytes *)ret_val) : 0));
 			break;
 		}
 		case EWS_PTYP_MULTIPLEINTEGER32:
@@ -715,56 +833,46 @@ ews_decode_oab_prop (EwsOabDecoder *eod, GInputStream *stream,
 		case EWS_PTYP_MULTIPLESTRING:
 		case EWS_PTYP_MULTIPLEBINARY:
 		{
-			guint32 num, i;
+			guint32 num = 0, i;
 			GSList *list = NULL;
 
-			num = ews_decode_uint32 (eod, stream, cancellable, error);
-			if (*error)
+			if (!ews_decode_uint32 (buf, &num, error)) {
+				success = FALSE;
 				break;
+			}
+
 			d (g_print ("prop id %X prop type: multi-num %d \n", prop_id, num);)
 
-			for (i = 0; i < num; i++) {
+			for (i = 0; i < num && success; i++) {
 				if (prop_type == EWS_PTYP_MULTIPLEINTEGER32) {
-					gpointer val;
 					guint32 v = 0;
 
-					v = ews_decode_uint32 (eod, stream, cancellable, error);
-					val = GUINT_TO_POINTER (v);
-					list = g_slist_prepend (list, val);
+					success = ews_decode_uint32 (buf, &v, error);
+					if (success)
+						list = g_slist_prepend (list, GUINT_TO_POINTER (v));
 
 					d (g_print ("prop id %X prop type: multi-int32 %d \n", prop_id, v);)
-					if (*error) {
-						g_slist_free (list);
-						return NULL;
-					}
 				} else if (prop_type == EWS_PTYP_MULTIPLEBINARY) {
 					GBytes *val;
 
-					val = ews_decode_binary (eod, stream, cancellable, error);
-					if (!val) {
-						g_slist_foreach (list, (GFunc) g_bytes_unref, NULL);
-						g_slist_free (list);
-						return NULL;
+					val = ews_decode_binary (buf, error);
+					success = val != NULL;
+					if (success) {
+						d (g_print ("prop id %X prop type: multi-bin size %zd\n", prop_id, g_bytes_get_size (val)));
+						list = g_slist_prepend (list, val);
 					}
-
-					d (g_print ("prop id %X prop type: multi-bin size %zd\n", prop_id, g_bytes_get_size (val)));
-
-					list = g_slist_prepend (list, val);
 				} else {
-					gchar *val;
+					const gchar *val;
 
-					val = ews_oab_read_upto (stream, '\0', cancellable, error);
-					if (!val) {
-						g_slist_foreach (list, (GFunc) g_free, NULL);
-						g_slist_free (list);
-						return NULL;
+					val = ews_oab_buffer_read_string (buf, error);
+					success = val != NULL;
+					if (success) {
+						d (g_print ("prop id %X prop type: multi-str '%s'\n", prop_id, val));
+						list = g_slist_prepend (list, (gpointer) val);
 					}
-
-					d (g_print ("prop id %X prop type: multi-str '%s'\n", prop_id, val));
-					list = g_slist_prepend (list, val);
 				}
-
 			}
+
 			ret_val = list;
 
 			break;
@@ -774,7 +882,9 @@ ews_decode_oab_prop (EwsOabDecoder *eod, GInputStream *stream,
 			break;
 	}
 
-	return ret_val;
+	*out_value = ret_val;
+
+	return success;
 }
 
 static void
@@ -788,20 +898,19 @@ ews_destroy_oab_prop (guint32 prop_id, gpointer val)
 		case EWS_PTYP_INTEGER32:
 		case EWS_PTYP_BOOLEAN:
 			break;
-		case EWS_PTYP_BINARY:
-			g_bytes_unref (val);
-			break;
 		case EWS_PTYP_STRING8:
 		case EWS_PTYP_STRING:
-			g_free ((gchar *) val);
+			/* points into the buffer */
+			break;
+		case EWS_PTYP_BINARY:
+			if (val)
+				g_bytes_unref (val);
 			break;
 		case EWS_PTYP_MULTIPLEBINARY:
 			g_slist_free_full ((GSList *) val, (GDestroyNotify) g_bytes_unref);
 			break;
 		case EWS_PTYP_MULTIPLESTRING8:
 		case EWS_PTYP_MULTIPLESTRING:
-			g_slist_free_full ((GSList *) val, g_free);
-			break;
 		case EWS_PTYP_MULTIPLEINTEGER32:
 			g_slist_free ((GSList *) val);
 			break;
@@ -888,52 +997,47 @@ ews_decode_addressbook_write_display_type (EContact **contact,
 }
 
 /**
- * ews_decode_addressbook_record 
- * @eod: 
+ * ews_decode_addressbook_record
+ * @eod:
+ * @buf: the record data, without the leading size
  * @contact: Pass a valid EContact for decoding the address-book record. NULL in case of header record.
  * @props:
- * @cancellable: 
- * @error: 
- * 
+ * @error:
+ *
  * Decodes the address-book records starting from presence bit array.
  *
  *
- * Returns: 
+ * Returns:
  **/
 static gboolean
 ews_decode_addressbook_record (EwsOabDecoder *eod,
-			       GInputStream *stream,
+			       EwsOabBuffer *buf,
 			       EContact *contact,
 			       GSList *props,
-			       GCancellable *cancellable,
 			       GError **error)
 {
-	EwsDeferredSet *dset = NULL;
+	EwsDeferredSet dset = { NULL };
+	const guchar *bit_str;
 	guint bit_array_size, i, len;
-	gchar *bit_str;
+	GSList *link;
 	gboolean ret = TRUE;
 
 	len = g_slist_length (props);
-	bit_array_size = (guint) ceil (len / 8.0);
-	bit_str = g_malloc0 (bit_array_size);
-	g_input_stream_read (stream, bit_str, bit_array_size, cancellable, error);
-	if (*error) {
-		ret = FALSE;
-		goto exit;
-	}
+	bit_array_size = (len + 7) / 8;
+	if (!ews_oab_buffer_ensure (buf, bit_array_size, error))
+		return FALSE;
 
-	if (contact)
-		dset = g_new0 (EwsDeferredSet, 1);
+	bit_str = buf->data + buf->pos;
+	buf->pos += bit_array_size;
 
-	for (i = 0; i < len; i++) {
-		gpointer val, index;
+	for (i = 0, link = props; i < len; i++, link = g_slist_next (link)) {
+		gpointer val = NULL, index;
 		guint32 prop_id;
 
 		if (!ews_is_bit_set (bit_str, i))
 			continue;
 
-		val = g_slist_nth_data (props, i);
-		prop_id = GPOINTER_TO_UINT (val);
+		prop_id = GPOINTER_TO_UINT (link->data);
 
 		/* these are not encoded in the OAB, according to
 		   http://msdn.microsoft.com/en-us/library/gg671985%28v=EXCHG.80%29.aspx
@@ -941,7 +1045,16 @@ ews_decode_addressbook_record (EwsOabDecoder *eod,
 		if ((prop_id & 0xFFFF) == EWS_PTYP_OBJECT)
 			continue;
 
-		val = ews_decode_oab_prop (eod, stream, prop_id, cancellable, error);
+		if (!ews_decode_oab_prop (buf, prop_id, &val, error)) {
+			ews_destroy_oab_prop (prop_id, val);
+			ret = FALSE;
+			break;
+		}
+
+		if (!contact) {
+			ews_destroy_oab_prop (prop_id, val);
+			continue;
+		}
 
 		if (prop_id == EWS_PT_DISPLAY_TYPE)
 			ews_decode_addressbook_write_display_type (&contact, GPOINTER_TO_UINT (val), FALSE);
@@ -951,31 +1064,27 @@ ews_decode_addressbook_record (EwsOabDecoder *eod,
 
 		/* Check the contact map and store the data in EContact */
 		index = g_hash_table_lookup (eod->priv->prop_index_dict, GINT_TO_POINTER (prop_id));
-		if (contact && index) {
+		if (index) {
 			gint idx = GPOINTER_TO_INT (index);
 
 			if (prop_map[idx - 1].populate_function)
 				prop_map[idx - 1].populate_function (contact, prop_map[idx - 1].field, val, (gpointer) eod);
 			else
-				prop_map[idx - 1].defered_populate_function (dset, prop_id, val);
+				prop_map[idx - 1].defered_populate_function (&dset, prop_id, val);
 		}
 		ews_destroy_oab_prop (prop_id, val);
-		if (*error)
-			goto exit;
 	}
 
-exit:
-	if (bit_str)
-		g_free (bit_str);
-
 	if (!contact)
 		return ret;
 
-	if (dset && dset->addr) {
-		e_contact_set (contact, E_CONTACT_ADDRESS_WORK, dset->addr);
-		e_contact_address_free (dset->addr);
+	if (dset.addr) {
+		e_contact_set (contact, E_CONTACT_ADDRESS_WORK, dset.addr);
+		e_contact_address_free (dset.addr);
 	}
-	g_free (dset);
+
+	if (!ret)
+		return FALSE;
 
 	/* set the smtp address as contact's uid */
 	if (!e_contact_get_const(contact, E_CONTACT_UID)) {
@@ -989,6 +1098,284 @@ exit:
 	return ret;
 }
 
+/* Decodes one address-book record, which is stored at the offset in the OAB file,
+   and passes it to the callbacks */
+static void
+ews_decode_and_store_oab_record (EwsOabDecoder *eod,
+				 const guchar *record_buf,
+				 guint32 rec_size,
+				 goffset offset,
+				 guint32 index,
+				 GChecksum *sum,
+				 EwsOabContactFilterCb filter_cb,
+				 EwsOabContactAddedCb cb,
+				 gpointer user_data,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	EContact *contact;
+	EwsOabBuffer buf;
+	const gchar *sum_str;
+
+	contact = e_contact_new ();
+
+	g_checksum_reset (sum);
+	g_checksum_update (sum, record_buf, rec_size);
+	sum_str = g_checksum_get_string (sum);
+
+	ews_oab_buffer_init (&buf, record_buf, rec_size);
+
+	if ((!filter_cb || filter_cb (offset, sum_str, user_data, error)) &&
+	    ews_decode_addressbook_record (eod, &buf,
+					   contact, eod->priv->oab_props,
+					   error))
+		cb (contact, offset, sum_str,
+		    ((gfloat) (index + 1) / eod->priv->total_records) * 100,
+		    user_data, cancellable, error);
+
+	g_object_unref (contact);
+}
+
+/* With more than one worker, the records are hashed and decoded in parallel.
+   The filter callback is called in the record order, from the worker threads,
+   thus possibly ahead of the added callback of the previous records. The added
+   callback is called in the record order, from the thread, which passes
+   the records in. */
+
+typedef struct _EwsOabDecodeJob {
+	guint32 index;
+	goffset offset;
+	GBytes *bytes;
+	gchar *sha1;
+	EContact *contact;
+	GError *error;
+	gboolean done;
+} EwsOabDecodeJob;
+
+typedef struct _EwsOabDecodeEngine {
+	EwsOabDecoder *eod;
+	EwsOabContactFilterCb filter_cb;
+	EwsOabContactAddedCb cb;
+	gpointer user_data;
+	GCancellable *cancellable;
+
+	GThreadPool *pool;
+	GMutex lock;
+	GCond cond;
+	GQueue jobs; /* EwsOabDecodeJob *, in the record order; used only by the committing thread */
+	guint max_jobs;
+	guint32 next_filter; /* index of the record to be filtered next */
+	gboolean failed;
+} EwsOabDecodeEngine;
+
+static void
+ews_oab_decode_job_free (gpointer ptr)
+{
+	EwsOabDecodeJob *job = ptr;
+
+	if (job) {
+		g_bytes_unref (job->bytes);
+		g_free (job->sha1);
+		g_clear_object (&job->contact);
+		g_clear_error (&job->error);
+		g_free (job);
+	}
+}
+
+static void
+ews_oab_decode_engine_worker (gpointer data,
+			      gpointer user_data)
+{
+	EwsOabDecodeJob *job = data;
+	EwsOabDecodeEngine *engine = user_data;
+	gconstpointer record;
+	gsize rec_size = 0;
+	gboolean decode = FALSE;
+
+	record = g_bytes_get_data (job->bytes, &rec_size);
+	job->sha1 = g_compute_checksum_for_data (G_CHECKSUM_SHA1, record, rec_size);
+
+	/* The jobs are started in order, thus the previous record is already being processed */
+	g_mutex_lock (&engine->lock);
+
+	while (!engine->failed && engine->next_filter != job->index)
+		g_cond_wait (&engine->cond, &engine->lock);
+
+	if (!engine->failed) {
+		decode = !engine->filter_cb || engine->filter_cb (job->offset, job->sha1, engine->user_data, &job->error);
+		if (job->error)
+			decode = FALSE;
+	}
+
+	engine->next_filter++;
+	g_cond_broadcast (&engine->cond);
+
+	g_mutex_unlock (&engine->lock);
+
+	if (decode) {
+		EwsOabBuffer buf;
+
+		job->contact = e_contact_new ();
+
+		ews_oab_buffer_init (&buf, record, rec_size);
+
+		if (!ews_decode_addressbook_record (engine->eod, &buf, job->contact, engine->eod->priv->oab_props, &job->error))
+			g_clear_object (&job->contact);
+	}
+
+	g_mutex_lock (&engine->lock);
+	job->done = TRUE;
+	g_cond_broadcast (&engine->cond);
+	g_mutex_unlock (&engine->lock);
+}
+
+/* Returns NULL, when the records should be decoded in the calling thread */
+static EwsOabDecodeEngine *
+ews_oab_decode_engine_new (EwsOabDecoder *eod,
+			   guint32 first_index,
+			   EwsOabContactFilterCb filter_cb,
+			   EwsOabContactAddedCb cb,
+			   gpointer user_data,
+			   GCancellable *cancellable)
+{
+	EwsOabDecodeEngine *engine;
+
+	if (eod->priv->n_workers <= 1)
+		return NULL;
+
+	engine = g_new0 (EwsOabDecodeEngine, 1);
+	engine->eod = eod;
+	engine->filter_cb = filter_cb;
+	engine->cb = cb;
+	engine->user_data = user_data;
+	engine->cancellable = cancellable;
+	engine->max_jobs = eod->priv->n_workers * 64;
+	engine->next_filter = first_index;
+
+	g_mutex_init (&engine->lock);
+	g_cond_init (&engine->cond);
+	g_queue_init (&engine->jobs);
+
+	engine->pool = g_thread_pool_new (ews_oab_decode_engine_worker, engine, eod->priv->n_workers, FALSE, NULL);
+
+	return engine;
+}
+
+/* Any records not committed yet are dropped */
+static void
+ews_oab_decode_engine_free (gpointer ptr)
+{
+	EwsOabDecodeEngine *engine = ptr;
+
+	if (!engine)
+		return;
+
+	g_mutex_lock (&engine->lock);
+	engine->failed = TRUE;
+	g_cond_broadcast (&engine->cond);
+	g_mutex_unlock (&engine->lock);
+
+	g_thread_pool_free (engine->pool, TRUE, TRUE);
+
+	g_queue_clear_full (&engine->jobs, ews_oab_decode_job_free);
+	g_mutex_clear (&engine->lock);
+	g_cond_clear (&engine->cond);
+	g_free (engine);
+}
+
+/* Passes the decoded records to the added callback in order. It waits for them,
+   until at most 'keep_jobs' are left in progress. */
+static gboolean
+ews_oab_decode_engine_commit (EwsOabDecodeEngine *engine,
+			      guint keep_jobs,
+			      GError **error)
+{
+	GError *local_error = NULL;
+
+	while (!local_error && !g_queue_is_empty (&engine->jobs)) {
+		EwsOabDecodeJob *job = g_queue_peek_head (&engine->jobs);
+		guint32 total_records = engine->eod->priv->total_records;
+
+		g_mutex_lock (&engine->lock);
+
+		if (!job->done && g_queue_get_length (&engine->jobs) <= keep_jobs) {
+			g_mutex_unlock (&engine->lock);
+			break;
+		}
+
+		while (!job->done)
+			g_cond_wait (&engine->cond, &engine->lock);
+
+		g_mutex_unlock (&engine->lock);
+
+		g_queue_pop_head (&engine->jobs);
+
+		if (job->error) {
+			local_error = g_steal_pointer (&job->error);
+		} else if (job->contact) {
+			engine->cb (job->contact, job->offset, job->sha1,
+				((gfloat) (job->index + 1) / total_records) * 100,
+				engine->user_data, engine->cancellable, &local_error);
+		}
+
+		ews_oab_decode_job_free (job);
+	}
+
+	if (local_error) {
+		g_mutex_lock (&engine->lock);
+		engine->failed = TRUE;
+		g_cond_broadcast (&engine->cond);
+		g_mutex_unlock (&engine->lock);
+
+		g_propagate_error (error, local_error);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Takes the 'bytes' */
+static gboolean
+ews_oab_decode_engine_add (EwsOabDecodeEngine *engine,
+			   guint32 index,
+			   goffset offset,
+			   GBytes *bytes,
+			   GError **error)
+{
+	EwsOabDecodeJob *job;
+
+	job = g_new0 (EwsOabDecodeJob, 1);
+	job->index = index;
+	job->offset = offset;
+	job->bytes = bytes;
+
+	g_queue_push_tail (&engine->jobs, job);
+	g_thread_pool_push (engine->pool, job, NULL);
+
+	return ews_oab_decode_engine_commit (engine, engine->max_jobs, error);
+}
+
+/* Verifies the record of the 'rec_size', which includes the size itself,
+   fits into the rest of the file, thus a corrupt or truncated file cannot
+   cause a huge allocation */
+static gboolean
+ews_oab_decoder_check_record_size (EwsOabDecoder *eod,
+				   guint32 rec_size,
+				   GError **error)
+{
+	goffset pos;
+
+	pos = g_seekable_tell ((GSeekable *) eod->priv->fis);
+
+	if (rec_size < 4 || (goffset) rec_size - 4 > eod->priv->fis_size - pos) {
+		g_set_error (error, EOD_ERROR, 1, "invalid OAB record size %u", rec_size);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 /* Decodes the hdr and address-book records and stores the address-book records inside the db */
 static gboolean
 ews_decode_and_store_oab_records (EwsOabDecoder *eod,
@@ -998,39 +1385,27 @@ ews_decode_and_store_oab_records (EwsOabDecoder *eod,
                                   GCancellable *cancellable,
                                   GError **error)
 {
+	EwsOabDecodeEngine *engine;
 	gboolean ret = FALSE;
 	guint32 i;
 	int buf_len = 200;
 	guchar *record_buf = g_malloc (buf_len);
 	GChecksum *sum = g_checksum_new (G_CHECKSUM_SHA1);
 
-	if (!record_buf || !sum)
-		goto exit;
+	engine = ews_oab_decode_engine_new (eod, 0, filter_cb, cb, user_data, cancellable);
 
-	/* eat the size */
-	ews_oab_read_uint32 (
-		eod->priv->fis,
-		cancellable, error);
-
-	ews_decode_addressbook_record (eod, eod->priv->fis, NULL,
-				       eod->priv->hdr_props, cancellable, error);
-
-	if (*error)
+	if (!record_buf || !sum)
 		goto exit;
 
-
-	for (i = 0; i < eod->priv->total_records; i++) {
-		EContact *contact;
+	/* the hdr record is the first, then the address-book records follow */
+	for (i = 0; i <= eod->priv->total_records; i++) {
 		goffset offset;
 		guint32 rec_size;
-		GInputStream *memstream;
-		const gchar *sum_str;
-
-		contact = e_contact_new ();
+		gsize bytes_read = 0;
 
 		/* eat the size */
 		rec_size = ews_oab_read_uint32 (eod->priv->fis, cancellable, error);
-		if (rec_size < 4)
+		if (!ews_oab_decoder_check_record_size (eod, rec_size, error))
 			goto exit;
 
 		rec_size -= 4;
@@ -1044,37 +1419,320 @@ ews_decode_and_store_oab_records (EwsOabDecoder *eod,
 		}
 		/* fetch the offset */
 		offset = g_seekable_tell ((GSeekable *) eod->priv->fis);
-		if (g_input_stream_read (eod->priv->fis, record_buf, rec_size, cancellable, error) != rec_size)
+		if (!g_input_stream_read_all (eod->priv->fis, record_buf, rec_size, &bytes_read, cancellable, error) ||
+		    bytes_read != rec_size)
 			goto exit;
 
-		g_checksum_reset (sum);
-		g_checksum_update (sum, record_buf, rec_size);
-		sum_str = g_checksum_get_string (sum);
-
-		memstream = g_memory_input_stream_new_from_data (record_buf, rec_size, NULL);
+		if (i == 0) {
+			EwsOabBuffer buf;
 
-		if ((!filter_cb || filter_cb (offset, sum_str, user_data, error)) &&
-		    ews_decode_addressbook_record (eod, memstream,
-						   contact, eod->priv->oab_props,
-						   cancellable, error))
-			cb (contact, offset, sum_str,
-			    ((gfloat) (i + 1) / eod->priv->total_records) * 100,
-			    user_data, cancellable, error);
+			ews_oab_buffer_init (&buf, record_buf, rec_size);
 
-		g_object_unref (memstream);
-		g_object_unref (contact);
+			if (!ews_decode_addressbook_record (eod, &buf, NULL, eod->priv->hdr_props, error))
+				goto exit;
+		} else if (engine) {
+			ews_oab_decode_engine_add (engine, i - 1, offset, g_bytes_new (record_buf, rec_size), error);
+		} else {
+			ews_decode_and_store_oab_record (eod, record_buf, rec_size, offset, i - 1, sum,
+				filter_cb, cb, user_data, cancellable, error);
+		}
 
 		if (*error)
 			goto exit;
 	}
 
-	ret = TRUE;
+	ret = !engine || ews_oab_decode_engine_commit (engine, 0, error);
 exit:
+	ews_oab_decode_engine_free (engine);
 	g_checksum_free (sum);
 	g_free (record_buf);
 	return ret;
 }
 
+/* The same as ews_decode_and_store_oab_records(), only for the mapped file,
+   where the records start at the 'pos' */
+static gboolean
+ews_decode_and_store_mapped_records (EwsOabDecoder *eod,
+				     gsize pos,
+				     EwsOabContactFilterCb filter_cb,
+				     EwsOabContactAddedCb cb,
+				     gpointer user_data,
+				     GCancellable *cancellable,
+				     GError **error)
+{
+	EwsOabDecodeEngine *engine;
+	EwsOabBuffer buf;
+	GChecksum *sum;
+	guint32 i;
+	gboolean ret = FALSE;
+
+	ews_oab_buffer_init (&buf, g_mapped_file_get_contents (eod->priv->mapped), g_mapped_file_get_length (eod->priv->mapped));
+	if (pos > buf.len) {
+		g_set_error_literal (error, EOD_ERROR, 1, "OAB file is truncated");
+		return FALSE;
+	}
+
+	buf.pos = pos;
+	sum = g_checksum_new (G_CHECKSUM_SHA1);
+	engine = ews_oab_decode_engine_new (eod, 0, filter_cb, cb, user_data, cancellable);
+
+	/* the hdr record is the first, then the address-book records follow */
+	for (i = 0; i <= eod->priv->total_records; i++) {
+		guint32 rec_size;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error))
+			goto exit;
+
+		if (!ews_oab_buffer_read_uint32 (&buf, &rec_size, error))
+			goto exit;
+
+		if (rec_size < 4) {
+			g_set_error (error, EOD_ERROR, 1, "invalid OAB record size %u", rec_size);
+			goto exit;
+		}
+
+		rec_size -= 4;
+
+		if (!ews_oab_buffer_ensure (&buf, rec_size, error))
+			goto exit;
+
+		if (i == 0) {
+			EwsOabBuffer hdr_buf;
+
+			ews_oab_buffer_init (&hdr_buf, buf.data + buf.pos, rec_size);
+
+			if (!ews_decode_addressbook_record (eod, &hdr_buf, NULL, eod->priv->hdr_props, error))
+				goto exit;
+		} else if (engine) {
+			ews_oab_decode_engine_add (engine, i - 1, buf.pos,
+				g_bytes_new_static (buf.data + buf.pos, rec_size), error);
+		} else {
+			ews_decode_and_store_oab_record (eod, buf.data + buf.pos, rec_size, buf.pos, i - 1, sum,
+				filter_cb, cb, user_data, cancellable, error);
+		}
+
+		if (*error)
+			goto exit;
+
+		buf.pos += rec_size;
+	}
+
+	ret = !engine || ews_oab_decode_engine_commit (engine, 0, error);
+exit:
+	ews_oab_decode_engine_free (engine);
+	g_checksum_free (sum);
+	return ret;
+}
+
+/* Limits the metadata and record sizes, to not buffer endlessly on broken data */
+#define EWS_OAB_MAX_PUSH_SIZE (1024 * 1024 * 1024)
+
+/**
+ * ews_oab_decoder_push:
+ * @eod: an #EwsOabDecoder created with ews_oab_decoder_new_for_push()
+ * @data: next part of the decompressed OAB file
+ * @length: length of the @data
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Decodes all the complete records from the data passed in so far and calls
+ * the callbacks for them. The incomplete data is kept for the next call.
+ * The data are expected in the same format as the file read
+ * by ews_oab_decoder_decode(), including the offsets passed to
+ * the callbacks.
+ *
+ * Returns: whether succeeded
+ **/
+gboolean
+ews_oab_decoder_push (EwsOabDecoder *eod,
+		      gconstpointer data,
+		      gsize length,
+		      GCancellable *cancellable,
+		      GError **error)
+{
+	EwsOabDecoderPrivate *priv;
+	GError *local_error = NULL;
+	gsize pos = 0;
+	gboolean done = FALSE;
+
+	g_return_val_if_fail (EWS_IS_OAB_DECODER (eod), FALSE);
+	g_return_val_if_fail (eod->priv->push_buffer != NULL, FALSE);
+
+	priv = eod->priv;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	if (priv->push_state == EWS_OAB_PUSH_DONE)
+		return TRUE;
+
+	g_byte_array_append (priv->push_buffer, data, length);
+
+	while (!done && !local_error) {
+		const guchar *ptr = priv->push_buffer->data + pos;
+		gsize avail = priv->push_buffer->len - pos;
+
+		switch (priv->push_state) {
+		case EWS_OAB_PUSH_HEADER:
+			if (avail < 12) {
+				done = TRUE;
+				break;
+			}
+
+			if (EndGetI32 (ptr) != 0x00000020) {
+				g_set_error_literal (&local_error, EOD_ERROR, 1, "wrong version header");
+				break;
+			}
+
+			priv->total_records = EndGetI32 (ptr + 8);
+			pos += 12;
+			priv->push_state = EWS_OAB_PUSH_METADATA;
+			break;
+		case EWS_OAB_PUSH_METADATA:
+		{
+			GInputStream *memstream;
+			guint64 need;
+
+			/* size, the hdr props count and the hdr props */
+			if (avail < 8) {
+				done = TRUE;
+				break;
+			}
+
+			need = 8 + ((guint64) EndGetI32 (ptr + 4)) * 8;
+			if (need + 4 > EWS_OAB_MAX_PUSH_SIZE) {
+				g_set_error_literal (&local_error, EOD_ERROR, 1, "OAB metadata exceeds maximum allowed size");
+				break;
+			}
+
+			/* the oab props count and the oab props */
+			if (avail < need + 4) {
+				done = TRUE;
+				break;
+			}
+
+			need = need + 4 + ((guint64) EndGetI32 (ptr + need)) * 8;
+			if (need > EWS_OAB_MAX_PUSH_SIZE) {
+				g_set_error_literal (&local_error, EOD_ERROR, 1, "OAB metadata exceeds maximum allowed size");
+				break;
+			}
+
+			if (avail < need) {
+				done = TRUE;
+				break;
+			}
+
+			memstream = g_memory_input_stream_new_from_data (ptr, need, NULL);
+			ews_decode_metadata (eod, memstream, cancellable, &local_error);
+			g_object_unref (memstream);
+
+			pos += need;
+			priv->push_state = EWS_OAB_PUSH_HDR_RECORD;
+			break;
+		}
+		case EWS_OAB_PUSH_HDR_RECORD:
+		case EWS_OAB_PUSH_RECORDS:
+		{
+			guint32 rec_size;
+
+			if (avail < 4) {
+				done = TRUE;
+				break;
+			}
+
+			rec_size = EndGetI32 (ptr);
+			if (rec_size < 4 || rec_size > EWS_OAB_MAX_PUSH_SIZE) {
+				g_set_error (&local_error, EOD_ERROR, 1, "invalid OAB record size %u", rec_size);
+				break;
+			}
+
+			if (avail < rec_size) {
+				done = TRUE;
+				break;
+			}
+
+			if (priv->push_state == EWS_OAB_PUSH_HDR_RECORD) {
+				EwsOabBuffer buf;
+
+				ews_oab_buffer_init (&buf, ptr + 4, rec_size - 4);
+				ews_decode_addressbook_record (eod, &buf, NULL, priv->hdr_props, &local_error);
+
+				priv->push_state = EWS_OAB_PUSH_RECORDS;
+
+				if (!local_error)
+					priv->push_engine = ews_oab_decode_engine_new (eod, 0,
+						priv->push_filter_cb, priv->push_cb, priv->push_user_data, cancellable);
+			} else if (priv->push_engine) {
+				/* the buffer is compacted below, thus copy the record */
+				ews_oab_decode_engine_add (priv->push_engine, priv->push_n_records,
+					priv->push_offset + pos + 4, g_bytes_new (ptr + 4, rec_size - 4), &local_error);
+
+				priv->push_n_records++;
+			} else {
+				ews_decode_and_store_oab_record (eod, ptr + 4, rec_size - 4,
+					priv->push_offset + pos + 4, priv->push_n_records, priv->push_sum,
+					priv->push_filter_cb, priv->push_cb, priv->push_user_data,
+					cancellable, &local_error);
+
+				priv->push_n_records++;
+			}
+
+			pos += rec_size;
+
+			if (priv->push_state == EWS_OAB_PUSH_RECORDS &&
+			    priv->push_n_records >= priv->total_records)
+				priv->push_state = EWS_OAB_PUSH_DONE;
+			break;
+		}
+		case EWS_OAB_PUSH_DONE:
+			/* ignore anything after the last record */
+			pos = priv->push_buffer->len;
+			done = TRUE;
+			break;
+		}
+	}
+
+	g_byte_array_remove_range (priv->push_buffer, 0, pos);
+	priv->push_offset += pos;
+
+	if (local_error) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * ews_oab_decoder_push_finish:
+ * @eod: an #EwsOabDecoder created with ews_oab_decoder_new_for_push()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Checks whether all the records had been decoded, once all the data
+ * had been passed in with ews_oab_decoder_push().
+ *
+ * Returns: whether all the records had been decoded
+ **/
+gboolean
+ews_oab_decoder_push_finish (EwsOabDecoder *eod,
+			     GError **error)
+{
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (EWS_IS_OAB_DECODER (eod), FALSE);
+
+	if (eod->priv->push_state != EWS_OAB_PUSH_DONE) {
+		g_set_error_literal (error, EOD_ERROR, 1, "OAB data is incomplete");
+		success = FALSE;
+	} else if (eod->priv->push_engine) {
+		success = ews_oab_decode_engine_commit (eod->priv->push_engine, 0, error);
+	}
+
+	g_clear_pointer (&eod->priv->push_engine, ews_oab_decode_engine_free);
+
+	return success;
+}
+
 gchar *
 ews_oab_decoder_get_oab_prop_string (EwsOabDecoder *eod,
                                      GError **error)
@@ -1162,10 +1820,20 @@ ews_oab_decoder_decode (EwsOabDecoder *eod,
                         GError **error)
 {
 	GError *err = NULL;
+	GInputStream *stream;
 	EwsOabHdr *o_hdr;
 	gboolean ret = TRUE;
 
-	o_hdr = ews_read_oab_header (eod, eod->priv->fis, cancellable, &err);
+	/* the header and the metadata are read only once, thus use the stream for them */
+	if (eod->priv->mapped) {
+		stream = g_memory_input_stream_new_from_data (
+			g_mapped_file_get_contents (eod->priv->mapped),
+			g_mapped_file_get_length (eod->priv->mapped), NULL);
+	} else {
+		stream = g_object_ref (eod->priv->fis);
+	}
+
+	o_hdr = ews_read_oab_header (eod, stream, cancellable, &err);
 	if (!o_hdr) {
 		ret = FALSE;
 		goto exit;
@@ -1174,16 +1842,23 @@ ews_oab_decoder_decode (EwsOabDecoder *eod,
 	eod->priv->total_records = o_hdr->total_recs;
 	d (g_print ("Total records is %d \n", eod->priv->total_records));
 
-	ret = ews_decode_metadata (eod, eod->priv->fis, cancellable, &err);
+	ret = ews_decode_metadata (eod, stream, cancellable, &err);
 	if (!ret)
 		goto exit;
 
-	ret = ews_decode_and_store_oab_records (
-		eod, filter_cb, cb, user_data, cancellable, &err);
+	if (eod->priv->mapped) {
+		ret = ews_decode_and_store_mapped_records (
+			eod, g_seekable_tell (G_SEEKABLE (stream)), filter_cb, cb, user_data, cancellable, &err);
+	} else {
+		ret = ews_decode_and_store_oab_records (
+			eod, filter_cb, cb, user_data, cancellable, &err);
+	}
 exit:
 	if (o_hdr)
 		g_free (o_hdr);
 
+	g_object_unref (stream);
+
 	if (err)
 		g_propagate_error (error, err);
 
@@ -1198,18 +1873,59 @@ ews_oab_decoder_get_contact_from_offset (EwsOabDecoder *eod,
                                          GError **error)
 {
 	EContact *contact = NULL;
+	EwsOabBuffer buf;
+	guchar *record_buf = NULL;
+	guint32 rec_size;
+
+	/* the offset points after the record size */
+	if (eod->priv->mapped) {
+		const guchar *data = (const guchar *) g_mapped_file_get_contents (eod->priv->mapped);
+		gsize len = g_mapped_file_get_length (eod->priv->mapped);
+
+		if (offset < 4 || offset > len ||
+		    (rec_size = EndGetI32 (data + offset - 4)) < 4 ||
+		    rec_size - 4 > len - offset) {
+			g_set_error (error, EOD_ERROR, 1, "invalid OAB record offset %" G_GINT64_FORMAT, (gint64) offset);
+			return NULL;
+		}
 
-	if (!g_seekable_seek ((GSeekable *) eod->priv->fis, offset, G_SEEK_SET, cancellable, error))
-		return NULL;
+		ews_oab_buffer_init (&buf, data + offset, rec_size - 4);
+	} else {
+		gsize bytes_read = 0;
+		GError *local_error = NULL;
+
+		if (offset < 4 || !g_seekable_seek ((GSeekable *) eod->priv->fis, offset - 4, G_SEEK_SET, cancellable, error))
+			return NULL;
+
+		rec_size = ews_oab_read_uint32 (eod->priv->fis, cancellable, &local_error);
+		if (local_error) {
+			g_propagate_error (error, local_error);
+			return NULL;
+		}
+
+		if (!ews_oab_decoder_check_record_size (eod, rec_size, error))
+			return NULL;
+
+		record_buf = g_malloc (rec_size - 4);
+		if (!g_input_stream_read_all (eod->priv->fis, record_buf, rec_size - 4, &bytes_read, cancellable, error) ||
+		    bytes_read != rec_size - 4) {
+			g_free (record_buf);
+			return NULL;
+		}
+
+		ews_oab_buffer_init (&buf, record_buf, rec_size - 4);
+	}
 
 	contact = e_contact_new ();
-	if (!ews_decode_addressbook_record (eod, eod->priv->fis,
-					    contact, oab_props, cancellable,
+	if (!ews_decode_addressbook_record (eod, &buf,
+					    contact, oab_props,
 					    error)) {
 		g_object_unref (contact);
 		contact = NULL;
 	}
 
+	g_free (record_buf);
+
 	return contact;
 }
 
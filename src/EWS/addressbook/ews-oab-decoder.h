@@ -59,6 +59,22 @@ GType		ews_oab_decoder_get_type	(void);
 EwsOabDecoder *	ews_oab_decoder_new		(const gchar *oab_filename,
 						 const gchar *cache_dir,
 						 GError **error);
+EwsOabDecoder *	ews_oab_decoder_new_mapped	(const gchar *oab_filename,
+						 const gchar *cache_dir,
+						 GError **error);
+EwsOabDecoder *	ews_oab_decoder_new_for_push	(const gchar *cache_dir,
+						 EwsOabContactFilterCb filter_cb,
+						 EwsOabContactAddedCb cb,
+						 gpointer user_data);
+void		ews_oab_decoder_set_n_workers	(EwsOabDecoder *eod,
+						 guint n_workers);
+gboolean	ews_oab_decoder_push		(EwsOabDecoder *eod,
+						 gconstpointer data,
+						 gsize length,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	ews_oab_decoder_push_finish	(EwsOabDecoder *eod,
+						 GError **error);
 gboolean	ews_oab_decoder_decode		(EwsOabDecoder *eod,
 						 EwsOabContactFilterCb filter_cb,
 						 EwsOabContactAddedCb cb,
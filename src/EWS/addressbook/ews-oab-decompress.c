@@ -5,6 +5,8 @@
 
 #include "evolution-ews-config.h"
 
+#include <stdlib.h>
+#include <string.h>
 #include <glib.h>
 #include "ews-oab-decompress.h"
 #include <mspack.h>
@@ -37,6 +39,188 @@ ews_oab_decompress_full (const gchar *filename, const gchar *output_filename,
 	return TRUE;
 }
 
+/* libmspack decompresses the whole file at once, in the calling thread */
+gboolean
+ews_oab_decompress_full_parallel (const gchar *filename,
+				  const gchar *output_filename,
+				  guint n_threads,
+				  GError **error)
+{
+	return ews_oab_decompress_full (filename, output_filename, error);
+}
+
+/* A libmspack I/O system, which reads and writes through the callbacks */
+typedef struct _OabStreamSystem OabStreamSystem;
+
+typedef struct _OabStreamFile {
+	OabStreamSystem *oss;
+} OabStreamFile;
+
+struct _OabStreamSystem {
+	struct mspack_system sys; /* must be the first member */
+	EwsOabReadFunc read_fn;
+	EwsOabWriteFunc write_fn;
+	gpointer user_data;
+	GError *error;
+	OabStreamFile input;
+	OabStreamFile output;
+};
+
+static struct mspack_file *
+oab_stream_open (struct mspack_system *self,
+		 const gchar *filename,
+		 gint mode)
+{
+	OabStreamSystem *oss = (OabStreamSystem *) self;
+
+	if (mode == MSPACK_SYS_OPEN_READ)
+		return (struct mspack_file *) &oss->input;
+
+	if (mode == MSPACK_SYS_OPEN_WRITE)
+		return (struct mspack_file *) &oss->output;
+
+	return NULL;
+}
+
+static void
+oab_stream_close (struct mspack_file *file)
+{
+}
+
+static gint
+oab_stream_read (struct mspack_file *file,
+		 gpointer buffer,
+		 gint bytes)
+{
+	OabStreamSystem *oss = ((OabStreamFile *) file)->oss;
+	gint done = 0;
+
+	/* libmspack expects full reads, except of the end of the data */
+	while (done < bytes) {
+		gssize nread;
+
+		nread = oss->read_fn (((gchar *) buffer) + done, bytes - done, oss->user_data, oss->error ? NULL : &oss->error);
+		if (nread < 0)
+			return -1;
+
+		if (nread == 0)
+			break;
+
+		done += nread;
+	}
+
+	return done;
+}
+
+static gint
+oab_stream_write (struct mspack_file *file,
+		  gpointer buffer,
+		  gint bytes)
+{
+	OabStreamSystem *oss = ((OabStreamFile *) file)->oss;
+
+	if (!oss->write_fn (buffer, bytes, oss->user_data, oss->error ? NULL : &oss->error))
+		return -1;
+
+	return bytes;
+}
+
+static gint
+oab_stream_seek (struct mspack_file *file,
+		 off_t offset,
+		 gint mode)
+{
+	/* the data cannot be seeked */
+	return -1;
+}
+
+static off_t
+oab_stream_tell (struct mspack_file *file)
+{
+	return -1;
+}
+
+static void
+oab_stream_message (struct mspack_file *file,
+		    const gchar *format,
+		    ...)
+{
+}
+
+static gpointer
+oab_stream_alloc (struct mspack_system *self,
+		  size_t bytes)
+{
+	return malloc (bytes);
+}
+
+static void
+oab_stream_free (gpointer ptr)
+{
+	free (ptr);
+}
+
+static void
+oab_stream_copy (gpointer src,
+		 gpointer dest,
+		 size_t bytes)
+{
+	memmove (dest, src, bytes);
+}
+
+gboolean
+ews_oab_decompress_full_stream (EwsOabReadFunc read_fn,
+				EwsOabWriteFunc write_fn,
+				gpointer user_data,
+				GError **error)
+{
+	struct msoab_decompressor *msoab;
+	OabStreamSystem oss = { { 0, }, };
+	int ret;
+
+	g_return_val_if_fail (read_fn != NULL, FALSE);
+	g_return_val_if_fail (write_fn != NULL, FALSE);
+
+	oss.sys.open = oab_stream_open;
+	oss.sys.close = oab_stream_close;
+	oss.sys.read = oab_stream_read;
+	oss.sys.write = oab_stream_write;
+	oss.sys.seek = oab_stream_seek;
+	oss.sys.tell = oab_stream_tell;
+	oss.sys.message = oab_stream_message;
+	oss.sys.alloc = oab_stream_alloc;
+	oss.sys.free = oab_stream_free;
+	oss.sys.copy = oab_stream_copy;
+	oss.read_fn = read_fn;
+	oss.write_fn = write_fn;
+	oss.user_data = user_data;
+	oss.input.oss = &oss;
+	oss.output.oss = &oss;
+
+	msoab = mspack_create_oab_decompressor (&oss.sys);
+	if (!msoab) {
+		g_set_error_literal (error, g_quark_from_string ("lzx"), 1,
+				     "Unable to create msoab decompressor");
+		return FALSE;
+	}
+
+	/* the file names are not used, the data go through the callbacks */
+	ret = msoab->decompress (msoab, "input", "output");
+	mspack_destroy_oab_decompressor (msoab);
+
+	if (oss.error) {
+		g_propagate_error (error, oss.error);
+		return FALSE;
+	}
+
+	if (ret != MSPACK_ERR_OK) {
+		g_set_error (error, g_quark_from_string ("lzx"), 1,
+			     "Failed to decompress LZX data: %d", ret);
+		return FALSE;
+	}
+
+	return TRUE;
+}
 
 gboolean
 ews_oab_decompress_patch (const gchar *filename, const gchar *orig_filename,
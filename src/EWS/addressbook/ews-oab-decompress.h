@@ -8,9 +8,27 @@
 
 #include <glib.h>
 
+/* Returns the number of bytes read, 0 at the end of the data, -1 on error */
+typedef gssize (* EwsOabReadFunc) (gpointer buffer,
+				   gsize size,
+				   gpointer user_data,
+				   GError **error);
+typedef gboolean (* EwsOabWriteFunc) (gconstpointer buffer,
+				      gsize size,
+				      gpointer user_data,
+				      GError **error);
+
 gboolean ews_oab_decompress_full (const gchar *filename,
 				  const gchar *output_filename,
 				  GError **error);
+gboolean ews_oab_decompress_full_parallel (const gchar *filename,
+					   const gchar *output_filename,
+					   guint n_threads,
+					   GError **error);
+gboolean ews_oab_decompress_full_stream (EwsOabReadFunc read_fn,
+					 EwsOabWriteFunc write_fn,
+					 gpointer user_data,
+					 GError **error);
 gboolean ews_oab_decompress_patch (const gchar *filename,
 				   const gchar *orig_filename,
 				   const gchar *output_filename,
@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* Measures how quickly a full OAB .lzx file is decompressed, once with
+   a single thread and once with the given number of threads (all
+   processors by default), and verifies both outputs are the same. */
+
+#include "evolution-ews-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "ews-oab-decompress.h"
+
+static gboolean
+run_decompress (const gchar *filename,
+		const gchar *output_filename,
+		guint n_threads,
+		guint iterations,
+		gdouble *out_seconds,
+		GError **error)
+{
+	GTimer *timer;
+	guint ii;
+
+	timer = g_timer_new ();
+
+	for (ii = 0; ii < iterations; ii++) {
+		if (!ews_oab_decompress_full_parallel (filename, output_filename, n_threads, error)) {
+			g_timer_destroy (timer);
+			return FALSE;
+		}
+	}
+
+	*out_seconds = g_timer_elapsed (timer, NULL) / iterations;
+
+	g_timer_destroy (timer);
+
+	return TRUE;
+}
+
+gint
+main (gint argc,
+      gchar *argv[])
+{
+	gchar *serial_filename, *parallel_filename;
+	gchar *serial_data = NULL, *parallel_data = NULL;
+	gsize serial_length = 0, parallel_length = 0;
+	gdouble serial_seconds = 0.0, parallel_seconds = 0.0;
+	guint n_threads, iterations;
+	GError *error = NULL;
+	gint res = 0;
+
+	if (argc < 2 || argc > 4) {
+		g_print ("Usage: %s FILE.lzx [THREADS [ITERATIONS]]\n", argv[0]);
+		return 1;
+	}
+
+	n_threads = argc > 2 ? (guint) strtoul (argv[2], NULL, 10) : 0;
+	if (!n_threads)
+		n_threads = g_get_num_processors ();
+
+	iterations = argc > 3 ? (guint) strtoul (argv[3], NULL, 10) : 3;
+	if (!iterations)
+		iterations = 1;
+
+	serial_filename = g_strconcat (argv[1], ".serial.oab", NULL);
+	parallel_filename = g_strconcat (argv[1], ".parallel.oab", NULL);
+
+	if (!run_decompress (argv[1], serial_filename, 1, iterations, &serial_seconds, &error) ||
+	    !run_decompress (argv[1], parallel_filename, n_threads, iterations, &parallel_seconds, &error)) {
+		g_printerr ("Decompression failed: %s\n", error ? error->message : "Unknown error");
+		g_clear_error (&error);
+		res = 1;
+		goto exit;
+	}
+
+	if (!g_file_get_contents (serial_filename, &serial_data, &serial_length, &error) ||
+	    !g_file_get_contents (parallel_filename, &parallel_data, &parallel_length, &error)) {
+		g_printerr ("Failed to read the output: %s\n", error ? error->message : "Unknown error");
+		g_clear_error (&error);
+		res = 1;
+		goto exit;
+	}
+
+	if (serial_length != parallel_length || memcmp (serial_data, parallel_data, serial_length) != 0) {
+		g_printerr ("The outputs differ\n");
+		res = 1;
+		goto exit;
+	}
+
+	g_print ("Decompressed %" G_GSIZE_FORMAT " bytes\n", serial_length);
+	g_print ("  1 thread:   %.3f s (%.1f MB/s)\n", serial_seconds,
+		serial_length / (1024.0 * 1024.0) / MAX (serial_seconds, 1e-6));
+	g_print ("  %u threads: %.3f s (%.1f MB/s)\n", n_threads, parallel_seconds,
+		parallel_length / (1024.0 * 1024.0) / MAX (parallel_seconds, 1e-6));
+
+ exit:
+	g_unlink (serial_filename);
+	g_unlink (parallel_filename);
+	g_free (serial_filename);
+	g_free (parallel_filename);
+	g_free (serial_data);
+	g_free (parallel_data);
+
+	return res;
+}
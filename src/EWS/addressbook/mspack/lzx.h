@@ -80,6 +80,12 @@ struct lzxd_stream {
   FILE   *input;		  /* input file handle                       */
   FILE  *output;		  /* output file handle                      */
 
+  /* in-memory input and output, used instead of the file handles */
+  const unsigned char *in_mem;    /* remaining input bytes                   */
+  size_t  in_mem_left;            /* number of remaining input bytes         */
+  unsigned char *out_mem;         /* where to write the next output bytes    */
+  size_t  out_mem_left;           /* free space left at out_mem              */
+
   off_t   offset;                 /* number of bytes actually output         */
   off_t   length;                 /* overall decompressed length of stream   */
 
@@ -183,6 +189,26 @@ extern struct lzxd_stream *ews_lzxd_init(FILE *input,
 extern void ews_lzxd_set_output_length(struct lzxd_stream *lzx,
 				   off_t output_length);
 
+/**
+ * Makes the stream read its input from, and write its output to, memory
+ * buffers instead of the file handles given in lzxd_init(), which can be
+ * NULL then. Either buffer can be NULL, to keep using the file handle.
+ *
+ * Call this before the first call to lzxd_decompress().
+ *
+ * @param lzx           the LZX stream to set the buffers to
+ * @param input         the compressed data, or NULL
+ * @param input_length  the length of the compressed data
+ * @param output        the buffer for the decompressed data, or NULL
+ * @param output_length the size of the output buffer; writing more
+ *                      is reported as LZX_ERR_WRITE
+ */
+extern void ews_lzxd_set_memory_io(struct lzxd_stream *lzx,
+				   const unsigned char *input,
+				   size_t input_length,
+				   unsigned char *output,
+				   size_t output_length);
+
 /**
  * Reads LZX DELTA reference data into the window and allows
  * lzxd_decompress() to reference it.
@@ -318,6 +318,10 @@ struct lzxd_stream *ews_lzxd_init(FILE *input,
   /* initialise decompression state */
   lzx->input           = input;
   lzx->output          = output;
+  lzx->in_mem          = NULL;
+  lzx->in_mem_left     = 0;
+  lzx->out_mem         = NULL;
+  lzx->out_mem_left    = 0;
   lzx->offset          = 0;
   lzx->length          = output_length;
 
@@ -375,6 +379,34 @@ int ews_lzxd_set_reference_data(struct lzxd_stream *lzx,
     return LZX_ERR_OK;
 }
 
+void ews_lzxd_set_memory_io(struct lzxd_stream *lzx,
+			    const unsigned char *input,
+			    size_t input_length,
+			    unsigned char *output,
+			    size_t output_length)
+{
+  if (!lzx) return;
+
+  lzx->in_mem       = input;
+  lzx->in_mem_left  = input ? input_length : 0;
+  lzx->out_mem      = output;
+  lzx->out_mem_left = output ? output_length : 0;
+}
+
+/* writes the decoded bytes either to the output file or to the memory buffer,
+ * returns how many bytes had been written */
+static int lzxd_write(struct lzxd_stream *lzx, unsigned char *data, int bytes) {
+  if (lzx->out_mem) {
+    if ((size_t) bytes > lzx->out_mem_left) return 0;
+    memcpy(lzx->out_mem, data, (size_t) bytes);
+    lzx->out_mem      += bytes;
+    lzx->out_mem_left -= bytes;
+    return bytes;
+  }
+
+  return (int) fwrite(data, 1, bytes, lzx->output);
+}
+
 void ews_lzxd_set_output_length(struct lzxd_stream *lzx, off_t out_bytes) {
   if (lzx) lzx->length = out_bytes;
 }
@@ -400,7 +432,7 @@ int ews_lzxd_decompress(struct lzxd_stream *lzx, off_t out_bytes) {
   i = lzx->o_end - lzx->o_ptr;
   if ((off_t) i > out_bytes) i = (int) out_bytes;
   if (i) {
-    if (fwrite(lzx->o_ptr, 1, i, lzx->output) != i) {
+    if (lzxd_write(lzx, lzx->o_ptr, i) != i) {
       return lzx->error = LZX_ERR_WRITE;
     }
     lzx->o_ptr  += i;
@@ -846,7 +878,7 @@ int ews_lzxd_decompress(struct lzxd_stream *lzx, off_t out_bytes) {
 
     /* write a frame */
     i = (out_bytes < (off_t)frame_size) ? (unsigned int)out_bytes : frame_size;
-    if (fwrite(lzx->o_ptr, 1, i, lzx->output) != i) {
+    if (lzxd_write(lzx, lzx->o_ptr, i) != i) {
       return lzx->error = LZX_ERR_WRITE;
     }
     lzx->o_ptr  += i;
@@ -8,6 +8,7 @@
 #include <sys/types.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <unistd.h>
 #include <glib.h>
@@ -52,8 +53,71 @@ read_uint32 (FILE *input,
 		return FALSE;
 }
 
+/* The full OAB file is read either from a file or through a callback */
+typedef struct _OabInput {
+	FILE *file;
+	EwsOabReadFunc read_fn;
+	gpointer user_data;
+	GError *error; /* set by the read_fn */
+} OabInput;
+
+typedef struct _OabOutput {
+	FILE *file;
+	EwsOabWriteFunc write_fn;
+	gpointer user_data;
+	GError *error; /* set by the write_fn */
+} OabOutput;
+
+static gboolean
+oab_input_read (OabInput *input,
+		gpointer buffer,
+		gsize size)
+{
+	gsize done = 0;
+
+	if (input->file)
+		return fread (buffer, 1, size, input->file) == size;
+
+	while (done < size) {
+		gssize nread;
+
+		nread = input->read_fn (((gchar *) buffer) + done, size - done, input->user_data,
+			input->error ? NULL : &input->error);
+		if (nread <= 0)
+			return FALSE;
+
+		done += nread;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+oab_output_write (OabOutput *output,
+		  gconstpointer buffer,
+		  gsize size)
+{
+	if (output->file)
+		return fwrite (buffer, 1, size, output->file) == size;
+
+	return output->write_fn (buffer, size, output->user_data, output->error ? NULL : &output->error);
+}
+
+static gboolean
+oab_input_read_uint32 (OabInput *input,
+		       guint32 *val)
+{
+	gchar buf[4];
+
+	if (oab_input_read (input, buf, 4)) {
+		*val = EndGetI32 (buf);
+		return TRUE;
+	} else
+		return FALSE;
+}
+
 static LzxHeader *
-read_headers (FILE *input,
+read_headers (OabInput *input,
               GError **error)
 {
 	LzxHeader *lzx_h;
@@ -61,10 +125,10 @@ read_headers (FILE *input,
 
 	lzx_h = g_new0 (LzxHeader, 1);
 
-	success = read_uint32 (input, &lzx_h->h_version);
+	success = oab_input_read_uint32 (input, &lzx_h->h_version);
 	if (!success)
 		goto exit;
-	success = read_uint32 (input, &lzx_h->l_version);
+	success = oab_input_read_uint32 (input, &lzx_h->l_version);
 	if (!success)
 		goto exit;
 
@@ -75,10 +139,10 @@ read_headers (FILE *input,
 		return NULL;
 	}
 
-	success = read_uint32 (input, &lzx_h->max_block_size);
+	success = oab_input_read_uint32 (input, &lzx_h->max_block_size);
 	if (!success)
 		goto exit;
-	success = read_uint32 (input, &lzx_h->target_size);
+	success = oab_input_read_uint32 (input, &lzx_h->target_size);
 	if (!success)
 		goto exit;
 
@@ -95,7 +159,7 @@ exit:
 }
 
 static LzxBlockHeader *
-read_block_header (FILE *input,
+read_block_header (OabInput *input,
                    GError **error)
 {
 	LzxBlockHeader *lzx_b;
@@ -103,19 +167,19 @@ read_block_header (FILE *input,
 
 	lzx_b = g_new0 (LzxBlockHeader, 1);
 
-	success = read_uint32 (input, &lzx_b->flags);
+	success = oab_input_read_uint32 (input, &lzx_b->flags);
 	if (!success)
 		goto exit;
 
-	success = read_uint32 (input, &lzx_b->comp_size);
+	success = oab_input_read_uint32 (input, &lzx_b->comp_size);
 	if (!success)
 		goto exit;
 
-	success = read_uint32 (input, &lzx_b->ucomp_size);
+	success = oab_input_read_uint32 (input, &lzx_b->ucomp_size);
 	if (!success)
 		goto exit;
 
-	success = read_uint32 (input, &lzx_b->crc);
+	success = oab_input_read_uint32 (input, &lzx_b->crc);
 
 exit:
 	if (!success) {
@@ -129,29 +193,225 @@ exit:
 	return	lzx_b;
 }
 
-gboolean
-ews_oab_decompress_full (const gchar *filename, const gchar *output_filename,
-			 GError **error)
+/* The CRC of the uncompressed block data, as described in [MS-OXOAB] 5.2 */
+static guint32 crc_table[256];
+
+static gpointer
+oab_crc_init_table (gpointer user_data)
+{
+	guint32 ii, jj, crc;
+
+	for (ii = 0; ii < 256; ii++) {
+		crc = ii;
+
+		for (jj = 0; jj < 8; jj++)
+			crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+
+		crc_table[ii] = crc;
+	}
+
+	return NULL;
+}
+
+static guint32
+oab_crc_compute (const guchar *data,
+		 gsize length)
+{
+	static GOnce init_once = G_ONCE_INIT;
+	guint32 crc = 0xFFFFFFFF;
+	gsize ii;
+
+	g_once (&init_once, oab_crc_init_table, NULL);
+
+	for (ii = 0; ii < length; ii++)
+		crc = crc_table[(crc ^ data[ii]) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+/* Every block of a full OAB file is compressed on its own, thus the blocks
+   are read in order, decompressed in a thread pool and written in order
+   again, with only a limited number of blocks in memory at once. */
+
+typedef struct _DecompressBlock {
+	LzxBlockHeader header;
+	guchar *comp_data;
+	guchar *ucomp_data;
+	gboolean done;
+	GError *error;
+} DecompressBlock;
+
+typedef struct _DecompressData {
+	GMutex lock;
+	GCond cond;
+} DecompressData;
+
+static void
+decompress_block_free (gpointer ptr)
+{
+	DecompressBlock *block = ptr;
+
+	if (block) {
+		g_free (block->comp_data);
+		g_free (block->ucomp_data);
+		g_clear_error (&block->error);
+		g_free (block);
+	}
+}
+
+static gboolean
+decompress_block (DecompressBlock *block,
+		  GError **error)
+{
+	LzxBlockHeader *lzx_b = &block->header;
+	struct lzxd_stream *lzs;
+	guint32 crc;
+
+	block->ucomp_data = g_try_malloc (lzx_b->ucomp_size);
+	if (!block->ucomp_data) {
+		g_set_error_literal (error, g_quark_from_string ("lzx"), 1, "out of memory");
+		return FALSE;
+	}
+
+	/* lzx_b points to 1, it is stored uncompressed */
+	if (lzx_b->flags == 0) {
+		if (lzx_b->comp_size != lzx_b->ucomp_size) {
+			g_set_error_literal (error, g_quark_from_string ("lzx"), 1, "invalid uncompressed block size");
+			return FALSE;
+		}
+
+		memcpy (block->ucomp_data, block->comp_data, lzx_b->ucomp_size);
+	} else {
+		/* The window size should be the smallest power of two between 2^17 and 2^25 that is
+		   greater than or equal to the sum of the size of the reference data rounded up to
+		   a multiple of 32768 and the size of the subject data. Since we have no reference
+		   data, forget that and the rounding. Just the smallest power of two which is large
+		   enough to cover the subject data (lzx_b->ucomp_size). */
+
+		guint window_bits = g_bit_nth_msf(lzx_b->ucomp_size - 1, -1) + 1;
+
+		if (window_bits < 17)
+			window_bits = 17;
+		else if (window_bits > 25)
+			window_bits = 25;
+
+		lzs = ews_lzxd_init (NULL, NULL, window_bits,
+				 0, 4096, lzx_b->ucomp_size, 1);
+		if (!lzs) {
+			g_set_error_literal (error, g_quark_from_string ("lzx"), 1, "decompression failed (lzxd_init)");
+			return FALSE;
+		}
+
+		/* Reading from memory also means the decompressor cannot read beyond the block */
+		ews_lzxd_set_memory_io (lzs, block->comp_data, lzx_b->comp_size, block->ucomp_data, lzx_b->ucomp_size);
+
+		if (ews_lzxd_decompress (lzs, lzx_b->ucomp_size) != LZX_ERR_OK) {
+			g_set_error_literal (error, g_quark_from_string ("lzx"), 1, "decompression failed (lzxd_decompress)");
+			ews_lzxd_free (lzs);
+			return FALSE;
+		}
+		ews_lzxd_free (lzs);
+	}
+
+	/* The specification does not apply the final inversion of the usual CRC-32,
+	   accept both forms to not depend on which one the server uses */
+	crc = oab_crc_compute (block->ucomp_data, lzx_b->ucomp_size);
+	if (crc != lzx_b->crc && ~crc != lzx_b->crc) {
+		g_set_error (error, g_quark_from_string ("lzx"), 1,
+			     "block CRC mismatch: expected 0x%08x, got 0x%08x", lzx_b->crc, crc);
+		return FALSE;
+	}
+
+	g_clear_pointer (&block->comp_data, g_free);
+
+	return TRUE;
+}
+
+static void
+decompress_block_thread (gpointer data,
+			 gpointer user_data)
+{
+	DecompressBlock *block = data;
+	DecompressData *dd = user_data;
+	GError *local_error = NULL;
+
+	decompress_block (block, &local_error);
+
+	g_mutex_lock (&dd->lock);
+	block->error = local_error;
+	block->done = TRUE;
+	g_cond_broadcast (&dd->cond);
+	g_mutex_unlock (&dd->lock);
+}
+
+/* Reads the next block header and its compressed data; the file is left
+   at the beginning of the next block */
+static DecompressBlock *
+read_block (OabInput *input,
+	    GError **error)
+{
+	DecompressBlock *block;
+	LzxBlockHeader *lzx_b;
+
+	lzx_b = read_block_header (input, error);
+	if (!lzx_b)
+		return NULL;
+
+	/* Sanity-check sizes to prevent integer overflows and
+	 * decompression bombs (max 1 GB decompressed) */
+	if (lzx_b->ucomp_size == 0 || lzx_b->ucomp_size > (1024 * 1024 * 1024)) {
+		g_set_error (error, g_quark_from_string ("lzx"), 1,
+			     "invalid uncompressed block size: %u", lzx_b->ucomp_size);
+		g_free (lzx_b);
+		return NULL;
+	}
+
+	if (lzx_b->comp_size > (1024 * 1024 * 1024)) {
+		g_set_error (error, g_quark_from_string ("lzx"), 1,
+			     "invalid compressed block size: %u", lzx_b->comp_size);
+		g_free (lzx_b);
+		return NULL;
+	}
+
+	block = g_new0 (DecompressBlock, 1);
+	block->header = *lzx_b;
+	g_free (lzx_b);
+
+	block->comp_data = g_try_malloc (block->header.comp_size + 1);
+	if (!block->comp_data ||
+	    !oab_input_read (input, block->comp_data, block->header.comp_size)) {
+		g_set_error_literal (error, g_quark_from_string ("lzx"), 1, "failed to read block data");
+		decompress_block_free (block);
+		return NULL;
+	}
+
+	return block;
+}
+
+static gboolean
+oab_decompress_full (OabInput *input,
+		     OabOutput *output,
+		     guint n_threads,
+		     GError **error)
 {
 	LzxHeader *lzx_h = NULL;
+	DecompressData dd;
+	GThreadPool *pool = NULL;
+	GQueue pending = G_QUEUE_INIT;
 	guint total_decomp_size = 0;
-	FILE *input, *output = NULL;
+	guint max_pending;
+	gboolean read_all = FALSE;
 	gboolean ret = TRUE;
 	GError *err = NULL;
 
-	input = fopen (filename, "rb");
-	if (!input) {
-		g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "unable to open the input file");
-		ret = FALSE;
-		goto exit;
-	}
+	if (!n_threads)
+		n_threads = g_get_num_processors ();
 
-	output = fopen (output_filename, "wb");
-	if (!output) {
-		g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "unable to open the output file");
-		ret = FALSE;
-		goto exit;
-	}
+	/* Keep the workers busy while the writer waits for the oldest block */
+	max_pending = n_threads * 4;
+
+	g_mutex_init (&dd.lock);
+	g_cond_init (&dd.cond);
 
 	lzx_h = read_headers (input, &err);
 	if (!lzx_h) {
@@ -159,107 +419,155 @@ ews_oab_decompress_full (const gchar *filename, const gchar *output_filename,
 		goto exit;
 	}
 
-	/* TODO decompressing multiple lzx_blocks has not been tested yet. Will need to get a setup and test it. */
-	do {
-		LzxBlockHeader *lzx_b;
-		struct lzxd_stream *lzs;
-		goffset offset;
-
-		lzx_b = read_block_header (input, &err);
-		if (err) {
-			ret = FALSE;
-			goto exit;
-		}
-
-		/* note the file offset */
-		offset = ftell (input);
-
-		/* Sanity-check sizes to prevent integer overflows and
-		 * decompression bombs (max 1 GB decompressed) */
-		if (lzx_b->ucomp_size == 0 || lzx_b->ucomp_size > (1024 * 1024 * 1024)) {
-			g_set_error (&err, g_quark_from_string ("lzx"), 1,
-				     "invalid uncompressed block size: %u", lzx_b->ucomp_size);
-			g_free (lzx_b);
-			ret = FALSE;
-			goto exit;
-		}
+	pool = g_thread_pool_new (decompress_block_thread, &dd, n_threads, FALSE, NULL);
 
-		/* lzx_b points to 1, write it directly to file */
-		if (lzx_b->flags == 0) {
-			gchar *buffer = g_malloc0 (lzx_b->ucomp_size);
+	while (!read_all || !g_queue_is_empty (&pending)) {
+		DecompressBlock *block;
 
-			if (!(fread (buffer, 1, lzx_b->ucomp_size, input) == lzx_b->ucomp_size &&
-				fwrite (buffer, 1, lzx_b->ucomp_size, output) == lzx_b->ucomp_size)) {
-				g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "failed to write data in output file");
-				g_free (buffer);
+		/* Index and queue blocks until the target size is covered */
+		while (!read_all && g_queue_get_length (&pending) < max_pending) {
+			block = read_block (input, &err);
+			if (!block) {
 				ret = FALSE;
 				goto exit;
 			}
-			g_free (buffer);
-		} else {
-			/* The window size should be the smallest power of two between 2^17 and 2^25 that is
-			   greater than or equal to the sum of the size of the reference data rounded up to
-			   a multiple of 32768 and the size of the subject data. Since we have no reference
-			   data, forget that and the rounding. Just the smallest power of two which is large
-			   enough to cover the subject data (lzx_b->ucomp_size). */
-
-			guint window_bits = g_bit_nth_msf(lzx_b->ucomp_size - 1, -1) + 1;
-
-			if (window_bits < 17)
-				window_bits = 17;
-			else if (window_bits > 25)
-				window_bits = 25;
-
-			lzs = ews_lzxd_init (input, output, window_bits,
-					 0, 4096, lzx_b->ucomp_size, 1);
-			if (!lzs) {
-				g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "decompression failed (lzxd_init)");
-				ret = FALSE;
-				goto exit;
-			}
-			if (ews_lzxd_decompress (lzs, lzx_b->ucomp_size) != LZX_ERR_OK) {
-				g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "decompression failed (lzxd_decompress)");
-				ews_lzxd_free (lzs);
+
+			/* Check for integer overflow in accumulated size */
+			if (block->header.ucomp_size > G_MAXUINT - total_decomp_size) {
+				g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "decompressed size overflow");
+				decompress_block_free (block);
 				ret = FALSE;
 				goto exit;
 			}
-			ews_lzxd_free (lzs);
+
+			total_decomp_size += block->header.ucomp_size;
+			read_all = total_decomp_size >= lzx_h->target_size;
+
+			g_queue_push_tail (&pending, block);
+			g_thread_pool_push (pool, block, NULL);
 		}
 
-		/* Set the fp to beggining of next block. This is a HACK, looks like decompress reads beyond the block.
-		 * Since we can identify the next block start from block header, we just reset the offset */
-		offset += lzx_b->comp_size;
-		fseek (input, offset, SEEK_SET);
+		/* Write the oldest block, once it is decompressed */
+		block = g_queue_peek_head (&pending);
 
-		/* Check for integer overflow in accumulated size */
-		if (lzx_b->ucomp_size > G_MAXUINT - total_decomp_size) {
-			g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "decompressed size overflow");
-			g_free (lzx_b);
+		g_mutex_lock (&dd.lock);
+		while (!block->done)
+			g_cond_wait (&dd.cond, &dd.lock);
+		g_mutex_unlock (&dd.lock);
+
+		if (block->error) {
+			g_propagate_error (&err, g_steal_pointer (&block->error));
+			ret = FALSE;
+			goto exit;
+		}
+
+		if (!oab_output_write (output, block->ucomp_data, block->header.ucomp_size)) {
+			g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "failed to write data in output file");
 			ret = FALSE;
 			goto exit;
 		}
-		total_decomp_size += lzx_b->ucomp_size;
-		g_free (lzx_b);
-	} while (total_decomp_size < lzx_h->target_size);
+
+		decompress_block_free (g_queue_pop_head (&pending));
+	}
 
 exit:
-	if (input)
-		fclose (input);
+	/* Waits for the running jobs, thus the pending blocks can be freed */
+	if (pool)
+		g_thread_pool_free (pool, TRUE, TRUE);
 
-	if (output)
-		fclose (output);
+	g_queue_clear_full (&pending, decompress_block_free);
+
+	/* Prefer the errors from the callbacks, they are more specific */
+	if (input->error || output->error) {
+		g_clear_error (&err);
+		err = g_steal_pointer (input->error ? &input->error : &output->error);
+	}
 
 	if (err) {
 		ret = FALSE;
 		g_propagate_error (error, err);
-		g_unlink (output_filename);
 	}
 
+	g_mutex_clear (&dd.lock);
+	g_cond_clear (&dd.cond);
 	g_free (lzx_h);
 
 	return ret;
 }
 
+gboolean
+ews_oab_decompress_full_parallel (const gchar *filename,
+				  const gchar *output_filename,
+				  guint n_threads,
+				  GError **error)
+{
+	OabInput input = { NULL, };
+	OabOutput output = { NULL, };
+	gboolean ret = TRUE;
+	GError *err = NULL;
+
+	input.file = fopen (filename, "rb");
+	if (!input.file) {
+		g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "unable to open the input file");
+		ret = FALSE;
+		goto exit;
+	}
+
+	output.file = fopen (output_filename, "wb");
+	if (!output.file) {
+		g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "unable to open the output file");
+		ret = FALSE;
+		goto exit;
+	}
+
+	ret = oab_decompress_full (&input, &output, n_threads, &err);
+
+exit:
+	if (input.file)
+		fclose (input.file);
+
+	if (output.file && fclose (output.file) != 0 && !err) {
+		g_set_error_literal (&err, g_quark_from_string ("lzx"), 1, "failed to write data in output file");
+		ret = FALSE;
+	}
+
+	if (err) {
+		ret = FALSE;
+		g_propagate_error (error, err);
+		g_unlink (output_filename);
+	}
+
+	return ret;
+}
+
+gboolean
+ews_oab_decompress_full_stream (EwsOabReadFunc read_fn,
+				EwsOabWriteFunc write_fn,
+				gpointer user_data,
+				GError **error)
+{
+	OabInput input = { NULL, };
+	OabOutput output = { NULL, };
+
+	g_return_val_if_fail (read_fn != NULL, FALSE);
+	g_return_val_if_fail (write_fn != NULL, FALSE);
+
+	input.read_fn = read_fn;
+	input.user_data = user_data;
+
+	output.write_fn = write_fn;
+	output.user_data = user_data;
+
+	return oab_decompress_full (&input, &output, 0, error);
+}
+
+gboolean
+ews_oab_decompress_full (const gchar *filename, const gchar *output_filename,
+			 GError **error)
+{
+	return ews_oab_decompress_full_parallel (filename, output_filename, 0, error);
+}
+
 typedef struct {
 	guint32 h_version;
 	guint32 l_version;
@@ -176,7 +176,17 @@ static const unsigned short lsb_bit_mask[17] = {
 } while (0)
 
 static int read_input(BITS_TYPE *p) {
-    int read = fread(p->inbuf, 1, (int)p->inbuf_size, p->input);
+    int read;
+
+    if (p->in_mem) {
+	read = (p->in_mem_left < p->inbuf_size) ? (int) p->in_mem_left : (int) p->inbuf_size;
+	memcpy(p->inbuf, p->in_mem, read);
+	p->in_mem += read;
+	p->in_mem_left -= read;
+    }
+    else {
+	read = fread(p->inbuf, 1, (int)p->inbuf_size, p->input);
+    }
     if (read < 0) return p->error = LZX_ERR_READ;
 
     /* we might overrun the input stream by asking for bits we don't use,
@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* Measures how quickly a decompressed OAB file is decoded, read through
+   the input stream, mapped into memory, and mapped into memory with
+   the given number of decoding threads (all processors by default),
+   and verifies all the decoders produce the same records. */
+
+#include "evolution-ews-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include <libebook/libebook.h>
+
+#include "ews-oab-decoder.h"
+
+typedef struct _DecodeData {
+	guint n_contacts;
+	GChecksum *sums; /* of the record checksums and offsets */
+} DecodeData;
+
+static void
+benchmark_contact_added_cb (EContact *contact,
+			    goffset offset,
+			    const gchar *sha1,
+			    guint percent,
+			    gpointer user_data,
+			    GCancellable *cancellable,
+			    GError **error)
+{
+	DecodeData *dd = user_data;
+	gint64 offset64 = offset;
+
+	dd->n_contacts++;
+
+	g_checksum_update (dd->sums, (const guchar *) sha1, -1);
+	g_checksum_update (dd->sums, (const guchar *) &offset64, sizeof (gint64));
+	g_checksum_update (dd->sums, (const guchar *) (e_contact_get_const (contact, E_CONTACT_UID)), -1);
+}
+
+static gboolean
+run_decode (const gchar *filename,
+	    const gchar *cache_dir,
+	    gboolean mapped,
+	    guint n_workers,
+	    guint iterations,
+	    gdouble *out_seconds,
+	    guint *out_n_contacts,
+	    gchar **out_digest,
+	    GError **error)
+{
+	GTimer *timer;
+	guint ii;
+
+	timer = g_timer_new ();
+
+	for (ii = 0; ii < iterations; ii++) {
+		EwsOabDecoder *eod;
+		DecodeData dd;
+		gboolean success;
+
+		if (mapped)
+			eod = ews_oab_decoder_new_mapped (filename, cache_dir, error);
+		else
+			eod = ews_oab_decoder_new (filename, cache_dir, error);
+
+		if (!eod) {
+			g_timer_destroy (timer);
+			return FALSE;
+		}
+
+		ews_oab_decoder_set_n_workers (eod, n_workers);
+
+		dd.n_contacts = 0;
+		dd.sums = g_checksum_new (G_CHECKSUM_SHA1);
+
+		success = ews_oab_decoder_decode (eod, NULL, benchmark_contact_added_cb, &dd, NULL, error);
+
+		if (success && ii + 1 == iterations) {
+			*out_n_contacts = dd.n_contacts;
+			*out_digest = g_strdup (g_checksum_get_string (dd.sums));
+		}
+
+		g_checksum_free (dd.sums);
+		g_object_unref (eod);
+
+		if (!success) {
+			g_timer_destroy (timer);
+			return FALSE;
+		}
+	}
+
+	*out_seconds = g_timer_elapsed (timer, NULL) / iterations;
+
+	g_timer_destroy (timer);
+
+	return TRUE;
+}
+
+static void
+print_result (const gchar *name,
+	      gdouble seconds,
+	      guint n_contacts,
+	      goffset file_size)
+{
+	g_print ("%-12s %8.3f s  %10.0f records/s  %8.2f MB/s\n", name, seconds,
+		seconds > 0.0 ? n_contacts / seconds : 0.0,
+		seconds > 0.0 ? file_size / seconds / (1024.0 * 1024.0) : 0.0);
+}
+
+gint
+main (gint argc,
+      gchar *argv[])
+{
+	GStatBuf st;
+	gchar *stream_digest = NULL, *mapped_digest = NULL, *parallel_digest = NULL;
+	gchar *parallel_name;
+	gdouble stream_seconds = 0.0, mapped_seconds = 0.0, parallel_seconds = 0.0;
+	guint stream_contacts = 0, mapped_contacts = 0, parallel_contacts = 0;
+	guint n_workers, iterations;
+	GError *error = NULL;
+	gint res = 0;
+
+	if (argc < 3 || argc > 5) {
+		g_print ("Usage: %s FILE.oab CACHE_DIR [WORKERS [ITERATIONS]]\n", argv[0]);
+		return 1;
+	}
+
+	if (g_stat (argv[1], &st) != 0) {
+		g_printerr ("Cannot stat '%s'\n", argv[1]);
+		return 1;
+	}
+
+	n_workers = argc > 3 ? (guint) strtoul (argv[3], NULL, 10) : 0;
+	if (!n_workers)
+		n_workers = g_get_num_processors ();
+
+	iterations = argc > 4 ? (guint) strtoul (argv[4], NULL, 10) : 3;
+	if (!iterations)
+		iterations = 1;
+
+	if (!run_decode (argv[1], argv[2], FALSE, 1, iterations, &stream_seconds, &stream_contacts, &stream_digest, &error) ||
+	    !run_decode (argv[1], argv[2], TRUE, 1, iterations, &mapped_seconds, &mapped_contacts, &mapped_digest, &error) ||
+	    !run_decode (argv[1], argv[2], TRUE, n_workers, iterations, &parallel_seconds, &parallel_contacts, &parallel_digest, &error)) {
+		g_printerr ("Decoding failed: %s\n", error ? error->message : "Unknown error");
+		g_clear_error (&error);
+		res = 1;
+		goto exit;
+	}
+
+	g_print ("Decoded %u records from %" G_GINT64_FORMAT " bytes, average of %u iterations\n",
+		mapped_contacts, (gint64) st.st_size, iterations);
+	print_result ("stream", stream_seconds, stream_contacts, st.st_size);
+	print_result ("mapped", mapped_seconds, mapped_contacts, st.st_size);
+
+	parallel_name = g_strdup_printf ("mapped x%u", n_workers);
+	print_result (parallel_name, parallel_seconds, parallel_contacts, st.st_size);
+	g_free (parallel_name);
+
+	if (stream_contacts != mapped_contacts || g_strcmp0 (stream_digest, mapped_digest) != 0 ||
+	    stream_contacts != parallel_contacts || g_strcmp0 (stream_digest, parallel_digest) != 0) {
+		g_printerr ("The decoded records differ\n");
+		res = 1;
+	}
+
+ exit:
+	g_free (stream_digest);
+	g_free (mapped_digest);
+	g_free (parallel_digest);
+
+	return res;
+}
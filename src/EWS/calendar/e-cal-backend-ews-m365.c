@@ -169,8 +169,6 @@ ecb_ews_save_as_online_meeting_sync (ESourceRegistry *registry,
 
 		new_comp = e_cal_component_get_icalcomponent (comp);
 
-		e_m365_tz_utils_ref_windows_zones ();
-
 		builder = e_cal_backend_m365_utils_ical_to_json (m365_cnc, NULL, NULL, timezone_cache, I_CAL_VEVENT_COMPONENT,
 			new_comp, NULL, cancellable, error);
 
@@ -203,8 +201,6 @@ ecb_ews_save_as_online_meeting_sync (ESourceRegistry *registry,
 			g_clear_pointer (&created_item, json_object_unref);
 			g_clear_object (&builder);
 		}
-
-		e_m365_tz_utils_unref_windows_zones ();
 	}
 
 	g_clear_object (&ews_settings);
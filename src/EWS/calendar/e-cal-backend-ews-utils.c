@@ -20,17 +20,13 @@
 #include <glib/gstdio.h>
 #include <gio/gio.h>
 
-#include <libxml/parser.h>
-#include <libxml/tree.h>
-#include <libxml/xpath.h>
-#include <libxml/xpathInternals.h>
-
 #include <libecal/libecal.h>
 
 #include "common/e-ews-calendar-utils.h"
 #include "common/e-ews-connection.h"
 #include "common/e-ews-request.h"
 #include "common/e-ews-item-change.h"
+#include "e-ews-windows-zones.h"
 
 #include "e-cal-backend-ews-utils.h"
 
@@ -41,179 +37,22 @@
 #endif
 
 /*
- * A bunch of global variables used to map the ICalTimezone to MSDN[0] format.
- * Also, some auxiliar functions to translate from one tz type to another.
+ * Maps the ICalTimezone location to MSDN[0] format and back, using the tables
+ * shared with the Microsoft365 code, which are generated from the windowsZones.xml
+ * at build time.
  *
  * [0]: http://msdn.microsoft.com/en-us/library/ms912391(v=winembedded.11).aspx
  */
-static GRecMutex tz_mutex;
-
-static GHashTable *ical_to_msdn = NULL;
-static GHashTable *msdn_to_ical = NULL;
-static guint tables_counter = 0;
-
-G_MODULE_EXPORT void
-e_cal_backend_ews_populate_windows_zones (void)
-{
-	const gchar *ews_test_windows_zones_xml_path;
-	const gchar *xpath_eval_exp;
-	gchar *filename = NULL;
-	xmlDocPtr doc;
-	xmlXPathContextPtr xpath_ctxt;
-	xmlXPathObjectPtr xpath_obj;
-	xmlNodeSetPtr nodes;
-	gint i, len;
-
-	g_rec_mutex_lock (&tz_mutex);
-	if (ical_to_msdn != NULL && msdn_to_ical != NULL) {
-		g_hash_table_ref (ical_to_msdn);
-		g_hash_table_ref (msdn_to_ical);
-		tables_counter++;
-
-		g_rec_mutex_unlock (&tz_mutex);
-		return;
-	}
-
-	ews_test_windows_zones_xml_path = g_getenv ("EWS_TEST_WINDOWS_ZONES_XML_PATH");
-	if (ews_test_windows_zones_xml_path != NULL)
-		filename = g_build_filename (ews_test_windows_zones_xml_path, "windowsZones.xml", NULL);
-	else
-		filename = g_build_filename (EXCHANGE_EWS_DATADIR, "windowsZones.xml", NULL);
-
-	doc = xmlReadFile (filename, NULL, 0);
-
-	if (doc == NULL) {
-		g_warning (G_STRLOC "Could not map %s file.", filename);
-		g_free (filename);
-
-		g_rec_mutex_unlock (&tz_mutex);
-		return;
-	}
-
-	xpath_eval_exp = "/supplementalData/windowsZones/mapTimezones/mapZone";
-
-	xpath_ctxt = xmlXPathNewContext (doc);
-	xpath_obj = xmlXPathEvalExpression (BAD_CAST xpath_eval_exp, xpath_ctxt);
-
-	if (xpath_obj == NULL) {
-		g_warning (G_STRLOC "Unable to evaluate xpath expression \"%s\".", xpath_eval_exp);
-		xmlXPathFreeContext (xpath_ctxt);
-		xmlFreeDoc (doc);
-		g_free (filename);
-
-		g_rec_mutex_unlock (&tz_mutex);
-		return;
-	}
-
-	nodes = xpath_obj->nodesetval;
-	len = nodes->nodeNr;
-
-	msdn_to_ical = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
-	ical_to_msdn = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
-	tables_counter++;
-
-	for (i = 0; i < len; i++) {
-		xmlChar *msdn = xmlGetProp (nodes->nodeTab[i], BAD_CAST "other");
-		xmlChar *ical = xmlGetProp (nodes->nodeTab[i], BAD_CAST "type");
-		gchar **tokens;
-		gint tokens_len;
-
-		tokens = g_strsplit ((gchar *) ical, " ", 0);
-		tokens_len = g_strv_length (tokens);
-		if (tokens_len == 1) {
-			if (!g_hash_table_lookup (msdn_to_ical, msdn))
-				g_hash_table_insert (msdn_to_ical, g_strdup ((gchar *) msdn), g_strdup ((gchar *) ical));
-
-			if (!g_hash_table_lookup (ical_to_msdn, ical))
-				g_hash_table_insert (ical_to_msdn, g_strdup ((gchar *) ical), g_strdup ((gchar *) msdn));
-		} else {
-			gint j;
-			for (j = 0; j < tokens_len; j++) {
-				if (!g_hash_table_lookup (msdn_to_ical, msdn))
-					g_hash_table_insert (msdn_to_ical, g_strdup ((gchar *) msdn), g_strdup (tokens[j]));
-
-				if (!g_hash_table_lookup (ical_to_msdn, tokens[j]))
-					g_hash_table_insert (ical_to_msdn, g_strdup (tokens[j]), g_strdup ((gchar *) msdn));
-			}
-		}
-
-		g_strfreev (tokens);
-		xmlFree (ical);
-		xmlFree (msdn);
-	}
-
-	xmlXPathFreeObject (xpath_obj);
-	xmlXPathFreeContext (xpath_ctxt);
-	xmlFreeDoc (doc);
-	g_free (filename);
-
-	g_rec_mutex_unlock (&tz_mutex);
-}
-
-void
-e_cal_backend_ews_unref_windows_zones (void)
-{
-	g_rec_mutex_lock (&tz_mutex);
-	if (ical_to_msdn != NULL)
-		g_hash_table_unref (ical_to_msdn);
-
-	if (msdn_to_ical != NULL)
-		g_hash_table_unref (msdn_to_ical);
-
-	if (tables_counter > 0) {
-		tables_counter--;
-
-		if (tables_counter == 0) {
-			ical_to_msdn = NULL;
-			msdn_to_ical = NULL;
-		}
-	}
-
-	g_rec_mutex_unlock (&tz_mutex);
-}
-
 G_MODULE_EXPORT const gchar *
 e_cal_backend_ews_tz_util_get_msdn_equivalent (const gchar *ical_tz_location)
 {
-	const gchar *msdn_tz_location = NULL;
-
-	if (!ical_tz_location || !*ical_tz_location)
-		return NULL;
-
-	g_rec_mutex_lock (&tz_mutex);
-	if (ical_to_msdn == NULL) {
-		g_rec_mutex_unlock (&tz_mutex);
-
-		g_warn_if_reached ();
-		return NULL;
-	}
-
-	msdn_tz_location = g_hash_table_lookup (ical_to_msdn, ical_tz_location);
-	g_rec_mutex_unlock (&tz_mutex);
-
-	return msdn_tz_location;
+	return e_ews_windows_zones_get_msdn_equivalent (ical_tz_location);
 }
 
 const gchar *
 e_cal_backend_ews_tz_util_get_ical_equivalent (const gchar *msdn_tz_location)
 {
-	const gchar *ical_tz_location = NULL;
-
-	if (!msdn_tz_location || !*msdn_tz_location)
-		return NULL;
-
-	g_rec_mutex_lock (&tz_mutex);
-	if (msdn_to_ical == NULL) {
-		g_rec_mutex_unlock (&tz_mutex);
-
-		g_warn_if_reached ();
-		return NULL;
-	}
-
-	ical_tz_location = g_hash_table_lookup (msdn_to_ical, msdn_tz_location);
-	g_rec_mutex_unlock (&tz_mutex);
-
-	return ical_tz_location;
+	return e_ews_windows_zones_get_ical_equivalent (msdn_tz_location);
 }
 
 /*
@@ -2285,18 +2124,460 @@ e_cal_backend_ews_convert_component_to_updatexml (ESoapRequest *request,
 	return success;
 }
 
-guint
-e_cal_backend_ews_rid_to_index (ICalTimezone *timezone,
-				const gchar *rid,
-				ICalComponent *comp,
-				GError **error)
+/*
+ * Mapping of a recurrence ID to the instance index, as used by the EWS.
+ *
+ * The simple DAILY, WEEKLY, MONTHLY and YEARLY rules have the index computed
+ * directly from the dates. The other rules are expanded, once, and the computed
+ * occurrences are remembered for each master, together with the iterator, thus
+ * the later lookups of the same master only search the remembered occurrences
+ * or continue where the previous expansion stopped. The remembered occurrences
+ * are thrown away when the RRULE, DTSTART or the time zone of the master change.
+ */
+
+/* Up to how many masters have their occurrences remembered */
+#define EWS_RID_INDEX_MAX_MASTERS 64
+
+typedef struct _EwsRidIndexOccurrence {
+	gint64 exact; /* the time in UTC, as compared by i_cal_time_compare() */
+	gint date; /* YYYYMMDD in the master's time zone */
+} EwsRidIndexOccurrence;
+
+typedef struct _EwsRidIndexMaster {
+	gchar *key; /* RRULE, DTSTART and time zone the below is computed for */
+	ICalRecurIterator *ritr; /* NULL, when all occurrences are computed */
+	GArray *occurrences; /* EwsRidIndexOccurrence, sorted by the index */
+} EwsRidIndexMaster;
+
+struct _ECalBackendEwsRidIndex {
+	GMutex lock;
+	GHashTable *masters; /* gchar *uid ~> EwsRidIndexMaster * */
+};
+
+static void
+ews_rid_index_master_free (gpointer ptr)
+{
+	EwsRidIndexMaster *master = ptr;
+
+	if (master) {
+		g_free (master->key);
+		g_clear_object (&master->ritr);
+		g_array_unref (master->occurrences);
+		g_free (master);
+	}
+}
+
+static EwsRidIndexMaster *
+ews_rid_index_master_new (gchar *key, /* (transfer full) */
+			  ICalRecurrence *rrule,
+			  ICalTime *dtstart)
+{
+	EwsRidIndexMaster *master;
+
+	master = g_new0 (EwsRidIndexMaster, 1);
+	master->key = key;
+	master->ritr = i_cal_recur_iterator_new (rrule, dtstart);
+	master->occurrences = g_array_new (FALSE, FALSE, sizeof (EwsRidIndexOccurrence));
+
+	return master;
+}
+
+static gint
+ews_rid_index_get_date (ICalTime *tt)
+{
+	return i_cal_time_get_year (tt) * 10000 + i_cal_time_get_month (tt) * 100 + i_cal_time_get_day (tt);
+}
+
+static gint64
+ews_rid_index_get_exact (ICalTime *tt)
+{
+	ICalTime *utc;
+	gint64 exact;
+
+	/* The same as i_cal_time_compare() does; the floating time is not converted */
+	utc = i_cal_time_clone (tt);
+	if (!i_cal_time_is_date (utc))
+		i_cal_time_convert_to_zone_inplace (utc, i_cal_timezone_get_utc_timezone ());
+
+	exact = (gint64) i_cal_time_as_timet (utc);
+
+	g_object_unref (utc);
+
+	return exact;
+}
+
+/* Returns the index of the first occurrence matching the @exact time, or
+   when there is none, of the first occurrence on the @date; 0 when none */
+static guint
+ews_rid_index_master_find (EwsRidIndexMaster *master,
+			   gint64 exact,
+			   gint date)
+{
+	EwsRidIndexOccurrence *occurrences;
+	guint lo, hi;
+
+	/* Compute the occurrences until the rid is certainly behind */
+	while (master->ritr && (!master->occurrences->len ||
+	       g_array_index (master->occurrences, EwsRidIndexOccurrence, master->occurrences->len - 1).exact <= exact ||
+	       g_array_index (master->occurrences, EwsRidIndexOccurrence, master->occurrences->len - 1).date <= date)) {
+		ICalTime *next;
+
+		next = i_cal_recur_iterator_next (master->ritr);
+
+		if (next && !i_cal_time_is_null_time (next)) {
+			EwsRidIndexOccurrence occurrence;
+
+			occurrence.exact = ews_rid_index_get_exact (next);
+			occurrence.date = ews_rid_index_get_date (next);
+
+			g_array_append_val (master->occurrences, occurrence);
+		} else {
+			g_clear_object (&master->ritr);
+		}
+
+		g_clear_object (&next);
+	}
+
+	occurrences = (EwsRidIndexOccurrence *) master->occurrences->data;
+
+	/* The occurrences are sorted, thus the first not older can be looked for */
+	lo = 0;
+	hi = master->occurrences->len;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (occurrences[mid].exact < exact)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < master->occurrences->len && occurrences[lo].exact == exact)
+		return lo + 1;
+
+	/* if cannot find an exact time, try with the date part only */
+	lo = 0;
+	hi = master->occurrences->len;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (occurrences[mid].date < date)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < master->occurrences->len && occurrences[lo].date == date)
+		return lo + 1;
+
+	return 0;
+}
+
+#ifndef HAVE_I_CAL_RECURRENCE_GET_BY
+static gint
+ews_rid_index_count_by_and_free (GArray *array)
+{
+	guint ii;
+
+	if (!array)
+		return 0;
+
+	for (ii = 0; ii < array->len; ii++) {
+		if (g_array_index (array, gshort, ii) == I_CAL_RECURRENCE_ARRAY_MAX)
+			break;
+	}
+
+	g_array_unref (array);
+
+	return ii;
+}
+#endif
+
+#ifdef HAVE_I_CAL_RECURRENCE_GET_BY
+#define ews_rid_index_count_by(_rrule, _by, _get_array) i_cal_recurrence_get_by_array_size (_rrule, _by)
+#define ews_rid_index_get_by_day(_rrule, _index) i_cal_recurrence_get_by (_rrule, I_CAL_BY_DAY, _index)
+#else
+#define ews_rid_index_count_by(_rrule, _by, _get_array) ews_rid_index_count_by_and_free (_get_array (_rrule))
+#define ews_rid_index_get_by_day(_rrule, _index) i_cal_recurrence_get_by_day (_rrule, _index)
+#endif
+
+/* Day of the week, 0 for Sunday, of the given julian day */
+static gint
+ews_rid_index_julian_weekday (guint32 julian)
+{
+	GDate date;
+
+	g_date_clear (&date, 1);
+	g_date_set_julian (&date, julian);
+
+	return g_date_get_weekday (&date) % 7;
+}
+
+/* Computes the index of an occurrence on the given date of a simple rule,
+   the one which does not use any BY part, except of the week days for
+   the WEEKLY rule; returns 0, when there is no occurrence on that date */
+static guint
+ews_rid_index_closed_form_date (ICalRecurrence *rrule,
+				ICalTime *dtstart,
+				guint day_mask, /* 1 << weekday, with 0 being Sunday */
+				gint year,
+				gint month,
+				gint day)
+{
+	ICalTime *until;
+	GDate start_date, rid_date;
+	gint interval, count;
+	guint64 index = 0;
+
+	if (!g_date_valid_dmy (day, month, year))
+		return 0;
+
+	g_date_clear (&start_date, 1);
+	g_date_clear (&rid_date, 1);
+	g_date_set_dmy (&start_date, i_cal_time_get_day (dtstart), i_cal_time_get_month (dtstart), i_cal_time_get_year (dtstart));
+	g_date_set_dmy (&rid_date, day, month, year);
+
+	if (g_date_compare (&rid_date, &start_date) < 0)
+		return 0;
+
+	interval = i_cal_recurrence_get_interval (rrule);
+	if (interval < 1)
+		interval = 1;
+
+	switch (i_cal_recurrence_get_freq (rrule)) {
+	case I_CAL_DAILY_RECURRENCE: {
+		guint32 days;
+
+		days = g_date_get_julian (&rid_date) - g_date_get_julian (&start_date);
+		if (days % interval == 0)
+			index = days / interval + 1;
+		} break;
+	case I_CAL_WEEKLY_RECURRENCE: {
+		guint32 start_week, rid_week, weeks;
+		gint wkst, start_pos, rid_pos, ii;
+		guint n_first = 0, n_week = 0, n_last = 0;
+
+		wkst = (gint) i_cal_recurrence_get_week_start (rrule) - 1;
+		if (wkst < 0 || wkst > 6)
+			wkst = 1;
+
+		start_pos = (ews_rid_index_julian_weekday (g_date_get_julian (&start_date)) - wkst + 7) % 7;
+		rid_pos = (ews_rid_index_julian_weekday (g_date_get_julian (&rid_date)) - wkst + 7) % 7;
+
+		if (!(day_mask & (1 << ((rid_pos + wkst) % 7))))
+			break;
+
+		start_week = g_date_get_julian (&start_date) - start_pos;
+		rid_week = g_date_get_julian (&rid_date) - rid_pos;
+		weeks = (rid_week - start_week) / 7;
+
+		if (weeks % interval != 0)
+			break;
+
+		/* Positions of the week days counted from the week start */
+		for (ii = 0; ii < 7; ii++) {
+			if (!(day_mask & (1 << ((ii + wkst) % 7))))
+				continue;
+
+			n_week++;
+
+			if (ii >= start_pos)
+				n_first++;
+			if (ii <= rid_pos)
+				n_last++;
+		}
+
+		if (!weeks)
+			index = n_last - (n_week - n_first);
+		else
+			index = n_first + ((guint64) weeks / interval - 1) * n_week + n_last;
+		} break;
+	case I_CAL_MONTHLY_RECURRENCE: {
+		gint months;
+
+		months = (year - i_cal_time_get_year (dtstart)) * 12 + month - i_cal_time_get_month (dtstart);
+		if (day == i_cal_time_get_day (dtstart) && months % interval == 0)
+			index = months / interval + 1;
+		} break;
+	case I_CAL_YEARLY_RECURRENCE: {
+		gint years;
+
+		years = year - i_cal_time_get_year (dtstart);
+		if (day == i_cal_time_get_day (dtstart) && month == i_cal_time_get_month (dtstart) && years % interval == 0)
+			index = years / interval + 1;
+		} break;
+	default:
+		break;
+	}
+
+	if (!index || index > G_MAXUINT)
+		return 0;
+
+	count = i_cal_recurrence_get_count (rrule);
+	if (count > 0 && index > (guint64) count)
+		return 0;
+
+	until = i_cal_recurrence_get_until (rrule);
+	if (until && !i_cal_time_is_null_time (until)) {
+		ICalTime *occurrence;
+
+		occurrence = i_cal_time_clone (dtstart);
+		i_cal_time_set_date (occurrence, year, month, day);
+
+		if (i_cal_time_compare (occurrence, until) > 0)
+			index = 0;
+
+		g_object_unref (occurrence);
+	}
+	g_clear_object (&until);
+
+	return (guint) index;
+}
+
+/* Returns TRUE, when the @rrule is simple enough to have the index computed
+   without the expansion; the @out_index is 0 when @o_time is not an occurrence */
+static gboolean
+ews_rid_index_closed_form (ICalRecurrence *rrule,
+			   ICalTime *dtstart,
+			   ICalTimezone *timezone,
+			   ICalTime *o_time,
+			   guint *out_index)
+{
+	ICalTime *local;
+	guint day_mask = 0;
+	gint n_by_day;
+
+	switch (i_cal_recurrence_get_freq (rrule)) {
+	case I_CAL_DAILY_RECURRENCE:
+	case I_CAL_WEEKLY_RECURRENCE:
+		break;
+	case I_CAL_MONTHLY_RECURRENCE:
+		/* Not every month has the day */
+		if (i_cal_time_get_day (dtstart) > 28)
+			return FALSE;
+		break;
+	case I_CAL_YEARLY_RECURRENCE:
+		if (i_cal_time_get_month (dtstart) == 2 && i_cal_time_get_day (dtstart) == 29)
+			return FALSE;
+		break;
+	default:
+		return FALSE;
+	}
+
+	n_by_day = ews_rid_index_count_by (rrule, I_CAL_BY_DAY, i_cal_recurrence_get_by_day_array);
+
+	if (ews_rid_index_count_by (rrule, I_CAL_BY_SECOND, i_cal_recurrence_get_by_second_array) != 0 ||
+	    ews_rid_index_count_by (rrule, I_CAL_BY_MINUTE, i_cal_recurrence_get_by_minute_array) != 0 ||
+	    ews_rid_index_count_by (rrule, I_CAL_BY_HOUR, i_cal_recurrence_get_by_hour_array) != 0 ||
+	    ews_rid_index_count_by (rrule, I_CAL_BY_MONTH_DAY, i_cal_recurrence_get_by_month_day_array) != 0 ||
+	    ews_rid_index_count_by (rrule, I_CAL_BY_YEAR_DAY, i_cal_recurrence_get_by_year_day_array) != 0 ||
+	    ews_rid_index_count_by (rrule, I_CAL_BY_WEEK_NO, i_cal_recurrence_get_by_week_no_array) != 0 ||
+	    ews_rid_index_count_by (rrule, I_CAL_BY_MONTH, i_cal_recurrence_get_by_month_array) != 0 ||
+	    ews_rid_index_count_by (rrule, I_CAL_BY_SET_POS, i_cal_recurrence_get_by_set_pos_array) != 0)
+		return FALSE;
+
+	if (n_by_day > 0) {
+		gint ii;
+
+		if (i_cal_recurrence_get_freq (rrule) != I_CAL_WEEKLY_RECURRENCE)
+			return FALSE;
+
+		for (ii = 0; ii < n_by_day; ii++) {
+			gshort byday = ews_rid_index_get_by_day (rrule, ii);
+			gint weekday = (gint) i_cal_recurrence_day_day_of_week (byday) - 1;
+
+			if (i_cal_recurrence_day_position (byday) != 0 || weekday < 0 || weekday > 6)
+				return FALSE;
+
+			day_mask |= 1 << weekday;
+		}
+
+		/* The DTSTART is the first occurrence only when it matches the rule */
+		if (!(day_mask & (1 << (i_cal_time_day_of_week (dtstart) - 1))))
+			return FALSE;
+	} else {
+		day_mask = 1 << (i_cal_time_day_of_week (dtstart) - 1);
+	}
+
+	/* The all day events can be matched with a date only */
+	if (i_cal_time_is_date (dtstart) && !i_cal_time_is_date (o_time))
+		return FALSE;
+
+	*out_index = 0;
+
+	if (!i_cal_time_is_date (dtstart) && !i_cal_time_is_date (o_time)) {
+		ICalTime *exact;
+
+		/* All the occurrences are at the DTSTART time in the master's time zone, thus
+		   the exact match, as compared in UTC, can be only the one at the rid's time */
+		exact = i_cal_time_clone (o_time);
+		if (!i_cal_time_get_timezone (exact))
+			i_cal_time_set_timezone (exact, i_cal_timezone_get_utc_timezone ());
+		if (timezone)
+			i_cal_time_convert_to_zone_inplace (exact, timezone);
+
+		if (i_cal_time_get_hour (exact) == i_cal_time_get_hour (dtstart) &&
+		    i_cal_time_get_minute (exact) == i_cal_time_get_minute (dtstart) &&
+		    i_cal_time_get_second (exact) == i_cal_time_get_second (dtstart)) {
+			*out_index = ews_rid_index_closed_form_date (rrule, dtstart, day_mask,
+				i_cal_time_get_year (exact), i_cal_time_get_month (exact), i_cal_time_get_day (exact));
+		}
+
+		g_object_unref (exact);
+	}
+
+	if (!*out_index) {
+		/* if cannot find an exact time, try with the date part only */
+		local = i_cal_time_clone (o_time);
+		if (!i_cal_time_is_date (local) && timezone)
+			i_cal_time_convert_to_zone_inplace (local, timezone);
+
+		*out_index = ews_rid_index_closed_form_date (rrule, dtstart, day_mask,
+			i_cal_time_get_year (local), i_cal_time_get_month (local), i_cal_time_get_day (local));
+
+		g_object_unref (local);
+	}
+
+	return TRUE;
+}
+
+G_MODULE_EXPORT ECalBackendEwsRidIndex *
+e_cal_backend_ews_rid_index_new (void)
+{
+	ECalBackendEwsRidIndex *rid_index;
+
+	rid_index = g_new0 (ECalBackendEwsRidIndex, 1);
+	g_mutex_init (&rid_index->lock);
+	rid_index->masters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, ews_rid_index_master_free);
+
+	return rid_index;
+}
+
+G_MODULE_EXPORT void
+e_cal_backend_ews_rid_index_free (ECalBackendEwsRidIndex *rid_index)
+{
+	if (rid_index) {
+		g_hash_table_destroy (rid_index->masters);
+		g_mutex_clear (&rid_index->lock);
+		g_free (rid_index);
+	}
+}
+
+/* Returns the index of the @rid occurrence of the @comp master, or 0 with
+   the @error set when the @rid is not an occurrence; the computed occurrences
+   of the complex rules are remembered in the @rid_index, when not NULL */
+G_MODULE_EXPORT guint
+e_cal_backend_ews_rid_index_lookup (ECalBackendEwsRidIndex *rid_index,
+				    ICalTimezone *timezone,
+				    const gchar *rid,
+				    ICalComponent *comp,
+				    GError **error)
 {
 	guint index = 1;
 	ICalProperty *prop;
 	ICalRecurrence *rrule;
 	ICalTime *dtstart;
-	ICalRecurIterator *ritr;
-	ICalTime *next, *o_time;
+	ICalTime *o_time;
 
 	prop = i_cal_component_get_first_property (comp, I_CAL_RRULE_PROPERTY);
 	if (!prop)
@@ -2322,49 +2603,87 @@ e_cal_backend_ews_rid_to_index (ICalTimezone *timezone,
 
 	o_time = i_cal_time_new_from_string (rid);
 
-	ritr = i_cal_recur_iterator_new (rrule, dtstart);
+	if (!ews_rid_index_closed_form (rrule, dtstart, timezone, o_time, &index)) {
+		EwsRidIndexMaster *master = NULL;
+		const gchar *uid;
+		gchar *key, *rrule_str, *dtstart_str;
+		gint64 exact;
+		gint date;
+		ICalTime *local;
 
-	for (next = i_cal_recur_iterator_next (ritr);
-	     next && !i_cal_time_is_null_time (next);
-	     g_object_unref (next), next = i_cal_recur_iterator_next (ritr), index++) {
-		/* Make sure the date is compared with the expected timezone, not converted into UTC */
-		if (i_cal_time_compare (o_time, next) == 0) {
-			break;
-		}
-	}
+		exact = ews_rid_index_get_exact (o_time);
 
-	/* if cannot find an exact time, try with the date part only */
-	if (!next || i_cal_time_is_null_time (next)) {
-		g_clear_object (&ritr);
-		g_clear_object (&next);
-		index = 1;
-		ritr = i_cal_recur_iterator_new (rrule, dtstart);
-		for (next = i_cal_recur_iterator_next (ritr);
-		     next && !i_cal_time_is_null_time (next);
-		     g_object_unref (next), next = i_cal_recur_iterator_next (ritr), index++) {
-			/* Make sure the date is compared with the expected timezone */
-			if (i_cal_time_compare_date_only_tz (o_time, next, timezone) == 0) {
-				break;
+		local = i_cal_time_clone (o_time);
+		if (!i_cal_time_is_date (local) && timezone)
+			i_cal_time_convert_to_zone_inplace (local, timezone);
+		date = ews_rid_index_get_date (local);
+		g_object_unref (local);
+
+		rrule_str = i_cal_recurrence_to_string (rrule);
+		dtstart_str = i_cal_time_as_ical_string (dtstart);
+		key = g_strconcat (rrule_str ? rrule_str : "", "\n", dtstart_str ? dtstart_str : "", "\n",
+			timezone ? i_cal_timezone_get_tzid (timezone) : "", NULL);
+		g_free (rrule_str);
+		g_free (dtstart_str);
+
+		uid = i_cal_component_get_uid (comp);
+
+		if (rid_index && uid && *uid) {
+			g_mutex_lock (&rid_index->lock);
+
+			master = g_hash_table_lookup (rid_index->masters, uid);
+
+			/* Changed master; compute it again */
+			if (master && g_strcmp0 (master->key, key) != 0)
+				master = NULL;
+
+			if (!master) {
+				if (g_hash_table_size (rid_index->masters) >= EWS_RID_INDEX_MAX_MASTERS)
+					g_hash_table_remove_all (rid_index->masters);
+
+				master = ews_rid_index_master_new (key, rrule, dtstart);
+				key = NULL;
+
+				g_hash_table_insert (rid_index->masters, g_strdup (uid), master);
 			}
+
+			index = ews_rid_index_master_find (master, exact, date);
+
+			g_mutex_unlock (&rid_index->lock);
+		} else {
+			master = ews_rid_index_master_new (key, rrule, dtstart);
+			key = NULL;
+
+			index = ews_rid_index_master_find (master, exact, date);
+
+			ews_rid_index_master_free (master);
 		}
+
+		g_free (key);
 	}
 
-	if (!next || i_cal_time_is_null_time (next)) {
+	if (!index) {
 		g_propagate_error (error,
 			e_client_error_create (E_CLIENT_ERROR_OTHER_ERROR, _("Invalid occurrence ID")));
-		index = 0;
 	}
 
 	g_clear_object (&prop);
 	g_clear_object (&rrule);
 	g_clear_object (&dtstart);
 	g_clear_object (&o_time);
-	g_clear_object (&next);
-	g_clear_object (&ritr);
 
 	return index;
 }
 
+G_MODULE_EXPORT guint
+e_cal_backend_ews_rid_to_index (ICalTimezone *timezone,
+				const gchar *rid,
+				ICalComponent *comp,
+				GError **error)
+{
+	return e_cal_backend_ews_rid_index_lookup (NULL, timezone, rid, comp, error);
+}
+
 gboolean
 e_cal_backend_ews_clear_reminder_is_set (ESoapRequest *request,
 					 gpointer user_data,
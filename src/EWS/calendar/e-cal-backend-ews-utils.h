@@ -51,8 +51,6 @@ void e_ews_clean_icomponent (ICalComponent *icomp);
 
 const gchar *e_cal_backend_ews_tz_util_get_msdn_equivalent (const gchar *ical_tz_location);
 const gchar *e_cal_backend_ews_tz_util_get_ical_equivalent (const gchar *msdn_tz_location);
-void e_cal_backend_ews_populate_windows_zones (void);
-void e_cal_backend_ews_unref_windows_zones (void);
 
 gboolean e_cal_backend_ews_convert_calcomp_to_xml (ESoapRequest *request, gpointer user_data, GError **error);
 gboolean e_cal_backend_ews_convert_component_to_updatexml (ESoapRequest *request, gpointer user_data, GError **error);
@@ -62,6 +60,12 @@ gboolean e_cal_backend_ews_prepare_accept_item_request (ESoapRequest *request, g
 
 guint e_cal_backend_ews_rid_to_index (ICalTimezone *timezone, const gchar *rid, ICalComponent *comp, GError **error);
 
+typedef struct _ECalBackendEwsRidIndex ECalBackendEwsRidIndex;
+
+ECalBackendEwsRidIndex *e_cal_backend_ews_rid_index_new (void);
+void e_cal_backend_ews_rid_index_free (ECalBackendEwsRidIndex *rid_index);
+guint e_cal_backend_ews_rid_index_lookup (ECalBackendEwsRidIndex *rid_index, ICalTimezone *timezone, const gchar *rid, ICalComponent *comp, GError **error);
+
 #if ICAL_CHECK_VERSION(3, 99, 99)
 typedef ICalTime * (* ECBEwsTimeGetFuncType) (const ICalProperty *prop);
 typedef void (* ECBEwsTimeSetFuncType) (ICalProperty *prop, const ICalTime *v);
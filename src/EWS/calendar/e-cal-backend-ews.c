@@ -72,9 +72,12 @@ struct _ECalBackendEwsPrivate {
 	gchar *attachments_dir;
 
 	EThreeState is_user_calendar;
+
+	ECalBackendEwsRidIndex *rid_index; /* the occurrence indexes of the recurring events */
 };
 
 #define ECB_EWS_SYNC_TAG_STAMP_KEY "ews-sync-tag-stamp"
+#define ECB_EWS_FREEBUSY_CHUNKS_KEY "ews-freebusy-chunks"
 
 #define X_EWS_ORIGINAL_COMP "X-EWS-ORIGINAL-COMP"
 
@@ -1885,298 +1888,710 @@ ecb_ews_disconnect_sync (ECalMetaBackend *meta_backend,
 	return TRUE;
 }
 
+/* Free/busy calendar */
+
+typedef struct _FreeBusyChunk {
+	time_t period_start;
+	time_t period_end;
+	gchar *key; /* for the ECache key of the chunk */
+	GSList *free_busy; /* ICalComponent * */
+	GError *error;
+	gchar *digest;
+	GPtrArray *uids; /* gchar *, the events in the chunk */
+	gboolean changed; /* the digest is stored once the changes are saved */
+} FreeBusyChunk;
+
+typedef struct _FreeBusyFetch {
+	EEwsConnection *cnc;
+	GSList *user_mails; /* gchar * */
+	GCancellable *cancellable; /* cancelled on the first failure */
+} FreeBusyFetch;
+
+static void
+ecb_ews_freebusy_chunk_free (gpointer ptr)
+{
+	FreeBusyChunk *chunk = ptr;
+
+	if (chunk) {
+		g_free (chunk->key);
+		g_slist_free_full (chunk->free_busy, g_object_unref);
+		g_clear_error (&chunk->error);
+		g_free (chunk->digest);
+		g_clear_pointer (&chunk->uids, g_ptr_array_unref);
+		g_free (chunk);
+	}
+}
+
+static void
+ecb_ews_freebusy_fetch_chunk_func (gpointer data,
+				   gpointer user_data)
+{
+	FreeBusyChunk *chunk = data;
+	FreeBusyFetch *fetch = user_data;
+	EEWSFreeBusyData fbdata;
+
+	if (g_cancellable_set_error_if_cancelled (fetch->cancellable, &chunk->error))
+		return;
+
+	fbdata.period_start = chunk->period_start;
+	fbdata.period_end = chunk->period_end;
+	fbdata.user_mails = fetch->user_mails;
+
+	/* No need to ask for the other chunks, when any of them fails */
+	if (!e_ews_connection_get_free_busy_sync (fetch->cnc, EWS_PRIORITY_MEDIUM,
+		e_ews_cal_utils_prepare_free_busy_request, &fbdata,
+		&chunk->free_busy, fetch->cancellable, &chunk->error))
+		g_cancellable_cancel (fetch->cancellable);
+}
+
+static void
+ecb_ews_freebusy_cancelled_cb (GCancellable *cancellable,
+			       gpointer user_data)
+{
+	g_cancellable_cancel (user_data);
+}
+
+/* Returns whether the 'fbprop' is of a type shown in the calendar */
 static gboolean
-ecb_ews_get_changes_sync (ECalMetaBackend *meta_backend,
-			  const gchar *last_sync_tag,
-			  gboolean is_repeat,
-			  gchar **out_new_sync_tag,
-			  gboolean *out_repeat,
-			  GSList **out_created_objects,
-			  GSList **out_modified_objects,
-			  GSList **out_removed_objects,
-			  GCancellable *cancellable,
-			  GError **error)
+ecb_ews_freebusy_get_fbtype (ICalProperty *fbprop,
+			     ICalParameterFbtype *out_fbtype)
 {
-	ECalBackendEws *cbews;
+	ICalParameter *param;
+
+	param = i_cal_property_get_first_parameter (fbprop, I_CAL_FBTYPE_PARAMETER);
+	if (!param)
+		return FALSE;
+
+	*out_fbtype = i_cal_parameter_get_fbtype (param);
+	g_clear_object (&param);
+
+	return *out_fbtype == I_CAL_FBTYPE_FREE ||
+	       *out_fbtype == I_CAL_FBTYPE_BUSY ||
+	       *out_fbtype == I_CAL_FBTYPE_BUSYUNAVAILABLE ||
+	       *out_fbtype == I_CAL_FBTYPE_BUSYTENTATIVE ||
+	       *out_fbtype == I_CAL_FBTYPE_X;
+}
+
+static ICalComponent *
+ecb_ews_freebusy_to_vevent (ICalProperty *fbprop,
+			    ICalParameterFbtype fbtype)
+{
+	ICalTimezone *utc_zone = i_cal_timezone_get_utc_timezone ();
+	ICalComponent *vevent;
+	ICalPeriod *fb;
+	ICalTime *itt;
+	gchar *id, *summary, *location;
+
+	fb = i_cal_property_get_freebusy (fbprop);
+	id = i_cal_property_get_parameter_as_string (fbprop, "X-EWS-ID");
+	summary = i_cal_property_get_parameter_as_string (fbprop, "X-SUMMARY");
+	location = i_cal_property_get_parameter_as_string (fbprop, "X-LOCATION");
+
+	vevent = i_cal_component_new_vevent ();
+
+	if (id && *id) {
+		i_cal_component_set_uid (vevent, id);
+	} else {
+		gchar *uid, *start, *end;
+
+		itt = i_cal_period_get_start (fb);
+		start = i_cal_time_as_ical_string (itt);
+		g_clear_object (&itt);
+
+		itt = i_cal_period_get_end (fb);
+		end = i_cal_time_as_ical_string (itt);
+		g_clear_object (&itt);
+
+		uid = g_strdup_printf ("%s-%s-%d", start, end, (gint) fbtype);
+
+		i_cal_component_set_uid (vevent, uid);
+
+		g_free (start);
+		g_free (end);
+		g_free (uid);
+	}
+
+	itt = i_cal_period_get_start (fb);
+	i_cal_time_set_timezone (itt, utc_zone);
+	i_cal_component_set_dtstart (vevent, itt);
+	g_clear_object (&itt);
+
+	itt = i_cal_period_get_end (fb);
+	i_cal_time_set_timezone (itt, utc_zone);
+	i_cal_component_set_dtend (vevent, itt);
+	g_clear_object (&itt);
+
+	itt = i_cal_time_new_current_with_zone (utc_zone);
+	i_cal_component_take_property (vevent, i_cal_property_new_created (itt));
+	g_clear_object (&itt);
+
+	if (fbtype == I_CAL_FBTYPE_FREE)
+		i_cal_component_take_property (vevent, i_cal_property_new_transp (I_CAL_TRANSP_TRANSPARENT));
+
+	if (summary && *summary) {
+		i_cal_component_set_summary (vevent, summary);
+	} else {
+		if (fbtype == I_CAL_FBTYPE_FREE) {
+			i_cal_component_set_summary (vevent, C_("FreeBusyType", "Free"));
+		} else if (fbtype == I_CAL_FBTYPE_BUSY) {
+			i_cal_component_set_summary (vevent, C_("FreeBusyType", "Busy"));
+		} else if (fbtype == I_CAL_FBTYPE_BUSYUNAVAILABLE) {
+			i_cal_component_set_summary (vevent, C_("FreeBusyType", "Out of Office"));
+		} else if (fbtype == I_CAL_FBTYPE_BUSYTENTATIVE) {
+			i_cal_component_set_summary (vevent, C_("FreeBusyType", "Tentative"));
+		} else if (fbtype == I_CAL_FBTYPE_X) {
+			gchar *str = i_cal_property_get_parameter_as_string (fbprop, "FBTYPE");
+			if (str && str[0] == 'X' && str[1] == '-') {
+				i_cal_component_set_summary (vevent, str + 2);
+			}
+			g_free (str);
+		}
+	}
+
+	if (location && *location)
+		i_cal_component_set_location (vevent, location);
+
+	g_free (id);
+	g_free (summary);
+	g_free (location);
+	g_clear_object (&fb);
+
+	return vevent;
+}
+
+/* Calls 'func' for each free/busy property of the chunk, which is shown in the calendar */
+static void
+ecb_ews_freebusy_chunk_foreach (FreeBusyChunk *chunk,
+				void (* func) (ICalProperty *fbprop,
+					       ICalParameterFbtype fbtype,
+					       gpointer user_data),
+				gpointer user_data)
+{
+	GSList *link;
+
+	for (link = chunk->free_busy; link; link = g_slist_next (link)) {
+		ICalComponent *fbcomp = link->data;
+		ICalProperty *fbprop;
+
+		if (!fbcomp || i_cal_component_isa (fbcomp) != I_CAL_VFREEBUSY_COMPONENT)
+			continue;
+
+		for (fbprop = i_cal_component_get_first_property (fbcomp, I_CAL_FREEBUSY_PROPERTY);
+		     fbprop;
+		     g_object_unref (fbprop), fbprop = i_cal_component_get_next_property (fbcomp, I_CAL_FREEBUSY_PROPERTY)) {
+			ICalParameterFbtype fbtype;
+
+			if (ecb_ews_freebusy_get_fbtype (fbprop, &fbtype))
+				func (fbprop, fbtype, user_data);
+		}
+	}
+}
+
+typedef struct _FreeBusyDigestData {
+	GChecksum *checksum;
+	GPtrArray *uids;
+} FreeBusyDigestData;
+
+static void
+ecb_ews_freebusy_digest_cb (ICalProperty *fbprop,
+			    ICalParameterFbtype fbtype,
+			    gpointer user_data)
+{
+	FreeBusyDigestData *dd = user_data;
+	ICalComponent *vevent;
+	gchar *str;
+
+	/* The property holds everything the event is made of */
+	str = i_cal_property_as_ical_string (fbprop);
+	g_checksum_update (dd->checksum, (const guchar *) str, -1);
+	g_free (str);
+
+	vevent = ecb_ews_freebusy_to_vevent (fbprop, fbtype);
+	g_ptr_array_add (dd->uids, g_strdup (i_cal_component_get_uid (vevent)));
+	g_object_unref (vevent);
+}
+
+static void
+ecb_ews_freebusy_chunk_compute_digest (FreeBusyChunk *chunk)
+{
+	FreeBusyDigestData dd;
+
+	dd.checksum = g_checksum_new (G_CHECKSUM_SHA1);
+	dd.uids = g_ptr_array_new_with_free_func (g_free);
+
+	ecb_ews_freebusy_chunk_foreach (chunk, ecb_ews_freebusy_digest_cb, &dd);
+
+	chunk->digest = g_strdup (g_checksum_get_string (dd.checksum));
+	chunk->uids = dd.uids;
+
+	g_checksum_free (dd.checksum);
+}
+
+/* The stored value is the digest on the first line, followed by the UID-s of the events, one per line */
+static gboolean
+ecb_ews_freebusy_chunk_unchanged (FreeBusyChunk *chunk,
+				  ECalCache *cal_cache,
+				  const gchar *stored)
+{
+	const gchar *eol;
+	guint ii;
+
+	if (!stored || !chunk->digest)
+		return FALSE;
+
+	eol = strchr (stored, '\n');
+	if (!eol || strlen (chunk->digest) != eol - stored || strncmp (stored, chunk->digest, eol - stored) != 0)
+		return FALSE;
+
+	/* Also when the events had been saved, which is done after the changes are returned */
+	for (ii = 0; ii < chunk->uids->len; ii++) {
+		if (!e_cal_cache_contains (cal_cache, chunk->uids->pdata[ii], NULL, E_CACHE_EXCLUDE_DELETED))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+ecb_ews_freebusy_chunks_contain (GPtrArray *chunks, /* FreeBusyChunk * */
+				 const gchar *key)
+{
+	guint ii;
+
+	for (ii = 0; ii < chunks->len; ii++) {
+		FreeBusyChunk *chunk = chunks->pdata[ii];
+
+		if (g_strcmp0 (chunk->key, key) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+typedef struct _FreeBusyChangesData {
 	ECalCache *cal_cache;
-	gboolean sync_tag_stamp_changed;
-	gboolean success = TRUE;
+	GHashTable *recognized; /* gchar *UID, the event can split among multiple chunks */
+	GSList **out_created_objects;
+	GSList **out_modified_objects;
+	GCancellable *cancellable;
+} FreeBusyChangesData;
+
+static void
+ecb_ews_freebusy_changes_cb (ICalProperty *fbprop,
+			     ICalParameterFbtype fbtype,
+			     gpointer user_data)
+{
+	FreeBusyChangesData *cd = user_data;
+	ECalComponent *ecomp = NULL;
+	ICalComponent *vevent;
+	const gchar *uid;
+
+	vevent = ecb_ews_freebusy_to_vevent (fbprop, fbtype);
+	uid = i_cal_component_get_uid (vevent);
+
+	if (g_hash_table_contains (cd->recognized, uid)) {
+		g_object_unref (vevent);
+		return;
+	}
+
+	if (e_cal_cache_get_component (cd->cal_cache, uid, NULL, &ecomp, cd->cancellable, NULL) && ecomp) {
+		if (ecb_ews_freebusy_ecomp_changed (ecomp, vevent)) {
+			ECalMetaBackendInfo *nfo;
+			gchar *revision = e_util_generate_uid ();
+
+			e_cal_util_component_set_x_property (vevent, "X-EVOLUTION-CHANGEKEY", revision);
+
+			nfo = e_cal_meta_backend_info_new (uid, NULL, NULL, NULL);
+			nfo->revision = revision;
+			nfo->object = i_cal_component_as_ical_string (vevent);
+
+			*cd->out_created_objects = g_slist_prepend (*cd->out_created_objects, nfo);
+		}
+	} else {
+		ECalMetaBackendInfo *nfo;
+		gchar *revision = e_util_generate_uid ();
+
+		e_cal_util_component_set_x_property (vevent, "X-EVOLUTION-CHANGEKEY", revision);
+
+		nfo = e_cal_meta_backend_info_new (uid, NULL, NULL, NULL);
+		nfo->revision = revision;
+		nfo->object = i_cal_component_as_ical_string (vevent);
+
+		*cd->out_modified_objects = g_slist_prepend (*cd->out_modified_objects, nfo);
+	}
+
+	g_hash_table_add (cd->recognized, g_strdup (uid));
+
+	g_clear_object (&ecomp);
+	g_object_unref (vevent);
+}
+
+/* The chunks are the fixed 5-week periods counted from a Monday, thus their
+   keys stay the same across the days and only the window edges change */
+#define ECB_EWS_FREEBUSY_CHUNK_SECONDS (5 * 7 * 24 * 60 * 60)
+#define ECB_EWS_FREEBUSY_CHUNK_ORIGIN (4 * 24 * 60 * 60) /* 1970-01-05 00:00:00 UTC, a Monday */
+
+/* Adds the UID-s of the 'stored' chunk value, which are not in the 'present',
+   into the 'removed'; the event can move to another chunk, or span more chunks */
+static void
+ecb_ews_freebusy_add_removed (GHashTable *removed,
+			      const gchar *stored,
+			      GHashTable *present)
+{
+	gchar **lines;
+	guint ii;
+
+	if (!stored)
+		return;
+
+	lines = g_strsplit (stored, "\n", -1);
+
+	/* The first line is the digest */
+	for (ii = 1; lines[ii]; ii++) {
+		if (*(lines[ii]) && !g_hash_table_contains (present, lines[ii]))
+			g_hash_table_add (removed, g_strdup (lines[ii]));
+	}
+
+	g_strfreev (lines);
+}
+
+/* The free/busy window is fetched in chunks of 5 weeks, all at once, up to
+   the "concurrent-connections" requests. Each chunk is remembered in the cache
+   with the digest of its content and its events, thus the unchanged chunks
+   are skipped and the removed events are found chunk by chunk, without reading
+   the whole cache. */
+static gboolean
+ecb_ews_get_freebusy_changes_sync (ECalBackendEws *cbews,
+				   ECalCache *cal_cache,
+				   GSList **out_created_objects,
+				   GSList **out_modified_objects,
+				   GSList **out_removed_objects,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	ESourceEwsFolder *ews_folder;
+	CamelEwsSettings *settings;
+	FreeBusyFetch fetch;
+	FreeBusyChangesData cd;
+	GThreadPool *pool;
+	GPtrArray *chunks; /* FreeBusyChunk * */
+	GHashTable *present; /* gchar *UID, the events of this sync */
+	GHashTable *removed; /* gchar *UID */
+	GHashTableIter iter;
+	GString *chunk_keys;
 	GError *local_error = NULL;
+	gpointer key;
+	gchar *mailbox, *stored_keys;
+	gulong cancelled_id = 0;
+	gint n_weeks, from_week;
+	guint ii, max_threads;
+	time_t today, window_end, period_start;
+	gboolean success = TRUE;
 
-	g_return_val_if_fail (E_IS_CAL_BACKEND_EWS (meta_backend), FALSE);
-	g_return_val_if_fail (out_new_sync_tag != NULL, FALSE);
-	g_return_val_if_fail (out_repeat != NULL, FALSE);
-	g_return_val_if_fail (out_created_objects != NULL, FALSE);
-	g_return_val_if_fail (out_modified_objects != NULL, FALSE);
-	g_return_val_if_fail (out_removed_objects != NULL, FALSE);
+	ews_folder = e_source_get_extension (e_backend_get_source (E_BACKEND (cbews)), E_SOURCE_EXTENSION_EWS_FOLDER);
+	cbews->priv->freebusy_calendar_weeks_before = e_source_ews_folder_get_freebusy_weeks_before (ews_folder);
+	cbews->priv->freebusy_calendar_weeks_after = e_source_ews_folder_get_freebusy_weeks_after (ews_folder);
 
-	*out_created_objects = NULL;
-	*out_modified_objects = NULL;
-	*out_removed_objects = NULL;
+	today = time_day_begin (time (NULL));
 
-	cbews = E_CAL_BACKEND_EWS (meta_backend);
+	from_week = -cbews->priv->freebusy_calendar_weeks_before;
+	if (from_week < -27)
+		from_week = -27;
+	n_weeks = -from_week + cbews->priv->freebusy_calendar_weeks_after;
+	if (n_weeks > 80)
+		n_weeks = 80;
+	if (n_weeks < 1)
+		n_weeks = 1;
 
-	cal_cache = e_cal_meta_backend_ref_cache (meta_backend);
-	g_return_val_if_fail (E_IS_CAL_CACHE (cal_cache), FALSE);
+	mailbox = e_source_ews_folder_dup_foreign_mail (ews_folder);
+	chunks = g_ptr_array_new_with_free_func (ecb_ews_freebusy_chunk_free);
+	period_start = time_add_week (today, from_week);
+	window_end = time_day_end (time_add_week (period_start, n_weeks));
 
-	sync_tag_stamp_changed = ecb_ews_get_sync_tag_stamp_changed (cbews);
-	if (sync_tag_stamp_changed)
-		last_sync_tag = NULL;
+	/* Start with the chunk containing the window start */
+	period_start -= (period_start - ECB_EWS_FREEBUSY_CHUNK_ORIGIN) % ECB_EWS_FREEBUSY_CHUNK_SECONDS;
 
-	g_rec_mutex_lock (&cbews->priv->cnc_lock);
+	while (period_start < window_end) {
+		FreeBusyChunk *chunk;
 
-	if (cbews->priv->is_freebusy_calendar) {
-		ESourceEwsFolder *ews_folder;
-		EEWSFreeBusyData fbdata;
-		GHashTable *known = NULL;
-		GHashTable *recognized; /* gchar *UID */
-		GHashTableIter iter;
-		gpointer key;
-		gint n_weeks, from_week;
-		time_t today;
-
-		ews_folder = e_source_get_extension (e_backend_get_source (E_BACKEND (cbews)), E_SOURCE_EXTENSION_EWS_FOLDER);
-		cbews->priv->freebusy_calendar_weeks_before = e_source_ews_folder_get_freebusy_weeks_before (ews_folder);
-		cbews->priv->freebusy_calendar_weeks_after = e_source_ews_folder_get_freebusy_weeks_after (ews_folder);
-
-		today = time_day_begin (time (NULL));
-
-		from_week = -cbews->priv->freebusy_calendar_weeks_before;
-		if (from_week < -27)
-			from_week = -27;
-		n_weeks = -from_week + cbews->priv->freebusy_calendar_weeks_after;
-		if (n_weeks > 80)
-			n_weeks = 80;
-		if (n_weeks < 1)
-			n_weeks = 1;
-
-		fbdata.period_end = time_add_week (today, from_week) - 1;
-		fbdata.user_mails = g_slist_prepend (NULL, e_source_ews_folder_dup_foreign_mail (ews_folder));
-
-		/* the event can split among multiple chunks, then do not add it multiple times */
-		recognized = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-
-		while (n_weeks > 0) {
-			GSList *free_busy = NULL, *link;
-
-			fbdata.period_start = fbdata.period_end + 1;
-			fbdata.period_end = time_day_end (time_add_week (fbdata.period_start + 1, n_weeks <= 5 ? n_weeks : 5));
-
-			if (n_weeks < 5)
-				n_weeks = 0;
-			else
-				n_weeks -= 5;
+		chunk = g_new0 (FreeBusyChunk, 1);
+		chunk->period_start = period_start;
+		chunk->period_end = period_start + ECB_EWS_FREEBUSY_CHUNK_SECONDS - 1;
+		chunk->key = g_strdup_printf ("freebusy-chunk::%s::%" G_GINT64_FORMAT "::%" G_GINT64_FORMAT,
+			mailbox ? mailbox : "", (gint64) chunk->period_start, (gint64) chunk->period_end);
 
-			success = e_ews_connection_get_free_busy_sync (cbews->priv->cnc, G_PRIORITY_DEFAULT,
-				e_ews_cal_utils_prepare_free_busy_request, &fbdata,
-				&free_busy, cancellable, &local_error);
+		period_start += ECB_EWS_FREEBUSY_CHUNK_SECONDS;
 
-			if (success) {
-				ICalTimezone *utc_zone = i_cal_timezone_get_utc_timezone ();
+		g_ptr_array_add (chunks, chunk);
+	}
 
-				if (!known) {
-					GSList *comps = NULL;
+	fetch.cnc = cbews->priv->cnc;
+	fetch.user_mails = g_slist_prepend (NULL, mailbox);
+	fetch.cancellable = g_cancellable_new ();
 
-					known = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+	if (cancellable)
+		cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (ecb_ews_freebusy_cancelled_cb), fetch.cancellable, NULL);
 
-					if (e_cal_cache_search_components (cal_cache, NULL, &comps, cancellable, NULL)) {
-						for (link = comps; link; link = g_slist_next (link)) {
-							ECalComponent *comp = link->data;
-							ICalComponent *icomp;
-							const gchar *uid;
+	settings = e_ews_connection_ref_settings (cbews->priv->cnc);
+	max_threads = settings ? camel_ews_settings_get_concurrent_connections (settings) : MIN_CONCURRENT_CONNECTIONS;
+	g_clear_object (&settings);
 
-							if (!comp)
-								continue;
+	pool = g_thread_pool_new (ecb_ews_freebusy_fetch_chunk_func, &fetch,
+		MIN (CLAMP (max_threads, MIN_CONCURRENT_CONNECTIONS, MAX_CONCURRENT_CONNECTIONS), chunks->len), FALSE, NULL);
 
-							icomp = e_cal_component_get_icalcomponent (comp);
-							if (!icomp)
-								continue;
+	for (ii = 0; ii < chunks->len; ii++) {
+		g_thread_pool_push (pool, chunks->pdata[ii], NULL);
+	}
 
-							uid = i_cal_component_get_uid (icomp);
+	/* Waits for all the chunks to be fetched */
+	g_thread_pool_free (pool, FALSE, TRUE);
 
-							if (uid && *uid)
-								g_hash_table_insert (known, g_strdup (uid), g_object_ref (comp));
-						}
+	if (cancelled_id)
+		g_cancellable_disconnect (cancellable, cancelled_id);
 
-						g_slist_free_full (comps, g_object_unref);
-					}
+	/* Prefer the error, which caused the cancel of the other chunks */
+	for (ii = 0; ii < chunks->len; ii++) {
+		FreeBusyChunk *chunk = chunks->pdata[ii];
+
+		if (chunk->error && (!local_error || g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))) {
+			g_clear_error (&local_error);
+			local_error = g_error_copy (chunk->error);
+		}
+	}
+
+	if (local_error) {
+		if (g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_NOFREEBUSYACCESS)) {
+			e_cal_meta_backend_empty_cache_sync (E_CAL_META_BACKEND (cbews), cancellable, NULL);
+
+			stored_keys = e_cache_dup_key (E_CACHE (cal_cache), ECB_EWS_FREEBUSY_CHUNKS_KEY, NULL);
+			if (stored_keys) {
+				gchar **keys = g_strsplit (stored_keys, "\n", -1);
+
+				for (ii = 0; keys[ii]; ii++) {
+					if (*(keys[ii]))
+						e_cache_set_key (E_CACHE (cal_cache), keys[ii], NULL, NULL);
 				}
 
-				for (link = free_busy; link; link = g_slist_next (link)) {
-					ICalComponent *fbcomp = link->data;
-					ICalProperty *fbprop;
-					ICalParameter *param;
-					ICalPeriod *fb;
-					ICalParameterFbtype fbtype;
+				e_cache_set_key (E_CACHE (cal_cache), ECB_EWS_FREEBUSY_CHUNKS_KEY, NULL, NULL);
 
-					if (!fbcomp || i_cal_component_isa (fbcomp) != I_CAL_VFREEBUSY_COMPONENT)
-						continue;
+				g_strfreev (keys);
+				g_free (stored_keys);
+			}
 
-					for (fbprop = i_cal_component_get_first_property (fbcomp, I_CAL_FREEBUSY_PROPERTY);
-					     fbprop;
-					     g_object_unref (fbprop), fbprop = i_cal_component_get_next_property (fbcomp, I_CAL_FREEBUSY_PROPERTY)) {
-						ECalComponent *ecomp;
-						ICalComponent *vevent;
-						ICalTime *itt;
-						gchar *id, *summary, *location;
-
-						param = i_cal_property_get_first_parameter (fbprop, I_CAL_FBTYPE_PARAMETER);
-						if (!param)
-							continue;
-
-						fbtype = i_cal_parameter_get_fbtype (param);
-						g_clear_object (&param);
-
-						if (fbtype != I_CAL_FBTYPE_FREE &&
-						    fbtype != I_CAL_FBTYPE_BUSY &&
-						    fbtype != I_CAL_FBTYPE_BUSYUNAVAILABLE &&
-						    fbtype != I_CAL_FBTYPE_BUSYTENTATIVE &&
-						    fbtype != I_CAL_FBTYPE_X)
-							continue;
-
-						fb = i_cal_property_get_freebusy (fbprop);
-						id = i_cal_property_get_parameter_as_string (fbprop, "X-EWS-ID");
-						summary = i_cal_property_get_parameter_as_string (fbprop, "X-SUMMARY");
-						location = i_cal_property_get_parameter_as_string (fbprop, "X-LOCATION");
-
-						vevent = i_cal_component_new_vevent ();
-
-						if (id && *id) {
-							i_cal_component_set_uid (vevent, id);
-						} else {
-							gchar *uid, *start, *end;
+			e_cal_backend_notify_error (E_CAL_BACKEND (cbews), local_error->message);
+			g_clear_error (&local_error);
+		} else {
+			g_propagate_error (error, local_error);
+			success = FALSE;
+		}
 
-							itt = i_cal_period_get_start (fb);
-							start = i_cal_time_as_ical_string (itt);
-							g_clear_object (&itt);
+		g_slist_free_full (fetch.user_mails, g_free);
+		g_object_unref (fetch.cancellable);
+		g_ptr_array_unref (chunks);
 
-							itt = i_cal_period_get_end (fb);
-							end = i_cal_time_as_ical_string (itt);
-							g_clear_object (&itt);
+		return success;
+	}
 
-							uid = g_strdup_printf ("%s-%s-%d", start, end, (gint) fbtype);
+	stored_keys = e_cache_dup_key (E_CACHE (cal_cache), ECB_EWS_FREEBUSY_CHUNKS_KEY, NULL);
 
-							i_cal_component_set_uid (vevent, uid);
+	cd.cal_cache = cal_cache;
+	cd.recognized = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	cd.out_created_objects = out_created_objects;
+	cd.out_modified_objects = out_modified_objects;
+	cd.cancellable = cancellable;
 
-							g_free (start);
-							g_free (end);
-							g_free (uid);
-						}
+	present = g_hash_table_new (g_str_hash, g_str_equal);
+	removed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	chunk_keys = g_string_new ("");
 
-						itt = i_cal_period_get_start (fb);
-						i_cal_time_set_timezone (itt, utc_zone);
-						i_cal_component_set_dtstart (vevent, itt);
-						g_clear_object (&itt);
+	for (ii = 0; ii < chunks->len; ii++) {
+		FreeBusyChunk *chunk = chunks->pdata[ii];
+		gchar *stored;
+		guint jj;
 
-						itt = i_cal_period_get_end (fb);
-						i_cal_time_set_timezone (itt, utc_zone);
-						i_cal_component_set_dtend (vevent, itt);
-						g_clear_object (&itt);
+		ecb_ews_freebusy_chunk_compute_digest (chunk);
 
-						itt = i_cal_time_new_current_with_zone (utc_zone);
-						i_cal_component_take_property (vevent, i_cal_property_new_created (itt));
-						g_clear_object (&itt);
+		stored = e_cache_dup_key (E_CACHE (cal_cache), chunk->key, NULL);
 
-						if (fbtype == I_CAL_FBTYPE_FREE)
-							i_cal_component_take_property (vevent, i_cal_property_new_transp (I_CAL_TRANSP_TRANSPARENT));
+		if (ecb_ews_freebusy_chunk_unchanged (chunk, cal_cache, stored)) {
+			for (jj = 0; jj < chunk->uids->len; jj++) {
+				g_hash_table_add (cd.recognized, g_strdup (chunk->uids->pdata[jj]));
+			}
+		} else {
+			ecb_ews_freebusy_chunk_foreach (chunk, ecb_ews_freebusy_changes_cb, &cd);
+			chunk->changed = TRUE;
+		}
 
-						if (summary && *summary) {
-							i_cal_component_set_summary (vevent, summary);
-						} else {
-							if (fbtype == I_CAL_FBTYPE_FREE) {
-								i_cal_component_set_summary (vevent, C_("FreeBusyType", "Free"));
-							} else if (fbtype == I_CAL_FBTYPE_BUSY) {
-								i_cal_component_set_summary (vevent, C_("FreeBusyType", "Busy"));
-							} else if (fbtype == I_CAL_FBTYPE_BUSYUNAVAILABLE) {
-								i_cal_component_set_summary (vevent, C_("FreeBusyType", "Out of Office"));
-							} else if (fbtype == I_CAL_FBTYPE_BUSYTENTATIVE) {
-								i_cal_component_set_summary (vevent, C_("FreeBusyType", "Tentative"));
-							} else if (fbtype == I_CAL_FBTYPE_X) {
-								gchar *str = i_cal_property_get_parameter_as_string (fbprop, "FBTYPE");
-								if (str && str[0] == 'X' && str[1] == '-') {
-									i_cal_component_set_summary (vevent, str + 2);
-								}
-								g_free (str);
-							}
-						}
+		for (jj = 0; jj < chunk->uids->len; jj++) {
+			g_hash_table_add (present, chunk->uids->pdata[jj]);
+		}
 
-						if (location && *location)
-							i_cal_component_set_location (vevent, location);
+		g_string_append (chunk_keys, chunk->key);
+		g_string_append_c (chunk_keys, '\n');
 
-						ecomp = g_hash_table_lookup (known, i_cal_component_get_uid (vevent));
-						if (ecomp) {
-							g_object_ref (ecomp);
+		g_free (stored);
+	}
 
-							/* This dereferences the ecomp, thus the ref() call above to keep it alive */
-							g_hash_table_remove (known, i_cal_component_get_uid (vevent));
+	if (stored_keys) {
+		gchar **keys;
 
-							if (ecb_ews_freebusy_ecomp_changed (ecomp, vevent)) {
-								ECalMetaBackendInfo *nfo;
-								gchar *revision = e_util_generate_uid ();
+		/* The removed events of the changed chunks; the unchanged chunks have the same events */
+		for (ii = 0; ii < chunks->len; ii++) {
+			FreeBusyChunk *chunk = chunks->pdata[ii];
+			gchar *stored;
 
-								e_cal_util_component_set_x_property (vevent, "X-EVOLUTION-CHANGEKEY", revision);
+			if (!chunk->changed)
+				continue;
 
-								nfo = e_cal_meta_backend_info_new (i_cal_component_get_uid (vevent), NULL, NULL, NULL);
-								nfo->revision = revision;
-								nfo->object = i_cal_component_as_ical_string (vevent);
+			stored = e_cache_dup_key (E_CACHE (cal_cache), chunk->key, NULL);
+			ecb_ews_freebusy_add_removed (removed, stored, present);
+			g_free (stored);
+		}
 
-								*out_created_objects = g_slist_prepend (*out_created_objects, nfo);
-							}
+		/* The events of the chunks, which are out of the window now */
+		keys = g_strsplit (stored_keys, "\n", -1);
 
-							g_clear_object (&ecomp);
+		for (ii = 0; keys[ii]; ii++) {
+			gchar *stored;
 
-							g_hash_table_add (recognized, g_strdup (i_cal_component_get_uid (vevent)));
-						} else if (!g_hash_table_contains (recognized, i_cal_component_get_uid (vevent))) {
-							ECalMetaBackendInfo *nfo;
-							gchar *revision = e_util_generate_uid ();
+			if (!*(keys[ii]) || ecb_ews_freebusy_chunks_contain (chunks, keys[ii]))
+				continue;
 
-							e_cal_util_component_set_x_property (vevent, "X-EVOLUTION-CHANGEKEY", revision);
+			stored = e_cache_dup_key (E_CACHE (cal_cache), keys[ii], NULL);
+			ecb_ews_freebusy_add_removed (removed, stored, present);
+			g_free (stored);
+		}
 
-							nfo = e_cal_meta_backend_info_new (i_cal_component_get_uid (vevent), NULL, NULL, NULL);
-							nfo->revision = revision;
-							nfo->object = i_cal_component_as_ical_string (vevent);
+		g_strfreev (keys);
+	} else {
+		GSList *ids = NULL, *link;
 
-							*out_modified_objects = g_slist_prepend (*out_modified_objects, nfo);
+		/* The first sync with the chunks remembered in the cache */
+		if (e_cal_cache_search_ids (cal_cache, NULL, &ids, cancellable, NULL)) {
+			for (link = ids; link; link = g_slist_next (link)) {
+				ECalComponentId *id = link->data;
+				const gchar *uid = id ? e_cal_component_id_get_uid (id) : NULL;
 
-							g_hash_table_add (recognized, g_strdup (i_cal_component_get_uid (vevent)));
-						}
+				if (uid && !g_hash_table_contains (present, uid))
+					g_hash_table_add (removed, g_strdup (uid));
+			}
 
-						g_free (id);
-						g_free (summary);
-						g_free (location);
-						g_clear_object (&fb);
-						g_object_unref (vevent);
-					}
-				}
+			g_slist_free_full (ids, (GDestroyNotify) e_cal_component_id_free);
+		}
+	}
 
-				g_slist_free_full (free_busy, g_object_unref);
-			} else {
-				if (g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_NOFREEBUSYACCESS)) {
-					e_cal_meta_backend_empty_cache_sync (meta_backend, cancellable, NULL);
+	g_hash_table_iter_init (&iter, removed);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		*out_removed_objects = g_slist_prepend (*out_removed_objects,
+			e_cal_meta_backend_info_new (key, NULL, NULL, NULL));
+	}
 
-					e_cal_backend_notify_error (E_CAL_BACKEND (cbews), local_error->message);
-					g_clear_error (&local_error);
-					success = TRUE;
-				} else {
-					g_propagate_error (error, local_error);
-				}
-				break;
+	/* Save the changes here, because the chunk digests can be stored only
+	   after it, otherwise the chunks would be skipped as unchanged on the next
+	   sync, even when the saving of their events failed */
+	success = e_cal_meta_backend_process_changes_sync (E_CAL_META_BACKEND (cbews), *out_created_objects,
+		*out_modified_objects, *out_removed_objects, cancellable, error);
+
+	if (success) {
+		g_slist_free_full (*out_created_objects, e_cal_meta_backend_info_free);
+		g_slist_free_full (*out_modified_objects, e_cal_meta_backend_info_free);
+		g_slist_free_full (*out_removed_objects, e_cal_meta_backend_info_free);
+		*out_created_objects = NULL;
+		*out_modified_objects = NULL;
+		*out_removed_objects = NULL;
+
+		for (ii = 0; ii < chunks->len; ii++) {
+			FreeBusyChunk *chunk = chunks->pdata[ii];
+			GString *value;
+			guint jj;
+
+			if (!chunk->changed)
+				continue;
+
+			value = g_string_new (chunk->digest);
+			g_string_append_c (value, '\n');
+
+			for (jj = 0; jj < chunk->uids->len; jj++) {
+				g_string_append (value, chunk->uids->pdata[jj]);
+				g_string_append_c (value, '\n');
 			}
+
+			e_cache_set_key (E_CACHE (cal_cache), chunk->key, value->str, NULL);
+
+			g_string_free (value, TRUE);
 		}
 
-		if (known && success) {
-			g_hash_table_iter_init (&iter, known);
-			while (g_hash_table_iter_next (&iter, &key, NULL)) {
-				const gchar *uid = key;
+		/* Forget the chunks, which are out of the window now */
+		if (stored_keys) {
+			gchar **keys = g_strsplit (stored_keys, "\n", -1);
 
-				*out_removed_objects = g_slist_prepend (*out_removed_objects,
-					e_cal_meta_backend_info_new (uid, NULL, NULL, NULL));
+			for (ii = 0; keys[ii]; ii++) {
+				if (*(keys[ii]) && !ecb_ews_freebusy_chunks_contain (chunks, keys[ii]))
+					e_cache_set_key (E_CACHE (cal_cache), keys[ii], NULL, NULL);
 			}
+
+			g_strfreev (keys);
 		}
 
-		g_slist_free_full (fbdata.user_mails, g_free);
-		g_clear_pointer (&known, g_hash_table_destroy);
-		g_hash_table_destroy (recognized);
+		e_cache_set_key (E_CACHE (cal_cache), ECB_EWS_FREEBUSY_CHUNKS_KEY, chunk_keys->str, NULL);
+	}
+
+	g_string_free (chunk_keys, TRUE);
+	g_hash_table_destroy (present);
+	g_hash_table_destroy (removed);
+	g_hash_table_destroy (cd.recognized);
+	g_slist_free_full (fetch.user_mails, g_free);
+	g_object_unref (fetch.cancellable);
+	g_ptr_array_unref (chunks);
+	g_free (stored_keys);
+
+	return success;
+}
+
+static gboolean
+ecb_ews_get_changes_sync (ECalMetaBackend *meta_backend,
+			  const gchar *last_sync_tag,
+			  gboolean is_repeat,
+			  gchar **out_new_sync_tag,
+			  gboolean *out_repeat,
+			  GSList **out_created_objects,
+			  GSList **out_modified_objects,
+			  GSList **out_removed_objects,
+			  GCancellable *cancellable,
+			  GError **error)
+{
+	ECalBackendEws *cbews;
+	ECalCache *cal_cache;
+	gboolean sync_tag_stamp_changed;
+	gboolean success = TRUE;
+	GError *local_error = NULL;
+
+	g_return_val_if_fail (E_IS_CAL_BACKEND_EWS (meta_backend), FALSE);
+	g_return_val_if_fail (out_new_sync_tag != NULL, FALSE);
+	g_return_val_if_fail (out_repeat != NULL, FALSE);
+	g_return_val_if_fail (out_created_objects != NULL, FALSE);
+	g_return_val_if_fail (out_modified_objects != NULL, FALSE);
+	g_return_val_if_fail (out_removed_objects != NULL, FALSE);
+
+	*out_created_objects = NULL;
+	*out_modified_objects = NULL;
+	*out_removed_objects = NULL;
+
+	cbews = E_CAL_BACKEND_EWS (meta_backend);
+
+	cal_cache = e_cal_meta_backend_ref_cache (meta_backend);
+	g_return_val_if_fail (E_IS_CAL_CACHE (cal_cache), FALSE);
+
+	sync_tag_stamp_changed = ecb_ews_get_sync_tag_stamp_changed (cbews);
+	if (sync_tag_stamp_changed)
+		last_sync_tag = NULL;
+
+	g_rec_mutex_lock (&cbews->priv->cnc_lock);
+
+	if (cbews->priv->is_freebusy_calendar) {
+		success = ecb_ews_get_freebusy_changes_sync (cbews, cal_cache,
+			out_created_objects, out_modified_objects, out_removed_objects,
+			cancellable, error);
 	} else {
 		GSList *items_created = NULL, *items_modified = NULL, *items_deleted = NULL, *link;
 		EEwsAdditionalProps *add_props;
@@ -2245,7 +2660,7 @@ ecb_ews_get_changes_sync (ECalMetaBackend *meta_backend,
 					}
 				}
 
-				g_slist_free_full (ids, e_cal_component_id_free);
+				g_slist_free_full (ids, (GDestroyNotify) e_cal_component_id_free);
 			}
 
 			g_slist_free_full (components_created, g_object_unref);
@@ -2691,7 +3106,7 @@ ecb_ews_remove_item_sync (ECalBackendEws *cbews,
 		success = FALSE;
 	} else {
 		if (parent) {
-			index = e_cal_backend_ews_rid_to_index (
+			index = e_cal_backend_ews_rid_index_lookup (cbews->priv->rid_index,
 				ecb_ews_get_timezone_from_icomponent (cbews,
 					e_cal_component_get_icalcomponent (parent)),
 				rid,
@@ -2907,7 +3322,7 @@ ecb_ews_get_change_type_is_instance (ECalBackendEws *cbews,
 			if (mid && g_strcmp0 (mid, sid) == 0) {
 				gint index;
 
-				index = e_cal_backend_ews_rid_to_index (
+				index = e_cal_backend_ews_rid_index_lookup (cbews->priv->rid_index,
 					ecb_ews_get_timezone_from_icomponent (cbews, main_comp),
 					rid,
 					main_comp,
@@ -3053,7 +3468,7 @@ ecb_ews_modify_item_sync (ECalBackendEws *cbews,
 			prop = link->data;
 
 			rid = i_cal_property_get_value_as_string (prop);
-			index = e_cal_backend_ews_rid_to_index (
+			index = e_cal_backend_ews_rid_index_lookup (cbews->priv->rid_index,
 				ecb_ews_get_timezone_from_icomponent (cbews, new_icomp),
 				rid,
 				new_icomp,
@@ -3273,7 +3688,7 @@ ecb_ews_save_component_sync (ECalMetaBackend *meta_backend,
 
 			folder_ids.data = &dfid;
 
-			success = e_ews_connection_get_folder_sync (cbews->priv->cnc, G_PRIORITY_DEFAULT, "IdOnly", NULL, &folder_ids, &folders, cancellable, error);
+			success = e_ews_connection_get_folder_sync (cbews->priv->cnc, EWS_PRIORITY_MEDIUM, "IdOnly", NULL, &folder_ids, &folders, cancellable, error);
 			if (success) {
 				gboolean is_user_calendar = FALSE;
 
@@ -3605,7 +4020,7 @@ ecb_ews_discard_alarm_sync (ECalBackendSync *cal_backend_sync,
 		gint index;
 
 		icomp = e_cal_component_get_icalcomponent (comp);
-		index = e_cal_backend_ews_rid_to_index (
+		index = e_cal_backend_ews_rid_index_lookup (cbews->priv->rid_index,
 			ecb_ews_get_timezone_from_icomponent (cbews, icomp),
 			rid,
 			icomp,
@@ -4335,7 +4750,7 @@ ecb_ews_receive_objects_sync (ECalBackendSync *sync_backend,
 			g_clear_error (&local_error);
 		}
 
-		g_slist_free_full (ids, e_cal_component_id_free);
+		g_slist_free_full (ids, (GDestroyNotify) e_cal_component_id_free);
 		} break;
 	default:
 		break;
@@ -4746,9 +5161,9 @@ ecb_ews_finalize (GObject *object)
 	g_free (cbews->priv->attachments_dir);
 	g_free (cbews->priv->last_subscription_id);
 
-	g_rec_mutex_clear (&cbews->priv->cnc_lock);
+	e_cal_backend_ews_rid_index_free (cbews->priv->rid_index);
 
-	e_cal_backend_ews_unref_windows_zones ();
+	g_rec_mutex_clear (&cbews->priv->cnc_lock);
 
 	/* Chain up to parent's method. */
 	G_OBJECT_CLASS (e_cal_backend_ews_parent_class)->finalize (object);
@@ -4762,7 +5177,7 @@ e_cal_backend_ews_init (ECalBackendEws *cbews)
 
 	g_rec_mutex_init (&cbews->priv->cnc_lock);
 
-	e_cal_backend_ews_populate_windows_zones ();
+	cbews->priv->rid_index = e_cal_backend_ews_rid_index_new ();
 }
 
 static void
@@ -12,6 +12,7 @@ which needs to be better organized via functions */
 #include "evolution-ews-config.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
@@ -69,6 +70,8 @@ struct _CamelEwsFolderPrivate {
 
 	gboolean apply_filters;
 	gboolean check_folder;
+
+	gchar *resync_filename;
 };
 
 static gboolean ews_delete_messages (CamelFolder *folder, const GSList *deleted_items, gboolean expunge, GCancellable *cancellable, GError **error);
@@ -726,6 +729,109 @@ ews_message_from_properties_sync (CamelEwsFolder *ews_folder,
 	return TRUE;
 }
 
+/* Fixes up a message freshly stored in the cache from the server: the From
+   and the Date may be missing or wrong in the MimeContent, thus take them
+   from the item, and keep the attachment flag in sync with the content. */
+static void
+ews_folder_finish_downloaded_message (CamelEwsFolder *ews_folder,
+				      const gchar *uid,
+				      EEwsItem *item,
+				      CamelMimeMessage *message,
+				      GCancellable *cancellable)
+{
+	CamelEwsFolderPrivate *priv = ews_folder->priv;
+	CamelFolder *folder = CAMEL_FOLDER (ews_folder);
+	CamelInternetAddress *from;
+	CamelMessageInfo *mi;
+	const gchar *email = NULL, *date_header;
+	gboolean resave = FALSE;
+
+	from = camel_mime_message_get_from (message);
+
+	if (!from || !camel_internet_address_get (from, 0, NULL, &email) || !email || !*email) {
+		const EwsMailbox *mailbox;
+
+		mailbox = e_ews_item_get_from (item);
+		if (!mailbox)
+			mailbox = e_ews_item_get_sender (item);
+		if (mailbox) {
+			email = NULL;
+
+			if (g_strcmp0 (mailbox->routing_type, "EX") == 0)
+				email = e_ews_item_util_strip_ex_address (mailbox->email);
+
+			from = camel_internet_address_new ();
+			camel_internet_address_add (from, mailbox->name, email ? email : mailbox->email);
+			camel_mime_message_set_from (message, from);
+			g_object_unref (from);
+
+			resave = TRUE;
+		}
+	}
+
+	date_header = e_ews_item_get_date_header (item);
+	if (date_header && *date_header) {
+		time_t tt;
+		gint tz_offset;
+
+		tt = camel_header_decode_date (date_header, &tz_offset);
+		if (tt > 0) {
+			camel_mime_message_set_date (message, tt, tz_offset);
+			resave = TRUE;
+		}
+	}
+
+	if (resave) {
+		CamelStream *cache_stream;
+
+		g_rec_mutex_lock (&priv->cache_lock);
+		/* Ignore errors here, it's nothing fatal in this case */
+		cache_stream = ews_data_cache_get (ews_folder->cache, "cur", uid, NULL);
+		if (cache_stream) {
+			GIOStream *iostream;
+
+			/* Truncate the stream first, in case the message will be shorter
+			   than the one received from the server */
+			iostream = camel_stream_ref_base_stream (cache_stream);
+			if (iostream) {
+				GOutputStream *output_stream;
+
+				output_stream = g_io_stream_get_output_stream (iostream);
+				if (G_IS_SEEKABLE (output_stream)) {
+					GSeekable *seekable = G_SEEKABLE (output_stream);
+
+					if (g_seekable_can_truncate (seekable)) {
+						g_seekable_truncate (seekable, 0, NULL, NULL);
+					}
+				}
+
+				g_object_unref (iostream);
+			}
+
+			camel_data_wrapper_write_to_stream_sync (CAMEL_DATA_WRAPPER (message), cache_stream, cancellable, NULL);
+			g_object_unref (cache_stream);
+		}
+		g_rec_mutex_unlock (&priv->cache_lock);
+	}
+
+	mi = camel_folder_summary_get (camel_folder_get_folder_summary (folder), uid);
+	if (mi) {
+		CamelMessageFlags flags;
+		gboolean has_attachment;
+
+		flags = camel_message_info_get_flags (mi);
+		has_attachment = camel_mime_message_has_attachment (message);
+		if (((flags & CAMEL_MESSAGE_ATTACHMENTS) && !has_attachment) ||
+		    ((flags & CAMEL_MESSAGE_ATTACHMENTS) == 0 && has_attachment)) {
+			camel_message_info_set_flags (
+				mi, CAMEL_MESSAGE_ATTACHMENTS,
+				has_attachment ? CAMEL_MESSAGE_ATTACHMENTS : 0);
+		}
+
+		g_clear_object (&mi);
+	}
+}
+
 static CamelMimeMessage *
 camel_ews_folder_get_message (CamelFolder *folder,
                               const gchar *uid,
@@ -979,97 +1085,8 @@ camel_ews_folder_get_message (CamelFolder *folder,
 	g_free (cache_file);
 
 	message = camel_ews_folder_get_message_from_cache (ews_folder, uid, cancellable, error);
-	if (message) {
-		CamelInternetAddress *from;
-		CamelMessageInfo *mi;
-		const gchar *email = NULL, *date_header;
-		gboolean resave = FALSE;
-
-		from = camel_mime_message_get_from (message);
-
-		if (!from || !camel_internet_address_get (from, 0, NULL, &email) || !email || !*email) {
-			const EwsMailbox *mailbox;
-
-			mailbox = e_ews_item_get_from (items->data);
-			if (!mailbox)
-				mailbox = e_ews_item_get_sender (items->data);
-			if (mailbox) {
-				email = NULL;
-
-				if (g_strcmp0 (mailbox->routing_type, "EX") == 0)
-					email = e_ews_item_util_strip_ex_address (mailbox->email);
-
-				from = camel_internet_address_new ();
-				camel_internet_address_add (from, mailbox->name, email ? email : mailbox->email);
-				camel_mime_message_set_from (message, from);
-				g_object_unref (from);
-
-				resave = TRUE;
-			}
-		}
-
-		date_header = e_ews_item_get_date_header (items->data);
-		if (date_header && *date_header) {
-			time_t tt;
-			gint tz_offset;
-
-			tt = camel_header_decode_date (date_header, &tz_offset);
-			if (tt > 0) {
-				camel_mime_message_set_date (message, tt, tz_offset);
-				resave = TRUE;
-			}
-		}
-
-		if (resave) {
-			CamelStream *cache_stream;
-
-			g_rec_mutex_lock (&priv->cache_lock);
-			/* Ignore errors here, it's nothing fatal in this case */
-			cache_stream = ews_data_cache_get (ews_folder->cache, "cur", uid, NULL);
-			if (cache_stream) {
-				GIOStream *iostream;
-
-				/* Truncate the stream first, in case the message will be shorter
-				   than the one received from the server */
-				iostream = camel_stream_ref_base_stream (cache_stream);
-				if (iostream) {
-					GOutputStream *output_stream;
-
-					output_stream = g_io_stream_get_output_stream (iostream);
-					if (G_IS_SEEKABLE (output_stream)) {
-						GSeekable *seekable = G_SEEKABLE (output_stream);
-
-						if (g_seekable_can_truncate (seekable)) {
-							g_seekable_truncate (seekable, 0, NULL, NULL);
-						}
-					}
-
-					g_object_unref (iostream);
-				}
-
-				camel_data_wrapper_write_to_stream_sync (CAMEL_DATA_WRAPPER (message), cache_stream, cancellable, NULL);
-				g_object_unref (cache_stream);
-			}
-			g_rec_mutex_unlock (&priv->cache_lock);
-		}
-
-		mi = camel_folder_summary_get (camel_folder_get_folder_summary (folder), uid);
-		if (mi) {
-			CamelMessageFlags flags;
-			gboolean has_attachment;
-
-			flags = camel_message_info_get_flags (mi);
-			has_attachment = camel_mime_message_has_attachment (message);
-			if (((flags & CAMEL_MESSAGE_ATTACHMENTS) && !has_attachment) ||
-			    ((flags & CAMEL_MESSAGE_ATTACHMENTS) == 0 && has_attachment)) {
-				camel_message_info_set_flags (
-					mi, CAMEL_MESSAGE_ATTACHMENTS,
-					has_attachment ? CAMEL_MESSAGE_ATTACHMENTS : 0);
-			}
-
-			g_clear_object (&mi);
-		}
-	}
+	if (message)
+		ews_folder_finish_downloaded_message (ews_folder, uid, items->data, message, cancellable);
 
 exit:
 	g_mutex_lock (&priv->state_lock);
@@ -1159,7 +1176,7 @@ ews_folder_get_message_sync (CamelFolder *folder,
 
 	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (folder), NULL);
 
-	message = camel_ews_folder_get_message (folder, uid, EWS_ITEM_HIGH, cancellable, error);
+	message = camel_ews_folder_get_message (folder, uid, EWS_PRIORITY_HIGH, cancellable, error);
 	if (message)
 		ews_folder_maybe_update_mlist (folder, uid, message);
 
@@ -1174,6 +1191,352 @@ ews_folder_get_message_cached (CamelFolder *folder,
 	return camel_ews_folder_get_message_from_cache ((CamelEwsFolder *) folder, message_uid, cancellable, NULL);
 }
 
+static gboolean
+ews_folder_is_message_cached (CamelEwsFolder *ews_folder,
+			      const gchar *uid)
+{
+	gchar *filename;
+	gboolean cached;
+
+	filename = ews_data_cache_get_filename (ews_folder->cache, "cur", uid, NULL);
+	cached = filename && g_access (filename, R_OK) == 0;
+	g_free (filename);
+
+	if (!cached) {
+		/* Files stored before the names had been hashed;
+		   camel_ews_folder_get_message_from_cache() renames them */
+		filename = camel_data_cache_get_filename (ews_folder->cache, "cur", uid);
+		cached = filename && g_access (filename, R_OK) == 0;
+		g_free (filename);
+	}
+
+	return cached;
+}
+
+static GPtrArray *
+ews_folder_get_uncached_uids (CamelFolder *folder,
+			      GPtrArray *uids,
+			      GError **error)
+{
+	CamelEwsFolder *ews_folder = CAMEL_EWS_FOLDER (folder);
+	GPtrArray *uncached_uids;
+	guint ii;
+
+	uncached_uids = g_ptr_array_new ();
+
+	for (ii = 0; uids && ii < uids->len; ii++) {
+		const gchar *uid = uids->pdata[ii];
+
+		if (!ews_folder_is_message_cached (ews_folder, uid))
+			g_ptr_array_add (uncached_uids, (gpointer) camel_pstring_strdup (uid));
+	}
+
+	return uncached_uids;
+}
+
+/* Downloads MimeContent of all the 'uids' with a single GetItem request; each
+   <MimeContent> is streamed into its own file in the 'mime_dir', which is then
+   moved into the cache. The 'uids' should be marked in the priv->fetching_uids.
+   Items, which need special care (meeting messages, conversion failures), are
+   skipped and left to camel_ews_folder_get_message(). */
+static gboolean
+ews_folder_prefetch_batch_sync (CamelEwsFolder *ews_folder,
+				EEwsConnection *cnc,
+				GSList *uids,
+				const gchar *mime_dir,
+				GCancellable *cancellable,
+				GError **error)
+{
+	EEwsAdditionalProps *add_props;
+	GHashTable *requested;
+	GSList *items = NULL, *link;
+	gboolean success;
+
+	add_props = e_ews_additional_props_new ();
+	add_props->field_uri = g_strdup ("item:MimeContent message:From message:Sender");
+	add_props->indexed_furis = g_slist_prepend (NULL, e_ews_indexed_field_uri_new ("item:InternetMessageHeader", "Date"));
+
+	success = e_ews_connection_get_items_sync (
+		cnc, EWS_PRIORITY_LOW, uids, "IdOnly", add_props,
+		TRUE, mime_dir, E_EWS_BODY_TYPE_ANY,
+		&items,
+		NULL, NULL,
+		cancellable, error);
+
+	e_ews_additional_props_free (add_props);
+
+	if (!success) {
+		g_slist_free_full (items, g_object_unref);
+		return FALSE;
+	}
+
+	requested = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (link = uids; link; link = g_slist_next (link)) {
+		g_hash_table_add (requested, link->data);
+	}
+
+	for (link = items; link; link = g_slist_next (link)) {
+		EEwsItem *item = link->data;
+		const EwsId *item_id;
+		const gchar *uid;
+		const gchar *mime_content;
+		CamelMimeMessage *message;
+		EEwsItemType item_type;
+		gchar *cache_file, *dir;
+
+		if (!item)
+			continue;
+
+		item_type = e_ews_item_get_item_type (item);
+
+		if (item_type == E_EWS_ITEM_TYPE_ERROR)
+			continue;
+
+		/* The mime_content actually contains the *filename*, due to the
+		 * streaming hack in ESoapResponse */
+		mime_content = e_ews_item_get_mime_content (item);
+		if (!mime_content)
+			continue;
+
+		item_id = e_ews_item_get_id (item);
+		uid = item_id ? g_hash_table_lookup (requested, item_id->id) : NULL;
+
+		if (!uid ||
+		    item_type == E_EWS_ITEM_TYPE_MEETING_REQUEST ||
+		    item_type == E_EWS_ITEM_TYPE_MEETING_CANCELLATION ||
+		    item_type == E_EWS_ITEM_TYPE_MEETING_MESSAGE ||
+		    item_type == E_EWS_ITEM_TYPE_MEETING_RESPONSE) {
+			g_unlink (mime_content);
+			continue;
+		}
+
+		cache_file = ews_data_cache_get_filename (ews_folder->cache, "cur", uid, NULL);
+		dir = g_path_get_dirname (cache_file);
+
+		if (g_mkdir_with_parents (dir, 0700) == -1 ||
+		    g_rename (mime_content, cache_file) != 0) {
+			g_warning ("%s: Failed to move message cache file from '%s' to '%s': %s", G_STRFUNC,
+				   mime_content, cache_file, g_strerror (errno));
+			g_unlink (mime_content);
+			g_free (cache_file);
+			g_free (dir);
+			continue;
+		}
+
+		g_free (cache_file);
+		g_free (dir);
+
+		message = camel_ews_folder_get_message_from_cache (ews_folder, uid, cancellable, NULL);
+		if (message) {
+			ews_folder_finish_downloaded_message (ews_folder, uid, item, message, cancellable);
+			g_object_unref (message);
+		}
+	}
+
+	g_hash_table_destroy (requested);
+	g_slist_free_full (items, g_object_unref);
+
+	return TRUE;
+}
+
+/* Downloads the uncached messages among 'uids' in batches, limited by
+   the "prefetch-batch-size" and "prefetch-batch-bytes" settings. */
+static gboolean
+ews_folder_prefetch_messages_sync (CamelEwsFolder *ews_folder,
+				   GPtrArray *uids,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (ews_folder);
+	CamelFolderSummary *folder_summary;
+	CamelEwsFolderPrivate *priv = ews_folder->priv;
+	CamelEwsStore *ews_store;
+	CamelSettings *settings;
+	EEwsConnection *cnc;
+	gchar *mime_dir;
+	guint batch_size, batch_bytes, ii;
+	gboolean success = TRUE;
+
+	if (!uids || !uids->len)
+		return TRUE;
+
+	ews_store = CAMEL_EWS_STORE (camel_folder_get_parent_store (folder));
+
+	if (!camel_ews_store_connected (ews_store, cancellable, error))
+		return FALSE;
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (ews_store));
+	batch_size = camel_ews_settings_get_prefetch_batch_size (CAMEL_EWS_SETTINGS (settings));
+	batch_bytes = camel_ews_settings_get_prefetch_batch_bytes (CAMEL_EWS_SETTINGS (settings));
+	g_clear_object (&settings);
+
+	mime_dir = g_build_filename (
+		camel_data_cache_get_path (ews_folder->cache),
+		"mimecontent", NULL);
+
+	if (g_access (mime_dir, F_OK) == -1 &&
+	    g_mkdir_with_parents (mime_dir, 0700) == -1) {
+		g_set_error (
+			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+			_("Unable to create cache path “%s”: %s"),
+			mime_dir, g_strerror (errno));
+		g_free (mime_dir);
+		return FALSE;
+	}
+
+	cnc = camel_ews_store_ref_connection (ews_store);
+	folder_summary = camel_folder_get_folder_summary (folder);
+
+	camel_operation_push_message (cancellable, _("Downloading messages for offline use"));
+
+	for (ii = 0; ii < uids->len && success;) {
+		GSList *batch = NULL, *link;
+		guint64 bytes = 0;
+		guint n_batch = 0;
+
+		g_mutex_lock (&priv->state_lock);
+
+		for (; ii < uids->len && n_batch < batch_size; ii++) {
+			const gchar *uid = uids->pdata[ii];
+			CamelMessageInfo *mi;
+			guint32 size = 0;
+
+			if (g_hash_table_lookup (priv->fetching_uids, uid) ||
+			    ews_folder_is_message_cached (ews_folder, uid))
+				continue;
+
+			mi = camel_folder_summary_get (folder_summary, uid);
+			if (mi) {
+				size = camel_message_info_get_size (mi);
+				g_object_unref (mi);
+			}
+
+			/* Always take at least one message, even if it exceeds the budget */
+			if (batch_bytes && n_batch > 0 && bytes + size > batch_bytes)
+				break;
+
+			bytes += size;
+			n_batch++;
+
+			g_hash_table_insert (priv->fetching_uids, (gchar *) uid, (gchar *) uid);
+			batch = g_slist_prepend (batch, (gpointer) uid);
+		}
+
+		g_mutex_unlock (&priv->state_lock);
+
+		if (!batch)
+			continue;
+
+		batch = g_slist_reverse (batch);
+
+		success = ews_folder_prefetch_batch_sync (ews_folder, cnc, batch, mime_dir, cancellable, error);
+
+		g_mutex_lock (&priv->state_lock);
+		for (link = batch; link; link = g_slist_next (link)) {
+			g_hash_table_remove (priv->fetching_uids, link->data);
+		}
+		g_cond_broadcast (&priv->fetch_cond);
+		g_mutex_unlock (&priv->state_lock);
+
+		g_slist_free (batch);
+
+		camel_operation_progress (cancellable, ii * 100 / uids->len);
+	}
+
+	camel_operation_pop_message (cancellable);
+
+	g_clear_object (&cnc);
+	g_free (mime_dir);
+
+	return success;
+}
+
+static gboolean
+ews_folder_downsync_sync (CamelOfflineFolder *offline_folder,
+			  const gchar *expression,
+			  GCancellable *cancellable,
+			  GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (offline_folder);
+	CamelFolderSummary *folder_summary;
+	CamelStore *parent_store;
+	CamelSettings *settings;
+	GPtrArray *uids, *uncached_uids;
+	gboolean limit_by_age = FALSE;
+	CamelTimeUnit limit_unit = CAMEL_TIME_UNIT_DAYS;
+	gint limit_value = 0;
+	gint64 limit_time = 0;
+	GError *local_error = NULL;
+
+	parent_store = camel_folder_get_parent_store (folder);
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (parent_store));
+	g_object_get (
+		settings,
+		"limit-by-age", &limit_by_age,
+		"limit-unit", &limit_unit,
+		"limit-value", &limit_value,
+		NULL);
+	g_clear_object (&settings);
+
+	if (limit_by_age)
+		limit_time = camel_time_value_apply ((time_t) 0, limit_unit, limit_value);
+
+	if (expression)
+		uids = camel_folder_search_by_expression (folder, expression, cancellable, NULL);
+	else
+		uids = camel_folder_get_uids (folder);
+
+	uncached_uids = ews_folder_get_uncached_uids (folder, uids, NULL);
+
+	if (expression)
+		camel_folder_search_free (folder, uids);
+	else
+		camel_folder_free_uids (folder, uids);
+
+	folder_summary = camel_folder_get_folder_summary (folder);
+
+	if (limit_time > 0) {
+		guint ii;
+
+		for (ii = 0; ii < uncached_uids->len;) {
+			CamelMessageInfo *mi;
+			gboolean too_old = FALSE;
+
+			mi = camel_folder_summary_get (folder_summary, uncached_uids->pdata[ii]);
+			if (mi) {
+				too_old = camel_message_info_get_date_sent (mi) < limit_time;
+				g_object_unref (mi);
+			}
+
+			if (too_old) {
+				camel_pstring_free (uncached_uids->pdata[ii]);
+				g_ptr_array_remove_index (uncached_uids, ii);
+			} else {
+				ii++;
+			}
+		}
+	}
+
+	/* Download what can be downloaded in bulk first; anything left behind
+	   is picked by the parent's one-by-one download below. */
+	if (!ews_folder_prefetch_messages_sync (CAMEL_EWS_FOLDER (folder), uncached_uids, cancellable, &local_error)) {
+		if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			camel_folder_free_uids (folder, uncached_uids);
+			g_propagate_error (error, local_error);
+			return FALSE;
+		}
+
+		camel_ews_store_maybe_disconnect (CAMEL_EWS_STORE (parent_store), local_error);
+		g_clear_error (&local_error);
+	}
+
+	camel_folder_free_uids (folder, uncached_uids);
+
+	return CAMEL_OFFLINE_FOLDER_CLASS (camel_ews_folder_parent_class)->downsync_sync (offline_folder, expression, cancellable, error);
+}
+
 /********************* folder functions*************************/
 
 static gboolean
@@ -1871,6 +2234,8 @@ camel_ews_folder_new (CamelStore *store,
 	camel_folder_take_state_filename (folder, g_steal_pointer (&state_file));
 	camel_folder_load_state (folder);
 
+	ews_folder->priv->resync_filename = g_build_filename (folder_dir, "resync-seen", NULL);
+
 	ews_folder->cache = camel_data_cache_new (folder_dir, error);
 	if (!ews_folder->cache) {
 		g_object_unref (folder);
@@ -2247,6 +2612,450 @@ ews_folder_forget_all_mails (CamelEwsFolder *ews_folder)
 	g_ptr_array_unref (known_uids);
 }
 
+/* A resync of the whole folder content, done when there is no usable sync
+   state, remembers which items had been received from the server in
+   a "resync-seen" file in the folder directory. The file exists only while
+   the resync is in progress, thus an interrupted resync can continue from
+   the last saved sync state and still find out which messages disappeared
+   from the server meanwhile. Only 64-bit hashes of the ItemId-s are stored;
+   a hash collision can only keep a stale message until the next resync,
+   it never removes a valid one. */
+
+static guint64
+ews_folder_resync_hash_uid (const gchar *uid)
+{
+	guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+
+	/* FNV-1a */
+	for (; *uid; uid++) {
+		hash ^= (guchar) *uid;
+		hash *= G_GUINT64_CONSTANT (0x100000001b3);
+	}
+
+	return hash;
+}
+
+static gint
+ews_folder_resync_compare_hashes (gconstpointer ptr1,
+				  gconstpointer ptr2)
+{
+	guint64 hash1 = *((const guint64 *) ptr1);
+	guint64 hash2 = *((const guint64 *) ptr2);
+
+	return hash1 < hash2 ? -1 : hash1 > hash2 ? 1 : 0;
+}
+
+static void
+ews_folder_resync_begin (CamelEwsFolder *ews_folder)
+{
+	GError *local_error = NULL;
+
+	/* When this fails, the resync only cannot be resumed */
+	if (!g_file_set_contents (ews_folder->priv->resync_filename, "", 0, &local_error)) {
+		g_debug ("%s: Failed to create '%s': %s", G_STRFUNC, ews_folder->priv->resync_filename,
+			local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+	}
+}
+
+static void
+ews_folder_resync_end (CamelEwsFolder *ews_folder)
+{
+	if (g_unlink (ews_folder->priv->resync_filename) == -1 && errno != ENOENT) {
+		g_debug ("%s: Failed to remove '%s': %s", G_STRFUNC, ews_folder->priv->resync_filename,
+			g_strerror (errno));
+	}
+}
+
+/* Returns a sorted array of the hashes of the items seen by the interrupted
+   resync, or NULL, when there is no resync in progress. */
+static GArray *
+ews_folder_resync_load_seen (CamelEwsFolder *ews_folder)
+{
+	GArray *seen;
+	gchar *contents = NULL;
+	gsize length = 0, ii;
+
+	if (!g_file_get_contents (ews_folder->priv->resync_filename, &contents, &length, NULL))
+		return NULL;
+
+	seen = g_array_sized_new (FALSE, FALSE, sizeof (guint64), length / sizeof (guint64));
+
+	for (ii = 0; ii + sizeof (guint64) <= length; ii += sizeof (guint64)) {
+		guint64 hash;
+
+		memcpy (&hash, contents + ii, sizeof (guint64));
+		hash = GUINT64_FROM_LE (hash);
+
+		g_array_append_val (seen, hash);
+	}
+
+	g_array_sort (seen, ews_folder_resync_compare_hashes);
+
+	g_free (contents);
+
+	return seen;
+}
+
+static gboolean
+ews_folder_resync_was_seen (GArray *seen,
+			    const gchar *uid)
+{
+	guint64 hash;
+
+	if (!seen || !seen->len)
+		return FALSE;
+
+	hash = ews_folder_resync_hash_uid (uid);
+
+	return bsearch (&hash, seen->data, seen->len, sizeof (guint64), ews_folder_resync_compare_hashes) != NULL;
+}
+
+/* Appends the items of one page to the seen file; it is done before the page's
+   sync state is saved, thus the file always covers all the committed pages. */
+static void
+ews_folder_resync_note_seen (CamelEwsFolder *ews_folder,
+			     GSList *items_created,
+			     GSList *items_updated)
+{
+	GArray *hashes;
+	GSList *lists[2], *link;
+	gsize written = 0;
+	guint ii;
+	gint fd;
+
+	/* Only append; when the file does not exist, the resync is not resumable */
+	fd = g_open (ews_folder->priv->resync_filename, O_WRONLY | O_APPEND, 0);
+	if (fd == -1)
+		return;
+
+	lists[0] = items_created;
+	lists[1] = items_updated;
+
+	hashes = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+	for (ii = 0; ii < G_N_ELEMENTS (lists); ii++) {
+		for (link = lists[ii]; link; link = g_slist_next (link)) {
+			EEwsItem *item = link->data;
+			const EwsId *id;
+			guint64 hash;
+
+			id = item ? e_ews_item_get_id (item) : NULL;
+			if (!id || !id->id)
+				continue;
+
+			hash = GUINT64_TO_LE (ews_folder_resync_hash_uid (id->id));
+			g_array_append_val (hashes, hash);
+		}
+	}
+
+	while (written < hashes->len * sizeof (guint64)) {
+		gssize wrote;
+
+		wrote = write (fd, ((const gchar *) hashes->data) + written, hashes->len * sizeof (guint64) - written);
+		if (wrote < 0 && errno == EINTR)
+			continue;
+
+		if (wrote <= 0)
+			break;
+
+		written += wrote;
+	}
+
+	close (fd);
+
+	/* An incomplete file could cause removal of valid messages after resume,
+	   thus rather give up on resuming this resync */
+	if (written < hashes->len * sizeof (guint64)) {
+		g_debug ("%s: Failed to write '%s': %s", G_STRFUNC, ews_folder->priv->resync_filename, g_strerror (errno));
+		ews_folder_resync_end (ews_folder);
+	}
+
+	g_array_unref (hashes);
+}
+
+/* Commits one page of the SyncFolderItems result into the folder summary and
+   only then saves its sync state, thus an interrupted refresh continues with
+   the first not committed page. The item lists are consumed. */
+static gboolean
+ews_refresh_info_commit_page (CamelEwsFolder *ews_folder,
+			      EEwsConnection *cnc,
+			      const gchar *folder_id,
+			      gboolean is_drafts_folder,
+			      CamelEwsSettings *settings,
+			      const gchar *sync_state,
+			      GSList *items_created,
+			      GSList *items_updated,
+			      GSList *items_deleted,
+			      GHashTable *updating_summary_uids,
+			      CamelFolderChangeInfo *change_info,
+			      gint64 *last_folder_update_time,
+			      GCancellable *cancellable,
+			      GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (ews_folder);
+	CamelFolderSummary *folder_summary;
+	CamelEwsStore *ews_store;
+	guint32 total, unread;
+	GError *local_error = NULL;
+
+	ews_store = CAMEL_EWS_STORE (camel_folder_get_parent_store (folder));
+	folder_summary = camel_folder_get_folder_summary (folder);
+
+	if (updating_summary_uids)
+		ews_folder_resync_note_seen (ews_folder, items_created, items_updated);
+
+	if (items_deleted)
+		camel_ews_utils_sync_deleted_items (ews_folder, items_deleted, change_info);
+
+	if (items_created)
+		sync_created_items (ews_folder, cnc, is_drafts_folder, items_created, updating_summary_uids, change_info, cancellable, &local_error);
+
+	if (local_error) {
+		g_slist_free_full (items_updated, g_object_unref);
+		g_propagate_error (error, local_error);
+
+		return FALSE;
+	}
+
+	if (items_updated)
+		sync_updated_items (ews_folder, cnc, is_drafts_folder, items_updated, change_info, cancellable, &local_error);
+
+	if (local_error) {
+		g_propagate_error (error, local_error);
+
+		return FALSE;
+	}
+
+	total = camel_folder_summary_count (folder_summary);
+	unread = camel_folder_summary_get_unread_count (folder_summary);
+
+	camel_ews_store_summary_set_folder_total (ews_store->summary, folder_id, total);
+	camel_ews_store_summary_set_folder_unread (ews_store->summary, folder_id, unread);
+	camel_ews_store_summary_save (ews_store->summary, NULL);
+
+	camel_ews_summary_set_sync_state (CAMEL_EWS_SUMMARY (folder_summary), sync_state);
+	if (settings)
+		camel_ews_summary_set_sync_tag_stamp (CAMEL_EWS_SUMMARY (folder_summary), camel_ews_settings_get_sync_tag_stamp (settings));
+
+	camel_folder_summary_touch (folder_summary);
+
+	if (camel_folder_change_info_changed (change_info)) {
+		camel_folder_summary_save (folder_summary, NULL);
+		/* Notify any listeners only once per 10 seconds, as such notify can cause UI update */
+		if (g_get_monotonic_time () - *last_folder_update_time >= 10 * G_USEC_PER_SEC) {
+			*last_folder_update_time = g_get_monotonic_time ();
+			camel_folder_changed (folder, change_info);
+			camel_folder_change_info_clear (change_info);
+		}
+	}
+
+	return TRUE;
+}
+
+/* How many SyncFolderItems pages can be fetched ahead of the committed page */
+#define EWS_REFRESH_PIPELINE_DEPTH 2
+
+typedef struct _RefreshPage {
+	gchar *sync_state;
+	gboolean includes_last_item;
+	GSList *items_created;
+	GSList *items_updated;
+	GSList *items_deleted;
+	GError *error;
+} RefreshPage;
+
+typedef struct _RefreshPipeline {
+	EEwsConnection *cnc;
+	gchar *folder_id;
+	gchar *sync_state;
+	GCancellable *cancellable;
+
+	GMutex lock;
+	GCond cond;
+	GQueue pages; /* RefreshPage * */
+	gboolean stop;
+	gboolean finished;
+} RefreshPipeline;
+
+static void
+refresh_page_free (gpointer ptr)
+{
+	RefreshPage *page = ptr;
+
+	if (page) {
+		g_free (page->sync_state);
+		g_slist_free_full (page->items_created, g_object_unref);
+		g_slist_free_full (page->items_updated, g_object_unref);
+		g_slist_free_full (page->items_deleted, g_free);
+		g_clear_error (&page->error);
+		g_free (page);
+	}
+}
+
+static void
+ews_refresh_pipeline_cancelled_cb (GCancellable *cancellable,
+				   gpointer user_data)
+{
+	RefreshPipeline *pipeline = user_data;
+
+	g_cancellable_cancel (pipeline->cancellable);
+}
+
+static gpointer
+ews_refresh_pipeline_thread (gpointer user_data)
+{
+	RefreshPipeline *pipeline = user_data;
+	gchar *sync_state;
+	gboolean done = FALSE;
+
+	sync_state = g_strdup (pipeline->sync_state);
+
+	while (!done) {
+		RefreshPage *page;
+
+		g_mutex_lock (&pipeline->lock);
+		while (!pipeline->stop && g_queue_get_length (&pipeline->pages) >= EWS_REFRESH_PIPELINE_DEPTH) {
+			g_cond_wait (&pipeline->cond, &pipeline->lock);
+		}
+		done = pipeline->stop;
+		g_mutex_unlock (&pipeline->lock);
+
+		if (done)
+			break;
+
+		page = g_new0 (RefreshPage, 1);
+
+		e_ews_connection_sync_folder_items_sync (pipeline->cnc, EWS_PRIORITY_MEDIUM, sync_state, pipeline->folder_id, "IdOnly", NULL, EWS_MAX_FETCH_COUNT,
+			&page->sync_state, &page->includes_last_item, &page->items_created, &page->items_updated, &page->items_deleted,
+			pipeline->cancellable, &page->error);
+
+		g_free (sync_state);
+		sync_state = g_strdup (page->sync_state);
+
+		done = page->error || page->includes_last_item || !sync_state;
+
+		g_mutex_lock (&pipeline->lock);
+		g_queue_push_tail (&pipeline->pages, page);
+		g_cond_broadcast (&pipeline->cond);
+		g_mutex_unlock (&pipeline->lock);
+	}
+
+	g_free (sync_state);
+
+	g_mutex_lock (&pipeline->lock);
+	pipeline->finished = TRUE;
+	g_cond_broadcast (&pipeline->cond);
+	g_mutex_unlock (&pipeline->lock);
+
+	return NULL;
+}
+
+/* Commits the 'first_page' and all the following SyncFolderItems pages in order
+   in the calling thread, while the next pages are fetched in a dedicated thread.
+   The 'first_page' is consumed. */
+static void
+ews_refresh_info_run_pipeline (CamelEwsFolder *ews_folder,
+			       EEwsConnection *cnc,
+			       const gchar *folder_id,
+			       gboolean is_drafts_folder,
+			       CamelEwsSettings *settings,
+			       RefreshPage *first_page,
+			       GHashTable *updating_summary_uids,
+			       CamelFolderChangeInfo *change_info,
+			       gint64 *last_folder_update_time,
+			       GCancellable *cancellable,
+			       GError **error)
+{
+	CamelEwsStore *ews_store;
+	RefreshPipeline pipeline;
+	GThread *thread;
+	gulong cancelled_id = 0;
+	gboolean done = FALSE;
+	GError *local_error = NULL;
+
+	ews_store = CAMEL_EWS_STORE (camel_folder_get_parent_store (CAMEL_FOLDER (ews_folder)));
+
+	pipeline.cnc = cnc;
+	pipeline.folder_id = g_strdup (folder_id);
+	pipeline.sync_state = g_strdup (first_page->sync_state);
+	pipeline.cancellable = g_cancellable_new ();
+	pipeline.stop = FALSE;
+	pipeline.finished = FALSE;
+	g_queue_init (&pipeline.pages);
+	g_mutex_init (&pipeline.lock);
+	g_cond_init (&pipeline.cond);
+
+	if (cancellable)
+		cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (ews_refresh_pipeline_cancelled_cb), &pipeline, NULL);
+
+	thread = g_thread_new ("ews_refresh_pipeline_thread", ews_refresh_pipeline_thread, &pipeline);
+
+	while (!done && !local_error) {
+		RefreshPage *page = g_steal_pointer (&first_page);
+
+		if (!page) {
+			g_mutex_lock (&pipeline.lock);
+			while (!pipeline.finished && g_queue_is_empty (&pipeline.pages)) {
+				g_cond_wait (&pipeline.cond, &pipeline.lock);
+			}
+			page = g_queue_pop_head (&pipeline.pages);
+			g_cond_broadcast (&pipeline.cond);
+			g_mutex_unlock (&pipeline.lock);
+		}
+
+		if (!page) {
+			/* The producer always finishes with the last page or with an error page */
+			g_set_error_literal (&local_error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Refresh pipeline finished prematurely"));
+			g_warn_if_reached ();
+			break;
+		}
+
+		if (page->error) {
+			local_error = g_steal_pointer (&page->error);
+			camel_ews_store_maybe_disconnect (ews_store, local_error);
+		} else {
+			done = page->includes_last_item || !page->sync_state;
+
+			if (!ews_refresh_info_commit_page (ews_folder, cnc, folder_id, is_drafts_folder, settings, page->sync_state,
+				g_steal_pointer (&page->items_created),
+				g_steal_pointer (&page->items_updated),
+				g_steal_pointer (&page->items_deleted),
+				updating_summary_uids, change_info, last_folder_update_time, cancellable, &local_error)) {
+				done = TRUE;
+			}
+
+			if (g_cancellable_is_cancelled (cancellable))
+				done = TRUE;
+		}
+
+		refresh_page_free (page);
+	}
+
+	g_mutex_lock (&pipeline.lock);
+	pipeline.stop = TRUE;
+	g_cond_broadcast (&pipeline.cond);
+	g_mutex_unlock (&pipeline.lock);
+
+	/* Do not wait for a page, which will not be used anyway */
+	g_cancellable_cancel (pipeline.cancellable);
+
+	g_thread_join (thread);
+
+	if (cancelled_id)
+		g_cancellable_disconnect (cancellable, cancelled_id);
+
+	g_queue_clear_full (&pipeline.pages, refresh_page_free);
+	g_mutex_clear (&pipeline.lock);
+	g_cond_clear (&pipeline.cond);
+	g_clear_object (&pipeline.cancellable);
+	g_free (pipeline.folder_id);
+	g_free (pipeline.sync_state);
+
+	if (local_error)
+		g_propagate_error (error, local_error);
+}
+
 static gboolean
 ews_refresh_info_sync (CamelFolder *folder,
                        GCancellable *cancellable,
@@ -2257,6 +3066,7 @@ ews_refresh_info_sync (CamelFolder *folder,
 	CamelEwsFolder *ews_folder;
 	CamelEwsFolderPrivate *priv;
 	GHashTable *updating_summary_uids = NULL;
+	GArray *resync_seen = NULL;
 	EEwsConnection *cnc;
 	CamelEwsStore *ews_store;
 	CamelEwsSettings *settings;
@@ -2349,13 +3159,19 @@ ews_refresh_info_sync (CamelFolder *folder,
 	if (!sync_state ||
 	    camel_ews_summary_get_version (CAMEL_EWS_SUMMARY (folder_summary)) < CAMEL_EWS_SUMMARY_VERSION) {
 		updating_summary_uids = camel_folder_summary_get_hash (folder_summary);
+		ews_folder_resync_begin (ews_folder);
+	} else {
+		/* Continue an interrupted resync from the saved sync state; the messages
+		   seen before the interruption are not expected to be received again */
+		resync_seen = ews_folder_resync_load_seen (ews_folder);
+		if (resync_seen)
+			updating_summary_uids = camel_folder_summary_get_hash (folder_summary);
 	}
 
 	do {
 		GSList *items_created = NULL, *items_updated = NULL;
 		GSList *items_deleted = NULL;
 		gchar *new_sync_state = NULL;
-		guint32 total, unread;
 
 		e_ews_connection_sync_folder_items_sync (cnc, EWS_PRIORITY_MEDIUM, sync_state, id, "IdOnly", NULL, EWS_MAX_FETCH_COUNT,
 			&new_sync_state, &includes_last_item, &items_created, &items_updated, &items_deleted,
@@ -2375,6 +3191,13 @@ ews_refresh_info_sync (CamelFolder *folder,
 				updating_summary_uids = NULL;
 			}
 
+			if (resync_seen) {
+				g_array_unref (resync_seen);
+				resync_seen = NULL;
+			}
+
+			ews_folder_resync_end (ews_folder);
+
 			e_ews_connection_sync_folder_items_sync (cnc, EWS_PRIORITY_MEDIUM, NULL, id, "IdOnly", NULL, EWS_MAX_FETCH_COUNT,
 				&sync_state, &includes_last_item, &items_created, &items_updated, &items_deleted,
 				cancellable, &local_error);
@@ -2385,49 +3208,27 @@ ews_refresh_info_sync (CamelFolder *folder,
 			break;
 		}
 
-		if (items_deleted)
-			camel_ews_utils_sync_deleted_items (ews_folder, items_deleted, change_info);
+		/* The next pages can be fetched in parallel with the commit of
+		   the previous page, when there is more than one connection slot */
+		if (!includes_last_item && sync_state && settings &&
+		    camel_ews_settings_get_concurrent_connections (settings) > 1) {
+			RefreshPage *first_page;
 
-		if (items_created)
-			sync_created_items (ews_folder, cnc, is_drafts_folder, items_created, updating_summary_uids, change_info, cancellable, &local_error);
-
-		if (local_error) {
-			if (items_updated) {
-				g_slist_foreach (items_updated, (GFunc) g_object_unref, NULL);
-				g_slist_free (items_updated);
-			}
+			first_page = g_new0 (RefreshPage, 1);
+			first_page->sync_state = g_strdup (sync_state);
+			first_page->items_created = items_created;
+			first_page->items_updated = items_updated;
+			first_page->items_deleted = items_deleted;
 
+			ews_refresh_info_run_pipeline (ews_folder, cnc, id, is_drafts_folder, settings, first_page,
+				updating_summary_uids, change_info, &last_folder_update_time, cancellable, &local_error);
 			break;
 		}
 
-		if (items_updated)
-			sync_updated_items (ews_folder, cnc, is_drafts_folder, items_updated, change_info, cancellable, &local_error);
-
-		if (local_error)
+		if (!ews_refresh_info_commit_page (ews_folder, cnc, id, is_drafts_folder, settings, sync_state,
+			items_created, items_updated, items_deleted, updating_summary_uids, change_info,
+			&last_folder_update_time, cancellable, &local_error))
 			break;
-
-		total = camel_folder_summary_count (folder_summary);
-		unread = camel_folder_summary_get_unread_count (folder_summary);
-
-		camel_ews_store_summary_set_folder_total (ews_store->summary, id, total);
-		camel_ews_store_summary_set_folder_unread (ews_store->summary, id, unread);
-		camel_ews_store_summary_save (ews_store->summary, NULL);
-
-		camel_ews_summary_set_sync_state (CAMEL_EWS_SUMMARY (folder_summary), sync_state);
-		if (settings)
-			camel_ews_summary_set_sync_tag_stamp (CAMEL_EWS_SUMMARY (folder_summary), camel_ews_settings_get_sync_tag_stamp (settings));
-
-		camel_folder_summary_touch (folder_summary);
-
-		if (camel_folder_change_info_changed (change_info)) {
-			camel_folder_summary_save (folder_summary, NULL);
-			/* Notify any listeners only once per 10 seconds, as such notify can cause UI update */
-			if (g_get_monotonic_time () - last_folder_update_time >= 10 * G_USEC_PER_SEC) {
-				last_folder_update_time = g_get_monotonic_time ();
-				camel_folder_changed (folder, change_info);
-				camel_folder_change_info_clear (change_info);
-			}
-		}
 	} while (!local_error && !includes_last_item && !g_cancellable_is_cancelled (cancellable));
 
 	if (updating_summary_uids) {
@@ -2441,6 +3242,9 @@ ews_refresh_info_sync (CamelFolder *folder,
 			while (g_hash_table_iter_next (&iter, &key, NULL)) {
 				const gchar *uid = key;
 
+				if (ews_folder_resync_was_seen (resync_seen, uid))
+					continue;
+
 				camel_folder_change_info_remove_uid (change_info, uid);
 				ews_data_cache_remove (ews_folder->cache, "cur", uid, NULL);
 
@@ -2452,10 +3256,16 @@ ews_refresh_info_sync (CamelFolder *folder,
 			g_ptr_array_unref (removed_uids);
 		}
 
+		if (!local_error && !g_cancellable_is_cancelled (cancellable))
+			ews_folder_resync_end (ews_folder);
+
 		g_hash_table_destroy (updating_summary_uids);
 		updating_summary_uids = NULL;
 	}
 
+	if (resync_seen)
+		g_array_unref (resync_seen);
+
 	camel_operation_pop_message (cancellable);
 
 	if (camel_folder_change_info_changed (change_info)) {
@@ -3228,6 +4038,7 @@ ews_folder_finalize (GObject *object)
 	g_rec_mutex_clear (&ews_folder->priv->cache_lock);
 	g_hash_table_destroy (ews_folder->priv->fetching_uids);
 	g_cond_clear (&ews_folder->priv->fetch_cond);
+	g_free (ews_folder->priv->resync_filename);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_ews_folder_parent_class)->finalize (object);
@@ -3277,6 +4088,7 @@ camel_ews_folder_class_init (CamelEwsFolderClass *class)
 {
 	GObjectClass *object_class;
 	CamelFolderClass *folder_class;
+	CamelOfflineFolderClass *offline_folder_class;
 
 	object_class = G_OBJECT_CLASS (class);
 	object_class->set_property = ews_folder_set_property;
@@ -3289,6 +4101,7 @@ camel_ews_folder_class_init (CamelEwsFolderClass *class)
 	folder_class->get_permanent_flags = ews_folder_get_permanent_flags;
 	folder_class->get_message_sync = ews_folder_get_message_sync;
 	folder_class->get_message_cached = ews_folder_get_message_cached;
+	folder_class->get_uncached_uids = ews_folder_get_uncached_uids;
 	folder_class->cmp_uids = ews_cmp_uids;
 	folder_class->append_message_sync = ews_append_message_sync;
 	folder_class->refresh_info_sync = ews_refresh_info_sync;
@@ -3299,6 +4112,9 @@ camel_ews_folder_class_init (CamelEwsFolderClass *class)
 	folder_class->get_filename = ews_get_filename;
 	folder_class->search_body_sync = ews_search_body_sync;
 
+	offline_folder_class = CAMEL_OFFLINE_FOLDER_CLASS (class);
+	offline_folder_class->downsync_sync = ews_folder_downsync_sync;
+
 	camel_folder_class_map_legacy_property (folder_class, "apply-filters", 0x2501);
 	camel_folder_class_map_legacy_property (folder_class, "check-folder", 0x2502);
 
@@ -3435,3 +4251,17 @@ camel_ews_folder_set_check_folder (CamelEwsFolder *self,
 	g_object_notify (G_OBJECT (self), "check-folder");
 	camel_ews_folder_update_flags (self);
 }
+
+gboolean
+camel_ews_folder_get_refreshing (CamelEwsFolder *self)
+{
+	gboolean refreshing;
+
+	g_return_val_if_fail (CAMEL_IS_EWS_FOLDER (self), FALSE);
+
+	g_mutex_lock (&self->priv->state_lock);
+	refreshing = self->priv->refreshing;
+	g_mutex_unlock (&self->priv->state_lock);
+
+	return refreshing;
+}
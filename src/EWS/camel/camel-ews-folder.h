@@ -61,6 +61,7 @@ void		camel_ews_folder_set_apply_filters	(CamelEwsFolder *sefl,
 gboolean	camel_ews_folder_get_check_folder	(CamelEwsFolder *self);
 void		camel_ews_folder_set_check_folder	(CamelEwsFolder *self,
 							 gboolean check_folder);
+gboolean	camel_ews_folder_get_refreshing	(CamelEwsFolder *self);
 
 G_END_DECLS
 
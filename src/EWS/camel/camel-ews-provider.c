@@ -51,6 +51,8 @@ static CamelProviderConfEntry ews_conf_entries[] = {
 	  N_("Connection _timeout (in seconds) %s") },
 	{ CAMEL_PROVIDER_CONF_CHECKSPIN, "concurrent-connections", NULL,
 	  N_("Numbe_r of concurrent connections to use") },
+	{ CAMEL_PROVIDER_CONF_CHECKBOX, "adaptive-concurrency", NULL,
+	  N_("_Adjust the number of concurrent connections to the server load") },
 	{ CAMEL_PROVIDER_CONF_CHECKBOX, "override-user-agent", NULL,
 	  N_("Override _User-Agent header value") },
 	{ CAMEL_PROVIDER_CONF_ENTRY, "user-agent", "override-user-agent", "" },
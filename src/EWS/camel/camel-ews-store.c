@@ -690,7 +690,7 @@ ews_exchange_server_categories_cb (CamelSession *session,
 	fid.id = (gchar *) "calendar";
 	fid.is_distinguished_id = TRUE;
 
-	if (e_ews_connection_get_user_configuration_sync (cnc, G_PRIORITY_DEFAULT, &fid, "CategoryList",
+	if (e_ews_connection_get_user_configuration_sync (cnc, EWS_PRIORITY_MEDIUM, &fid, "CategoryList",
 		E_EWS_USER_CONFIGURATION_PROPERTIES_XMLDATA, &properties, cancellable, &local_error) && properties) {
 		guchar *data;
 		gsize data_len = 0;
@@ -977,12 +977,65 @@ camel_ews_folder_list_update_thread (gpointer user_data)
 	return NULL;
 }
 
+typedef struct _FolderRefreshData {
+	CamelEwsStore *ews_store; /* not referenced */
+	GCancellable *cancellable; /* not referenced */
+	GMutex lock;
+	gboolean failed;
+} FolderRefreshData;
+
+static void
+ews_store_refresh_folder_func (gpointer data,
+			       gpointer user_data)
+{
+	gchar *folder_name = data;
+	FolderRefreshData *frd = user_data;
+	CamelFolder *folder;
+	gboolean failed;
+	GError *error = NULL;
+
+	g_mutex_lock (&frd->lock);
+	failed = frd->failed;
+	g_mutex_unlock (&frd->lock);
+
+	if (failed || g_cancellable_is_cancelled (frd->cancellable)) {
+		g_free (folder_name);
+		return;
+	}
+
+	folder = camel_store_get_folder_sync (CAMEL_STORE (frd->ews_store), folder_name, 0, frd->cancellable, NULL);
+
+	/* Someone else could start the refresh meanwhile; do not queue behind it */
+	if (folder && !camel_ews_folder_get_refreshing (CAMEL_EWS_FOLDER (folder)) &&
+	    !camel_folder_refresh_info_sync (folder, frd->cancellable, &error)) {
+		g_warning ("%s: %s\n", G_STRFUNC, error ? error->message : "Unknown error");
+		g_clear_error (&error);
+
+		/* Stop the not yet started refreshes, the same as the sequential
+		   walk did; those already running finish on their own */
+		g_mutex_lock (&frd->lock);
+		frd->failed = TRUE;
+		g_mutex_unlock (&frd->lock);
+	}
+
+	g_clear_object (&folder);
+	g_free (folder_name);
+}
+
 static gpointer
 camel_ews_folder_update_thread (gpointer user_data)
 {
 	struct ScheduleUpdateData *sud = user_data;
 	CamelEwsStore *ews_store = sud->ews_store;
+	CamelObjectBag *folders_bag;
+	CamelSettings *settings;
+	FolderRefreshData frd;
+	GThreadPool *pool;
+	GHashTable *known;
 	GSList *update_folder_names, *l;
+	GSList *opened = NULL, *others = NULL;
+	gchar *inbox_name = NULL, *inbox_fid;
+	gint max_threads;
 
 	g_return_val_if_fail (sud != NULL, NULL);
 
@@ -991,27 +1044,73 @@ camel_ews_folder_update_thread (gpointer user_data)
 	ews_store->priv->update_folder_names = NULL;
 	UPDATE_UNLOCK (ews_store);
 
-	for (l = update_folder_names; l != NULL && !g_cancellable_is_cancelled (sud->cancellable); l = l->next) {
+	inbox_fid = camel_ews_store_summary_get_folder_id_from_folder_type (ews_store->summary, CAMEL_FOLDER_TYPE_INBOX);
+	if (inbox_fid)
+		inbox_name = camel_ews_store_summary_get_folder_full_name (ews_store->summary, inbox_fid, NULL);
+	g_free (inbox_fid);
+
+	/* The Inbox goes first, then the folders which are already opened, which
+	   includes the one currently selected in the UI, then the rest. Folders
+	   with a refresh in progress are skipped, they will pick up the changes. */
+	folders_bag = camel_store_get_folders_bag (CAMEL_STORE (ews_store));
+	known = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (l = update_folder_names; l != NULL; l = l->next) {
 		const gchar *folder_name = l->data;
 		CamelFolder *folder;
-		GError *error = NULL;
 
-		folder = camel_store_get_folder_sync (CAMEL_STORE (ews_store), folder_name, 0, sud->cancellable, NULL);
-		if (folder == NULL)
+		if (g_hash_table_contains (known, folder_name))
 			continue;
 
-		camel_folder_refresh_info_sync (folder, sud->cancellable, &error);
-		g_object_unref (folder);
+		g_hash_table_add (known, (gpointer) folder_name);
 
-		if (error != NULL) {
-			g_warning ("%s: %s\n", G_STRFUNC, error->message);
-			g_clear_error (&error);
-			break;
+		folder = camel_object_bag_peek (folders_bag, folder_name);
+		if (folder) {
+			if (!CAMEL_IS_EWS_FOLDER (folder) ||
+			    !camel_ews_folder_get_refreshing (CAMEL_EWS_FOLDER (folder))) {
+				if (g_strcmp0 (folder_name, inbox_name) == 0)
+					opened = g_slist_prepend (opened, g_strdup (folder_name));
+				else
+					opened = g_slist_append (opened, g_strdup (folder_name));
+			}
+
+			g_object_unref (folder);
+		} else if (g_strcmp0 (folder_name, inbox_name) == 0) {
+			opened = g_slist_prepend (opened, g_strdup (folder_name));
+		} else {
+			others = g_slist_prepend (others, g_strdup (folder_name));
 		}
 	}
 
+	g_hash_table_destroy (known);
 	g_slist_free_full (update_folder_names, g_free);
-	update_folder_names = NULL;
+	update_folder_names = g_slist_concat (opened, g_slist_reverse (others));
+	g_free (inbox_name);
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (ews_store));
+	max_threads = camel_ews_settings_get_concurrent_connections (CAMEL_EWS_SETTINGS (settings));
+	g_clear_object (&settings);
+
+	frd.ews_store = ews_store;
+	frd.cancellable = sud->cancellable;
+	frd.failed = FALSE;
+	g_mutex_init (&frd.lock);
+
+	/* The pool runs the jobs in the order they had been pushed */
+	pool = g_thread_pool_new (ews_store_refresh_folder_func, &frd,
+		CLAMP (max_threads, MIN_CONCURRENT_CONNECTIONS, MAX_CONCURRENT_CONNECTIONS), FALSE, NULL);
+
+	for (l = update_folder_names; l != NULL; l = l->next) {
+		/* the function frees the name */
+		g_thread_pool_push (pool, l->data, NULL);
+		l->data = NULL;
+	}
+
+	/* Waits for all the pushed jobs to finish */
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	g_mutex_clear (&frd.lock);
+	g_slist_free (update_folder_names);
 	free_schedule_update_data (sud);
 
 	return NULL;
@@ -2082,6 +2181,9 @@ ews_authenticate_sync (CamelService *service,
 
 	connection = e_ews_connection_new (source, hosturl, ews_settings);
 	e_ews_connection_set_password (connection, password);
+	/* Folders are refreshed and downloaded in parallel jobs, which
+	   can share their GetItem requests */
+	e_ews_connection_set_coalesce_window (connection, 20);
 
 	g_clear_object (&source);
 	g_free (hosturl);
@@ -2263,7 +2365,7 @@ ews_store_query_auth_types_sync (CamelService *service,
 		connection, "proxy-resolver",
 		G_BINDING_SYNC_CREATE);
 
-	if (e_ews_connection_query_auth_methods_sync (connection, G_PRIORITY_DEFAULT, &auth_methods, cancellable, error)) {
+	if (e_ews_connection_query_auth_methods_sync (connection, EWS_PRIORITY_MEDIUM, &auth_methods, cancellable, error)) {
 		CamelProvider *provider;
 		CamelServiceAuthType *authtype;
 
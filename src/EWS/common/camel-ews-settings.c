@@ -19,6 +19,7 @@ struct _CamelEwsSettingsPrivate {
 	gboolean use_impersonation;
 	gboolean show_public_folders;
 	gboolean force_http1;
+	gboolean adaptive_concurrency;
 	gchar *email;
 	gchar *gal_uid;
 	gchar *hosturl;
@@ -32,6 +33,8 @@ struct _CamelEwsSettingsPrivate {
 	gchar *user_agent;
 	gboolean override_oauth2;
 	gboolean use_oauth2_v2;
+	guint prefetch_batch_size;
+	guint prefetch_batch_bytes;
 	gchar *oauth2_tenant;
 	gchar *oauth2_client_id;
 	gchar *oauth2_redirect_uri;
@@ -71,7 +74,10 @@ enum {
 	PROP_CONCURRENT_CONNECTIONS,
 	PROP_SYNC_TAG_STAMP,
 	PROP_FORCE_HTTP1,
-	PROP_USE_OAUTH2_V2
+	PROP_USE_OAUTH2_V2,
+	PROP_PREFETCH_BATCH_SIZE,
+	PROP_PREFETCH_BATCH_BYTES,
+	PROP_ADAPTIVE_CONCURRENCY
 };
 
 G_DEFINE_TYPE_WITH_CODE (CamelEwsSettings, camel_ews_settings, CAMEL_TYPE_OFFLINE_SETTINGS,
@@ -299,6 +305,24 @@ ews_settings_set_property (GObject *object,
 				CAMEL_EWS_SETTINGS (object),
 				g_value_get_boolean (value));
 			return;
+
+		case PROP_PREFETCH_BATCH_SIZE:
+			camel_ews_settings_set_prefetch_batch_size (
+				CAMEL_EWS_SETTINGS (object),
+				g_value_get_uint (value));
+			return;
+
+		case PROP_PREFETCH_BATCH_BYTES:
+			camel_ews_settings_set_prefetch_batch_bytes (
+				CAMEL_EWS_SETTINGS (object),
+				g_value_get_uint (value));
+			return;
+
+		case PROP_ADAPTIVE_CONCURRENCY:
+			camel_ews_settings_set_adaptive_concurrency (
+				CAMEL_EWS_SETTINGS (object),
+				g_value_get_boolean (value));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -527,6 +551,27 @@ ews_settings_get_property (GObject *object,
 				camel_ews_settings_get_use_oauth2_v2 (
 				CAMEL_EWS_SETTINGS (object)));
 			return;
+
+		case PROP_PREFETCH_BATCH_SIZE:
+			g_value_set_uint (
+				value,
+				camel_ews_settings_get_prefetch_batch_size (
+				CAMEL_EWS_SETTINGS (object)));
+			return;
+
+		case PROP_PREFETCH_BATCH_BYTES:
+			g_value_set_uint (
+				value,
+				camel_ews_settings_get_prefetch_batch_bytes (
+				CAMEL_EWS_SETTINGS (object)));
+			return;
+
+		case PROP_ADAPTIVE_CONCURRENCY:
+			g_value_set_boolean (
+				value,
+				camel_ews_settings_get_adaptive_concurrency (
+				CAMEL_EWS_SETTINGS (object)));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -913,6 +958,49 @@ camel_ews_settings_class_init (CamelEwsSettingsClass *class)
 			G_PARAM_READWRITE |
 			G_PARAM_CONSTRUCT |
 			G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_PREFETCH_BATCH_SIZE,
+		g_param_spec_uint (
+			"prefetch-batch-size",
+			"Prefetch Batch Size",
+			"How many messages to download with one request when downloading for offline use",
+			MIN_PREFETCH_BATCH_SIZE,
+			MAX_PREFETCH_BATCH_SIZE,
+			DEFAULT_PREFETCH_BATCH_SIZE,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_EXPLICIT_NOTIFY |
+			G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_PREFETCH_BATCH_BYTES,
+		g_param_spec_uint (
+			"prefetch-batch-bytes",
+			"Prefetch Batch Bytes",
+			"Approximate limit, in bytes, of messages downloaded with one request when downloading for offline use; 0 means unlimited",
+			0,
+			G_MAXUINT,
+			DEFAULT_PREFETCH_BATCH_BYTES,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_EXPLICIT_NOTIFY |
+			G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_ADAPTIVE_CONCURRENCY,
+		g_param_spec_boolean (
+			"adaptive-concurrency",
+			"Adaptive Concurrency",
+			"Whether to adjust the number of concurrent requests according to the server response times",
+			FALSE,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_EXPLICIT_NOTIFY |
+			G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -1996,3 +2084,74 @@ camel_ews_settings_set_use_oauth2_v2 (CamelEwsSettings *settings,
 
 	g_object_notify (G_OBJECT (settings), "use-oauth2-v2");
 }
+
+guint
+camel_ews_settings_get_prefetch_batch_size (CamelEwsSettings *settings)
+{
+	g_return_val_if_fail (CAMEL_IS_EWS_SETTINGS (settings), DEFAULT_PREFETCH_BATCH_SIZE);
+
+	return settings->priv->prefetch_batch_size;
+}
+
+void
+camel_ews_settings_set_prefetch_batch_size (CamelEwsSettings *settings,
+					    guint prefetch_batch_size)
+{
+	g_return_if_fail (CAMEL_IS_EWS_SETTINGS (settings));
+
+	prefetch_batch_size = CLAMP (
+		prefetch_batch_size,
+		MIN_PREFETCH_BATCH_SIZE,
+		MAX_PREFETCH_BATCH_SIZE);
+
+	if (settings->priv->prefetch_batch_size == prefetch_batch_size)
+		return;
+
+	settings->priv->prefetch_batch_size = prefetch_batch_size;
+
+	g_object_notify (G_OBJECT (settings), "prefetch-batch-size");
+}
+
+guint
+camel_ews_settings_get_prefetch_batch_bytes (CamelEwsSettings *settings)
+{
+	g_return_val_if_fail (CAMEL_IS_EWS_SETTINGS (settings), DEFAULT_PREFETCH_BATCH_BYTES);
+
+	return settings->priv->prefetch_batch_bytes;
+}
+
+void
+camel_ews_settings_set_prefetch_batch_bytes (CamelEwsSettings *settings,
+					     guint prefetch_batch_bytes)
+{
+	g_return_if_fail (CAMEL_IS_EWS_SETTINGS (settings));
+
+	if (settings->priv->prefetch_batch_bytes == prefetch_batch_bytes)
+		return;
+
+	settings->priv->prefetch_batch_bytes = prefetch_batch_bytes;
+
+	g_object_notify (G_OBJECT (settings), "prefetch-batch-bytes");
+}
+
+gboolean
+camel_ews_settings_get_adaptive_concurrency (CamelEwsSettings *settings)
+{
+	g_return_val_if_fail (CAMEL_IS_EWS_SETTINGS (settings), FALSE);
+
+	return settings->priv->adaptive_concurrency;
+}
+
+void
+camel_ews_settings_set_adaptive_concurrency (CamelEwsSettings *settings,
+					     gboolean adaptive_concurrency)
+{
+	g_return_if_fail (CAMEL_IS_EWS_SETTINGS (settings));
+
+	if ((settings->priv->adaptive_concurrency ? 1 : 0) == (adaptive_concurrency ? 1 : 0))
+		return;
+
+	settings->priv->adaptive_concurrency = adaptive_concurrency;
+
+	g_object_notify (G_OBJECT (settings), "adaptive-concurrency");
+}
@@ -29,6 +29,13 @@
 
 #define MIN_CONCURRENT_CONNECTIONS 1
 #define MAX_CONCURRENT_CONNECTIONS 7
+/* The limit when the "adaptive-concurrency" is enabled */
+#define MAX_ADAPTIVE_CONCURRENT_CONNECTIONS 32
+
+#define MIN_PREFETCH_BATCH_SIZE 1
+#define MAX_PREFETCH_BATCH_SIZE 100
+#define DEFAULT_PREFETCH_BATCH_SIZE 25
+#define DEFAULT_PREFETCH_BATCH_BYTES (10 * 1024 * 1024)
 
 G_BEGIN_DECLS
 
@@ -202,6 +209,21 @@ gboolean	camel_ews_settings_get_use_oauth2_v2
 void		camel_ews_settings_set_use_oauth2_v2
 						(CamelEwsSettings *settings,
 						 gboolean use_oauth2_v2);
+guint		camel_ews_settings_get_prefetch_batch_size
+						(CamelEwsSettings *settings);
+void		camel_ews_settings_set_prefetch_batch_size
+						(CamelEwsSettings *settings,
+						 guint prefetch_batch_size);
+guint		camel_ews_settings_get_prefetch_batch_bytes
+						(CamelEwsSettings *settings);
+void		camel_ews_settings_set_prefetch_batch_bytes
+						(CamelEwsSettings *settings,
+						 guint prefetch_batch_bytes);
+gboolean	camel_ews_settings_get_adaptive_concurrency
+						(CamelEwsSettings *settings);
+void		camel_ews_settings_set_adaptive_concurrency
+						(CamelEwsSettings *settings,
+						 gboolean adaptive_concurrency);
 G_END_DECLS
 
 #endif /* CAMEL_EWS_SETTINGS_H */
@@ -31,6 +31,9 @@
 /* A chunk size limit when moving items in chunks. */
 #define EWS_MOVE_ITEMS_CHUNK_SIZE 500
 
+/* Most items requested by one coalesced GetItem request. */
+#define EWS_COALESCE_MAX_ITEMS 100
+
 #define EWS_RETRY_IO_ERROR_SECONDS 3
 #define EWS_RETRY_AUTH_ERROR_SECONDS 0.1
 
@@ -40,6 +43,12 @@
 #define NOTIFICATION_LOCK(x) (g_mutex_lock(&(x)->priv->notification_lock))
 #define NOTIFICATION_UNLOCK(x) (g_mutex_unlock(&(x)->priv->notification_lock))
 
+#define EWS_N_PRIORITIES (EWS_PRIORITY_HIGH + 1)
+
+/* With the "adaptive-concurrency", the in-flight limit is decreased when
+   the smoothed response time exceeds the base response time this many times */
+#define EWS_ADAPTIVE_LATENCY_FACTOR 2
+
 static GMutex connecting;
 static GHashTable *loaded_connections_permissions = NULL;
 
@@ -52,11 +61,40 @@ struct _EEwsSoupThreadData {
 	GThread *thread;
 };
 
+struct _EEwsSchedulerData {
+	GMutex mutex;
+	GCond cond;
+	/* Waiting requests, one queue per priority, each in FIFO order */
+	GQueue waiting[EWS_N_PRIORITIES];
+	guint n_running;
+	guint n_running_pri[EWS_N_PRIORITIES];
+	guint64 n_dispatched[EWS_N_PRIORITIES];
+	gint64 total_wait_usec[EWS_N_PRIORITIES];
+	gint64 max_wait_usec[EWS_N_PRIORITIES];
+
+	/* The in-flight limit with the "adaptive-concurrency" (AIMD) */
+	gdouble adaptive_limit;
+	gint64 srtt_usec; /* smoothed response time */
+	gint64 base_rtt_usec; /* the response time of an unloaded server */
+	gint64 last_decrease_usec;
+};
+
+struct _EEwsCoalescerData {
+	GMutex mutex;
+	GCond cond;
+	/* 0 to not coalesce GetItem requests */
+	guint window_ms;
+	/* gchar *shape_key ~> GetItemsBatch *, requests waiting to be sent */
+	GHashTable *batches;
+};
+
 /* Connection APIS */
 
 struct _EEwsConnectionPrivate {
 	ESource *source;
 	struct _EEwsSoupThreadData soup;
+	struct _EEwsSchedulerData scheduler;
+	struct _EEwsCoalescerData coalescer;
 
 	GProxyResolver *proxy_resolver;
 	EEwsNotification *notification;
@@ -70,6 +108,10 @@ struct _EEwsConnectionPrivate {
 	/* Hash key for the loaded_connections_permissions table. */
 	gchar *hash_key;
 
+	/* gchar *source_uid ~> EEwsClientUsage *, who uses the (shared) connection;
+	   guarded by the 'connecting' mutex */
+	GHashTable *clients;
+
 	gchar *uri;
 	gchar *email;
 	gchar *impersonate_user;
@@ -88,6 +130,8 @@ struct _EEwsConnectionPrivate {
 
 	EEwsServerVersion version;
 	gboolean backoff_enabled;
+	/* monotonic time until which the server asked to back off; guarded by property_lock */
+	gint64 server_busy_until;
 
 	/* Set to TRUE when this connection had been disconnected and cannot be used anymore */
 	gboolean disconnected_flag;
@@ -176,8 +220,12 @@ e_ews_connection_create_soup_session (EEwsConnection *cnc)
 	session = g_object_new (E_TYPE_SOUP_SESSION,
 		"source", cnc->priv->source,
 		"timeout", 30,
-		"max-conns", cnc->priv->concurrent_connections,
-		"max-conns-per-host", cnc->priv->concurrent_connections,
+		/* The number of requests in flight is limited by the scheduler,
+		   which can change it at runtime, thus allow the largest
+		   possible value here; it is also the number of streams with
+		   HTTP/2, where all the requests share a single connection */
+		"max-conns", MAX_ADAPTIVE_CONCURRENT_CONNECTIONS,
+		"max-conns-per-host", MAX_ADAPTIVE_CONCURRENT_CONNECTIONS,
 		NULL);
 
 	e_binding_bind_property (
@@ -310,6 +358,7 @@ typedef struct _ProcessData {
 	GError *error;
 	gchar **out_certificate_pem;
 	GTlsCertificateFlags *out_certificate_errors;
+	gint64 got_headers_time; /* monotonic time, when the response headers had been received */
 } ProcessData;
 
 static void
@@ -324,6 +373,9 @@ e_ews_connection_process_request_ready_cb (GObject *source_object,
 
 	input_stream = e_soup_session_send_message_finish (E_SOUP_SESSION (source_object), result, pd->out_certificate_pem, pd->out_certificate_errors, &pd->error);
 
+	/* Only the body is read from the 'input_stream' */
+	pd->got_headers_time = g_get_monotonic_time ();
+
 	/* Need to process the 'input_stream' in this thread */
 	if (!ews_connection_credentials_failed (pd->cnc, pd->message, FALSE, NULL) &&
 	    soup_message_get_status (pd->message) != SOUP_STATUS_UNAUTHORIZED &&
@@ -384,6 +436,7 @@ e_ews_connection_process_request_sync (EEwsConnection *cnc,
 				       gchar **out_certificate_pem,
 				       GTlsCertificateFlags *out_certificate_errors,
 				       gboolean *out_repeat,
+				       gint64 *out_got_headers_time, /* monotonic time, when the response headers had been received; 0 if not */
 				       GCancellable *cancellable,
 				       GError **error)
 {
@@ -398,6 +451,7 @@ e_ews_connection_process_request_sync (EEwsConnection *cnc,
 
 	*out_message = NULL;
 	*out_repeat = FALSE;
+	*out_got_headers_time = 0;
 
 	settings = e_ews_connection_ref_settings (cnc);
 
@@ -455,6 +509,7 @@ e_ews_connection_process_request_sync (EEwsConnection *cnc,
 	pd.error = NULL;
 	pd.out_certificate_pem = out_certificate_pem;
 	pd.out_certificate_errors = out_certificate_errors;
+	pd.got_headers_time = 0;
 
 	g_mutex_lock (&pd.mutex);
 
@@ -482,6 +537,7 @@ e_ews_connection_process_request_sync (EEwsConnection *cnc,
 
 	*out_message = g_steal_pointer (&pd.message);
 	*out_repeat = pd.repeat;
+	*out_got_headers_time = pd.got_headers_time;
 
 	g_clear_object (&pd.message);
 	g_mutex_clear (&pd.mutex);
@@ -542,6 +598,7 @@ e_ews_connection_wait_ms (gint wait_ms,
 static gboolean
 e_ews_connection_handle_backoff_policy (EEwsConnection *cnc,
 					ESoapResponse *response,
+					gboolean *out_server_busy,
 					GCancellable *cancellable,
 					GError **error)
 {
@@ -549,10 +606,9 @@ e_ews_connection_handle_backoff_policy (EEwsConnection *cnc,
 	gint wait_ms = 0;
 	gboolean repeat = FALSE;
 
-	if (e_ews_connection_get_backoff_enabled (cnc))
-		param = e_soap_response_get_first_parameter_by_name (response, "detail", NULL);
-	else
-		param = NULL;
+	*out_server_busy = FALSE;
+
+	param = e_soap_response_get_first_parameter_by_name (response, "detail", NULL);
 	if (param)
 		param = e_soap_parameter_get_first_child_by_name (param, "ResponseCode");
 	if (param) {
@@ -560,6 +616,8 @@ e_ews_connection_handle_backoff_policy (EEwsConnection *cnc,
 
 		value = e_soap_parameter_get_string_value (param);
 		if (value && ews_get_error_code (value) == EWS_CONNECTION_ERROR_SERVERBUSY) {
+			*out_server_busy = TRUE;
+
 			param = e_soap_response_get_first_parameter_by_name (response, "detail", NULL);
 			if (param)
 				param = e_soap_parameter_get_first_child_by_name (param, "MessageXml");
@@ -580,6 +638,14 @@ e_ews_connection_handle_backoff_policy (EEwsConnection *cnc,
 	}
 
 	if (wait_ms > 0) {
+		/* Remember the server's wish also when not waiting here, thus
+		   callers with disabled back off can pace their own requests */
+		g_mutex_lock (&cnc->priv->property_lock);
+		cnc->priv->server_busy_until = g_get_monotonic_time () + (G_TIME_SPAN_MILLISECOND * wait_ms);
+		g_mutex_unlock (&cnc->priv->property_lock);
+	}
+
+	if (wait_ms > 0 && e_ews_connection_get_backoff_enabled (cnc)) {
 		e_ews_connection_wait_ms (wait_ms, cancellable);
 
 		repeat = !g_cancellable_set_error_if_cancelled (cancellable, error);
@@ -588,8 +654,221 @@ e_ews_connection_handle_backoff_policy (EEwsConnection *cnc,
 	return repeat;
 }
 
+/* The 'pri' is one of the EWS_PRIORITY_ values. The values out of their range
+   are treated as the GLib priorities, where the lower value means the higher
+   priority. The G_PRIORITY_DEFAULT cannot be distinguished from the EWS_PRIORITY_LOW,
+   thus the callers should not use it. */
+static gint
+ews_connection_scheduler_normalize_priority (gint pri)
+{
+	/* G_PRIORITY_HIGH */
+	if (pri < EWS_PRIORITY_LOW)
+		return EWS_PRIORITY_HIGH;
+
+	/* G_PRIORITY_HIGH_IDLE, G_PRIORITY_DEFAULT_IDLE, G_PRIORITY_LOW */
+	if (pri > EWS_PRIORITY_HIGH)
+		return EWS_PRIORITY_LOW;
+
+	return pri;
+}
+
+static void
+ews_connection_scheduler_cancelled_cb (GCancellable *cancellable,
+				       gpointer user_data)
+{
+	EEwsConnection *cnc = user_data;
+
+	/* Wake up the waiters, thus the cancelled one can leave the queue */
+	g_mutex_lock (&cnc->priv->scheduler.mutex);
+	g_cond_broadcast (&cnc->priv->scheduler.cond);
+	g_mutex_unlock (&cnc->priv->scheduler.mutex);
+}
+
+static gboolean
+ews_connection_get_adaptive_concurrency (EEwsConnection *cnc)
+{
+	return cnc->priv->settings && camel_ews_settings_get_adaptive_concurrency (cnc->priv->settings);
+}
+
+/* The scheduler.mutex should be locked by the caller */
+static guint
+ews_connection_scheduler_get_limit_locked (EEwsConnection *cnc)
+{
+	if (ews_connection_get_adaptive_concurrency (cnc)) {
+		return CLAMP ((guint) cnc->priv->scheduler.adaptive_limit,
+			MIN_CONCURRENT_CONNECTIONS,
+			MAX_ADAPTIVE_CONCURRENT_CONNECTIONS);
+	}
+
+	return MAX (cnc->priv->concurrent_connections, 1);
+}
+
+/* The scheduler.mutex should be locked by the caller. A request can be sent
+   when there is a free slot, no request of a higher priority is waiting and
+   it is the first one waiting for its own priority. */
+static gboolean
+ews_connection_scheduler_can_run_locked (EEwsConnection *cnc,
+					 gint pri,
+					 GList *link)
+{
+	gint ii;
+
+	if (cnc->priv->scheduler.n_running >= ews_connection_scheduler_get_limit_locked (cnc))
+		return FALSE;
+
+	for (ii = EWS_PRIORITY_HIGH; ii > pri; ii--) {
+		if (!g_queue_is_empty (&cnc->priv->scheduler.waiting[ii]))
+			return FALSE;
+	}
+
+	return g_queue_peek_head_link (&cnc->priv->scheduler.waiting[pri]) == link;
+}
+
+/* Blocks until the request of the priority 'pri' can be sent. The number
+   of requests being sent at once is limited by the "concurrent-connections"
+   property, or adjusted at runtime with the "adaptive-concurrency"; the request
+   of a higher priority is always preferred over the lower priority requests.
+   Each successful call should be followed by ews_connection_scheduler_release(). */
+static gboolean
+ews_connection_scheduler_acquire (EEwsConnection *cnc,
+				  gint pri,
+				  GCancellable *cancellable,
+				  GError **error)
+{
+	GList link = { NULL, NULL, NULL };
+	gulong cancelled_id = 0;
+	gint64 queued_at, waited;
+	gboolean cancelled;
+
+	pri = ews_connection_scheduler_normalize_priority (pri);
+
+	if (cancellable)
+		cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (ews_connection_scheduler_cancelled_cb), cnc, NULL);
+
+	g_mutex_lock (&cnc->priv->scheduler.mutex);
+
+	queued_at = g_get_monotonic_time ();
+
+	g_queue_push_tail_link (&cnc->priv->scheduler.waiting[pri], &link);
+
+	while (cancelled = g_cancellable_is_cancelled (cancellable),
+	       !cancelled && !ews_connection_scheduler_can_run_locked (cnc, pri, &link)) {
+		g_cond_wait (&cnc->priv->scheduler.cond, &cnc->priv->scheduler.mutex);
+	}
+
+	g_queue_unlink (&cnc->priv->scheduler.waiting[pri], &link);
+
+	if (!cancelled) {
+		waited = g_get_monotonic_time () - queued_at;
+
+		cnc->priv->scheduler.n_running++;
+		cnc->priv->scheduler.n_running_pri[pri]++;
+		cnc->priv->scheduler.n_dispatched[pri]++;
+		cnc->priv->scheduler.total_wait_usec[pri] += waited;
+
+		if (cnc->priv->scheduler.max_wait_usec[pri] < waited)
+			cnc->priv->scheduler.max_wait_usec[pri] = waited;
+	}
+
+	/* The head of the queue changed, let the next waiter check its state */
+	g_cond_broadcast (&cnc->priv->scheduler.cond);
+
+	g_mutex_unlock (&cnc->priv->scheduler.mutex);
+
+	/* Cannot disconnect with the scheduler.mutex locked, the callback locks it too */
+	if (cancelled_id)
+		g_cancellable_disconnect (cancellable, cancelled_id);
+
+	if (cancelled)
+		return !g_cancellable_set_error_if_cancelled (cancellable, error);
+
+	return TRUE;
+}
+
+static void
+ews_connection_scheduler_release (EEwsConnection *cnc,
+				  gint pri)
+{
+	pri = ews_connection_scheduler_normalize_priority (pri);
+
+	g_mutex_lock (&cnc->priv->scheduler.mutex);
+
+	g_warn_if_fail (cnc->priv->scheduler.n_running > 0);
+	g_warn_if_fail (cnc->priv->scheduler.n_running_pri[pri] > 0);
+
+	if (cnc->priv->scheduler.n_running > 0)
+		cnc->priv->scheduler.n_running--;
+	if (cnc->priv->scheduler.n_running_pri[pri] > 0)
+		cnc->priv->scheduler.n_running_pri[pri]--;
+
+	g_cond_broadcast (&cnc->priv->scheduler.cond);
+
+	g_mutex_unlock (&cnc->priv->scheduler.mutex);
+}
+
+/* Adjusts the in-flight limit with the "adaptive-concurrency", additive
+   increase, multiplicative decrease: the limit grows by one per a round
+   of responses, while there are requests waiting, and it shrinks to a half
+   when the server asks to back off, or to three quarters when the response
+   times grow, at most once per a response time. */
+static void
+ews_connection_scheduler_feedback (EEwsConnection *cnc,
+				   gboolean server_busy,
+				   gint64 response_usec)
+{
+	struct _EEwsSchedulerData *scheduler = &cnc->priv->scheduler;
+	gboolean has_waiting = FALSE;
+	gint64 now;
+	gint ii;
+
+	if (!ews_connection_get_adaptive_concurrency (cnc))
+		return;
+
+	g_mutex_lock (&scheduler->mutex);
+
+	now = g_get_monotonic_time ();
+
+	if (server_busy) {
+		if (now - scheduler->last_decrease_usec >= scheduler->srtt_usec) {
+			scheduler->adaptive_limit = MAX (scheduler->adaptive_limit / 2, MIN_CONCURRENT_CONNECTIONS);
+			scheduler->last_decrease_usec = now;
+		}
+	} else if (response_usec > 0) {
+		if (scheduler->srtt_usec)
+			scheduler->srtt_usec = (7 * scheduler->srtt_usec + response_usec) / 8;
+		else
+			scheduler->srtt_usec = response_usec;
+
+		/* Let the base follow slowly also upwards, the server load or
+		   the network conditions can change over time */
+		if (!scheduler->base_rtt_usec || scheduler->srtt_usec < scheduler->base_rtt_usec)
+			scheduler->base_rtt_usec = scheduler->srtt_usec;
+		else
+			scheduler->base_rtt_usec += (scheduler->srtt_usec - scheduler->base_rtt_usec) / 64;
+
+		for (ii = 0; ii < EWS_N_PRIORITIES && !has_waiting; ii++) {
+			has_waiting = !g_queue_is_empty (&scheduler->waiting[ii]);
+		}
+
+		if (scheduler->srtt_usec > EWS_ADAPTIVE_LATENCY_FACTOR * scheduler->base_rtt_usec) {
+			if (now - scheduler->last_decrease_usec >= scheduler->srtt_usec) {
+				scheduler->adaptive_limit = MAX (scheduler->adaptive_limit * 3 / 4, MIN_CONCURRENT_CONNECTIONS);
+				scheduler->last_decrease_usec = now;
+			}
+		} else if (has_waiting) {
+			scheduler->adaptive_limit = MIN (scheduler->adaptive_limit + 1.0 / scheduler->adaptive_limit,
+				MAX_ADAPTIVE_CONCURRENT_CONNECTIONS);
+		}
+	}
+
+	g_cond_broadcast (&scheduler->cond);
+
+	g_mutex_unlock (&scheduler->mutex);
+}
+
 static ESoapResponse *
 e_ews_connection_send_request_sync (EEwsConnection *cnc,
+				    gint pri,
 				    ESoapRequest *request,
 				    GCancellable *cancellable,
 				    GError **error)
@@ -604,12 +883,20 @@ e_ews_connection_send_request_sync (EEwsConnection *cnc,
 
 	while (repeat) {
 		GError *local_error2 = NULL;
+		gint64 started, got_headers_time = 0;
 
 		repeat = FALSE;
 
 		g_clear_error (&local_error);
 
-		response = e_ews_connection_process_request_sync (cnc, request, &message, &certificate_pem, &certificate_errors, &repeat, cancellable, &local_error);
+		if (!ews_connection_scheduler_acquire (cnc, pri, cancellable, &local_error))
+			break;
+
+		started = g_get_monotonic_time ();
+
+		response = e_ews_connection_process_request_sync (cnc, request, &message, &certificate_pem, &certificate_errors, &repeat, &got_headers_time, cancellable, &local_error);
+
+		ews_connection_scheduler_release (cnc, pri);
 
 		g_mutex_lock (&cnc->priv->property_lock);
 		g_clear_pointer (&cnc->priv->ssl_certificate_pem, g_free);
@@ -703,7 +990,16 @@ e_ews_connection_send_request_sync (EEwsConnection *cnc,
 		}
 
 		if (!local_error && response && !repeat) {
-			repeat = e_ews_connection_handle_backoff_policy (cnc, response, cancellable, &local_error);
+			/* Response time without the body download and the back off wait,
+			   thus the large responses do not look like a growing latency */
+			gint64 response_usec = (got_headers_time > 0 ? got_headers_time : g_get_monotonic_time ()) - started;
+			gboolean server_busy = FALSE;
+
+			repeat = e_ews_connection_handle_backoff_policy (cnc, response, &server_busy, cancellable, &local_error);
+
+			/* The server can be busy also when not backing off here */
+			if (server_busy || !local_error)
+				ews_connection_scheduler_feedback (cnc, server_busy, response_usec);
 
 			if (repeat || local_error)
 				g_clear_object (&response);
@@ -768,9 +1064,13 @@ ews_connection_set_concurrent_connections (EEwsConnection *cnc,
 	if (cnc->priv->concurrent_connections == concurrent_connections)
 		return;
 
-	/* Will be updated in the priv->soup.session the next time it's created,
-	   because "max-conns" is a construct-only property */
+	/* The scheduler uses the new value immediately; it is also the starting
+	   point of the in-flight limit with the "adaptive-concurrency" */
+	g_mutex_lock (&cnc->priv->scheduler.mutex);
 	cnc->priv->concurrent_connections = concurrent_connections;
+	cnc->priv->scheduler.adaptive_limit = concurrent_connections;
+	g_cond_broadcast (&cnc->priv->scheduler.cond);
+	g_mutex_unlock (&cnc->priv->scheduler.mutex);
 
 	g_object_notify (G_OBJECT (cnc), "concurrent-connections");
 }
@@ -1317,6 +1617,7 @@ ews_connection_finalize (GObject *object)
 	g_free (cnc->priv->uri);
 	g_free (cnc->priv->email);
 	g_free (cnc->priv->hash_key);
+	g_clear_pointer (&cnc->priv->clients, g_hash_table_destroy);
 	g_free (cnc->priv->impersonate_user);
 	g_free (cnc->priv->ssl_certificate_pem);
 	g_free (cnc->priv->last_subscription_id);
@@ -1329,6 +1630,13 @@ ews_connection_finalize (GObject *object)
 	g_mutex_clear (&cnc->priv->soup.mutex);
 	g_cond_clear (&cnc->priv->soup.cond);
 
+	g_mutex_clear (&cnc->priv->scheduler.mutex);
+	g_cond_clear (&cnc->priv->scheduler.cond);
+
+	g_hash_table_destroy (cnc->priv->coalescer.batches);
+	g_mutex_clear (&cnc->priv->coalescer.mutex);
+	g_cond_clear (&cnc->priv->coalescer.cond);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_ews_connection_parent_class)->finalize (object);
 }
@@ -1459,6 +1767,14 @@ e_ews_connection_init (EEwsConnection *cnc)
 	cnc->priv->soup.main_context = g_main_context_new ();
 	cnc->priv->soup.main_loop = g_main_loop_new (cnc->priv->soup.main_context, FALSE);
 
+	g_mutex_init (&cnc->priv->scheduler.mutex);
+	g_cond_init (&cnc->priv->scheduler.cond);
+	cnc->priv->scheduler.adaptive_limit = 1;
+
+	g_mutex_init (&cnc->priv->coalescer.mutex);
+	g_cond_init (&cnc->priv->coalescer.cond);
+	cnc->priv->coalescer.batches = g_hash_table_new (g_str_hash, g_str_equal);
+
 	cnc->priv->backoff_enabled = TRUE;
 	cnc->priv->disconnected_flag = FALSE;
 	cnc->priv->concurrent_connections = 1;
@@ -1778,32 +2094,123 @@ e_ews_connection_list_existing (void)
 	return connections;
 }
 
+static EEwsClientUsage *
+ews_client_usage_copy (const EEwsClientUsage *usage)
+{
+	EEwsClientUsage *copy;
+
+	copy = g_slice_new (EEwsClientUsage);
+	copy->source_uid = g_strdup (usage->source_uid);
+	copy->display_name = g_strdup (usage->display_name);
+	copy->n_acquired = usage->n_acquired;
+	copy->first_acquired = usage->first_acquired;
+	copy->last_acquired = usage->last_acquired;
+
+	return copy;
+}
+
 /**
- * e_ews_connection_new_full
- * @source: corresponding #ESource
- * @uri: Exchange server uri
- * @settings: a #CamelEwsSettings
- * @allow_connection_reuse: whether can return already created connection
+ * e_ews_connection_list_clients_usage:
+ * @cnc: an #EEwsConnection
  *
- * This does not authenticate to the server. It merely stores the username and password.
- * Authentication happens when a request is made to the server.
+ * Lists the clients (the mail account, the address books, calendars, task
+ * and memo lists), which obtained the @cnc, which is shared between all
+ * of them within the process.
  *
- * Returns: EEwsConnection
+ * Returns: (transfer full) (element-type EEwsClientUsage): a new #GSList
+ *    of #EEwsClientUsage, one for each client. Free the returned #GSList with
+ *    g_slist_free_full (usages, (GDestroyNotify) e_ews_client_usage_free);
+ *    when no longer needed.
  **/
-EEwsConnection *
-e_ews_connection_new_full (ESource *source,
-			   const gchar *uri,
-			   CamelEwsSettings *settings,
-			   gboolean allow_connection_reuse)
+GSList *
+e_ews_connection_list_clients_usage (EEwsConnection *cnc)
+{
+	GSList *usages = NULL;
+
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), NULL);
+
+	g_mutex_lock (&connecting);
+
+	if (cnc->priv->clients) {
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, cnc->priv->clients);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			usages = g_slist_prepend (usages, ews_client_usage_copy (value));
+		}
+	}
+
+	g_mutex_unlock (&connecting);
+
+	return usages;
+}
+
+/**
+ * e_ews_client_usage_free:
+ * @usage: (nullable): an #EEwsClientUsage
+ *
+ * Frees the @usage, previously returned by e_ews_connection_list_clients_usage().
+ **/
+void
+e_ews_client_usage_free (EEwsClientUsage *usage)
+{
+	if (usage) {
+		g_free (usage->source_uid);
+		g_free (usage->display_name);
+		g_slice_free (EEwsClientUsage, usage);
+	}
+}
+
+/* The 'connecting' mutex should be locked by the caller */
+static void
+ews_connection_note_client_locked (EEwsConnection *cnc,
+				   ESource *client_source)
+{
+	EEwsClientUsage *usage;
+	const gchar *uid;
+
+	if (!client_source)
+		return;
+
+	uid = e_source_get_uid (client_source);
+	if (!uid)
+		return;
+
+	if (!cnc->priv->clients) {
+		cnc->priv->clients = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify) e_ews_client_usage_free);
+	}
+
+	usage = g_hash_table_lookup (cnc->priv->clients, uid);
+	if (!usage) {
+		usage = g_slice_new0 (EEwsClientUsage);
+		usage->source_uid = g_strdup (uid);
+		usage->first_acquired = g_get_real_time ();
+
+		g_hash_table_insert (cnc->priv->clients, usage->source_uid, usage);
+	}
+
+	g_free (usage->display_name);
+	usage->display_name = e_source_dup_display_name (client_source);
+	usage->n_acquired++;
+	usage->last_acquired = g_get_real_time ();
+
+	e_ews_debug_print ("Connection %p (%s) used by '%s' (%s), shared by %u clients\n",
+		cnc, cnc->priv->hash_key, usage->display_name, uid,
+		g_hash_table_size (cnc->priv->clients));
+}
+
+static EEwsConnection *
+ews_connection_new_internal (ESource *source,
+			     ESource *client_source,
+			     const gchar *uri,
+			     CamelEwsSettings *settings,
+			     gboolean allow_connection_reuse)
 {
 	EEwsConnection *cnc;
 	gchar *hash_key;
 
-	if (source)
-		g_return_val_if_fail (E_IS_SOURCE (source), NULL);
-	g_return_val_if_fail (uri != NULL, NULL);
-	g_return_val_if_fail (CAMEL_IS_EWS_SETTINGS (settings), NULL);
-
 	hash_key = e_ews_connection_construct_hash_key (uri, settings);
 
 	g_mutex_lock (&connecting);
@@ -1819,6 +2226,8 @@ e_ews_connection_new_full (ESource *source,
 
 			g_free (hash_key);
 
+			ews_connection_note_client_locked (cnc, client_source);
+
 			g_mutex_unlock (&connecting);
 			return cnc;
 		}
@@ -1855,12 +2264,40 @@ e_ews_connection_new_full (ESource *source,
 			g_strdup (cnc->priv->hash_key), cnc);
 	}
 
+	ews_connection_note_client_locked (cnc, client_source);
+
 	/* free memory */
 	g_mutex_unlock (&connecting);
 	return cnc;
 
 }
 
+/**
+ * e_ews_connection_new_full
+ * @source: corresponding #ESource
+ * @uri: Exchange server uri
+ * @settings: a #CamelEwsSettings
+ * @allow_connection_reuse: whether can return already created connection
+ *
+ * This does not authenticate to the server. It merely stores the username and password.
+ * Authentication happens when a request is made to the server.
+ *
+ * Returns: EEwsConnection
+ **/
+EEwsConnection *
+e_ews_connection_new_full (ESource *source,
+			   const gchar *uri,
+			   CamelEwsSettings *settings,
+			   gboolean allow_connection_reuse)
+{
+	if (source)
+		g_return_val_if_fail (E_IS_SOURCE (source), NULL);
+	g_return_val_if_fail (uri != NULL, NULL);
+	g_return_val_if_fail (CAMEL_IS_EWS_SETTINGS (settings), NULL);
+
+	return ews_connection_new_internal (source, source, uri, settings, allow_connection_reuse);
+}
+
 EEwsConnection *
 e_ews_connection_new (ESource *source,
 		      const gchar *uri,
@@ -1880,6 +2317,8 @@ e_ews_connection_new_for_backend (EBackend *backend,
 
 	g_return_val_if_fail (E_IS_BACKEND (backend), NULL);
 	g_return_val_if_fail (E_IS_SOURCE_REGISTRY (registry), NULL);
+	g_return_val_if_fail (uri != NULL, NULL);
+	g_return_val_if_fail (CAMEL_IS_EWS_SETTINGS (settings), NULL);
 
 	source = e_backend_get_source (backend);
 	if (!source)
@@ -1901,10 +2340,10 @@ e_ews_connection_new_for_backend (EBackend *backend,
 		source = parent;
 	}
 
-	if (source)
-		cnc = e_ews_connection_new (source, uri, settings);
-	else
-		cnc = e_ews_connection_new (e_backend_get_source (backend), uri, settings);
+	/* All backends of the account share one connection, thus also one
+	   session with its authenticated connections and cookies */
+	cnc = ews_connection_new_internal (source ? source : e_backend_get_source (backend),
+		e_backend_get_source (backend), uri, settings, TRUE);
 
 	g_clear_object (&source);
 
@@ -2200,6 +2639,32 @@ e_ews_connection_set_backoff_enabled (EEwsConnection *cnc,
 	cnc->priv->backoff_enabled = enabled;
 }
 
+/**
+ * e_ews_connection_get_server_busy_until:
+ * @cnc: an #EEwsConnection
+ *
+ * Returns the time, as returned by g_get_monotonic_time(), until which
+ * the server asked the last time to not send any further requests, with
+ * its ErrorServerBusy response and its BackOffMilliseconds value. It is
+ * recorded regardless of the e_ews_connection_get_backoff_enabled() value.
+ *
+ * Returns: the monotonic time until which the server is busy, or 0, when
+ *    the server did not ask for any back off yet
+ **/
+gint64
+e_ews_connection_get_server_busy_until (EEwsConnection *cnc)
+{
+	gint64 busy_until;
+
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), 0);
+
+	g_mutex_lock (&cnc->priv->property_lock);
+	busy_until = cnc->priv->server_busy_until;
+	g_mutex_unlock (&cnc->priv->property_lock);
+
+	return busy_until;
+}
+
 gboolean
 e_ews_connection_get_disconnected_flag (EEwsConnection *cnc)
 {
@@ -2217,31 +2682,119 @@ e_ews_connection_set_disconnected_flag (EEwsConnection *cnc,
 	cnc->priv->disconnected_flag = disconnected_flag;
 }
 
-gchar *
-e_ews_connection_dup_last_subscription_id (EEwsConnection *cnc)
+/**
+ * e_ews_connection_get_queue_stats:
+ * @cnc: an #EEwsConnection
+ * @pri: one of the EWS_PRIORITY_ values
+ * @out_n_queued: (out) (optional): number of requests currently waiting to be sent
+ * @out_n_running: (out) (optional): number of requests currently being sent
+ * @out_n_dispatched: (out) (optional): number of requests sent since the @cnc creation
+ * @out_total_wait_usec: (out) (optional): summary time, in microseconds, the sent requests had been waiting in the queue
+ * @out_max_wait_usec: (out) (optional): the longest time, in microseconds, any request had been waiting in the queue
+ *
+ * Returns the request scheduler counters for the priority @pri. All the values
+ * are taken atomically, at the time of the call.
+ **/
+void
+e_ews_connection_get_queue_stats (EEwsConnection *cnc,
+				  gint pri,
+				  guint *out_n_queued,
+				  guint *out_n_running,
+				  guint64 *out_n_dispatched,
+				  gint64 *out_total_wait_usec,
+				  gint64 *out_max_wait_usec)
 {
-	gchar *res;
-
-	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), NULL);
+	g_return_if_fail (E_IS_EWS_CONNECTION (cnc));
 
-	g_mutex_lock (&cnc->priv->property_lock);
+	pri = ews_connection_scheduler_normalize_priority (pri);
 
-	res = g_strdup (cnc->priv->last_subscription_id);
+	g_mutex_lock (&cnc->priv->scheduler.mutex);
 
-	g_mutex_unlock (&cnc->priv->property_lock);
+	if (out_n_queued)
+		*out_n_queued = g_queue_get_length (&cnc->priv->scheduler.waiting[pri]);
+	if (out_n_running)
+		*out_n_running = cnc->priv->scheduler.n_running_pri[pri];
+	if (out_n_dispatched)
+		*out_n_dispatched = cnc->priv->scheduler.n_dispatched[pri];
+	if (out_total_wait_usec)
+		*out_total_wait_usec = cnc->priv->scheduler.total_wait_usec[pri];
+	if (out_max_wait_usec)
+		*out_max_wait_usec = cnc->priv->scheduler.max_wait_usec[pri];
 
-	return res;
+	g_mutex_unlock (&cnc->priv->scheduler.mutex);
 }
 
+/**
+ * e_ews_connection_set_coalesce_window:
+ * @cnc: an #EEwsConnection
+ * @window_ms: time window, in milliseconds, or 0 to disable the coalescing
+ *
+ * Sets for how long e_ews_connection_get_items_sync() waits for other
+ * calls with the same item shape, to send them all together as a single
+ * GetItem request, with up to 100 items. Each caller receives only
+ * the items it asked for, with the same errors as if it sent the request
+ * on its own. Calls with a progress function and calls with
+ * the %EWS_PRIORITY_HIGH priority are never delayed nor coalesced.
+ *
+ * The coalescing is disabled by default.
+ **/
 void
-e_ews_connection_set_last_subscription_id (EEwsConnection *cnc,
-					   const gchar *subscription_id)
+e_ews_connection_set_coalesce_window (EEwsConnection *cnc,
+				      guint window_ms)
 {
 	g_return_if_fail (E_IS_EWS_CONNECTION (cnc));
 
-	g_mutex_lock (&cnc->priv->property_lock);
+	g_mutex_lock (&cnc->priv->coalescer.mutex);
+	cnc->priv->coalescer.window_ms = window_ms;
+	g_mutex_unlock (&cnc->priv->coalescer.mutex);
+}
 
-	if (g_strcmp0 (subscription_id, cnc->priv->last_subscription_id) != 0) {
+/**
+ * e_ews_connection_get_coalesce_window:
+ * @cnc: an #EEwsConnection
+ *
+ * Returns: the GetItem coalesce window, in milliseconds, as set by
+ *    e_ews_connection_set_coalesce_window()
+ **/
+guint
+e_ews_connection_get_coalesce_window (EEwsConnection *cnc)
+{
+	guint window_ms;
+
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), 0);
+
+	g_mutex_lock (&cnc->priv->coalescer.mutex);
+	window_ms = cnc->priv->coalescer.window_ms;
+	g_mutex_unlock (&cnc->priv->coalescer.mutex);
+
+	return window_ms;
+}
+
+gchar *
+e_ews_connection_dup_last_subscription_id (EEwsConnection *cnc)
+{
+	gchar *res;
+
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), NULL);
+
+	g_mutex_lock (&cnc->priv->property_lock);
+
+	res = g_strdup (cnc->priv->last_subscription_id);
+
+	g_mutex_unlock (&cnc->priv->property_lock);
+
+	return res;
+}
+
+void
+e_ews_connection_set_last_subscription_id (EEwsConnection *cnc,
+					   const gchar *subscription_id)
+{
+	g_return_if_fail (E_IS_EWS_CONNECTION (cnc));
+
+	g_mutex_lock (&cnc->priv->property_lock);
+
+	if (g_strcmp0 (subscription_id, cnc->priv->last_subscription_id) != 0) {
 		g_free (cnc->priv->last_subscription_id);
 		cnc->priv->last_subscription_id = g_strdup (subscription_id);
 	}
@@ -3344,7 +3897,7 @@ e_ews_connection_get_oal_list_sync (EEwsConnection *cnc,
 
 	e_soap_request_set_custom_process_fn (request, e_ews_process_oal_data_response, &req_data);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, &local_error);
+	response = e_ews_connection_send_request_sync (cnc, EWS_PRIORITY_MEDIUM, request, cancellable, &local_error);
 	g_warn_if_fail (response == NULL);
 
 	g_clear_object (&request);
@@ -3411,7 +3964,7 @@ e_ews_connection_get_oal_detail_sync (EEwsConnection *cnc,
 	e_soap_request_set_custom_process_fn (request, e_ews_process_oal_data_response, &req_data);
 	e_soap_request_set_etag (request, old_etag);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, &local_error);
+	response = e_ews_connection_send_request_sync (cnc, EWS_PRIORITY_LOW, request, cancellable, &local_error);
 	g_warn_if_fail (response == NULL);
 
 	g_clear_object (&request);
@@ -3438,6 +3991,8 @@ e_ews_connection_get_oal_detail_sync (EEwsConnection *cnc,
 typedef struct _DownloadOalData {
 	const gchar *cache_filename;
 	gint fd;
+	EEwsDownloadDataCallback data_cb; /* used instead of the fd, when set */
+	gpointer data_user_data;
 } DownloadOalData;
 
 static void
@@ -3461,7 +4016,7 @@ e_ews_process_download_oal_file_response (ESoapRequest *request,
 	gboolean success;
 
 	g_return_if_fail (dod != NULL);
-	g_return_if_fail (dod->fd != -1);
+	g_return_if_fail (dod->fd != -1 || dod->data_cb != NULL);
 
 	e_soap_request_get_progress_fn (request, &progress_fn, &progress_data);
 
@@ -3484,7 +4039,10 @@ e_ews_process_download_oal_file_response (ESoapRequest *request,
 			}
 		}
 
-		if (write (dod->fd, (const gchar *) buffer, nread) != nread) {
+		if (dod->data_cb) {
+			if (!dod->data_cb (buffer, nread, dod->data_user_data, cancellable, error))
+				break;
+		} else if (write (dod->fd, (const gchar *) buffer, nread) != nread) {
 			g_set_error (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_UNKNOWN,
 				"Failed to write streaming data to file '%s': %s", dod->cache_filename, g_strerror (errno));
 			break;
@@ -3519,6 +4077,8 @@ e_ews_connection_download_oal_file_sync (EEwsConnection *cnc,
 	g_unlink (cache_filename);
 
 	dod.cache_filename = cache_filename;
+	dod.data_cb = NULL;
+	dod.data_user_data = NULL;
 	dod.fd = g_open (cache_filename, O_RDONLY | O_WRONLY | O_APPEND | O_CREAT, 0600);
 	if (dod.fd == -1) {
 		g_set_error (error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_UNKNOWN,
@@ -3532,7 +4092,7 @@ e_ews_connection_download_oal_file_sync (EEwsConnection *cnc,
 
 	e_soap_request_set_custom_process_fn (request, e_ews_process_download_oal_file_response, &dod);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, &local_error);
+	response = e_ews_connection_send_request_sync (cnc, EWS_PRIORITY_LOW, request, cancellable, &local_error);
 	g_warn_if_fail (response == NULL);
 
 	g_clear_object (&request);
@@ -3547,6 +4107,71 @@ e_ews_connection_download_oal_file_sync (EEwsConnection *cnc,
 	return TRUE;
 }
 
+/**
+ * e_ews_connection_download_oal_data_sync:
+ * @cnc: an #EEwsConnection
+ * @oal_uri: URI of the OAL file to download
+ * @data_cb: (scope call): a function to pass the downloaded data to
+ * @data_user_data: user data for @data_cb
+ * @progress_fn: (nullable): a progress function, or %NULL
+ * @progress_data: user data for @progress_fn
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Downloads the OAL file the same as e_ews_connection_download_oal_file_sync(),
+ * only the data is passed to @data_cb as it is received, instead of being
+ * stored into a file. The @data_cb is called from the connection's own
+ * thread; it can block to throttle the download, and it can stop it by
+ * returning %FALSE with the @error set.
+ *
+ * Returns: whether succeeded
+ **/
+gboolean
+e_ews_connection_download_oal_data_sync (EEwsConnection *cnc,
+					 const gchar *oal_uri,
+					 EEwsDownloadDataCallback data_cb,
+					 gpointer data_user_data,
+					 ESoapResponseProgressFn progress_fn,
+					 gpointer progress_data,
+					 GCancellable *cancellable,
+					 GError **error)
+{
+	ESoapRequest *request;
+	ESoapResponse *response;
+	DownloadOalData dod;
+	GError *local_error = NULL;
+
+	g_return_val_if_fail (E_IS_EWS_CONNECTION (cnc), FALSE);
+	g_return_val_if_fail (data_cb != NULL, FALSE);
+
+	request = e_ews_create_request_for_url (oal_uri, NULL, error);
+
+	if (!request)
+		return FALSE;
+
+	dod.cache_filename = NULL;
+	dod.fd = -1;
+	dod.data_cb = data_cb;
+	dod.data_user_data = data_user_data;
+
+	e_soap_request_set_progress_fn (request, progress_fn, progress_data);
+
+	e_soap_request_set_custom_process_fn (request, e_ews_process_download_oal_file_response, &dod);
+
+	response = e_ews_connection_send_request_sync (cnc, EWS_PRIORITY_LOW, request, cancellable, &local_error);
+	g_warn_if_fail (response == NULL);
+
+	g_clear_object (&request);
+	g_clear_object (&response);
+
+	if (local_error) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 const gchar *
 e_ews_connection_get_mailbox (EEwsConnection *cnc)
 {
@@ -3781,7 +4406,7 @@ e_ews_connection_sync_folder_items_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -3981,7 +4606,7 @@ e_ews_connection_find_folder_items_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -4096,7 +4721,7 @@ e_ews_connection_sync_folder_hierarchy_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -4170,6 +4795,95 @@ e_ews_connection_satisfies_server_version (EEwsConnection *cnc,
 	return cnc->priv->version >= version;
 }
 
+/* Prepends items from one *ResponseMessage into the 'out_items' */
+static void
+ews_process_get_items_response_message (ESoapParameter *subparam,
+					GSList **out_items)
+{
+	ESoapParameter *node;
+	EEwsItem *item;
+	GError *local_error = NULL;
+
+	if (ews_get_response_status (subparam, &local_error))
+		local_error = NULL;
+
+	for (node = e_soap_parameter_get_first_child_by_name (subparam, "Items");
+	     node;
+	     node = e_soap_parameter_get_next_child_by_name (subparam, "Items")) {
+		if (node->children)
+			item = e_ews_item_new_from_soap_parameter (node);
+		else
+			item = NULL;
+		if (!item && local_error != NULL)
+			item = e_ews_item_new_from_error (local_error);
+		if (item)
+			*out_items = g_slist_prepend (*out_items, item);
+	}
+
+	/* Do not stop on errors. */
+	g_clear_error (&local_error);
+}
+
+typedef struct _StreamedObjects {
+	/* The response the 'objects' belong to; it can change when the request is repeated */
+	ESoapResponse *response;
+	GSList *objects; /* GObject-s, in the reverse order */
+} StreamedObjects;
+
+static void
+streamed_objects_clear (StreamedObjects *so)
+{
+	g_slist_free_full (so->objects, g_object_unref);
+	so->objects = NULL;
+
+	g_clear_object (&so->response);
+}
+
+/* Returns the objects, in the reverse order, which belong to the 'response' */
+static GSList *
+streamed_objects_steal (StreamedObjects *so,
+			ESoapResponse *response)
+{
+	GSList *objects = NULL;
+
+	if (so->response == response)
+		objects = g_steal_pointer (&so->objects);
+
+	streamed_objects_clear (so);
+
+	return objects;
+}
+
+static void
+streamed_objects_prepare (StreamedObjects *so,
+			  ESoapResponse *response)
+{
+	if (so->response != response) {
+		streamed_objects_clear (so);
+		so->response = g_object_ref (response);
+	}
+}
+
+/* Called by the ESoapResponse for each fully received child of the <ResponseMessages>,
+   thus the items are created while the response is still being received and the XML
+   document does not need to hold all of them at once. */
+static gboolean
+ews_get_items_response_message_cb (ESoapResponse *response,
+				   ESoapParameter *param,
+				   gpointer user_data)
+{
+	StreamedObjects *so = user_data;
+
+	if (!g_str_has_suffix ((const gchar *) param->name, "ResponseMessage"))
+		return FALSE;
+
+	streamed_objects_prepare (so, response);
+
+	ews_process_get_items_response_message (param, &so->objects);
+
+	return TRUE;
+}
+
 static gboolean
 e_ews_process_get_items_response (EEwsConnection *cnc,
 				  ESoapResponse *response,
@@ -4198,31 +4912,11 @@ e_ews_process_get_items_response (EEwsConnection *cnc,
 		const gchar *name = (const gchar *) subparam->name;
 
 		if (g_str_has_suffix (name, "ResponseMessage")) {
-			ESoapParameter *node;
-			EEwsItem *item;
-
-			if (ews_get_response_status (subparam, &local_error))
-				local_error = NULL;
-
-			for (node = e_soap_parameter_get_first_child_by_name (subparam, "Items");
-			     node;
-			     node = e_soap_parameter_get_next_child_by_name (subparam, "Items")) {
-				if (node->children)
-					item = e_ews_item_new_from_soap_parameter (node);
-				else
-					item = NULL;
-				if (!item && local_error != NULL)
-					item = e_ews_item_new_from_error (local_error);
-				if (item)
-					*out_items = g_slist_prepend (*out_items, item);
-			}
+			ews_process_get_items_response_message (subparam, out_items);
 		} else {
 			g_warning ("%s: Unexpected element <%s>", G_STRFUNC, name);
 		}
 
-		/* Do not stop on errors. */
-		g_clear_error (&local_error);
-
 		subparam = e_soap_parameter_get_next_child (subparam);
 	}
 
@@ -4245,23 +4939,24 @@ e_ews_process_get_items_response (EEwsConnection *cnc,
 	return TRUE;
 }
 
-gboolean
-e_ews_connection_get_items_sync (EEwsConnection *cnc,
-                                 gint pri,
-                                 const GSList *ids,
-                                 const gchar *default_props,
-				 const EEwsAdditionalProps *add_props,
-                                 gboolean include_mime,
-                                 const gchar *mime_directory,
-				 EEwsBodyType body_type,
-                                 GSList **out_items,
-                                 ESoapResponseProgressFn progress_fn,
-                                 gpointer progress_data,
-                                 GCancellable *cancellable,
-                                 GError **error)
+static gboolean
+ews_connection_get_items_real_sync (EEwsConnection *cnc,
+				    gint pri,
+				    const GSList *ids,
+				    const gchar *default_props,
+				    const EEwsAdditionalProps *add_props,
+				    gboolean include_mime,
+				    const gchar *mime_directory,
+				    EEwsBodyType body_type,
+				    GSList **out_items,
+				    ESoapResponseProgressFn progress_fn,
+				    gpointer progress_data,
+				    GCancellable *cancellable,
+				    GError **error)
 {
 	ESoapRequest *request;
 	ESoapResponse *response;
+	StreamedObjects streamed = { NULL, NULL };
 	const GSList *link;
 	gboolean success;
 
@@ -4325,13 +5020,19 @@ e_ews_connection_get_items_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	e_soap_request_set_node_fn (request, "ResponseMessages", ews_get_items_response_message_cb, &streamed);
+
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
+		streamed_objects_clear (&streamed);
 		g_clear_object (&request);
 		return FALSE;
 	}
 
+	/* The response messages had been consumed while being received */
+	*out_items = streamed_objects_steal (&streamed, response);
+
 	success = e_ews_process_get_items_response (cnc, response, out_items, error);
 
 	g_clear_object (&request);
@@ -4345,6 +5046,407 @@ e_ews_connection_get_items_sync (EEwsConnection *cnc,
 	return success;
 }
 
+/* Items requested by a single caller are in the same (coalesced) GetItem
+   request; when the request fails as a whole, or when the server stops
+   processing the items due to an error in an item of another caller,
+   the caller repeats its request on its own. */
+typedef struct _GetItemsWaiter {
+	gint ref_count;
+	GSList *ids; /* gchar *, a copy, the caller can leave before the request is sent */
+	guint n_ids;
+	gint pri;
+	gboolean done;
+	gboolean retry_alone;
+	GSList *items;
+	GError *error;
+} GetItemsWaiter;
+
+typedef struct _GetItemsBatch {
+	gchar *key; /* the ItemShape description, the key in the coalescer.batches */
+	GPtrArray *waiters; /* GetItemsWaiter * */
+	guint n_ids;
+	gboolean closed; /* removed from the coalescer.batches, no new waiters can join */
+	gboolean sent;
+} GetItemsBatch;
+
+static GetItemsWaiter *
+get_items_waiter_new (const GSList *ids,
+		      guint n_ids,
+		      gint pri)
+{
+	GetItemsWaiter *waiter;
+
+	waiter = g_slice_new0 (GetItemsWaiter);
+	waiter->ref_count = 1;
+	waiter->ids = g_slist_copy_deep ((GSList *) ids, (GCopyFunc) g_strdup, NULL);
+	waiter->n_ids = n_ids;
+	waiter->pri = pri;
+
+	return waiter;
+}
+
+static GetItemsWaiter *
+get_items_waiter_ref (GetItemsWaiter *waiter)
+{
+	g_atomic_int_inc (&waiter->ref_count);
+
+	return waiter;
+}
+
+static void
+get_items_waiter_unref (gpointer ptr)
+{
+	GetItemsWaiter *waiter = ptr;
+
+	if (waiter && g_atomic_int_dec_and_test (&waiter->ref_count)) {
+		g_slist_free_full (waiter->ids, g_free);
+		g_slist_free_full (waiter->items, g_object_unref);
+		g_clear_error (&waiter->error);
+		g_slice_free (GetItemsWaiter, waiter);
+	}
+}
+
+static gchar *
+ews_get_items_shape_key (const gchar *default_props,
+			 const EEwsAdditionalProps *add_props,
+			 gboolean include_mime,
+			 const gchar *mime_directory,
+			 EEwsBodyType body_type)
+{
+	GString *key;
+	GSList *link;
+
+	key = g_string_new (default_props);
+
+	g_string_append_printf (key, "\n%d\n%d\n%s\n", include_mime ? 1 : 0, body_type, mime_directory ? mime_directory : "");
+
+	if (add_props) {
+		g_string_append (key, add_props->field_uri ? add_props->field_uri : "");
+
+		for (link = add_props->extended_furis; link; link = g_slist_next (link)) {
+			EEwsExtendedFieldURI *ex_furi = link->data;
+
+			g_string_append_printf (key, "\nE:%s|%s|%s|%s|%s|%s",
+				ex_furi->distinguished_prop_set_id ? ex_furi->distinguished_prop_set_id : "",
+				ex_furi->prop_set_id ? ex_furi->prop_set_id : "",
+				ex_furi->prop_tag ? ex_furi->prop_tag : "",
+				ex_furi->prop_name ? ex_furi->prop_name : "",
+				ex_furi->prop_id ? ex_furi->prop_id : "",
+				ex_furi->prop_type ? ex_furi->prop_type : "");
+		}
+
+		for (link = add_props->indexed_furis; link; link = g_slist_next (link)) {
+			EEwsIndexedFieldURI *in_furi = link->data;
+
+			g_string_append_printf (key, "\nI:%s|%s",
+				in_furi->field_uri ? in_furi->field_uri : "",
+				in_furi->field_index ? in_furi->field_index : "");
+		}
+	}
+
+	return g_string_free (key, FALSE);
+}
+
+static void
+ews_connection_coalescer_cancelled_cb (GCancellable *cancellable,
+				       gpointer user_data)
+{
+	EEwsConnection *cnc = user_data;
+
+	g_mutex_lock (&cnc->priv->coalescer.mutex);
+	g_cond_broadcast (&cnc->priv->coalescer.cond);
+	g_mutex_unlock (&cnc->priv->coalescer.mutex);
+}
+
+/* The coalescer.mutex should be locked by the caller */
+static void
+ews_connection_coalescer_close_batch_locked (EEwsConnection *cnc,
+					     GetItemsBatch *batch)
+{
+	if (batch->closed)
+		return;
+
+	g_hash_table_remove (cnc->priv->coalescer.batches, batch->key);
+	batch->closed = TRUE;
+
+	g_cond_broadcast (&cnc->priv->coalescer.cond);
+}
+
+/* Splits the 'items', which are in the order of the requested ids,
+   between the waiters of the 'batch'. Returns FALSE, when the items
+   do not match the requested ids. */
+static gboolean
+ews_connection_coalescer_distribute_items (GetItemsBatch *batch,
+					   GSList *items)
+{
+	guint ii;
+
+	if (g_slist_length (items) != batch->n_ids)
+		return FALSE;
+
+	for (ii = 0; ii < batch->waiters->len; ii++) {
+		GetItemsWaiter *waiter = g_ptr_array_index (batch->waiters, ii);
+		GSList *link, *last = NULL;
+		gboolean stopped = FALSE;
+		guint jj;
+
+		waiter->items = items;
+
+		for (jj = 0, link = items; jj < waiter->n_ids; jj++, link = g_slist_next (link)) {
+			EEwsItem *item = link->data;
+
+			if (item && e_ews_item_get_item_type (item) == E_EWS_ITEM_TYPE_ERROR &&
+			    g_error_matches (e_ews_item_get_error (item), EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_BATCHPROCESSINGSTOPPED))
+				stopped = TRUE;
+
+			last = link;
+		}
+
+		items = last ? last->next : NULL;
+
+		if (last)
+			last->next = NULL;
+		else
+			waiter->items = NULL;
+
+		if (stopped) {
+			/* The error might be caused by items of another waiter */
+			g_slist_free_full (waiter->items, g_object_unref);
+			waiter->items = NULL;
+			waiter->retry_alone = TRUE;
+		} else if (waiter->items && !waiter->items->next) {
+			EEwsItem *item = waiter->items->data;
+
+			/* The same as in the e_ews_process_get_items_response() */
+			if (item && e_ews_item_get_item_type (item) == E_EWS_ITEM_TYPE_ERROR) {
+				waiter->error = g_error_copy (e_ews_item_get_error (item));
+
+				g_slist_free_full (waiter->items, g_object_unref);
+				waiter->items = NULL;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/* Joins the request into a pending GetItem request with the same ItemShape,
+   or creates a new one and sends it after the coalesce window elapses. */
+static gboolean
+ews_connection_coalesce_get_items_sync (EEwsConnection *cnc,
+					gint pri,
+					const GSList *ids,
+					guint n_ids,
+					const gchar *default_props,
+					const EEwsAdditionalProps *add_props,
+					gboolean include_mime,
+					const gchar *mime_directory,
+					EEwsBodyType body_type,
+					GSList **out_items,
+					gboolean *out_retry_alone,
+					GCancellable *cancellable,
+					GError **error)
+{
+	GetItemsBatch *batch;
+	GetItemsWaiter *waiter;
+	gulong cancelled_id = 0;
+	gboolean success;
+	gchar *key;
+
+	key = ews_get_items_shape_key (default_props, add_props, include_mime, mime_directory, body_type);
+	waiter = get_items_waiter_new (ids, n_ids, pri);
+
+	if (cancellable)
+		cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (ews_connection_coalescer_cancelled_cb), cnc, NULL);
+
+	g_mutex_lock (&cnc->priv->coalescer.mutex);
+
+	batch = g_hash_table_lookup (cnc->priv->coalescer.batches, key);
+
+	if (batch && batch->n_ids + n_ids > EWS_COALESCE_MAX_ITEMS) {
+		/* Let its sender send it right away */
+		ews_connection_coalescer_close_batch_locked (cnc, batch);
+		batch = NULL;
+	}
+
+	if (batch) {
+		g_ptr_array_add (batch->waiters, get_items_waiter_ref (waiter));
+		batch->n_ids += n_ids;
+
+		if (batch->n_ids >= EWS_COALESCE_MAX_ITEMS)
+			ews_connection_coalescer_close_batch_locked (cnc, batch);
+
+		while (!waiter->done && !g_cancellable_is_cancelled (cancellable)) {
+			g_cond_wait (&cnc->priv->coalescer.cond, &cnc->priv->coalescer.mutex);
+		}
+
+		/* The batch is freed only after all its waiters are done */
+		if (!waiter->done && !batch->sent) {
+			batch->n_ids -= n_ids;
+			g_ptr_array_remove (batch->waiters, waiter);
+		}
+
+		g_free (key);
+	} else {
+		GSList *combined_ids = NULL, *items = NULL;
+		GError *local_error = NULL;
+		gint64 deadline;
+		guint ii;
+
+		batch = g_slice_new0 (GetItemsBatch);
+		batch->key = key;
+		batch->waiters = g_ptr_array_new_with_free_func (get_items_waiter_unref);
+		batch->n_ids = n_ids;
+
+		g_ptr_array_add (batch->waiters, get_items_waiter_ref (waiter));
+		g_hash_table_insert (cnc->priv->coalescer.batches, batch->key, batch);
+
+		deadline = g_get_monotonic_time () + cnc->priv->coalescer.window_ms * G_TIME_SPAN_MILLISECOND;
+
+		while (!batch->closed && !g_cancellable_is_cancelled (cancellable) &&
+		       g_cond_wait_until (&cnc->priv->coalescer.cond, &cnc->priv->coalescer.mutex, deadline)) {
+			/* Wait until the window elapses or the batch is full */
+		}
+
+		ews_connection_coalescer_close_batch_locked (cnc, batch);
+
+		for (ii = 0; ii < batch->waiters->len; ii++) {
+			GetItemsWaiter *bwaiter = g_ptr_array_index (batch->waiters, ii);
+			const GSList *link;
+
+			/* The strings are owned by the 'combined_ids' now */
+			for (link = bwaiter->ids; link; link = g_slist_next (link)) {
+				combined_ids = g_slist_prepend (combined_ids, link->data);
+			}
+
+			g_slist_free (bwaiter->ids);
+			bwaiter->ids = NULL;
+			pri = MAX (pri, bwaiter->pri);
+		}
+
+		batch->sent = TRUE;
+
+		g_mutex_unlock (&cnc->priv->coalescer.mutex);
+
+		combined_ids = g_slist_reverse (combined_ids);
+
+		success = ews_connection_get_items_real_sync (
+			cnc, pri, combined_ids, default_props, add_props, include_mime, mime_directory, body_type,
+			&items, NULL, NULL, cancellable, &local_error);
+
+		g_slist_free_full (combined_ids, g_free);
+
+		g_mutex_lock (&cnc->priv->coalescer.mutex);
+
+		if (!success || !ews_connection_coalescer_distribute_items (batch, items)) {
+			gboolean sender_gets_error;
+
+			/* The failure can be caused by the ids of any of the waiters, thus
+			   all of them try alone, including the sender. The sender gets the error
+			   only when it is the only waiter, or when it was cancelled, because
+			   only the sender's cancellable had been used for the request */
+			sender_gets_error = local_error && (batch->waiters->len == 1 || g_cancellable_is_cancelled (cancellable));
+
+			for (ii = 0; ii < batch->waiters->len; ii++) {
+				GetItemsWaiter *bwaiter = g_ptr_array_index (batch->waiters, ii);
+
+				if (bwaiter == waiter && sender_gets_error) {
+					waiter->error = g_steal_pointer (&local_error);
+				} else {
+					g_slist_free_full (bwaiter->items, g_object_unref);
+					bwaiter->items = NULL;
+					bwaiter->retry_alone = TRUE;
+				}
+			}
+
+			if (success)
+				g_slist_free_full (items, g_object_unref);
+		}
+
+		for (ii = 0; ii < batch->waiters->len; ii++) {
+			GetItemsWaiter *bwaiter = g_ptr_array_index (batch->waiters, ii);
+
+			bwaiter->done = TRUE;
+		}
+
+		g_cond_broadcast (&cnc->priv->coalescer.cond);
+
+		g_clear_error (&local_error);
+		g_ptr_array_unref (batch->waiters);
+		g_free (batch->key);
+		g_slice_free (GetItemsBatch, batch);
+	}
+
+	g_mutex_unlock (&cnc->priv->coalescer.mutex);
+
+	/* Cannot disconnect with the coalescer.mutex locked, the callback locks it too */
+	if (cancelled_id)
+		g_cancellable_disconnect (cancellable, cancelled_id);
+
+	if (!waiter->done) {
+		/* Cancelled while waiting */
+		g_cancellable_set_error_if_cancelled (cancellable, error);
+		success = FALSE;
+	} else if (waiter->retry_alone) {
+		*out_retry_alone = TRUE;
+		success = FALSE;
+	} else if (waiter->error) {
+		g_propagate_error (error, g_steal_pointer (&waiter->error));
+		success = FALSE;
+	} else {
+		*out_items = g_steal_pointer (&waiter->items);
+		success = TRUE;
+	}
+
+	get_items_waiter_unref (waiter);
+
+	return success;
+}
+
+gboolean
+e_ews_connection_get_items_sync (EEwsConnection *cnc,
+                                 gint pri,
+                                 const GSList *ids,
+                                 const gchar *default_props,
+				 const EEwsAdditionalProps *add_props,
+                                 gboolean include_mime,
+                                 const gchar *mime_directory,
+				 EEwsBodyType body_type,
+                                 GSList **out_items,
+                                 ESoapResponseProgressFn progress_fn,
+                                 gpointer progress_data,
+                                 GCancellable *cancellable,
+                                 GError **error)
+{
+	g_return_val_if_fail (cnc != NULL, FALSE);
+	g_return_val_if_fail (out_items != NULL, FALSE);
+
+	*out_items = NULL;
+
+	/* Requests with a progress cannot share it with others and the high
+	   priority requests are not delayed by the coalesce window */
+	if (ids && !progress_fn && ews_connection_scheduler_normalize_priority (pri) != EWS_PRIORITY_HIGH &&
+	    e_ews_connection_get_coalesce_window (cnc) > 0) {
+		guint n_ids = g_slist_length ((GSList *) ids);
+
+		if (n_ids < EWS_COALESCE_MAX_ITEMS) {
+			gboolean retry_alone = FALSE;
+			gboolean success;
+
+			success = ews_connection_coalesce_get_items_sync (cnc, pri, ids, n_ids,
+				default_props, add_props, include_mime, mime_directory, body_type,
+				out_items, &retry_alone, cancellable, error);
+
+			if (!retry_alone)
+				return success;
+		}
+	}
+
+	return ews_connection_get_items_real_sync (cnc, pri, ids, default_props, add_props,
+		include_mime, mime_directory, body_type, out_items, progress_fn, progress_data,
+		cancellable, error);
+}
+
 static const gchar *
 ews_delete_type_to_str (EwsDeleteType delete_type)
 {
@@ -4436,7 +5538,7 @@ e_ews_connection_delete_items_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -4514,7 +5616,7 @@ e_ews_connection_delete_item_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -4741,7 +5843,7 @@ e_ews_connection_update_items_sync (EEwsConnection *cnc,
 		return TRUE;
 	}
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -4816,7 +5918,7 @@ e_ews_connection_create_items_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -4995,7 +6097,7 @@ e_ews_connection_resolve_names_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -5302,7 +6404,7 @@ e_ews_connection_expand_dl_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -5365,7 +6467,7 @@ e_ews_connection_update_folder_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -5422,7 +6524,7 @@ e_ews_connection_move_folder_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -5437,6 +6539,58 @@ e_ews_connection_move_folder_sync (EEwsConnection *cnc,
 	return success;
 }
 
+/* Prepends folders from one *ResponseMessage into the 'out_folders' */
+static gboolean
+ews_process_get_folder_response_message (ESoapParameter *subparam,
+					 GSList **out_folders, /* EEwsFolder * */
+					 GError **error)
+{
+	const gchar *name = (const gchar *) subparam->name;
+	GError *local_error = NULL;
+
+	if (!ews_get_response_status (subparam, &local_error)) {
+		if (g_strcmp0 (name, "GetFolderResponseMessage") == 0) {
+			if (out_folders)
+				*out_folders = g_slist_prepend (*out_folders, e_ews_folder_new_from_error (local_error));
+			g_clear_error (&local_error);
+		} else {
+			g_propagate_error (error, local_error);
+			return FALSE;
+		}
+	} else if (E_EWS_CONNECTION_UTILS_CHECK_ELEMENT (name, "GetFolderResponseMessage") && out_folders) {
+		ESoapParameter *node;
+		EEwsFolder *folder;
+
+		for (node = e_soap_parameter_get_first_child_by_name (subparam, "Folders");
+		     node;
+		     node = e_soap_parameter_get_next_child_by_name (subparam, "Folders")) {
+			folder = e_ews_folder_new_from_soap_parameter (node);
+			if (!folder)
+				continue;
+			*out_folders = g_slist_prepend (*out_folders, folder);
+		}
+	}
+
+	return TRUE;
+}
+
+/* Only GetFolderResponseMessage-s are consumed here, any other message
+   is left for e_ews_process_get_folder_response(), which reports the error */
+static gboolean
+ews_get_folder_response_message_cb (ESoapResponse *response,
+				    ESoapParameter *param,
+				    gpointer user_data)
+{
+	StreamedObjects *so = user_data;
+
+	if (g_strcmp0 ((const gchar *) param->name, "GetFolderResponseMessage") != 0)
+		return FALSE;
+
+	streamed_objects_prepare (so, response);
+
+	return ews_process_get_folder_response_message (param, &so->objects, NULL);
+}
+
 static gboolean
 e_ews_process_get_folder_response (EEwsConnection *cnc,
 				   ESoapResponse *response,
@@ -5462,30 +6616,8 @@ e_ews_process_get_folder_response (EEwsConnection *cnc,
 	subparam = e_soap_parameter_get_first_child (param);
 
 	while (subparam != NULL) {
-		const gchar *name = (const gchar *) subparam->name;
-
-		if (!ews_get_response_status (subparam, &local_error)) {
-			if (g_strcmp0 (name, "GetFolderResponseMessage") == 0) {
-				if (out_folders)
-					*out_folders = g_slist_prepend (*out_folders, e_ews_folder_new_from_error (local_error));
-				g_clear_error (&local_error);
-			} else {
-				g_propagate_error (error, local_error);
-				return FALSE;
-			}
-		} else if (E_EWS_CONNECTION_UTILS_CHECK_ELEMENT (name, "GetFolderResponseMessage") && out_folders) {
-			ESoapParameter *node;
-			EEwsFolder *folder;
-
-			for (node = e_soap_parameter_get_first_child_by_name (subparam, "Folders");
-			     node;
-			     node = e_soap_parameter_get_next_child_by_name (subparam, "Folders")) {
-				folder = e_ews_folder_new_from_soap_parameter (node);
-				if (!folder)
-					continue;
-				*out_folders = g_slist_prepend (*out_folders, folder);
-			}
-		}
+		if (!ews_process_get_folder_response_message (subparam, out_folders, error))
+			return FALSE;
 
 		subparam = e_soap_parameter_get_next_child (subparam);
 	}
@@ -5505,6 +6637,7 @@ e_ews_connection_get_folder_sync (EEwsConnection *cnc,
 {
 	ESoapRequest *request;
 	ESoapResponse *response;
+	StreamedObjects streamed = { NULL, NULL };
 	gboolean success;
 
 	g_return_val_if_fail (cnc != NULL, FALSE);
@@ -5537,15 +6670,20 @@ e_ews_connection_get_folder_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	if (out_folders)
+		e_soap_request_set_node_fn (request, "ResponseMessages", ews_get_folder_response_message_cb, &streamed);
+
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
+		streamed_objects_clear (&streamed);
 		g_clear_object (&request);
 		return FALSE;
 	}
 
+	/* The response messages had been consumed while being received */
 	if (out_folders)
-		*out_folders = NULL;
+		*out_folders = streamed_objects_steal (&streamed, response);
 
 	success = e_ews_process_get_folder_response (cnc, response, out_folders, error);
 
@@ -5728,7 +6866,7 @@ e_ews_connection_create_folder_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -5814,7 +6952,7 @@ e_ews_connection_move_items_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -5953,7 +7091,7 @@ e_ews_connection_delete_folder_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -6021,7 +7159,7 @@ e_ews_connection_empty_folder_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -6224,7 +7362,7 @@ e_ews_connection_create_attachments_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -6341,7 +7479,7 @@ e_ews_connection_delete_attachments_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -6487,7 +7625,7 @@ e_ews_connection_get_attachments_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -6761,7 +7899,7 @@ e_ews_connection_get_free_busy_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7005,7 +8143,7 @@ e_ews_connection_get_delegate_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7155,7 +8293,7 @@ e_ews_connection_add_delegate_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7221,7 +8359,7 @@ e_ews_connection_remove_delegate_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7310,7 +8448,7 @@ e_ews_connection_update_delegate_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7426,7 +8564,7 @@ e_ews_connection_get_folder_permissions_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7587,7 +8725,7 @@ e_ews_connection_set_folder_permissions_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7664,7 +8802,7 @@ e_ews_connection_get_password_expiration_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7775,7 +8913,7 @@ e_ews_connection_get_folder_info_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -7913,7 +9051,7 @@ e_ews_connection_find_folder_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -8904,7 +10042,7 @@ e_ews_connection_get_server_time_zones_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -9009,7 +10147,7 @@ e_ews_connection_get_user_photo_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -9187,7 +10325,7 @@ e_ews_connection_get_user_configuration_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -9302,7 +10440,7 @@ e_ews_connection_convert_id_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -9518,7 +10656,7 @@ e_ews_connection_get_user_oof_settings_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -9665,7 +10803,7 @@ e_ews_connection_set_user_oof_settings_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -9781,7 +10919,7 @@ e_ews_connection_subscribe_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -9828,7 +10966,7 @@ e_ews_connection_unsubscribe_sync (EEwsConnection *cnc,
 
 	e_ews_request_write_footer (request);
 
-	response = e_ews_connection_send_request_sync (cnc, request, cancellable, error);
+	response = e_ews_connection_send_request_sync (cnc, pri, request, cancellable, error);
 
 	if (!response) {
 		g_clear_object (&request);
@@ -83,6 +83,11 @@ typedef gboolean(*EEwsStreamingEventsReadCallback)
 typedef void	(*EEwsStreamingEventsFinishedCallback)
 						(gpointer user_data,
 						 const GError *error);
+typedef gboolean(*EEwsDownloadDataCallback)	(gconstpointer buffer,
+						 gsize length,
+						 gpointer user_data,
+						 GCancellable *cancellable,
+						 GError **error);
 
 typedef enum {
 	EWS_SEARCH_AD,
@@ -214,6 +219,14 @@ typedef struct {
 	gsize len;
 } EwsPhotoAttachmentInfo;
 
+typedef struct {
+	gchar *source_uid;
+	gchar *display_name;
+	guint n_acquired; /* how many times it obtained the connection */
+	gint64 first_acquired; /* g_get_real_time() */
+	gint64 last_acquired; /* g_get_real_time() */
+} EEwsClientUsage;
+
 typedef enum {
 	E_EWS_NOTIFICATION_EVENT_COPIED = 0,
 	E_EWS_NOTIFICATION_EVENT_CREATED,
@@ -459,11 +472,26 @@ gboolean	e_ews_connection_get_backoff_enabled
 void		e_ews_connection_set_backoff_enabled
 						(EEwsConnection *cnc,
 						 gboolean enabled);
+gint64		e_ews_connection_get_server_busy_until
+						(EEwsConnection *cnc);
 gboolean	e_ews_connection_get_disconnected_flag
 						(EEwsConnection *cnc);
 void		e_ews_connection_set_disconnected_flag
 						(EEwsConnection *cnc,
 						 gboolean disconnected_flag);
+void		e_ews_connection_get_queue_stats
+						(EEwsConnection *cnc,
+						 gint pri,
+						 guint *out_n_queued,
+						 guint *out_n_running,
+						 guint64 *out_n_dispatched,
+						 gint64 *out_total_wait_usec,
+						 gint64 *out_max_wait_usec);
+void		e_ews_connection_set_coalesce_window
+						(EEwsConnection *cnc,
+						 guint window_ms);
+guint		e_ews_connection_get_coalesce_window
+						(EEwsConnection *cnc);
 gchar *		e_ews_connection_dup_last_subscription_id
 						(EEwsConnection *cnc);
 void		e_ews_connection_set_last_subscription_id
@@ -472,6 +500,9 @@ void		e_ews_connection_set_last_subscription_id
 EEwsConnection *e_ews_connection_find		(const gchar *uri,
 						 CamelEwsSettings *ews_settings);
 GSList *	e_ews_connection_list_existing	(void); /* EEwsConnection * */
+GSList *	e_ews_connection_list_clients_usage /* EEwsClientUsage * */
+						(EEwsConnection *cnc);
+void		e_ews_client_usage_free		(EEwsClientUsage *usage);
 
 gboolean	e_ews_autodiscover_ws_url_sync	(ESource *source,
 						 CamelEwsSettings *settings,
@@ -758,6 +789,15 @@ gboolean	e_ews_connection_download_oal_file_sync
 						 gpointer progress_data,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	e_ews_connection_download_oal_data_sync
+						(EEwsConnection *cnc,
+						 const gchar *oal_uri,
+						 EEwsDownloadDataCallback data_cb,
+						 gpointer data_user_data,
+						 ESoapResponseProgressFn progress_fn,
+						 gpointer progress_data,
+						 GCancellable *cancellable,
+						 GError **error);
 gboolean	e_ews_connection_get_free_busy_sync
 						(EEwsConnection *cnc,
 						 gint pri,
@@ -220,7 +220,7 @@ e_ews_notification_subscribe_folder_sync (EEwsNotification *notification,
 	if (!cnc)
 		return FALSE;
 
-	success = e_ews_connection_subscribe_sync (cnc, G_PRIORITY_DEFAULT, folder_ids, out_subscription_id, cancellable, NULL);
+	success = e_ews_connection_subscribe_sync (cnc, EWS_PRIORITY_MEDIUM, folder_ids, out_subscription_id, cancellable, NULL);
 
 	g_signal_emit (notification, signals[SUBSCRIPTION_ID_CHANGED], 0, success ? *out_subscription_id : NULL, NULL);
 
@@ -246,7 +246,7 @@ e_ews_notification_unsubscribe_folder_sync (EEwsNotification *notification,
 	if (!cnc)
 		return FALSE;
 
-	success = e_ews_connection_unsubscribe_sync (cnc, G_PRIORITY_DEFAULT, subscription_id, cancellable, NULL);
+	success = e_ews_connection_unsubscribe_sync (cnc, EWS_PRIORITY_MEDIUM, subscription_id, cancellable, NULL);
 
 	g_signal_emit (notification, signals[SUBSCRIPTION_ID_CHANGED], 0, NULL, NULL);
 
@@ -498,7 +498,7 @@ e_ews_notification_get_events_sync (EEwsNotification *notification,
 	if (!cnc)
 		return FALSE;
 
-	input_stream = e_ews_connection_prepare_streaming_events_sync (cnc, G_PRIORITY_DEFAULT, subscription_id, &session, &message, cancellable, &local_error);
+	input_stream = e_ews_connection_prepare_streaming_events_sync (cnc, EWS_PRIORITY_MEDIUM, subscription_id, &session, &message, cancellable, &local_error);
 
 	if (input_stream) {
 		GByteArray *chunk_data;
@@ -207,7 +207,7 @@ ews_oof_settings_initable_init (GInitable *initable,
 	g_return_val_if_fail (settings->priv->connection != NULL, FALSE);
 
 	return e_ews_connection_get_user_oof_settings_sync (settings->priv->connection,
-		G_PRIORITY_DEFAULT, settings, cancellable, error);
+		EWS_PRIORITY_MEDIUM, settings, cancellable, error);
 }
 
 static void
@@ -599,7 +599,7 @@ ews_oof_settings_call_submit_sync (EEwsOofSettings *settings,
 	g_return_val_if_fail (cnc != NULL, FALSE);
 
 	return e_ews_connection_set_user_oof_settings_sync (cnc,
-		G_PRIORITY_DEFAULT, sd->state, sd->external_audience, sd->date_start,
+		EWS_PRIORITY_MEDIUM, sd->state, sd->external_audience, sd->date_start,
 		sd->date_end, sd->internal_reply, sd->external_reply,
 		cancellable, error);
 }
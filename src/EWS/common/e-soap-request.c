@@ -37,6 +37,10 @@ struct _ESoapRequestPrivate {
 	gchar *store_node_data_directory;
 	gboolean store_node_data_base64;
 
+	gchar *node_fn_parents;
+	ESoapResponseNodeFn node_fn;
+	gpointer node_fn_data;
+
 	gchar *certificate_pem;
 	GTlsCertificateFlags certificate_errors;
 
@@ -65,6 +69,7 @@ soap_request_finalize (GObject *object)
 	g_clear_pointer (&req->priv->certificate_pem, g_free);
 	g_clear_pointer (&req->priv->store_node_data_nodename, g_free);
 	g_clear_pointer (&req->priv->store_node_data_directory, g_free);
+	g_clear_pointer (&req->priv->node_fn_parents, g_free);
 
 	g_clear_pointer (&req->priv->doc, xmlFreeDoc);
 	g_clear_pointer (&req->priv->action, g_free);
@@ -1073,6 +1078,24 @@ e_soap_request_get_store_node_data (ESoapRequest *req,
 	*out_base64 = req->priv->store_node_data_base64;
 }
 
+/* See e_soap_response_set_node_fn() */
+void
+e_soap_request_set_node_fn (ESoapRequest *req,
+			    const gchar *parent_nodenames,
+			    ESoapResponseNodeFn fn,
+			    gpointer user_data)
+{
+	g_return_if_fail (E_IS_SOAP_REQUEST (req));
+
+	if (g_strcmp0 (req->priv->node_fn_parents, parent_nodenames) != 0) {
+		g_free (req->priv->node_fn_parents);
+		req->priv->node_fn_parents = g_strdup (parent_nodenames);
+	}
+
+	req->priv->node_fn = fn;
+	req->priv->node_fn_data = user_data;
+}
+
 /**
  * e_soap_request_persist:
  * @req: the #ESoapRequest.
@@ -1141,4 +1164,5 @@ e_soap_request_setup_response (ESoapRequest *req,
 	e_soap_response_set_progress_fn (response, req->priv->progress_fn, req->priv->progress_data);
 	e_soap_response_set_store_node_data (response, req->priv->store_node_data_nodename,
 		req->priv->store_node_data_directory, req->priv->store_node_data_base64);
+	e_soap_response_set_node_fn (response, req->priv->node_fn_parents, req->priv->node_fn, req->priv->node_fn_data);
 }
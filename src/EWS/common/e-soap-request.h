@@ -152,6 +152,10 @@ void		e_soap_request_get_store_node_data
 						 const gchar **out_nodename,
 						 const gchar **out_directory,
 						 gboolean *out_base64);
+void		e_soap_request_set_node_fn	(ESoapRequest *req,
+						 const gchar *parent_nodenames,
+						 ESoapResponseNodeFn fn,
+						 gpointer user_data);
 void		e_soap_request_set_custom_body	(ESoapRequest *req,
 						 const gchar *content_type,
 						 gconstpointer body,
@@ -8,8 +8,10 @@
 #include <libedataserver/eds-version.h>
 #include <libedataserver/libedataserver.h>
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <libxml/tree.h>
 #include <libsoup/soup.h>
 #include "e-soap-response.h"
@@ -27,7 +29,7 @@ struct _ESoapResponsePrivate {
 	xmlParserCtxtPtr ctxt;
 
 	/* Content stealing */
-	gchar *steal_node;
+	gchar **steal_nodes;
 	gchar *steal_dir;
 	gboolean steal_base64;
 
@@ -35,9 +37,18 @@ struct _ESoapResponsePrivate {
 	guint steal_b64_save;
 	gint steal_fd;
 
+	/* Decoded data waiting to be written into the steal_fd */
+	guchar *steal_buffer;
+	gsize steal_buffer_len;
+
 	/* Progress callbacks */
 	ESoapResponseProgressFn progress_fn;
 	gpointer progress_data;
+
+	/* Streamed nodes */
+	gchar **node_parents;
+	ESoapResponseNodeFn node_fn;
+	gpointer node_data;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (ESoapResponse, e_soap_response, G_TYPE_OBJECT)
@@ -51,6 +62,49 @@ soup_xml_real_node (xmlNode *node)
 	return node;
 }
 
+/* Writes are coalesced into chunks of this size */
+#define STEAL_BUFFER_SIZE (256 * 1024)
+
+static void
+soap_response_flush_steal_buffer (ESoapResponse *response)
+{
+	const guchar *data = response->priv->steal_buffer;
+	gsize len = response->priv->steal_buffer_len;
+
+	response->priv->steal_buffer_len = 0;
+
+	if (response->priv->steal_fd == -1)
+		return;
+
+	while (len > 0) {
+		gssize written;
+
+		written = write (response->priv->steal_fd, data, len);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			g_warning ("%s: Failed to write streaming data to file: %s", G_STRFUNC, g_strerror (errno));
+			break;
+		}
+
+		data += written;
+		len -= written;
+	}
+}
+
+static void
+soap_response_close_steal_fd (ESoapResponse *response)
+{
+	if (response->priv->steal_fd == -1)
+		return;
+
+	soap_response_flush_steal_buffer (response);
+
+	close (response->priv->steal_fd);
+	response->priv->steal_fd = -1;
+}
+
 static void
 soap_response_finalize (GObject *object)
 {
@@ -65,11 +119,12 @@ soap_response_finalize (GObject *object)
 		xmlFreeParserCtxt (resp->priv->ctxt);
 	}
 
-	g_free (resp->priv->steal_node);
-	g_free (resp->priv->steal_dir);
+	soap_response_close_steal_fd (resp);
 
-	if (resp->priv->steal_fd != -1)
-		close (resp->priv->steal_fd);
+	g_strfreev (resp->priv->steal_nodes);
+	g_free (resp->priv->steal_dir);
+	g_free (resp->priv->steal_buffer);
+	g_strfreev (resp->priv->node_parents);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_soap_response_parent_class)->finalize (object);
@@ -286,34 +341,37 @@ soap_sax_startElementNs (gpointer _ctxt,
 	xmlParserCtxt *ctxt = _ctxt;
 	ESoapResponse *response = ctxt->_private;
 	gchar *fname;
+	gint ii;
 
 	xmlSAX2StartElementNs (
 		ctxt, localname, prefix, uri, nb_namespaces,
 		namespaces, nb_attributes, nb_defaulted,
 		attributes);
 
-	/* steal_node can contain multiple node name separated by " " */
-	if (response->priv->steal_node && *response->priv->steal_node) {
-		gchar **prop = g_strsplit (response->priv->steal_node, " ", 0);
-		gint i = 0;
-		gboolean isnode = FALSE;
+	if (!response->priv->steal_nodes)
+		return;
 
-		while (prop[i]) {
-			if (strcmp ((const gchar *) localname, prop[i]) == 0) {
-				isnode = TRUE;
-				break;
-			}
-			i++;
-		}
-		g_strfreev (prop);
+	for (ii = 0; response->priv->steal_nodes[ii]; ii++) {
+		if (strcmp ((const gchar *) localname, response->priv->steal_nodes[ii]) == 0)
+			break;
+	}
 
-		if (!isnode) return;
-	} else
+	if (!response->priv->steal_nodes[ii])
 		return;
 
+	/* Just in case the previous node was not closed */
+	soap_response_close_steal_fd (response);
+
 	fname = g_build_filename (response->priv->steal_dir, "XXXXXX", NULL);
 	response->priv->steal_fd = g_mkstemp (fname);
 	if (response->priv->steal_fd != -1) {
+		response->priv->steal_b64_state = 0;
+		response->priv->steal_b64_save = 0;
+		response->priv->steal_buffer_len = 0;
+
+		if (!response->priv->steal_buffer)
+			response->priv->steal_buffer = g_malloc (STEAL_BUFFER_SIZE);
+
 		if (response->priv->steal_base64) {
 			gchar *enc = g_base64_encode ((guchar *) fname, strlen (fname));
 			xmlSAX2Characters (ctxt, (xmlChar *) enc, strlen (enc));
@@ -328,6 +386,23 @@ soap_sax_startElementNs (gpointer _ctxt,
 	g_free (fname);
 }
 
+static gboolean
+soap_response_is_node_parent (ESoapResponse *response,
+			      xmlNodePtr parent)
+{
+	gint ii;
+
+	if (!parent || parent->type != XML_ELEMENT_NODE || !parent->name)
+		return FALSE;
+
+	for (ii = 0; response->priv->node_parents[ii]; ii++) {
+		if (strcmp ((const gchar *) parent->name, response->priv->node_parents[ii]) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 static void
 soap_sax_endElementNs (gpointer _ctxt,
                        const xmlChar *localname,
@@ -336,12 +411,21 @@ soap_sax_endElementNs (gpointer _ctxt,
 {
 	xmlParserCtxt *ctxt = _ctxt;
 	ESoapResponse *response = ctxt->_private;
+	xmlNodePtr node;
+
+	soap_response_close_steal_fd (response);
+
+	/* The node being closed; the ctxt->node is its parent after the call below */
+	node = ctxt->node;
 
-	if (response->priv->steal_fd != -1) {
-		close (response->priv->steal_fd);
-		response->priv->steal_fd = -1;
-	}
 	xmlSAX2EndElementNs (ctxt, localname, prefix, uri);
+
+	if (response->priv->node_fn && node && node != ctxt->node &&
+	    soap_response_is_node_parent (response, node->parent) &&
+	    response->priv->node_fn (response, node, response->priv->node_data)) {
+		xmlUnlinkNode (node);
+		xmlFreeNode (node);
+	}
 }
 
 static void
@@ -352,51 +436,82 @@ soap_sax_characters (gpointer _ctxt,
 	xmlParserCtxt *ctxt = _ctxt;
 	ESoapResponse *response = ctxt->_private;
 
-	if (response->priv->steal_fd == -1)
+	if (response->priv->steal_fd == -1) {
 		xmlSAX2Characters (ctxt, ch, len);
-	else if (!response->priv->steal_base64) {
-		if (write (response->priv->steal_fd, (const gchar *) ch, len) != len) {
-		write_err:
-			/* Handle error better */
-			g_warning ("Failed to write streaming data to file");
-		}
-	} else {
-		guchar *bdata = g_malloc ((len * 3 / 4) + 3);
-		gsize blen;
-
-		blen = g_base64_decode_step (
-			(const gchar *) ch, len,
-			bdata, &response->priv->steal_b64_state,
-			&response->priv->steal_b64_save);
-		if (write (response->priv->steal_fd, (const gchar *) bdata, blen) != blen) {
-			g_free (bdata);
-			goto write_err;
+		return;
+	}
+
+	while (len > 0) {
+		gsize avail, chunk;
+
+		avail = STEAL_BUFFER_SIZE - response->priv->steal_buffer_len;
+
+		if (response->priv->steal_base64) {
+			/* g_base64_decode_step() writes at most (len / 4) * 3 + 3 bytes */
+			if (avail < 7) {
+				soap_response_flush_steal_buffer (response);
+				continue;
+			}
+
+			chunk = MIN ((gsize) len, (avail - 3) / 3 * 4);
+
+			response->priv->steal_buffer_len += g_base64_decode_step (
+				(const gchar *) ch, chunk,
+				response->priv->steal_buffer + response->priv->steal_buffer_len,
+				&response->priv->steal_b64_state,
+				&response->priv->steal_b64_save);
+		} else {
+			if (!avail) {
+				soap_response_flush_steal_buffer (response);
+				continue;
+			}
+
+			chunk = MIN ((gsize) len, avail);
+
+			memcpy (response->priv->steal_buffer + response->priv->steal_buffer_len, ch, chunk);
+			response->priv->steal_buffer_len += chunk;
 		}
-		g_free (bdata);
+
+		ch += chunk;
+		len -= chunk;
 	}
 }
 
 #define BUFFER_SIZE 16384
 
+/**
+ * e_soap_response_xmldoc_from_stream_sync:
+ * @response: the %ESoapResponse
+ * @response_data: a #GInputStream with the response body
+ * @response_size: expected size of the @response_data, or 0 when not known
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Parses the @response_data into an XML document the same way
+ * as e_soap_response_xmldoc_from_message_sync(), including the settings
+ * from e_soap_response_set_store_node_data(), e_soap_response_set_progress_fn()
+ * and e_soap_response_set_node_fn(). The @response_size is used only
+ * for the progress reporting.
+ *
+ * Returns: (transfer full) (nullable): the parsed XML document, or %NULL on error.
+ *    Free it with xmlFreeDoc(), when no longer needed.
+ **/
 xmlDoc *
-e_soap_response_xmldoc_from_message_sync (ESoapResponse *response,
-					  SoupMessage *msg,
-					  GInputStream *response_data,
-					  GCancellable *cancellable,
-					  GError **error)
+e_soap_response_xmldoc_from_stream_sync (ESoapResponse *response,
+					 GInputStream *response_data,
+					 gsize response_size,
+					 GCancellable *cancellable,
+					 GError **error)
 {
-	const gchar *size;
 	xmlDoc *xmldoc = NULL;
 	gboolean success;
 	gpointer buffer;
-	gsize response_size = 0;
 	gsize response_received = 0;
 	gsize progress_percent = 0;
 	gsize nread = 0;
 
-	g_return_val_if_fail (E_IS_SOAP_RESPONSE (response), FALSE);
-	g_return_val_if_fail (SOUP_IS_MESSAGE (msg), FALSE);
-	g_return_val_if_fail (G_IS_INPUT_STREAM (response_data), FALSE);
+	g_return_val_if_fail (E_IS_SOAP_RESPONSE (response), NULL);
+	g_return_val_if_fail (G_IS_INPUT_STREAM (response_data), NULL);
 
 	/* Discard the existing context, if there is one, and start again */
 	if (response->priv->ctxt) {
@@ -406,20 +521,7 @@ e_soap_response_xmldoc_from_message_sync (ESoapResponse *response,
 		response->priv->ctxt = NULL;
 	}
 
-	if (response->priv->steal_fd != -1) {
-		close (response->priv->steal_fd);
-		response->priv->steal_fd = -1;
-	}
-
-	if (!SOUP_STATUS_IS_SUCCESSFUL (soup_message_get_status (msg))) {
-		g_set_error_literal (error, E_SOUP_SESSION_ERROR, soup_message_get_status (msg), soup_message_get_reason_phrase (msg));
-		return NULL;
-	}
-
-	size = soup_message_headers_get_one (soup_message_get_response_headers (msg), "Content-Length");
-
-	if (size)
-		response_size = g_ascii_strtoll (size, NULL, 10);
+	soap_response_close_steal_fd (response);
 
 	buffer = g_malloc (BUFFER_SIZE);
 
@@ -470,14 +572,38 @@ e_soap_response_xmldoc_from_message_sync (ESoapResponse *response,
 		response->priv->ctxt = NULL;
 	}
 
-	if (response->priv->steal_fd != -1) {
-		close (response->priv->steal_fd);
-		response->priv->steal_fd = -1;
-	}
+	soap_response_close_steal_fd (response);
 
 	return xmldoc;
 }
 
+xmlDoc *
+e_soap_response_xmldoc_from_message_sync (ESoapResponse *response,
+					  SoupMessage *msg,
+					  GInputStream *response_data,
+					  GCancellable *cancellable,
+					  GError **error)
+{
+	const gchar *size;
+	gsize response_size = 0;
+
+	g_return_val_if_fail (E_IS_SOAP_RESPONSE (response), FALSE);
+	g_return_val_if_fail (SOUP_IS_MESSAGE (msg), FALSE);
+	g_return_val_if_fail (G_IS_INPUT_STREAM (response_data), FALSE);
+
+	if (!SOUP_STATUS_IS_SUCCESSFUL (soup_message_get_status (msg))) {
+		g_set_error_literal (error, E_SOUP_SESSION_ERROR, soup_message_get_status (msg), soup_message_get_reason_phrase (msg));
+		return NULL;
+	}
+
+	size = soup_message_headers_get_one (soup_message_get_response_headers (msg), "Content-Length");
+
+	if (size)
+		response_size = g_ascii_strtoll (size, NULL, 10);
+
+	return e_soap_response_xmldoc_from_stream_sync (response, response_data, response_size, cancellable, error);
+}
+
 gboolean
 e_soap_response_from_message_sync (ESoapResponse *response,
 				   SoupMessage *msg,
@@ -523,13 +649,52 @@ e_soap_response_set_store_node_data (ESoapResponse *response,
 				     gboolean base64)
 {
 	g_return_if_fail (E_IS_SOAP_RESPONSE (response));
-	g_return_if_fail (response->priv->steal_node == NULL);
+	g_return_if_fail (response->priv->steal_nodes == NULL);
 
-	response->priv->steal_node = g_strdup (nodename);
+	/* nodename can contain multiple node names separated by " " */
+	if (nodename && *nodename)
+		response->priv->steal_nodes = g_strsplit (nodename, " ", 0);
 	response->priv->steal_dir = g_strdup (directory);
 	response->priv->steal_base64 = base64;
 }
 
+/**
+ * e_soap_response_set_node_fn:
+ * @response: the %ESoapResponse
+ * @parent_nodenames: (nullable): space-separated names of the parent nodes
+ * @fn: (nullable): callback function to call for each complete child node
+ * @user_data: user data passed to @fn
+ *
+ * Requests that @fn is called as soon as any element, whose parent element
+ * name is one of the @parent_nodenames, is fully parsed, while the rest
+ * of the response is still being received. When the @fn returns %TRUE,
+ * the node is consumed and it is removed from the response document,
+ * thus the response does not hold all such nodes in the memory at once.
+ *
+ * The @fn is called from the thread, which parses the response.
+ *
+ * It is used only with e_soap_response_from_message_sync().
+ */
+void
+e_soap_response_set_node_fn (ESoapResponse *response,
+			     const gchar *parent_nodenames,
+			     ESoapResponseNodeFn fn,
+			     gpointer user_data)
+{
+	g_return_if_fail (E_IS_SOAP_RESPONSE (response));
+
+	g_clear_pointer (&response->priv->node_parents, g_strfreev);
+
+	if (parent_nodenames && *parent_nodenames && fn) {
+		response->priv->node_parents = g_strsplit (parent_nodenames, " ", -1);
+		response->priv->node_fn = fn;
+		response->priv->node_data = user_data;
+	} else {
+		response->priv->node_fn = NULL;
+		response->priv->node_data = NULL;
+	}
+}
+
 /**
  * e_soap_response_set_progress_fn:
  * @response: the %ESoapResponse
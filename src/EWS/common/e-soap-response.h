@@ -38,6 +38,13 @@ typedef struct _ESoapResponse ESoapResponse;
 typedef struct _ESoapResponseClass ESoapResponseClass;
 typedef struct _ESoapResponsePrivate ESoapResponsePrivate;
 
+typedef xmlNode ESoapParameter;
+
+/* Returns TRUE, when the node had been consumed and can be freed */
+typedef gboolean (* ESoapResponseNodeFn) (ESoapResponse *response,
+					  ESoapParameter *param,
+					  gpointer user_data);
+
 struct _ESoapResponse {
 	GObject parent;
 	ESoapResponsePrivate *priv;
@@ -69,6 +76,12 @@ xmlDoc *	e_soap_response_xmldoc_from_message_sync
 						 GInputStream *response_data,
 						 GCancellable *cancellable,
 						 GError **error);
+xmlDoc *	e_soap_response_xmldoc_from_stream_sync
+						(ESoapResponse *response,
+						 GInputStream *response_data,
+						 gsize response_size,
+						 GCancellable *cancellable,
+						 GError **error);
 /* used only with e_soap_response_from_message_sync() */
 void		e_soap_response_set_store_node_data
 						(ESoapResponse *response,
@@ -79,12 +92,15 @@ void		e_soap_response_set_store_node_data
 void		e_soap_response_set_progress_fn	(ESoapResponse *response,
 						 ESoapResponseProgressFn fn,
 						 gpointer object);
+/* used only with e_soap_response_from_message_sync() */
+void		e_soap_response_set_node_fn	(ESoapResponse *response,
+						 const gchar *parent_nodenames,
+						 ESoapResponseNodeFn fn,
+						 gpointer user_data);
 const gchar *	e_soap_response_get_method_name	(ESoapResponse *response);
 void		e_soap_response_set_method_name	(ESoapResponse *response,
 						 const gchar *method_name);
 
-typedef xmlNode ESoapParameter;
-
 const gchar *	e_soap_parameter_get_name	(ESoapParameter *param);
 gint		e_soap_parameter_get_int_value	(ESoapParameter *param);
 guint64		e_soap_parameter_get_uint64_value
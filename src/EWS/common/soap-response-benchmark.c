@@ -0,0 +1,195 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* Measures how quickly a GetItem response with MimeContent is parsed and
+   the MimeContent stored into files. Either pass a recorded response body,
+   or nothing, in which case a response with the given size (in MB) is
+   generated, with messages of about 5 MB each. */
+
+#include "evolution-ews-config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "e-soap-response.h"
+
+#define MESSAGE_SIZE (5 * 1024 * 1024)
+
+static gboolean
+write_response (const gchar *filename,
+		guint size_mb,
+		GError **error)
+{
+	GString *response;
+	guchar *message;
+	gchar *encoded;
+	guint ii, n_messages;
+	gboolean success;
+
+	n_messages = MAX (1, size_mb * 1024 * 1024 / MESSAGE_SIZE * 3 / 4);
+
+	message = g_malloc (MESSAGE_SIZE);
+	for (ii = 0; ii < MESSAGE_SIZE; ii++) {
+		message[ii] = 32 + (ii * 7) % 95;
+	}
+
+	encoded = g_base64_encode (message, MESSAGE_SIZE);
+	g_free (message);
+
+	response = g_string_new (
+		"<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+		"<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+		"<s:Body>"
+		"<m:GetItemResponse xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\""
+		" xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+		"<m:ResponseMessages>");
+
+	for (ii = 0; ii < n_messages; ii++) {
+		g_string_append_printf (response,
+			"<m:GetItemResponseMessage ResponseClass=\"Success\">"
+			"<m:ResponseCode>NoError</m:ResponseCode>"
+			"<m:Items><t:Message>"
+			"<t:MimeContent CharacterSet=\"UTF-8\">%s</t:MimeContent>"
+			"<t:ItemId Id=\"item-%u\" ChangeKey=\"ck\"/>"
+			"</t:Message></m:Items>"
+			"</m:GetItemResponseMessage>", encoded, ii);
+	}
+
+	g_string_append (response,
+		"</m:ResponseMessages>"
+		"</m:GetItemResponse>"
+		"</s:Body>"
+		"</s:Envelope>");
+
+	success = g_file_set_contents (filename, response->str, response->len, error);
+
+	g_string_free (response, TRUE);
+	g_free (encoded);
+
+	return success;
+}
+
+/* Removes the files stored in the 'tmpdir', except of the 'keep_filename';
+   returns how many had been removed */
+static guint
+remove_stored_files (const gchar *tmpdir,
+		     const gchar *keep_filename)
+{
+	GDir *dir;
+	const gchar *name;
+	guint n_files = 0;
+
+	dir = g_dir_open (tmpdir, 0, NULL);
+	while (name = dir ? g_dir_read_name (dir) : NULL, name) {
+		gchar *filename = g_build_filename (tmpdir, name, NULL);
+
+		if (g_strcmp0 (filename, keep_filename) != 0) {
+			n_files++;
+			g_unlink (filename);
+		}
+
+		g_free (filename);
+	}
+	g_clear_pointer (&dir, g_dir_close);
+
+	return n_files;
+}
+
+gint
+main (gint argc,
+      gchar *argv[])
+{
+	ESoapResponse *response = NULL;
+	GFileInputStream *input_stream = NULL;
+	GFile *file = NULL;
+	GTimer *timer = NULL;
+	xmlDoc *xmldoc;
+	GStatBuf st;
+	GError *error = NULL;
+	gchar *response_filename = NULL;
+	gchar *tmpdir;
+	goffset response_size = 0;
+	guint64 size_mb = 50;
+	guint n_files;
+	gdouble elapsed;
+	gboolean generated = FALSE;
+	gboolean success = FALSE;
+
+	if (argc > 2 || (argc == 2 && !g_file_test (argv[1], G_FILE_TEST_IS_REGULAR) &&
+	    !g_ascii_string_to_unsigned (argv[1], 10, 1, G_MAXUINT / (1024 * 1024), &size_mb, NULL))) {
+		g_print ("Usage: %s [response-file | size-in-MB]\n", argv[0]);
+		return 1;
+	}
+
+	tmpdir = g_dir_make_tmp ("soap-response-benchmark-XXXXXX", &error);
+	if (!tmpdir) {
+		g_printerr ("Failed to create temporary directory: %s\n", error->message);
+		g_clear_error (&error);
+		return 1;
+	}
+
+	if (argc == 2 && g_file_test (argv[1], G_FILE_TEST_IS_REGULAR)) {
+		response_filename = g_strdup (argv[1]);
+	} else {
+		response_filename = g_build_filename (tmpdir, "response.xml", NULL);
+		generated = TRUE;
+
+		if (!write_response (response_filename, (guint) size_mb, &error)) {
+			g_printerr ("Failed to write response: %s\n", error->message);
+			g_clear_error (&error);
+			goto exit;
+		}
+	}
+
+	file = g_file_new_for_path (response_filename);
+	input_stream = g_file_read (file, NULL, &error);
+	if (!input_stream) {
+		g_printerr ("Failed to open '%s': %s\n", response_filename, error->message);
+		g_clear_error (&error);
+		goto exit;
+	}
+
+	if (g_stat (response_filename, &st) == 0)
+		response_size = st.st_size;
+
+	response = e_soap_response_new ();
+	e_soap_response_set_store_node_data (response, "MimeContent", tmpdir, TRUE);
+
+	timer = g_timer_new ();
+
+	xmldoc = e_soap_response_xmldoc_from_stream_sync (response, G_INPUT_STREAM (input_stream), response_size, NULL, &error);
+
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	success = xmldoc != NULL;
+
+	if (!success) {
+		g_printerr ("Failed to parse response: %s\n", error ? error->message : "Unknown error");
+		g_clear_error (&error);
+	} else {
+		xmlFreeDoc (xmldoc);
+	}
+
+	n_files = remove_stored_files (tmpdir, response_filename);
+
+	g_print ("Parsed %" G_GOFFSET_FORMAT " bytes, stored %u files in %.3f s (%.1f MB/s)\n",
+		response_size, n_files, elapsed,
+		elapsed > 0 ? response_size / elapsed / (1024 * 1024) : 0.0);
+
+ exit:
+	/* Remove also what a failed write could leave behind */
+	remove_stored_files (tmpdir, generated ? NULL : response_filename);
+	g_rmdir (tmpdir);
+
+	g_clear_pointer (&timer, g_timer_destroy);
+	g_clear_object (&response);
+	g_clear_object (&input_stream);
+	g_clear_object (&file);
+	g_free (response_filename);
+	g_free (tmpdir);
+
+	return success ? 0 : 1;
+}
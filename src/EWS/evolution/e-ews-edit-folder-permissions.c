@@ -190,7 +190,7 @@ write_folder_permissions_thread (GObject *dialog,
 
 	e_ews_connection_set_folder_permissions_sync (
 		widgets->conn,
-		G_PRIORITY_DEFAULT, widgets->folder_id, widgets->folder_type, permissions, cancellable, perror);
+		EWS_PRIORITY_MEDIUM, widgets->folder_id, widgets->folder_type, permissions, cancellable, perror);
 }
 
 static void
@@ -687,11 +687,11 @@ read_folder_permissions_thread (GObject *dialog,
 
 	if (e_ews_connection_get_folder_permissions_sync (
 		widgets->conn,
-		G_PRIORITY_DEFAULT, widgets->folder_id, ppermissions, cancellable, perror)) {
+		EWS_PRIORITY_MEDIUM, widgets->folder_id, ppermissions, cancellable, perror)) {
 		EEwsFolder *folder = NULL;
 
 		e_ews_connection_get_folder_info_sync (widgets->conn,
-			G_PRIORITY_DEFAULT, NULL, widgets->folder_id,
+			EWS_PRIORITY_MEDIUM, NULL, widgets->folder_id,
 			&folder, cancellable, NULL);
 
 		if (folder) {
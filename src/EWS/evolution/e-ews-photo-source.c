@@ -81,7 +81,7 @@ e_ews_photo_source_pool_thread_func_cb (gpointer data,
 
 		g_hash_table_insert (covered_uris, g_strdup (uri), NULL);
 
-		if (e_ews_connection_get_user_photo_sync (cnc, G_PRIORITY_LOW, email_address, E_EWS_SIZE_REQUESTED_48X48,
+		if (e_ews_connection_get_user_photo_sync (cnc, EWS_PRIORITY_LOW, email_address, E_EWS_SIZE_REQUESTED_48X48,
 			&picture_data, cancellable, local_error ? NULL : &local_error) && picture_data) {
 			gsize len = 0;
 			guchar *decoded;
@@ -305,7 +305,7 @@ check_foreign_folder_thread (GObject *with_object,
 		fbdata.period_end = fbdata.period_start + (60 * 60);
 		fbdata.user_mails = g_slist_prepend (NULL, cffd->email);
 
-		success = e_ews_connection_get_free_busy_sync (conn, G_PRIORITY_DEFAULT,
+		success = e_ews_connection_get_free_busy_sync (conn, EWS_PRIORITY_MEDIUM,
 			e_ews_cal_utils_prepare_free_busy_request, &fbdata,
 			&free_busy, cancellable, perror);
 
@@ -332,7 +332,7 @@ check_foreign_folder_thread (GObject *with_object,
 		fid.change_key = NULL;
 		fid.is_distinguished_id = cffd->use_foldername != NULL || (cffd->orig_foldername && strlen (cffd->orig_foldername) < 40);
 
-		if (!e_ews_connection_get_folder_info_sync (conn, G_PRIORITY_DEFAULT,
+		if (!e_ews_connection_get_folder_info_sync (conn, EWS_PRIORITY_MEDIUM,
 			cffd->email, &fid, &folder, cancellable, &local_error)) {
 			if (!local_error ||
 			    g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_ITEMNOTFOUND) ||
@@ -812,7 +812,7 @@ e_ews_subscribe_foreign_folder_resolve_name_sync (EEwsConnection *cnc,
 	gboolean includes_last_item = FALSE;
 	GError *local_error = NULL;
 
-	if (!e_ews_connection_resolve_names_sync (cnc, G_PRIORITY_DEFAULT,
+	if (!e_ews_connection_resolve_names_sync (cnc, EWS_PRIORITY_MEDIUM,
 		name, EWS_SEARCH_AD, NULL, FALSE,
 		&includes_last_item, &mailboxes, NULL,
 		cancellable, &local_error)) {
@@ -868,7 +868,7 @@ e_ews_subscribe_foreign_folder_resolve_name_sync (EEwsConnection *cnc,
 		if (out_display_name && e_ews_looks_like_guid (*out_display_name)) {
 			GSList *contacts = NULL;
 
-			if (e_ews_connection_resolve_names_sync (cnc, G_PRIORITY_DEFAULT,
+			if (e_ews_connection_resolve_names_sync (cnc, EWS_PRIORITY_MEDIUM,
 				*out_display_name, EWS_SEARCH_AD, NULL, TRUE,
 				&includes_last_item, &mailboxes, &contacts,
 				cancellable, NULL)) {
@@ -683,7 +683,7 @@ get_folder_permissions_sync (EEwsConnection *conn,
 	folder_id = e_ews_folder_id_new (fid, change_key, FALSE);
 
 	res = e_ews_connection_get_folder_permissions_sync (
-		conn, G_PRIORITY_DEFAULT, folder_id, permissions, cancellable, error);
+		conn, EWS_PRIORITY_MEDIUM, folder_id, permissions, cancellable, error);
 
 	e_ews_folder_id_free (folder_id);
 	g_free (change_key);
@@ -1154,17 +1154,17 @@ mail_config_ews_delegates_page_submit_thread (GTask *task,
 	GError *local_error = NULL;
 	
 	if (sd->deliver_to_changed || sd->updated) {
-		success = e_ews_connection_update_delegate_sync (sd->cnc, G_PRIORITY_DEFAULT, NULL, sd->deliver_to, sd->updated,
+		success = e_ews_connection_update_delegate_sync (sd->cnc, EWS_PRIORITY_MEDIUM, NULL, sd->deliver_to, sd->updated,
 			cancellable, &local_error);
 	}
 
 	if (success && sd->removed) {
-		success = e_ews_connection_remove_delegate_sync (sd->cnc, G_PRIORITY_DEFAULT, NULL, sd->removed,
+		success = e_ews_connection_remove_delegate_sync (sd->cnc, EWS_PRIORITY_MEDIUM, NULL, sd->removed,
 			cancellable, &local_error);
 	}
 
 	if (success && sd->added) {
-		success = e_ews_connection_add_delegate_sync (sd->cnc, G_PRIORITY_DEFAULT, NULL, sd->added,
+		success = e_ews_connection_add_delegate_sync (sd->cnc, EWS_PRIORITY_MEDIUM, NULL, sd->added,
 			cancellable, &local_error);
 	}
 
@@ -1354,7 +1354,7 @@ mail_config_ews_delegates_page_try_credentials_sync (EEwsConnection *connection,
 	g_clear_object (&async_context->page->priv->connection);
 	e_ews_connection_set_mailbox (connection, mailbox);
 
-	if (e_ews_connection_get_delegate_sync (connection, G_PRIORITY_DEFAULT, NULL, TRUE,
+	if (e_ews_connection_get_delegate_sync (connection, EWS_PRIORITY_MEDIUM, NULL, TRUE,
 		&deliver_to, &delegates, cancellable, &local_error) ||
 	    g_error_matches (local_error, EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_ITEMNOTFOUND)) {
 		if (local_error) {
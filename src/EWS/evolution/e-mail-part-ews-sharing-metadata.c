@@ -63,7 +63,7 @@ ews_sharing_metadata_subscribe_thread (EAlertSinkThreadJobData *job_data,
 
 	email = e_named_parameters_get (sd->params, "email");
 
-	if (!e_ews_connection_convert_id_sync (sd->cnc, G_PRIORITY_DEFAULT, email,
+	if (!e_ews_connection_convert_id_sync (sd->cnc, EWS_PRIORITY_MEDIUM, email,
 		e_named_parameters_get (sd->params, "folder_id"),
 		"HexEntryId", "EwsId", &folder_id, cancellable, error)) {
 		return;
@@ -73,7 +73,7 @@ ews_sharing_metadata_subscribe_thread (EAlertSinkThreadJobData *job_data,
 	fid.change_key = NULL;
 	fid.is_distinguished_id = FALSE;
 
-	if (e_ews_connection_get_folder_info_sync (sd->cnc, G_PRIORITY_DEFAULT, email, &fid, &folder, cancellable, &local_error)) {
+	if (e_ews_connection_get_folder_info_sync (sd->cnc, EWS_PRIORITY_MEDIUM, email, &fid, &folder, cancellable, &local_error)) {
 		if (e_ews_folder_get_folder_type (folder) == E_EWS_FOLDER_TYPE_UNKNOWN) {
 			local_error = g_error_new_literal (EWS_CONNECTION_ERROR, EWS_CONNECTION_ERROR_FOLDERNOTFOUND,
 				_("Cannot add folder, cannot determine folder’s type"));
@@ -31,6 +31,9 @@
 #define EC_ERROR_EX(_code,_msg) e_client_error_create (_code, _msg)
 #define EBC_ERROR_EX(_code,_msg) e_book_client_error_create (_code, _msg)
 
+/* The next link of the interrupted delta sync, to continue from */
+#define EBB_M365_DELTA_NEXT_LINK_KEY "m365-delta-next-link"
+
 #define LOCK(_bb) g_rec_mutex_lock (&_bb->priv->property_lock)
 #define UNLOCK(_bb) g_rec_mutex_unlock (&_bb->priv->property_lock)
 
@@ -2118,7 +2121,9 @@ ebb_m365_disconnect_sync (EBookMetaBackend *meta_backend,
 typedef struct _ObjectsDeltaData {
 	EBookBackendM365 *bbm365;
 	ECache *cache;
-	GPtrArray *ids;
+	GPtrArray *objects; /* EM365Contact *, complete objects from the delta */
+	GPtrArray *ids; /* gchar *, to be downloaded */
+	GHashTable *known_uids; /* gchar *uid ~> NULL; loaded on demand */
 	GSList **out_created_objects;
 	GSList **out_modified_objects;
 	GSList **out_removed_objects;
@@ -2151,6 +2156,11 @@ ebb_m365_get_objects_delta_cb (EM365Connection *cnc,
 		if (e_m365_delta_is_removed_object (contact)) {
 			*(odd->out_removed_objects) = g_slist_prepend (*(odd->out_removed_objects),
 				e_book_meta_backend_info_new (id, NULL, NULL, NULL));
+
+			if (odd->known_uids)
+				g_hash_table_remove (odd->known_uids, id);
+		} else if (e_m365_connection_util_delta_object_is_complete (odd->bbm365->priv->folder_kind, contact)) {
+			g_ptr_array_add (odd->objects, json_object_ref (contact));
 		} else {
 			g_ptr_array_add (odd->ids, g_strdup (id));
 		}
@@ -2159,6 +2169,155 @@ ebb_m365_get_objects_delta_cb (EM365Connection *cnc,
 	return TRUE;
 }
 
+/* Converts the 'contact' and adds it into the 'odd->out_created_objects'
+   or the 'odd->out_modified_objects' */
+static void
+ebb_m365_add_contact_locked (ObjectsDeltaData *odd,
+			     EM365Contact *contact,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	GSList **out_slist;
+	EContact *vcard;
+	gchar *object;
+	const gchar *id = e_m365_contact_get_id (contact);
+
+	if (!id)
+		return;
+
+	/* One query for all the known contacts, instead of one per changed contact */
+	if (!odd->known_uids) {
+		GSList *uids = NULL, *link;
+
+		odd->known_uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+		if (e_cache_get_uids (odd->cache, E_CACHE_INCLUDE_DELETED, &uids, NULL, cancellable, NULL)) {
+			for (link = uids; link; link = g_slist_next (link)) {
+				if (link->data)
+					g_hash_table_add (odd->known_uids, g_strdup (link->data));
+			}
+		}
+
+		g_slist_free_full (uids, g_free);
+	}
+
+	if (g_hash_table_contains (odd->known_uids, id)) {
+		out_slist = odd->out_modified_objects;
+	} else {
+		out_slist = odd->out_created_objects;
+		g_hash_table_add (odd->known_uids, g_strdup (id));
+	}
+
+	vcard = ebb_m365_json_contact_to_vcard (odd->bbm365, contact, odd->bbm365->priv->cnc, &object, cancellable, error);
+
+	g_clear_object (&vcard);
+
+	if (!g_cancellable_is_cancelled (cancellable))
+		g_warn_if_fail (object != NULL);
+
+	if (object) {
+		EBookMetaBackendInfo *nfo;
+
+		nfo = e_book_meta_backend_info_new (id,
+			e_m365_contact_get_change_key (contact),
+			object, NULL);
+
+		nfo->extra = object; /* assumes ownership, to avoid unnecessary re-allocation */
+
+		*out_slist = g_slist_prepend (*out_slist, nfo);
+	}
+}
+
+/* Converts the 'odd->objects' and downloads the objects of the 'odd->ids', or the people,
+   and adds them into the 'odd->out_created_objects' and the 'odd->out_modified_objects' */
+static gboolean
+ebb_m365_process_objects_locked (ObjectsDeltaData *odd,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	GPtrArray *contacts = NULL;
+	gboolean success = TRUE;
+	guint ii;
+
+	for (ii = 0; ii < odd->objects->len; ii++) {
+		ebb_m365_add_contact_locked (odd, g_ptr_array_index (odd->objects, ii), cancellable, error);
+	}
+
+	if (odd->ids->len || odd->bbm365->priv->folder_kind == E_M365_FOLDER_KIND_PEOPLE) {
+		switch (odd->bbm365->priv->folder_kind) {
+		case E_M365_FOLDER_KIND_CONTACTS:
+			success = e_m365_connection_get_contacts_sync (odd->bbm365->priv->cnc, NULL,
+				odd->bbm365->priv->folder_id, odd->ids, &contacts, cancellable, error);
+			break;
+		case E_M365_FOLDER_KIND_ORG_CONTACTS:
+			success = e_m365_connection_get_org_contacts_sync (odd->bbm365->priv->cnc, NULL,
+				odd->ids, &contacts, cancellable, error);
+			break;
+		case E_M365_FOLDER_KIND_USERS:
+			success = e_m365_connection_get_users_sync (odd->bbm365->priv->cnc, NULL,
+				odd->ids, &contacts, cancellable, error);
+			break;
+		case E_M365_FOLDER_KIND_PEOPLE:
+			success = e_m365_connection_get_people_sync (odd->bbm365->priv->cnc, NULL,
+				odd->bbm365->priv->max_people, &contacts, cancellable, error);
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* process them also on failure, because it could fail in following batch requests */
+	if (contacts != NULL) {
+		for (ii = 0; ii < contacts->len; ii++) {
+			ebb_m365_add_contact_locked (odd, g_ptr_array_index (contacts, ii), cancellable, error);
+		}
+
+		g_ptr_array_unref (contacts);
+	}
+
+	g_ptr_array_set_size (odd->objects, 0);
+	g_ptr_array_set_size (odd->ids, 0);
+
+	return success;
+}
+
+/* Stores the changes received so far and remembers where to continue,
+   thus an interrupted sync does not start from the beginning again */
+static gboolean
+ebb_m365_objects_delta_checkpoint_cb (EM365Connection *cnc,
+				      const gchar *next_link,
+				      gpointer user_data,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	ObjectsDeltaData *odd = user_data;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (odd != NULL, FALSE);
+
+	if (odd->objects->len || odd->ids->len)
+		success = ebb_m365_process_objects_locked (odd, cancellable, error);
+
+	if (success) {
+		success = e_book_meta_backend_process_changes_sync (E_BOOK_META_BACKEND (odd->bbm365), *(odd->out_created_objects),
+			*(odd->out_modified_objects), *(odd->out_removed_objects), cancellable, error);
+	}
+
+	if (success) {
+		g_slist_free_full (*(odd->out_created_objects), e_book_meta_backend_info_free);
+		g_slist_free_full (*(odd->out_modified_objects), e_book_meta_backend_info_free);
+		g_slist_free_full (*(odd->out_removed_objects), e_book_meta_backend_info_free);
+
+		*(odd->out_created_objects) = NULL;
+		*(odd->out_modified_objects) = NULL;
+		*(odd->out_removed_objects) = NULL;
+
+		e_cache_set_key (odd->cache, EBB_M365_DELTA_NEXT_LINK_KEY, next_link, NULL);
+	}
+
+	return success;
+}
+
 static gboolean
 ebb_m365_get_changes_sync (EBookMetaBackend *meta_backend,
 			   const gchar *last_sync_tag,
@@ -2195,7 +2354,9 @@ ebb_m365_get_changes_sync (EBookMetaBackend *meta_backend,
 
 	odd.bbm365 = bbm365;
 	odd.cache = E_CACHE (book_cache);
+	odd.objects = g_ptr_array_new_with_free_func ((GDestroyNotify) json_object_unref);
 	odd.ids = g_ptr_array_new_with_free_func (g_free);
+	odd.known_uids = NULL;
 	odd.out_created_objects = out_created_objects;
 	odd.out_modified_objects = out_modified_objects;
 	odd.out_removed_objects = out_removed_objects;
@@ -2203,10 +2364,20 @@ ebb_m365_get_changes_sync (EBookMetaBackend *meta_backend,
 	LOCK (bbm365);
 
 	if (bbm365->priv->cached_for_offline && bbm365->priv->folder_kind != E_M365_FOLDER_KIND_PEOPLE) {
+		gchar *next_link;
+
+		/* Continue the previously interrupted sync, if any */
+		next_link = e_cache_dup_key (odd.cache, EBB_M365_DELTA_NEXT_LINK_KEY, NULL);
+
+		if (next_link && !*next_link)
+			g_clear_pointer (&next_link, g_free);
+
 		success = e_m365_connection_get_objects_delta_sync (bbm365->priv->cnc, NULL,
-			bbm365->priv->folder_kind, bbm365->priv->folder_id, "id", last_sync_tag, 0,
-			ebb_m365_get_objects_delta_cb, &odd,
+			bbm365->priv->folder_kind, bbm365->priv->folder_id, "|full|", next_link ? next_link : last_sync_tag, 0,
+			ebb_m365_get_objects_delta_cb, ebb_m365_objects_delta_checkpoint_cb, &odd,
 			out_new_sync_tag, cancellable, &local_error);
+
+		g_free (next_link);
 	} else {
 		success = TRUE;
 	}
@@ -2216,6 +2387,12 @@ ebb_m365_get_changes_sync (EBookMetaBackend *meta_backend,
 
 		g_clear_error (&local_error);
 
+		e_cache_set_key (odd.cache, EBB_M365_DELTA_NEXT_LINK_KEY, NULL, NULL);
+		g_slist_free_full (*out_removed_objects, e_book_meta_backend_info_free);
+		*out_removed_objects = NULL;
+		g_ptr_array_set_size (odd.objects, 0);
+		g_ptr_array_set_size (odd.ids, 0);
+
 		if (e_book_cache_search_uids (book_cache, NULL, &known_uids, cancellable, error)) {
 			for (link = known_uids; link; link = g_slist_next (link)) {
 				const gchar *uid = link->data;
@@ -2228,90 +2405,34 @@ ebb_m365_get_changes_sync (EBookMetaBackend *meta_backend,
 		}
 
 		e_cache_remove_all (E_CACHE (book_cache), cancellable, NULL);
+		g_clear_pointer (&odd.known_uids, g_hash_table_destroy);
 
 		g_slist_free_full (known_uids, g_free);
 
 		success = e_m365_connection_get_objects_delta_sync (bbm365->priv->cnc, NULL,
-			bbm365->priv->folder_kind, bbm365->priv->folder_id, "id", NULL, 0,
-			ebb_m365_get_objects_delta_cb, &odd,
+			bbm365->priv->folder_kind, bbm365->priv->folder_id, "|full|", NULL, 0,
+			ebb_m365_get_objects_delta_cb, ebb_m365_objects_delta_checkpoint_cb, &odd,
 			out_new_sync_tag, cancellable, &local_error);
-	} else if (local_error) {
-		g_propagate_error (error, local_error);
 	}
 
-	if (success && (odd.ids->len || bbm365->priv->folder_kind == E_M365_FOLDER_KIND_PEOPLE)) {
-		GPtrArray *contacts = NULL;
-
-		switch (bbm365->priv->folder_kind) {
-		case E_M365_FOLDER_KIND_CONTACTS:
-			success = e_m365_connection_get_contacts_sync (bbm365->priv->cnc, NULL,
-				bbm365->priv->folder_id, odd.ids, &contacts, cancellable, error);
-			break;
-		case E_M365_FOLDER_KIND_ORG_CONTACTS:
-			success = e_m365_connection_get_org_contacts_sync (bbm365->priv->cnc, NULL,
-				odd.ids, &contacts, cancellable, error);
-			break;
-		case E_M365_FOLDER_KIND_USERS:
-			success = e_m365_connection_get_users_sync (bbm365->priv->cnc, NULL,
-				odd.ids, &contacts, cancellable, error);
-			break;
-		case E_M365_FOLDER_KIND_PEOPLE:
-			success = e_m365_connection_get_people_sync (bbm365->priv->cnc, NULL,
-				bbm365->priv->max_people, &contacts, cancellable, error);
-			break;
-		default:
-			break;
-		}
-
-		/* process them also on failure, because it could fail in following batch requests */
-		if (contacts != NULL) {
-			guint ii;
-
-			for (ii = 0; ii < contacts->len; ii++) {
-				EM365Contact *contact = g_ptr_array_index (contacts, ii);
-				GSList **out_slist;
-				EContact *vcard;
-				gchar *object;
-				const gchar *id = e_m365_contact_get_id (contact);
-
-				if (!id)
-					continue;
-
-				if (e_cache_contains (odd.cache, id, E_CACHE_INCLUDE_DELETED))
-					out_slist = odd.out_modified_objects;
-				else
-					out_slist = odd.out_created_objects;
-
-				vcard = ebb_m365_json_contact_to_vcard (bbm365, contact, bbm365->priv->cnc, &object, cancellable, error);
-
-				g_clear_object (&vcard);
-
-				if (!g_cancellable_is_cancelled (cancellable))
-					g_warn_if_fail (object != NULL);
-
-				if (object) {
-					EBookMetaBackendInfo *nfo;
-
-					nfo = e_book_meta_backend_info_new (id,
-						e_m365_contact_get_change_key (contact),
-						object, NULL);
-
-					nfo->extra = object; /* assumes ownership, to avoid unnecessary re-allocation */
+	if (local_error)
+		g_propagate_error (error, local_error);
 
-					*out_slist = g_slist_prepend (*out_slist, nfo);
-				}
-			}
+	if (success && (odd.objects->len || odd.ids->len || bbm365->priv->folder_kind == E_M365_FOLDER_KIND_PEOPLE))
+		success = ebb_m365_process_objects_locked (&odd, cancellable, error);
 
-			g_ptr_array_unref (contacts);
-		}
-	}
+	/* The sync finished, the new sync tag is used from now on */
+	if (success)
+		e_cache_set_key (odd.cache, EBB_M365_DELTA_NEXT_LINK_KEY, NULL, NULL);
 
 	UNLOCK (bbm365);
 
 	ebb_m365_convert_error_to_client_error (error);
 	ebb_m365_maybe_disconnect_sync (bbm365, error, cancellable);
 
+	g_clear_pointer (&odd.objects, g_ptr_array_unref);
 	g_clear_pointer (&odd.ids, g_ptr_array_unref);
+	g_clear_pointer (&odd.known_uids, g_hash_table_destroy);
 	g_clear_object (&book_cache);
 
 	return success;
@@ -27,6 +27,13 @@
 #define ECC_ERROR(_code) e_cal_client_error_create (_code, NULL)
 #define ECC_ERROR_EX(_code, _msg) e_cal_client_error_create (_code, _msg)
 
+/* The next link of the interrupted delta sync, to continue from */
+#define ECB_M365_DELTA_NEXT_LINK_KEY "m365-delta-next-link"
+
+/* Newline-separated UIDs of the events known before the interrupted full
+   resync, which had not been returned by it yet */
+#define ECB_M365_DELTA_RESYNC_UNSEEN_KEY "m365-delta-resync-unseen"
+
 #define LOCK(_cb) g_rec_mutex_lock (&_cb->priv->property_lock)
 #define UNLOCK(_cb) g_rec_mutex_unlock (&_cb->priv->property_lock)
 
@@ -437,10 +444,122 @@ ecb_m365_gather_ids_cb (ECalCache *cal_cache,
 
 typedef struct {
 	ECalBackendM365 *cbm365;
-	GPtrArray *ids;
+	ECalCache *cal_cache;
+	GPtrArray *events; /* JsonObject *, complete events from the delta */
+	GPtrArray *ids; /* gchar *, to be downloaded */
+	GHashTable *known_uids; /* gchar *uid ~> NULL; loaded on demand */
+	GHashTable *resync_unseen; /* gchar *uid ~> NULL; known before the full resync, not returned by it yet */
 	GSList **out_removed_objects;
 } CalDeltaData;
 
+static void
+ecb_m365_save_resync_unseen (CalDeltaData *cdd)
+{
+	GString *value = NULL;
+	GHashTableIter iter;
+	gpointer key;
+
+	if (cdd->resync_unseen) {
+		value = g_string_new ("");
+
+		g_hash_table_iter_init (&iter, cdd->resync_unseen);
+		while (g_hash_table_iter_next (&iter, &key, NULL)) {
+			g_string_append (value, key);
+			g_string_append_c (value, '\n');
+		}
+	}
+
+	e_cache_set_key (E_CACHE (cdd->cal_cache), ECB_M365_DELTA_RESYNC_UNSEEN_KEY, value ? value->str : NULL, NULL);
+
+	if (value)
+		g_string_free (value, TRUE);
+}
+
+/* Converts the complete events and downloads the others, split into the new and the changed ones */
+static gboolean
+ecb_m365_process_delta_locked (CalDeltaData *cdd,
+			       GSList **out_created_objects,
+			       GSList **out_modified_objects,
+			       GCancellable *cancellable,
+			       GError **error)
+{
+	GSList *created_ids = NULL, *modified_ids = NULL;
+	GSList *created_objects = NULL, *link;
+	gboolean success = TRUE;
+	guint ii;
+
+	if (!cdd->events->len && !cdd->ids->len)
+		return TRUE;
+
+	/* One query for all the known components, instead of one per changed event */
+	if (!cdd->known_uids) {
+		GSList *uids = NULL;
+
+		cdd->known_uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+		if (e_cache_get_uids (E_CACHE (cdd->cal_cache), E_CACHE_INCLUDE_DELETED, &uids, NULL, cancellable, NULL)) {
+			for (link = uids; link; link = g_slist_next (link)) {
+				if (link->data)
+					g_hash_table_add (cdd->known_uids, g_strdup (link->data));
+			}
+		}
+
+		g_slist_free_full (uids, g_free);
+	}
+
+	for (ii = 0; ii < cdd->events->len; ii++) {
+		JsonObject *event = g_ptr_array_index (cdd->events, ii);
+		ECalMetaBackendInfo *nfo;
+
+		nfo = ecb_m365_json_to_ical_nfo (cdd->cbm365, event, cancellable, NULL);
+
+		if (!nfo) {
+			/* Try it the usual way */
+			g_ptr_array_add (cdd->ids, g_strdup (e_m365_event_get_id (event)));
+		} else if (g_hash_table_contains (cdd->known_uids, nfo->uid)) {
+			*out_modified_objects = g_slist_prepend (*out_modified_objects, nfo);
+		} else {
+			created_objects = g_slist_prepend (created_objects, nfo);
+		}
+	}
+
+	for (ii = 0; ii < cdd->ids->len; ii++) {
+		const gchar *id = g_ptr_array_index (cdd->ids, ii);
+
+		if (g_hash_table_contains (cdd->known_uids, id))
+			modified_ids = g_slist_prepend (modified_ids, (gpointer) id);
+		else
+			created_ids = g_slist_prepend (created_ids, (gpointer) id);
+	}
+
+	if (created_ids) {
+		created_ids = g_slist_reverse (created_ids);
+		success = ecb_m365_download_changes_locked (cdd->cbm365, created_ids, &created_objects, cancellable, error);
+	}
+
+	if (success && modified_ids) {
+		modified_ids = g_slist_reverse (modified_ids);
+		success = ecb_m365_download_changes_locked (cdd->cbm365, modified_ids, out_modified_objects, cancellable, error);
+	}
+
+	for (link = created_objects; link; link = g_slist_next (link)) {
+		ECalMetaBackendInfo *nfo = link->data;
+
+		if (nfo && nfo->uid)
+			g_hash_table_add (cdd->known_uids, g_strdup (nfo->uid));
+	}
+
+	*out_created_objects = g_slist_concat (created_objects, *out_created_objects);
+
+	g_slist_free (created_ids);
+	g_slist_free (modified_ids);
+
+	g_ptr_array_set_size (cdd->events, 0);
+	g_ptr_array_set_size (cdd->ids, 0);
+
+	return success;
+}
+
 static gboolean
 ecb_m365_get_events_delta_cb (EM365Connection *cnc,
 			      const GSList *results,
@@ -465,9 +584,19 @@ ecb_m365_get_events_delta_cb (EM365Connection *cnc,
 		if (!id)
 			continue;
 
+		if (cdd->resync_unseen)
+			g_hash_table_remove (cdd->resync_unseen, id);
+
 		if (e_m365_delta_is_removed_object (event)) {
 			*(cdd->out_removed_objects) = g_slist_prepend (*(cdd->out_removed_objects),
 				e_cal_meta_backend_info_new (id, NULL, NULL, NULL));
+
+			if (cdd->known_uids)
+				g_hash_table_remove (cdd->known_uids, id);
+		} else if (e_m365_connection_util_delta_object_is_complete (E_M365_FOLDER_KIND_CALENDAR, event) &&
+			   !e_m365_event_get_recurrence (event)) {
+			/* The recurring events need the recurrence blob, which the delta does not return */
+			g_ptr_array_add (cdd->events, json_object_ref (event));
 		} else {
 			g_ptr_array_add (cdd->ids, g_strdup (id));
 		}
@@ -476,6 +605,45 @@ ecb_m365_get_events_delta_cb (EM365Connection *cnc,
 	return TRUE;
 }
 
+/* Stores the changes received so far and remembers where to continue,
+   thus an interrupted sync does not start from the beginning again */
+static gboolean
+ecb_m365_events_delta_checkpoint_cb (EM365Connection *cnc,
+				     const gchar *next_link,
+				     gpointer user_data,
+				     GCancellable *cancellable,
+				     GError **error)
+{
+	CalDeltaData *cdd = user_data;
+	GSList *created_objects = NULL, *modified_objects = NULL;
+	gboolean success;
+
+	g_return_val_if_fail (cdd != NULL, FALSE);
+
+	success = ecb_m365_process_delta_locked (cdd, &created_objects, &modified_objects, cancellable, error);
+
+	if (success) {
+		success = e_cal_meta_backend_process_changes_sync (E_CAL_META_BACKEND (cdd->cbm365), created_objects,
+			modified_objects, *(cdd->out_removed_objects), cancellable, error);
+	}
+
+	if (success) {
+		g_slist_free_full (*(cdd->out_removed_objects), e_cal_meta_backend_info_free);
+		*(cdd->out_removed_objects) = NULL;
+
+		/* Thus the continued full resync knows what to remove at its end */
+		if (cdd->resync_unseen)
+			ecb_m365_save_resync_unseen (cdd);
+
+		e_cache_set_key (E_CACHE (cdd->cal_cache), ECB_M365_DELTA_NEXT_LINK_KEY, next_link, NULL);
+	}
+
+	g_slist_free_full (created_objects, e_cal_meta_backend_info_free);
+	g_slist_free_full (modified_objects, e_cal_meta_backend_info_free);
+
+	return success;
+}
+
 static gboolean
 ecb_m365_get_changes_sync (ECalMetaBackend *meta_backend,
 			   const gchar *last_sync_tag,
@@ -514,77 +682,114 @@ ecb_m365_get_changes_sync (ECalMetaBackend *meta_backend,
 		/* Use delta sync for calendar events */
 		CalDeltaData cdd;
 		GError *local_error = NULL;
+		gchar *next_link;
 
 		cdd.cbm365 = cbm365;
+		cdd.cal_cache = cal_cache;
+		cdd.events = g_ptr_array_new_with_free_func ((GDestroyNotify) json_object_unref);
 		cdd.ids = g_ptr_array_new_with_free_func (g_free);
+		cdd.known_uids = NULL;
+		cdd.resync_unseen = NULL;
 		cdd.out_removed_objects = out_removed_objects;
 
+		/* Continue the previously interrupted sync, if any */
+		next_link = e_cache_dup_key (E_CACHE (cal_cache), ECB_M365_DELTA_NEXT_LINK_KEY, NULL);
+
+		if (next_link && !*next_link)
+			g_clear_pointer (&next_link, g_free);
+
+		if (next_link) {
+			gchar *stored;
+
+			/* The interrupted sync was a full resync */
+			stored = e_cache_dup_key (E_CACHE (cal_cache), ECB_M365_DELTA_RESYNC_UNSEEN_KEY, NULL);
+
+			if (stored) {
+				gchar **uids = g_strsplit (stored, "\n", -1);
+				guint ii;
+
+				cdd.resync_unseen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+				for (ii = 0; uids[ii]; ii++) {
+					if (*(uids[ii]))
+						g_hash_table_add (cdd.resync_unseen, g_strdup (uids[ii]));
+				}
+
+				g_strfreev (uids);
+				g_free (stored);
+			}
+		}
+
 		success = e_m365_connection_get_objects_delta_sync (cbm365->priv->cnc, NULL,
-			E_M365_FOLDER_KIND_CALENDAR, cbm365->priv->folder_id, "id", last_sync_tag, 0,
-			ecb_m365_get_events_delta_cb, &cdd,
+			E_M365_FOLDER_KIND_CALENDAR, cbm365->priv->folder_id, "|full|", next_link ? next_link : last_sync_tag, 0,
+			ecb_m365_get_events_delta_cb, ecb_m365_events_delta_checkpoint_cb, &cdd,
 			out_new_sync_tag, cancellable, &local_error);
 
+		g_free (next_link);
+
 		if (e_m365_connection_util_delta_token_failed (local_error)) {
 			/* Delta token expired/invalid - clear cache and do full sync */
 			GSList *known_uids = NULL, *link;
 
 			g_clear_error (&local_error);
 
+			e_cache_set_key (E_CACHE (cal_cache), ECB_M365_DELTA_NEXT_LINK_KEY, NULL, NULL);
+			g_slist_free_full (*out_removed_objects, e_cal_meta_backend_info_free);
+			*out_removed_objects = NULL;
+
+			/* The events not returned by the full resync are removed only after
+			   its last page; the checkpoints store only the "@removed" entries */
+			g_clear_pointer (&cdd.resync_unseen, g_hash_table_destroy);
+			cdd.resync_unseen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
 			if (e_cache_get_uids (E_CACHE (cal_cache), E_CACHE_INCLUDE_DELETED, &known_uids, NULL, cancellable, NULL)) {
 				for (link = known_uids; link; link = g_slist_next (link)) {
 					const gchar *uid = link->data;
 
-					if (uid) {
-						*out_removed_objects = g_slist_prepend (*out_removed_objects,
-							e_cal_meta_backend_info_new (uid, NULL, NULL, NULL));
-					}
+					if (uid)
+						g_hash_table_add (cdd.resync_unseen, g_strdup (uid));
 				}
 			}
 
 			g_slist_free_full (known_uids, g_free);
+			g_ptr_array_set_size (cdd.events, 0);
 			g_ptr_array_set_size (cdd.ids, 0);
+			g_clear_pointer (&cdd.known_uids, g_hash_table_destroy);
 
 			success = e_m365_connection_get_objects_delta_sync (cbm365->priv->cnc, NULL,
-				E_M365_FOLDER_KIND_CALENDAR, cbm365->priv->folder_id, "id", NULL, 0,
-				ecb_m365_get_events_delta_cb, &cdd,
+				E_M365_FOLDER_KIND_CALENDAR, cbm365->priv->folder_id, "|full|", NULL, 0,
+				ecb_m365_get_events_delta_cb, ecb_m365_events_delta_checkpoint_cb, &cdd,
 				out_new_sync_tag, cancellable, &local_error);
 		}
 
 		if (local_error)
 			g_propagate_error (error, local_error);
 
-		if (success && cdd.ids->len) {
-			GSList *created_ids = NULL, *modified_ids = NULL;
-			guint ii;
+		if (success)
+			success = ecb_m365_process_delta_locked (&cdd, out_created_objects, out_modified_objects, cancellable, error);
 
-			/* Determine which are new vs modified by checking the cache */
-			for (ii = 0; ii < cdd.ids->len; ii++) {
-				const gchar *id = g_ptr_array_index (cdd.ids, ii);
-				gchar *extra = NULL;
-
-				if (e_cal_cache_get_component_extra (cal_cache, id, NULL, &extra, cancellable, NULL)) {
-					modified_ids = g_slist_prepend (modified_ids, (gpointer) id);
-					g_free (extra);
-				} else {
-					created_ids = g_slist_prepend (created_ids, (gpointer) id);
-				}
-			}
+		if (success && cdd.resync_unseen) {
+			GHashTableIter iter;
+			gpointer key;
 
-			if (created_ids) {
-				created_ids = g_slist_reverse (created_ids);
-				success = ecb_m365_download_changes_locked (cbm365, created_ids, out_created_objects, cancellable, error);
-			}
-
-			if (success && modified_ids) {
-				modified_ids = g_slist_reverse (modified_ids);
-				success = ecb_m365_download_changes_locked (cbm365, modified_ids, out_modified_objects, cancellable, error);
+			/* The full resync finished, what it did not return is gone */
+			g_hash_table_iter_init (&iter, cdd.resync_unseen);
+			while (g_hash_table_iter_next (&iter, &key, NULL)) {
+				*out_removed_objects = g_slist_prepend (*out_removed_objects,
+					e_cal_meta_backend_info_new (key, NULL, NULL, NULL));
 			}
+		}
 
-			g_slist_free (created_ids);
-			g_slist_free (modified_ids);
+		/* The sync finished, the new sync tag is used from now on */
+		if (success) {
+			e_cache_set_key (E_CACHE (cal_cache), ECB_M365_DELTA_NEXT_LINK_KEY, NULL, NULL);
+			e_cache_set_key (E_CACHE (cal_cache), ECB_M365_DELTA_RESYNC_UNSEEN_KEY, NULL, NULL);
 		}
 
+		g_ptr_array_unref (cdd.events);
 		g_ptr_array_unref (cdd.ids);
+		g_clear_pointer (&cdd.known_uids, g_hash_table_destroy);
+		g_clear_pointer (&cdd.resync_unseen, g_hash_table_destroy);
 	} else {
 		/* Tasks: use the old list-all-and-compare approach (no delta support) */
 		GSList *items = NULL, *link;
@@ -2153,8 +2358,6 @@ ecb_m365_constructed (GObject *object)
 
 	g_free (cache_dirname);
 
-	e_m365_tz_utils_ref_windows_zones ();
-
 	/* ensure the user email is set */
 	registry = e_cal_backend_get_registry (E_CAL_BACKEND (cbm365));
 	m365_settings = camel_m365_settings_get_from_backend (E_BACKEND (cbm365), registry);
@@ -2196,8 +2399,6 @@ ecb_m365_finalize (GObject *object)
 
 	g_rec_mutex_clear (&cbm365->priv->property_lock);
 
-	e_m365_tz_utils_unref_windows_zones ();
-
 	/* Chain up to parent's method. */
 	G_OBJECT_CLASS (e_cal_backend_m365_parent_class)->finalize (object);
 }
@@ -300,8 +300,17 @@ m365_folder_get_message_sync (CamelFolder *folder,
 	g_mutex_unlock (&m365_folder->priv->get_message_lock);
 
 	if (success && !message) {
+		CamelMessageInfo *info;
 		GChecksum *checksum;
 		GIOStream *base_stream;
+		guint32 expected_size = 0;
+
+		info = camel_folder_summary_get (camel_folder_get_folder_summary (folder), uid);
+
+		if (info) {
+			expected_size = camel_message_info_get_size (info);
+			g_object_unref (info);
+		}
 
 		checksum = m365_folder_cache_new_checksum (uid);
 
@@ -313,7 +322,7 @@ m365_folder_get_message_sync (CamelFolder *folder,
 
 		success = cache_stream != NULL;
 
-		success = success && e_m365_connection_get_mail_message_sync (cnc, NULL, folder_id, uid,
+		success = success && e_m365_connection_get_mail_message_sync (cnc, NULL, folder_id, uid, expected_size,
 			e_m365_connection_util_read_raw_data_cb, cache_stream, cancellable, &local_error);
 
 		if (local_error) {
@@ -860,6 +869,36 @@ m365_folder_got_summary_messages_cb (EM365Connection *cnc,
 	return TRUE;
 }
 
+/* Commits what had been received so far and remembers where to continue,
+   thus an interrupted refresh does not start from the beginning again */
+static gboolean
+m365_folder_delta_checkpoint_cb (EM365Connection *cnc,
+				 const gchar *next_link,
+				 gpointer user_data,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	SummaryDeltaData *sdd = user_data;
+	CamelFolderSummary *summary;
+
+	g_return_val_if_fail (sdd != NULL, FALSE);
+
+	summary = camel_folder_get_folder_summary (sdd->folder);
+
+	if (!summary)
+		return FALSE;
+
+	if (sdd->removed_uids && sdd->removed_uids->len) {
+		camel_folder_summary_remove_uids (summary, sdd->removed_uids);
+		g_ptr_array_set_size (sdd->removed_uids, 0);
+	}
+
+	camel_m365_folder_summary_set_delta_link (CAMEL_M365_FOLDER_SUMMARY (summary), next_link);
+	m365_folder_save_summary (CAMEL_M365_FOLDER (sdd->folder));
+
+	return TRUE;
+}
+
 static gboolean
 m365_folder_refresh_info_sync (CamelFolder *folder,
 			       GCancellable *cancellable,
@@ -897,6 +936,7 @@ m365_folder_refresh_info_sync (CamelFolder *folder,
 	folder_summary = camel_folder_get_folder_summary (folder);
 	m365_folder_summary = CAMEL_M365_FOLDER_SUMMARY (folder_summary);
 
+	/* It can be also the next link of the previously interrupted refresh */
 	curr_delta_link = camel_m365_folder_summary_dup_delta_link (m365_folder_summary);
 
 	sdd.folder = folder;
@@ -907,8 +947,11 @@ m365_folder_refresh_info_sync (CamelFolder *folder,
 	if (!curr_delta_link)
 		sdd.known_uids = camel_folder_summary_get_hash (folder_summary);
 
+	/* The messages removed on the server are known only after the full list
+	   is received, when there are any local messages without the delta link */
 	success = e_m365_connection_get_objects_delta_sync (cnc, NULL, E_M365_FOLDER_KIND_MAIL, folder_id, M365_FETCH_SUMMARY_PROPERTIES,
-		curr_delta_link, 0, m365_folder_got_summary_messages_cb, &sdd,
+		curr_delta_link, 0, m365_folder_got_summary_messages_cb,
+		(!sdd.known_uids || !g_hash_table_size (sdd.known_uids)) ? m365_folder_delta_checkpoint_cb : NULL, &sdd,
 		&new_delta_link, cancellable, &local_error);
 
 	if (curr_delta_link && e_m365_connection_util_delta_token_failed (local_error)) {
@@ -921,7 +964,8 @@ m365_folder_refresh_info_sync (CamelFolder *folder,
 		sdd.known_uids = camel_folder_summary_get_hash (folder_summary);
 
 		success = e_m365_connection_get_objects_delta_sync (cnc, NULL, E_M365_FOLDER_KIND_MAIL, folder_id, M365_FETCH_SUMMARY_PROPERTIES,
-			NULL, 0, m365_folder_got_summary_messages_cb, &sdd,
+			NULL, 0, m365_folder_got_summary_messages_cb,
+			!g_hash_table_size (sdd.known_uids) ? m365_folder_delta_checkpoint_cb : NULL, &sdd,
 			&new_delta_link, cancellable, &local_error);
 	}
 
@@ -951,7 +995,8 @@ m365_folder_refresh_info_sync (CamelFolder *folder,
 	g_clear_pointer (&sdd.known_uids, g_hash_table_unref);
 
 	if (sdd.removed_uids) {
-		camel_folder_summary_remove_uids (folder_summary, sdd.removed_uids);
+		if (sdd.removed_uids->len)
+			camel_folder_summary_remove_uids (folder_summary, sdd.removed_uids);
 
 		g_ptr_array_unref (sdd.removed_uids);
 	}
@@ -12,6 +12,7 @@
 
 #include "camel-m365-settings.h"
 #include "e-ews-common-utils.h"
+#include "e-m365-json-stream.h"
 #include "e-m365-json-utils.h"
 
 #include "e-m365-connection.h"
@@ -52,6 +53,13 @@ m365_validate_server_url (const gchar *url,
 	return valid;
 }
 #define X_EVO_M365_DATA "X-EVO-M365-DATA"
+#define X_EVO_M365_RAW_DATA "X-EVO-M365-RAW-DATA"
+
+/* How long to wait for other requests, to send them together in one $batch request */
+#define M365_COALESCE_WINDOW_USEC (20 * G_TIME_SPAN_MILLISECOND)
+/* Only smaller messages are coalesced, because the batch response is read into memory
+   and non-JSON bodies are base64 encoded in it */
+#define M365_COALESCE_MAX_MESSAGE_SIZE (256 * 1024)
 
 #define ORG_CONTACTS_PROPS "addresses,companyName,department,displayName,givenName,id,jobTitle,mail,mailNickname,phones,proxyAddresses,surname"
 #define USERS_PROPS	"aboutMe,birthday,businessPhones,city,companyName,country,createdDateTime,department,displayName,faxNumber,givenName," \
@@ -78,12 +86,19 @@ struct _EM365ConnectionPrivate {
 
 	gchar *hash_key; /* in the opened connections hash */
 
-	/* How many microseconds to wait, until can execute a new request.
-	   This is to cover throttling and server unavailable responses.
+	/* Paces the requests per mailbox and resource family, to cover throttling
+	   and server unavailable responses; it has its own lock.
 	   https://docs.microsoft.com/en-us/graph/best-practices-concept#handling-expected-errors */
-	gint64 backoff_for_usec;
+	EM365Throttle *throttle;
 
 	guint concurrent_connections;
+
+	/* Coalesces independent GET requests into $batch requests */
+	GMutex coalesce_lock;
+	GCond coalesce_cond;
+	GSList *coalesce_queue; /* M365CoalescedRequest *, in the order of arrival */
+	gboolean coalesce_collecting; /* whether some thread collects the queue */
+	guint coalesce_n_callers; /* inside the m365_connection_send_coalesced_sync() */
 };
 
 enum {
@@ -435,6 +450,9 @@ m365_connection_finalize (GObject *object)
 	g_clear_pointer (&cnc->priv->user, g_free);
 	g_clear_pointer (&cnc->priv->impersonate_user, g_free);
 	g_free (cnc->priv->hash_key);
+	e_m365_throttle_free (cnc->priv->throttle);
+	g_mutex_clear (&cnc->priv->coalesce_lock);
+	g_cond_clear (&cnc->priv->coalesce_cond);
 
 	/* Chain up to parent's method. */
 	G_OBJECT_CLASS (e_m365_connection_parent_class)->finalize (object);
@@ -543,7 +561,52 @@ e_m365_connection_init (EM365Connection *cnc)
 
 	g_rec_mutex_init (&cnc->priv->property_lock);
 
-	cnc->priv->backoff_for_usec = 0;
+	cnc->priv->throttle = e_m365_throttle_new ();
+
+	g_mutex_init (&cnc->priv->coalesce_lock);
+	g_cond_init (&cnc->priv->coalesce_cond);
+}
+
+/* Whether the 'object', as returned by the e_m365_connection_get_objects_delta_sync()
+   with the "|full|" select, contains all the properties needed to store it locally.
+   The server can return only the changed properties of the directory objects. */
+gboolean
+e_m365_connection_util_delta_object_is_complete (EM365FolderKind kind,
+						 JsonObject *object)
+{
+	const gchar *contact_members[] = { "changeKey", "displayName", "emailAddresses", NULL };
+	const gchar *event_members[] = { "changeKey", "subject", "body", "start", "end", "recurrence", NULL };
+	const gchar * const *members = NULL;
+	gchar **props = NULL;
+	gboolean complete = TRUE;
+	guint ii;
+
+	g_return_val_if_fail (object != NULL, FALSE);
+
+	switch (kind) {
+	case E_M365_FOLDER_KIND_CONTACTS:
+		members = contact_members;
+		break;
+	case E_M365_FOLDER_KIND_ORG_CONTACTS:
+		props = g_strsplit (ORG_CONTACTS_PROPS, ",", -1);
+		break;
+	case E_M365_FOLDER_KIND_CALENDAR:
+		members = event_members;
+		break;
+	default:
+		return FALSE;
+	}
+
+	if (props)
+		members = (const gchar * const *) props;
+
+	for (ii = 0; members[ii] && complete; ii++) {
+		complete = json_object_has_member (object, members[ii]);
+	}
+
+	g_strfreev (props);
+
+	return complete;
 }
 
 gboolean
@@ -890,6 +953,16 @@ e_m365_connection_set_concurrent_connections (EM365Connection *cnc,
 	g_object_notify (G_OBJECT (cnc), "concurrent-connections");
 }
 
+/* Returns the counters of the request pacing per mailbox and resource family;
+   free with g_slist_free_full (stats, e_m365_throttle_stats_free); */
+GSList *
+e_m365_connection_dup_throttle_stats (EM365Connection *cnc)
+{
+	g_return_val_if_fail (E_IS_M365_CONNECTION (cnc), NULL);
+
+	return e_m365_throttle_dup_stats (cnc->priv->throttle);
+}
+
 GProxyResolver *
 e_m365_connection_ref_proxy_resolver (EM365Connection *cnc)
 {
@@ -1091,94 +1164,327 @@ e_m365_connection_json_node_from_message (SoupMessage *message,
 	return success;
 }
 
+typedef struct _EM365ResponseData {
+	EM365ConnectionJsonFunc json_func;
+	EM365ConnectionDeltaCheckpointFunc checkpoint_func; /* called with the next link of each page, after the json_func */
+	gpointer func_user_data;
+	gboolean read_only_once; /* To be able to just try authentication */
+	GSList **out_items; /* JsonObject * */
+	GPtrArray *out_array_items; /* JsonObject * */
+	gchar **out_delta_link; /* set only if available and not NULL */
+	GPtrArray *inout_requests; /* SoupMessage *, for the batch request */
+} EM365ResponseData;
+
 static gboolean
-m365_connection_send_request_sync (EM365Connection *cnc,
-				   SoupMessage *message,
-				   EM365ResponseFunc response_func,
-				   EM365ConnectionRawDataFunc raw_data_func,
-				   gpointer func_user_data,
+e_m365_read_valued_response_cb (EM365Connection *cnc,
+				SoupMessage *message,
+				GInputStream *input_stream,
+				JsonNode *node,
+				gpointer user_data,
+				gchar **out_next_link,
+				GCancellable *cancellable,
+				GError **error)
+{
+	EM365ResponseData *response_data = user_data;
+	JsonObject *object;
+	JsonArray *value;
+	const gchar *delta_link;
+	GSList *items = NULL;
+	gboolean can_continue = TRUE;
+	guint ii, len;
+
+	g_return_val_if_fail (response_data != NULL, FALSE);
+	g_return_val_if_fail (out_next_link != NULL, FALSE);
+	g_return_val_if_fail (JSON_NODE_HOLDS_OBJECT (node), FALSE);
+
+	object = json_node_get_object (node);
+	g_return_val_if_fail (object != NULL, FALSE);
+
+	if (!response_data->read_only_once)
+		*out_next_link = g_strdup (e_m365_json_get_string_member (object, "@odata.nextLink", NULL));
+
+	delta_link = e_m365_json_get_string_member (object, "@odata.deltaLink", NULL);
+
+	if (delta_link && response_data->out_delta_link)
+		*response_data->out_delta_link = g_strdup (delta_link);
+
+	value = e_m365_json_get_array_member (object, "value");
+	g_return_val_if_fail (value != NULL, FALSE);
+
+	len = json_array_get_length (value);
+
+	for (ii = 0; ii < len; ii++) {
+		JsonNode *elem = json_array_get_element (value, ii);
+
+		g_warn_if_fail (JSON_NODE_HOLDS_OBJECT (elem));
+
+		if (JSON_NODE_HOLDS_OBJECT (elem)) {
+			JsonObject *elem_object = json_node_get_object (elem);
+
+			if (elem_object) {
+				if (response_data->out_items)
+					*response_data->out_items = g_slist_prepend (*response_data->out_items, json_object_ref (elem_object));
+				else if (response_data->out_array_items)
+					g_ptr_array_add (response_data->out_array_items, json_object_ref (elem_object));
+				else
+					items = g_slist_prepend (items, json_object_ref (elem_object));
+			}
+		}
+	}
+
+	if (response_data->json_func)
+		can_continue = response_data->json_func (cnc, items, response_data->func_user_data, cancellable, error);
+
+	if (can_continue && response_data->checkpoint_func && *out_next_link && **out_next_link)
+		can_continue = response_data->checkpoint_func (cnc, *out_next_link, response_data->func_user_data, cancellable, error);
+
+	g_slist_free_full (items, (GDestroyNotify) json_object_unref);
+
+	return can_continue;
+}
+
+/* Graph pages can be read directly from the stream, unless they had been
+   already parsed, like the parts of the batch request, or they are errors */
+static gboolean
+m365_connection_can_stream_response (SoupMessage *message,
+				     GInputStream *input_stream)
+{
+	const gchar *content_type;
+
+	if (!input_stream || g_object_get_data (G_OBJECT (message), X_EVO_M365_DATA) ||
+	    !SOUP_STATUS_IS_SUCCESSFUL (e_m365_connection_util_get_message_status_code (message)))
+		return FALSE;
+
+	content_type = soup_message_get_response_headers (message) ?
+		soup_message_headers_get_content_type (soup_message_get_response_headers (message), NULL) : NULL;
+
+	return content_type && g_ascii_strcasecmp (content_type, "application/json") == 0;
+}
+
+/* How many streamed elements are collected, before they are passed to the json_func */
+#define M365_STREAM_ELEMENTS_SLICE 50
+
+typedef struct _EM365StreamData {
+	EM365Connection *cnc;
+	EM365ResponseData *response_data;
+	GSList *items; /* JsonObject *, for the json_func */
+	guint n_items;
+} EM365StreamData;
+
+static gboolean
+m365_connection_stream_element_cb (JsonObject *element,
+				   gpointer user_data,
 				   GCancellable *cancellable,
 				   GError **error)
 {
-	SoupSession *soup_session;
-	gint need_retry_seconds = 5;
-	gboolean did_io_error_retry = FALSE;
-	gboolean success = FALSE, need_retry = TRUE;
+	EM365StreamData *sd = user_data;
+	EM365ResponseData *response_data = sd->response_data;
 
-	g_return_val_if_fail (E_IS_M365_CONNECTION (cnc), FALSE);
-	g_return_val_if_fail (SOUP_IS_MESSAGE (message), FALSE);
-	g_return_val_if_fail (response_func != NULL || raw_data_func != NULL, FALSE);
-	g_return_val_if_fail (response_func == NULL || raw_data_func == NULL, FALSE);
+	if (response_data->out_items) {
+		*response_data->out_items = g_slist_prepend (*response_data->out_items, json_object_ref (element));
+	} else if (response_data->out_array_items) {
+		g_ptr_array_add (response_data->out_array_items, json_object_ref (element));
+	} else {
+		sd->items = g_slist_prepend (sd->items, json_object_ref (element));
+		sd->n_items++;
 
-	while (need_retry && !g_cancellable_is_cancelled (cancellable)) {
-		need_retry = FALSE;
+		/* Let the caller process the elements, without waiting for the whole page */
+		if (sd->n_items >= M365_STREAM_ELEMENTS_SLICE && response_data->json_func) {
+			gboolean can_continue;
 
-		LOCK (cnc);
+			can_continue = response_data->json_func (sd->cnc, sd->items, response_data->func_user_data, cancellable, error);
 
-		if (cnc->priv->backoff_for_usec) {
-			EFlag *flag;
-			gint64 wait_ms;
-			gulong handler_id = 0;
+			g_slist_free_full (sd->items, (GDestroyNotify) json_object_unref);
+			sd->items = NULL;
+			sd->n_items = 0;
 
-			wait_ms = cnc->priv->backoff_for_usec / G_TIME_SPAN_MILLISECOND;
+			return can_continue;
+		}
+	}
 
-			UNLOCK (cnc);
+	return TRUE;
+}
 
-			flag = e_flag_new ();
+/* The streaming counterpart of the e_m365_connection_json_node_from_message()
+   and the e_m365_read_valued_response_cb() */
+static gboolean
+m365_connection_read_valued_stream_sync (EM365Connection *cnc,
+					 SoupMessage *message,
+					 GInputStream *input_stream,
+					 EM365ResponseData *response_data,
+					 gchar **out_next_link,
+					 GCancellable *cancellable,
+					 GError **error)
+{
+	EM365StreamData sd;
+	JsonNode *error_node = NULL;
+	gchar *delta_link = NULL;
+	gboolean success;
 
-			if (cancellable) {
-				handler_id = g_cancellable_connect (cancellable, G_CALLBACK (m365_connection_request_cancelled_cb),
-					flag, NULL);
-			}
+	g_return_val_if_fail (response_data != NULL, FALSE);
+	g_return_val_if_fail (out_next_link != NULL, FALSE);
 
-			while (wait_ms > 0 && !g_cancellable_is_cancelled (cancellable)) {
-				gint64 now = g_get_monotonic_time ();
-				gint left_minutes, left_seconds;
+	sd.cnc = cnc;
+	sd.response_data = response_data;
+	sd.items = NULL;
+	sd.n_items = 0;
 
-				left_minutes = wait_ms / 60000;
-				left_seconds = (wait_ms / 1000) % 60;
+	success = e_m365_json_stream_read_page_sync (input_stream, m365_connection_stream_element_cb, &sd,
+		response_data->read_only_once ? NULL : out_next_link, &delta_link, &error_node, cancellable, error);
 
-				if (left_minutes > 0) {
-					camel_operation_push_message (cancellable,
-						g_dngettext (GETTEXT_PACKAGE,
-							"Microsoft 365 server is busy, waiting to retry (%d:%02d minute)",
-							"Microsoft 365 server is busy, waiting to retry (%d:%02d minutes)", left_minutes),
-						left_minutes, left_seconds);
-				} else {
-					camel_operation_push_message (cancellable,
-						g_dngettext (GETTEXT_PACKAGE,
-							"Microsoft 365 server is busy, waiting to retry (%d second)",
-							"Microsoft 365 server is busy, waiting to retry (%d seconds)", left_seconds),
-						left_seconds);
-				}
+	if (success && error_node)
+		success = !m365_connection_extract_error (error_node, e_m365_connection_util_get_message_status_code (message), error);
 
-				e_flag_wait_until (flag, now + (G_TIME_SPAN_MILLISECOND * (wait_ms > 1000 ? 1000 : wait_ms)));
-				e_flag_clear (flag);
+	if (success && delta_link && response_data->out_delta_link) {
+		*response_data->out_delta_link = delta_link;
+		delta_link = NULL;
+	}
 
-				now = g_get_monotonic_time () - now;
-				now = now / G_TIME_SPAN_MILLISECOND;
+	if (success && response_data->json_func)
+		success = response_data->json_func (cnc, sd.items, response_data->func_user_data, cancellable, error);
 
-				if (now >= wait_ms)
-					wait_ms = 0;
-				wait_ms -= now;
+	if (success && response_data->checkpoint_func && *out_next_link && **out_next_link)
+		success = response_data->checkpoint_func (cnc, *out_next_link, response_data->func_user_data, cancellable, error);
 
-				camel_operation_pop_message (cancellable);
-			}
+	if (!success)
+		g_clear_pointer (out_next_link, g_free);
 
-			if (handler_id)
-				g_cancellable_disconnect (cancellable, handler_id);
+	g_slist_free_full (sd.items, (GDestroyNotify) json_object_unref);
+	g_clear_pointer (&error_node, json_node_unref);
+	g_free (delta_link);
 
-			e_flag_free (flag);
+	return success;
+}
 
-			LOCK (cnc);
+static gboolean
+m365_connection_follow_next_link (SoupMessage *message,
+				  const gchar *next_link,
+				  gboolean *out_need_retry,
+				  GError **error)
+{
+	GUri *uri;
+
+	if (!next_link || !*next_link)
+		return TRUE;
+
+	if (!m365_validate_server_url (next_link, error))
+		return FALSE;
+
+	uri = g_uri_parse (next_link, SOUP_HTTP_URI_FLAGS | G_URI_FLAGS_PARSE_RELAXED, NULL);
+
+	if (uri) {
+		*out_need_retry = TRUE;
+		soup_message_set_uri (message, uri);
+		g_uri_unref (uri);
+	}
+
+	return TRUE;
+}
 
-			cnc->priv->backoff_for_usec = 0;
+static void
+m365_connection_throttle_wait_sync (EM365Connection *cnc,
+				    gint64 wait_usec,
+				    GCancellable *cancellable)
+{
+	EFlag *flag;
+	gint64 wait_ms;
+	gulong handler_id = 0;
+	gboolean with_message;
+
+	wait_ms = wait_usec / G_TIME_SPAN_MILLISECOND;
+
+	if (wait_ms <= 0)
+		return;
+
+	/* the usual pacing is below a second, do not bother the user with it */
+	with_message = wait_ms >= 1000;
+
+	flag = e_flag_new ();
+
+	if (cancellable) {
+		handler_id = g_cancellable_connect (cancellable, G_CALLBACK (m365_connection_request_cancelled_cb),
+			flag, NULL);
+	}
+
+	while (wait_ms > 0 && !g_cancellable_is_cancelled (cancellable)) {
+		gint64 now = g_get_monotonic_time ();
+		gint left_minutes, left_seconds;
+
+		left_minutes = wait_ms / 60000;
+		left_seconds = (wait_ms / 1000) % 60;
+
+		if (!with_message) {
+			/* nothing to show */
+		} else if (left_minutes > 0) {
+			camel_operation_push_message (cancellable,
+				g_dngettext (GETTEXT_PACKAGE,
+					"Microsoft 365 server is busy, waiting to retry (%d:%02d minute)",
+					"Microsoft 365 server is busy, waiting to retry (%d:%02d minutes)", left_minutes),
+				left_minutes, left_seconds);
+		} else {
+			camel_operation_push_message (cancellable,
+				g_dngettext (GETTEXT_PACKAGE,
+					"Microsoft 365 server is busy, waiting to retry (%d second)",
+					"Microsoft 365 server is busy, waiting to retry (%d seconds)", left_seconds),
+				left_seconds);
 		}
 
+		e_flag_wait_until (flag, now + (G_TIME_SPAN_MILLISECOND * (wait_ms > 1000 ? 1000 : wait_ms)));
+		e_flag_clear (flag);
+
+		now = g_get_monotonic_time () - now;
+		now = now / G_TIME_SPAN_MILLISECOND;
+
+		if (now >= wait_ms)
+			wait_ms = 0;
+		wait_ms -= now;
+
+		if (with_message)
+			camel_operation_pop_message (cancellable);
+	}
+
+	if (handler_id)
+		g_cancellable_disconnect (cancellable, handler_id);
+
+	e_flag_free (flag);
+}
+
+static gboolean
+m365_connection_send_request_sync (EM365Connection *cnc,
+				   SoupMessage *message,
+				   EM365ResponseFunc response_func,
+				   EM365ConnectionRawDataFunc raw_data_func,
+				   gpointer func_user_data,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	SoupSession *soup_session;
+	gint need_retry_seconds = 5;
+	gboolean did_io_error_retry = FALSE;
+	gboolean success = FALSE, need_retry = TRUE;
+	gchar *bucket = NULL;
+
+	g_return_val_if_fail (E_IS_M365_CONNECTION (cnc), FALSE);
+	g_return_val_if_fail (SOUP_IS_MESSAGE (message), FALSE);
+	g_return_val_if_fail (response_func != NULL || raw_data_func != NULL, FALSE);
+	g_return_val_if_fail (response_func == NULL || raw_data_func == NULL, FALSE);
+
+	while (need_retry && !g_cancellable_is_cancelled (cancellable)) {
+		need_retry = FALSE;
+
+		/* the next link can point to a different resource */
+		g_free (bucket);
+		bucket = e_m365_throttle_dup_bucket (soup_message_get_uri (message));
+
+		m365_connection_throttle_wait_sync (cnc, e_m365_throttle_reserve (cnc->priv->throttle, bucket), cancellable);
+
+		LOCK (cnc);
+
 		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
 			UNLOCK (cnc);
 
 			e_m365_connection_util_set_message_status_code (message, -1);
+			g_free (bucket);
 
 			return FALSE;
 		}
@@ -1202,6 +1508,9 @@ m365_connection_send_request_sync (EM365Connection *cnc,
 				local_error = NULL;
 			}
 
+			e_m365_throttle_learn (cnc->priv->throttle, bucket, e_m365_connection_util_get_message_status_code (message),
+				soup_message_get_response_headers (message));
+
 			if (is_io_error ||
 			    /* Throttling - https://docs.microsoft.com/en-us/graph/throttling  */
 			    e_m365_connection_util_get_message_status_code (message) == 429 ||
@@ -1230,19 +1539,27 @@ m365_connection_send_request_sync (EM365Connection *cnc,
 				else if (need_retry_seconds < 120)
 					need_retry_seconds *= 2;
 
-				LOCK (cnc);
-
-				if (cnc->priv->backoff_for_usec < need_retry_seconds * G_USEC_PER_SEC)
-					cnc->priv->backoff_for_usec = need_retry_seconds * G_USEC_PER_SEC;
-
-				if (e_m365_connection_util_get_message_status_code (message) == SOUP_STATUS_SERVICE_UNAVAILABLE)
-					soup_session_abort (soup_session);
-
-				UNLOCK (cnc);
+				/* Only the server's throttling blocks the whole bucket, the I/O error
+				   concerns this request only, thus wait for it locally */
+				if (e_m365_connection_util_get_message_status_code (message) == 429 ||
+				    e_m365_connection_util_get_message_status_code (message) == SOUP_STATUS_SERVICE_UNAVAILABLE)
+					e_m365_throttle_backoff (cnc->priv->throttle, bucket, need_retry_seconds);
+				else
+					m365_connection_throttle_wait_sync (cnc, need_retry_seconds * G_USEC_PER_SEC, cancellable);
 
+				/* The 503 blocks only the bucket; the session is not aborted,
+				   it would fail the requests of all the other buckets too */
 				success = FALSE;
 			} else if (success && raw_data_func && SOUP_STATUS_IS_SUCCESSFUL (e_m365_connection_util_get_message_status_code (message))) {
 				success = raw_data_func (cnc, message, input_stream, func_user_data, cancellable, error);
+			} else if (success && response_func == e_m365_read_valued_response_cb &&
+				   m365_connection_can_stream_response (message, input_stream)) {
+				gchar *next_link = NULL;
+
+				success = m365_connection_read_valued_stream_sync (cnc, message, input_stream, func_user_data, &next_link, cancellable, error);
+				success = success && m365_connection_follow_next_link (message, next_link, &need_retry, error);
+
+				g_free (next_link);
 			} else if (success) {
 				JsonNode *node = NULL;
 
@@ -1252,22 +1569,7 @@ m365_connection_send_request_sync (EM365Connection *cnc,
 					gchar *next_link = NULL;
 
 					success = response_func && response_func (cnc, message, input_stream, node, func_user_data, &next_link, cancellable, error);
-
-					if (success && next_link && *next_link) {
-						if (m365_validate_server_url (next_link, error)) {
-							GUri *uri;
-
-							uri = g_uri_parse (next_link, SOUP_HTTP_URI_FLAGS | G_URI_FLAGS_PARSE_RELAXED, NULL);
-
-							if (uri) {
-								need_retry = TRUE;
-								soup_message_set_uri (message, uri);
-								g_uri_unref (uri);
-							}
-						} else {
-							success = FALSE;
-						}
-					}
+					success = success && m365_connection_follow_next_link (message, next_link, &need_retry, error);
 
 					g_free (next_link);
 				} else if (error && !*error && e_m365_connection_util_get_message_status_code (message) && !SOUP_STATUS_IS_SUCCESSFUL (e_m365_connection_util_get_message_status_code (message))) {
@@ -1317,6 +1619,8 @@ m365_connection_send_request_sync (EM365Connection *cnc,
 		}
 	}
 
+	g_free (bucket);
+
 	return success;
 }
 
@@ -1376,81 +1680,6 @@ e_m365_read_to_byte_array_cb (EM365Connection *cnc,
 	return !n_read;
 }
 
-typedef struct _EM365ResponseData {
-	EM365ConnectionJsonFunc json_func;
-	gpointer func_user_data;
-	gboolean read_only_once; /* To be able to just try authentication */
-	GSList **out_items; /* JsonObject * */
-	GPtrArray *out_array_items; /* JsonObject * */
-	gchar **out_delta_link; /* set only if available and not NULL */
-	GPtrArray *inout_requests; /* SoupMessage *, for the batch request */
-} EM365ResponseData;
-
-static gboolean
-e_m365_read_valued_response_cb (EM365Connection *cnc,
-				SoupMessage *message,
-				GInputStream *input_stream,
-				JsonNode *node,
-				gpointer user_data,
-				gchar **out_next_link,
-				GCancellable *cancellable,
-				GError **error)
-{
-	EM365ResponseData *response_data = user_data;
-	JsonObject *object;
-	JsonArray *value;
-	const gchar *delta_link;
-	GSList *items = NULL;
-	gboolean can_continue = TRUE;
-	guint ii, len;
-
-	g_return_val_if_fail (response_data != NULL, FALSE);
-	g_return_val_if_fail (out_next_link != NULL, FALSE);
-	g_return_val_if_fail (JSON_NODE_HOLDS_OBJECT (node), FALSE);
-
-	object = json_node_get_object (node);
-	g_return_val_if_fail (object != NULL, FALSE);
-
-	if (!response_data->read_only_once)
-		*out_next_link = g_strdup (e_m365_json_get_string_member (object, "@odata.nextLink", NULL));
-
-	delta_link = e_m365_json_get_string_member (object, "@odata.deltaLink", NULL);
-
-	if (delta_link && response_data->out_delta_link)
-		*response_data->out_delta_link = g_strdup (delta_link);
-
-	value = e_m365_json_get_array_member (object, "value");
-	g_return_val_if_fail (value != NULL, FALSE);
-
-	len = json_array_get_length (value);
-
-	for (ii = 0; ii < len; ii++) {
-		JsonNode *elem = json_array_get_element (value, ii);
-
-		g_warn_if_fail (JSON_NODE_HOLDS_OBJECT (elem));
-
-		if (JSON_NODE_HOLDS_OBJECT (elem)) {
-			JsonObject *elem_object = json_node_get_object (elem);
-
-			if (elem_object) {
-				if (response_data->out_items)
-					*response_data->out_items = g_slist_prepend (*response_data->out_items, json_object_ref (elem_object));
-				else if (response_data->out_array_items)
-					g_ptr_array_add (response_data->out_array_items, json_object_ref (elem_object));
-				else
-					items = g_slist_prepend (items, json_object_ref (elem_object));
-			}
-		}
-	}
-
-	if (response_data->json_func)
-		can_continue = response_data->json_func (cnc, items, response_data->func_user_data, cancellable, error);
-
-	g_slist_free_full (items, (GDestroyNotify) json_object_unref);
-
-	return can_continue;
-}
-
 static gboolean
 e_m365_read_json_object_response_cb (EM365Connection *cnc,
 				     SoupMessage *message,
@@ -1821,8 +2050,27 @@ e_m365_connection_fill_batch_response (SoupMessage *message,
 
 	subobject = e_m365_json_get_object_member (object, "body");
 
-	if (subobject)
+	if (subobject) {
 		g_object_set_data_full (G_OBJECT (message), X_EVO_M365_DATA, json_object_ref (subobject), (GDestroyNotify) json_object_unref);
+	} else {
+		const gchar *body, *content_type;
+
+		body = e_m365_json_get_string_member (object, "body", NULL);
+		content_type = soup_message_headers_get_content_type (soup_message_get_response_headers (message), NULL);
+
+		/* Only the non-JSON bodies are base64 encoded; a JSON string body, or a body
+		   of an unknown type, is left unset, thus its caller sends the request directly */
+		if (body && content_type &&
+		    g_ascii_strcasecmp (content_type, "application/json") != 0 &&
+		    !g_str_has_suffix (content_type, "+json")) {
+			guchar *data;
+			gsize len = 0;
+
+			data = g_base64_decode (body, &len);
+
+			g_object_set_data_full (G_OBJECT (message), X_EVO_M365_RAW_DATA, g_bytes_new_take (data, len), (GDestroyNotify) g_bytes_unref);
+		}
+	}
 }
 
 static gboolean
@@ -2074,6 +2322,7 @@ e_m365_connection_batch_request_sync (EM365Connection *cnc,
 	gint need_retry_seconds = 5;
 	gboolean did_io_error_retry = FALSE;
 	gboolean success, need_retry = TRUE;
+	guint ii;
 
 	g_return_val_if_fail (E_IS_M365_CONNECTION (cnc), FALSE);
 	g_return_val_if_fail (requests != NULL, FALSE);
@@ -2084,10 +2333,27 @@ e_m365_connection_batch_request_sync (EM365Connection *cnc,
 
 	while (need_retry) {
 		GError *local_error = NULL;
+		gint64 wait_usec = 0;
 
 		need_retry = FALSE;
 		g_clear_error (error);
 
+		/* Each of the requests counts into its own bucket; the batch request itself is paced
+		   by the m365_connection_send_request_sync() */
+		for (ii = 0; ii < use_requests->len; ii++) {
+			SoupMessage *message = g_ptr_array_index (use_requests, ii);
+			gchar *bucket;
+
+			if (!message)
+				continue;
+
+			bucket = e_m365_throttle_dup_bucket (soup_message_get_uri (message));
+			wait_usec = MAX (wait_usec, e_m365_throttle_reserve (cnc->priv->throttle, bucket));
+			g_free (bucket);
+		}
+
+		m365_connection_throttle_wait_sync (cnc, wait_usec, cancellable);
+
 		success = e_m365_connection_batch_request_internal_sync (cnc, api_version, use_requests, cancellable, &local_error);
 
 		if (!did_io_error_retry && g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT)) {
@@ -2095,12 +2361,8 @@ e_m365_connection_batch_request_sync (EM365Connection *cnc,
 			success = FALSE;
 			need_retry = TRUE;
 
-			LOCK (cnc);
-
-			if (cnc->priv->backoff_for_usec < M365_RETRY_IO_ERROR_SECONDS * G_USEC_PER_SEC)
-				cnc->priv->backoff_for_usec = M365_RETRY_IO_ERROR_SECONDS * G_USEC_PER_SEC;
-
-			UNLOCK (cnc);
+			/* Only this batch waits, it does not tell anything about the buckets */
+			m365_connection_throttle_wait_sync (cnc, M365_RETRY_IO_ERROR_SECONDS * G_USEC_PER_SEC, cancellable);
 		}
 
 		if (local_error) {
@@ -2109,16 +2371,21 @@ e_m365_connection_batch_request_sync (EM365Connection *cnc,
 		}
 
 		if (success) {
-			GPtrArray *new_requests = NULL;
+			GPtrArray *new_requests = NULL, *new_buckets = NULL;
 			gint delay_seconds = 0;
-			gint ii;
 
 			for (ii = 0; ii < use_requests->len; ii++) {
 				SoupMessage *message = g_ptr_array_index (use_requests, ii);
+				gchar *bucket;
 
 				if (!message)
 					continue;
 
+				bucket = e_m365_throttle_dup_bucket (soup_message_get_uri (message));
+
+				e_m365_throttle_learn (cnc->priv->throttle, bucket, e_m365_connection_util_get_message_status_code (message),
+					soup_message_get_response_headers (message));
+
 				/* Throttling - https://docs.microsoft.com/en-us/graph/throttling  */
 				if (e_m365_connection_util_get_message_status_code (message) == 429 ||
 				    /* https://docs.microsoft.com/en-us/graph/best-practices-concept#handling-expected-errors */
@@ -2128,10 +2395,13 @@ e_m365_connection_batch_request_sync (EM365Connection *cnc,
 
 					need_retry = TRUE;
 
-					if (!new_requests)
+					if (!new_requests) {
 						new_requests = g_ptr_array_sized_new (use_requests->len);
+						new_buckets = g_ptr_array_new_with_free_func (g_free);
+					}
 
 					g_ptr_array_add (new_requests, message);
+					g_ptr_array_add (new_buckets, g_steal_pointer (&bucket));
 
 					retry_after_str = soup_message_get_response_headers (message) ?
 						soup_message_headers_get_one (soup_message_get_response_headers (message), "Retry-After") : NULL;
@@ -2146,6 +2416,8 @@ e_m365_connection_batch_request_sync (EM365Connection *cnc,
 					else
 						delay_seconds = MAX (delay_seconds, need_retry_seconds);
 				}
+
+				g_free (bucket);
 			}
 
 			if (new_requests) {
@@ -2154,12 +2426,12 @@ e_m365_connection_batch_request_sync (EM365Connection *cnc,
 				else if (need_retry_seconds < 120)
 					need_retry_seconds *= 2;
 
-				LOCK (cnc);
-
-				if (cnc->priv->backoff_for_usec < need_retry_seconds * G_USEC_PER_SEC)
-					cnc->priv->backoff_for_usec = need_retry_seconds * G_USEC_PER_SEC;
+				/* Only the throttled buckets wait, the others can continue */
+				for (ii = 0; ii < new_buckets->len; ii++) {
+					e_m365_throttle_backoff (cnc->priv->throttle, g_ptr_array_index (new_buckets, ii), need_retry_seconds);
+				}
 
-				UNLOCK (cnc);
+				g_ptr_array_unref (new_buckets);
 
 				if (use_requests != requests)
 					g_ptr_array_free (use_requests, TRUE);
@@ -2175,6 +2447,251 @@ e_m365_connection_batch_request_sync (EM365Connection *cnc,
 	return success;
 }
 
+typedef struct _M365CoalescedRequest {
+	gint ref_count;
+	SoupMessage *message;
+	gboolean batched; /* whether the response had been received in the $batch */
+	gboolean sent; /* whether it had been part of a sent $batch */
+	gboolean done;
+} M365CoalescedRequest;
+
+static M365CoalescedRequest *
+m365_coalesced_request_new (SoupMessage *message) /* (transfer full) */
+{
+	M365CoalescedRequest *cr;
+
+	cr = g_new0 (M365CoalescedRequest, 1);
+	cr->ref_count = 1;
+	cr->message = message;
+
+	return cr;
+}
+
+static M365CoalescedRequest *
+m365_coalesced_request_ref (M365CoalescedRequest *cr)
+{
+	g_atomic_int_inc (&cr->ref_count);
+
+	return cr;
+}
+
+static void
+m365_coalesced_request_unref (gpointer ptr)
+{
+	M365CoalescedRequest *cr = ptr;
+
+	if (cr && g_atomic_int_dec_and_test (&cr->ref_count)) {
+		g_clear_object (&cr->message);
+		g_free (cr);
+	}
+}
+
+static void
+m365_connection_coalesce_cancelled_cb (GCancellable *cancellable,
+				       gpointer user_data)
+{
+	EM365Connection *cnc = user_data;
+
+	/* Wake up the waiters, thus the cancelled one can leave */
+	g_mutex_lock (&cnc->priv->coalesce_lock);
+	g_cond_broadcast (&cnc->priv->coalesce_cond);
+	g_mutex_unlock (&cnc->priv->coalesce_lock);
+}
+
+static void
+m365_connection_send_coalesced_batch (EM365Connection *cnc,
+				      GSList *batch, /* M365CoalescedRequest * */
+				      GCancellable *cancellable)
+{
+	GPtrArray *requests;
+	GSList *link;
+	gboolean success;
+
+	requests = g_ptr_array_sized_new (g_slist_length (batch));
+
+	for (link = batch; link; link = g_slist_next (link)) {
+		M365CoalescedRequest *cr = link->data;
+
+		g_ptr_array_add (requests, cr->message);
+	}
+
+	/* The requests are independent, thus without "dependsOn", and the server
+	   can run them in any order; a lone request is sent by its caller */
+	success = requests->len > 1 &&
+		e_m365_connection_batch_request_sync (cnc, E_M365_API_V1_0, requests, cancellable, NULL);
+
+	g_mutex_lock (&cnc->priv->coalesce_lock);
+
+	for (link = batch; link; link = g_slist_next (link)) {
+		M365CoalescedRequest *cr = link->data;
+
+		/* The failed requests are sent again by their callers, to get the right error */
+		cr->batched = success &&
+			SOUP_STATUS_IS_SUCCESSFUL (e_m365_connection_util_get_message_status_code (cr->message)) &&
+			g_object_get_data (G_OBJECT (cr->message), X_EVO_M365_RAW_DATA);
+		cr->sent = requests->len > 1;
+		cr->done = TRUE;
+	}
+
+	g_cond_broadcast (&cnc->priv->coalesce_cond);
+	g_mutex_unlock (&cnc->priv->coalesce_lock);
+
+	g_ptr_array_unref (requests);
+}
+
+/* Sends the GET request of the 'uri' together with the other requests arriving
+   within the M365_COALESCE_WINDOW_USEC, in one $batch request. The first waiting
+   request collects the others and sends the batch, then each caller processes
+   its own response in its thread. A cancelled caller leaves right away; its
+   request stays referenced by the batch, when that is already being sent.
+   A caller without any concurrent caller sends its request directly. */
+static gboolean
+m365_connection_send_coalesced_sync (EM365Connection *cnc,
+				     const gchar *uri,
+				     EM365ConnectionRawDataFunc func,
+				     gpointer func_user_data,
+				     GCancellable *cancellable,
+				     GError **error)
+{
+	M365CoalescedRequest *cr;
+	SoupMessage *message;
+	gulong cancelled_id = 0;
+	gboolean success, done, batched, sent, concurrent;
+
+	message = m365_connection_new_soup_message (SOUP_METHOD_GET, uri, CSM_DEFAULT, error);
+
+	if (!message)
+		return FALSE;
+
+	g_mutex_lock (&cnc->priv->coalesce_lock);
+	concurrent = cnc->priv->coalesce_n_callers > 0;
+	cnc->priv->coalesce_n_callers++;
+	g_mutex_unlock (&cnc->priv->coalesce_lock);
+
+	/* Nothing to coalesce with, thus do not wait for the window; the requests
+	   arriving meanwhile are coalesced together */
+	if (!concurrent) {
+		success = m365_connection_send_request_sync (cnc, message, NULL, func, func_user_data, cancellable, error);
+
+		g_object_unref (message);
+
+		g_mutex_lock (&cnc->priv->coalesce_lock);
+		cnc->priv->coalesce_n_callers--;
+		g_mutex_unlock (&cnc->priv->coalesce_lock);
+
+		return success;
+	}
+
+	cr = m365_coalesced_request_new (message);
+
+	if (cancellable)
+		cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (m365_connection_coalesce_cancelled_cb), cnc, NULL);
+
+	g_mutex_lock (&cnc->priv->coalesce_lock);
+
+	cnc->priv->coalesce_queue = g_slist_append (cnc->priv->coalesce_queue, m365_coalesced_request_ref (cr));
+	g_cond_broadcast (&cnc->priv->coalesce_cond);
+
+	while (!cr->done && !g_cancellable_is_cancelled (cancellable)) {
+		if (!cnc->priv->coalesce_collecting && g_slist_find (cnc->priv->coalesce_queue, cr)) {
+			GSList *batch = NULL;
+			gint64 deadline;
+			guint ii;
+
+			cnc->priv->coalesce_collecting = TRUE;
+			deadline = g_get_monotonic_time () + M365_COALESCE_WINDOW_USEC;
+
+			while (g_slist_length (cnc->priv->coalesce_queue) < E_M365_BATCH_MAX_REQUESTS &&
+			       !g_cancellable_is_cancelled (cancellable) &&
+			       g_cond_wait_until (&cnc->priv->coalesce_cond, &cnc->priv->coalesce_lock, deadline)) {
+				/* woken by a new request, by a finished batch or by the cancel */
+			}
+
+			if (g_cancellable_is_cancelled (cancellable)) {
+				/* Let another waiting thread collect the queue */
+				cnc->priv->coalesce_collecting = FALSE;
+				g_cond_broadcast (&cnc->priv->coalesce_cond);
+				break;
+			}
+
+			/* The batch takes over the references of the queue */
+			for (ii = 0; ii < E_M365_BATCH_MAX_REQUESTS && cnc->priv->coalesce_queue; ii++) {
+				batch = g_slist_prepend (batch, cnc->priv->coalesce_queue->data);
+				cnc->priv->coalesce_queue = g_slist_delete_link (cnc->priv->coalesce_queue, cnc->priv->coalesce_queue);
+			}
+
+			batch = g_slist_reverse (batch);
+
+			/* The rest, if any, is collected by another waiting thread */
+			cnc->priv->coalesce_collecting = FALSE;
+			g_cond_broadcast (&cnc->priv->coalesce_cond);
+
+			g_mutex_unlock (&cnc->priv->coalesce_lock);
+
+			m365_connection_send_coalesced_batch (cnc, batch, cancellable);
+
+			g_slist_free_full (batch, m365_coalesced_request_unref);
+
+			g_mutex_lock (&cnc->priv->coalesce_lock);
+		} else {
+			g_cond_wait (&cnc->priv->coalesce_cond, &cnc->priv->coalesce_lock);
+		}
+	}
+
+	done = cr->done;
+	batched = cr->batched;
+	sent = cr->sent;
+
+	if (!done) {
+		GSList *link;
+
+		/* Cancelled while waiting; when not in the queue, then the batch with it
+		   is being sent, and it releases the request once finished */
+		link = g_slist_find (cnc->priv->coalesce_queue, cr);
+
+		if (link) {
+			cnc->priv->coalesce_queue = g_slist_delete_link (cnc->priv->coalesce_queue, link);
+			m365_coalesced_request_unref (cr);
+		}
+	}
+
+	cnc->priv->coalesce_n_callers--;
+
+	g_mutex_unlock (&cnc->priv->coalesce_lock);
+
+	/* Cannot disconnect with the coalesce_lock locked, the callback locks it too */
+	if (cancelled_id)
+		g_cancellable_disconnect (cancellable, cancelled_id);
+
+	if (!done || g_cancellable_is_cancelled (cancellable)) {
+		/* The 'done' is FALSE only when cancelled while waiting */
+		g_cancellable_set_error_if_cancelled (cancellable, error);
+		success = FALSE;
+	} else if (batched) {
+		GInputStream *input_stream;
+
+		input_stream = g_memory_input_stream_new_from_bytes (g_object_get_data (G_OBJECT (cr->message), X_EVO_M365_RAW_DATA));
+
+		success = func (cnc, cr->message, input_stream, func_user_data, cancellable, error);
+
+		g_object_unref (input_stream);
+	} else if (!sent) {
+		/* Left alone in the window, the message is untouched */
+		success = m365_connection_send_request_sync (cnc, cr->message, NULL, func, func_user_data, cancellable, error);
+	} else {
+		/* The message could be filled by the $batch response, thus use a new one */
+		message = m365_connection_new_soup_message (SOUP_METHOD_GET, uri, CSM_DEFAULT, error);
+
+		success = message && m365_connection_send_request_sync (cnc, message, NULL, func, func_user_data, cancellable, error);
+
+		g_clear_object (&message);
+	}
+
+	m365_coalesced_request_unref (cr);
+
+	return success;
+}
+
 /* This can be used as an EM365ConnectionJsonFunc function, it only
    copies items of 'results' into 'user_data', which is supposed
    to be a pointer to a GSList *. */
@@ -2672,22 +3189,44 @@ e_m365_connection_get_objects_delta_sync (EM365Connection *cnc,
 					  EM365FolderKind kind,
 					  const gchar *folder_id, /* folder ID to get delta messages in, nullable for orgContacts, users */
 					  const gchar *select, /* properties to select, nullable */
-					  const gchar *delta_link, /* previous delta link */
+					  const gchar *delta_link, /* previous delta link, or a next link to resume from */
 					  guint max_page_size, /* 0 for default by the server */
 					  EM365ConnectionJsonFunc func, /* function to call with each result set */
-					  gpointer func_user_data, /* user data passed into the 'func' */
+					  EM365ConnectionDeltaCheckpointFunc checkpoint_func, /* nullable, function to call with the next link after each page */
+					  gpointer func_user_data, /* user data passed into the 'func' and the 'checkpoint_func' */
 					  gchar **out_delta_link,
 					  GCancellable *cancellable,
 					  GError **error)
 {
 	EM365ResponseData rd;
 	SoupMessage *message = NULL;
+	gboolean with_full;
 	gboolean success;
 
 	g_return_val_if_fail (E_IS_M365_CONNECTION (cnc), FALSE);
 	g_return_val_if_fail (out_delta_link != NULL, FALSE);
 	g_return_val_if_fail (func != NULL, FALSE);
 
+	/* "|full|" means to return all the properties needed to store the object,
+	   thus the caller does not need to download each changed object again */
+	with_full = g_strcmp0 (select, "|full|") == 0;
+	if (with_full) {
+		switch (kind) {
+		case E_M365_FOLDER_KIND_ORG_CONTACTS:
+			select = ORG_CONTACTS_PROPS;
+			break;
+		case E_M365_FOLDER_KIND_USERS:
+			/* some of the USERS_PROPS cannot be used with the delta,
+			   thus the users are always downloaded by their ID */
+			select = "id";
+			break;
+		default:
+			/* all the properties are returned without the $select */
+			select = NULL;
+			break;
+		}
+	}
+
 	if (delta_link && m365_validate_server_url (delta_link, NULL))
 		message = m365_connection_new_soup_message (SOUP_METHOD_GET, delta_link, CSM_DEFAULT, NULL);
 
@@ -2750,6 +3289,10 @@ e_m365_connection_get_objects_delta_sync (EM365Connection *cnc,
 		g_free (uri);
 	}
 
+	/* The delta link does not remember the headers, thus set it also when resuming */
+	if (with_full && kind == E_M365_FOLDER_KIND_CALENDAR)
+		soup_message_headers_append (soup_message_get_request_headers (message), "Prefer", "outlook.body-content-type=\"text\"");
+
 	if (max_page_size > 0) {
 		gchar *prefer_value;
 
@@ -2763,6 +3306,7 @@ e_m365_connection_get_objects_delta_sync (EM365Connection *cnc,
 	memset (&rd, 0, sizeof (EM365ResponseData));
 
 	rd.json_func = func;
+	rd.checkpoint_func = checkpoint_func;
 	rd.func_user_data = func_user_data;
 	rd.out_delta_link = out_delta_link;
 
@@ -2780,6 +3324,7 @@ e_m365_connection_get_mail_message_sync (EM365Connection *cnc,
 					 const gchar *user_override, /* for which user, NULL to use the account user */
 					 const gchar *folder_id,
 					 const gchar *message_id,
+					 guint32 expected_size, /* 0 when not known */
 					 EM365ConnectionRawDataFunc func,
 					 gpointer func_user_data,
 					 GCancellable *cancellable,
@@ -2800,6 +3345,15 @@ e_m365_connection_get_mail_message_sync (EM365Connection *cnc,
 		"$value",
 		NULL);
 
+	/* Small messages, like when opening a thread, can be fetched together with the others */
+	if (expected_size > 0 && expected_size <= M365_COALESCE_MAX_MESSAGE_SIZE) {
+		success = m365_connection_send_coalesced_sync (cnc, uri, func, func_user_data, cancellable, error);
+
+		g_free (uri);
+
+		return success;
+	}
+
 	message = m365_connection_new_soup_message (SOUP_METHOD_GET, uri, CSM_DEFAULT, error);
 
 	if (!message) {
@@ -16,6 +16,7 @@
 #include "camel-m365-settings.h"
 #include "e-m365-enums.h"
 #include "e-m365-json-utils.h"
+#include "e-m365-throttle.h"
 
 #define E_M365_ARTIFICIAL_FOLDER_ID_ORG_CONTACTS	"folder-id::orgContacts"
 #define E_M365_ARTIFICIAL_FOLDER_ID_USERS		"folder-id::users"
@@ -72,6 +73,15 @@ typedef gboolean (* EM365ConnectionJsonFunc)	(EM365Connection *cnc,
 						 GCancellable *cancellable,
 						 GError **error);
 
+/* Called after all the objects of a delta page had been passed to the EM365ConnectionJsonFunc;
+   the 'next_link' continues the delta right after them. Returns whether can continue */
+typedef gboolean (* EM365ConnectionDeltaCheckpointFunc)
+						(EM365Connection *cnc,
+						 const gchar *next_link,
+						 gpointer user_data,
+						 GCancellable *cancellable,
+						 GError **error);
+
 typedef gboolean (* EM365ConnectionRawDataFunc)	(EM365Connection *cnc,
 						 SoupMessage *message,
 						 GInputStream *raw_data_stream,
@@ -90,6 +100,9 @@ struct _EM365ConnectionClass {
 
 gboolean	e_m365_connection_util_delta_token_failed
 						(const GError *error);
+gboolean	e_m365_connection_util_delta_object_is_complete
+						(EM365FolderKind kind,
+						 JsonObject *object);
 void		e_m365_connection_util_set_message_status_code
 						(SoupMessage *message,
 						 gint status_code);
@@ -129,6 +142,8 @@ guint		e_m365_connection_get_concurrent_connections
 void		e_m365_connection_set_concurrent_connections
 						(EM365Connection *cnc,
 						 guint concurrent_connections);
+GSList *	e_m365_connection_dup_throttle_stats /* EM365ThrottleStats * */
+						(EM365Connection *cnc);
 GProxyResolver *e_m365_connection_ref_proxy_resolver
 						(EM365Connection *cnc);
 void		e_m365_connection_set_proxy_resolver
@@ -255,11 +270,12 @@ gboolean	e_m365_connection_get_objects_delta_sync
 						 const gchar *user_override, /* for which user, NULL to use the account user */
 						 EM365FolderKind kind,
 						 const gchar *folder_id, /* folder ID to get delta messages in */
-						 const gchar *select, /* nullable - properties to select */
-						 const gchar *delta_link, /* previous delta link */
+						 const gchar *select, /* nullable - properties to select, or "|full|" for the objects which can be stored without downloading them again */
+						 const gchar *delta_link, /* previous delta link, or a next link to resume from */
 						 guint max_page_size, /* 0 for default by the server */
 						 EM365ConnectionJsonFunc func, /* function to call with each result set */
-						 gpointer func_user_data, /* user data passed into the 'func' */
+						 EM365ConnectionDeltaCheckpointFunc checkpoint_func, /* nullable, function to call with the next link after each page */
+						 gpointer func_user_data, /* user data passed into the 'func' and the 'checkpoint_func' */
 						 gchar **out_delta_link,
 						 GCancellable *cancellable,
 						 GError **error);
@@ -268,6 +284,7 @@ gboolean	e_m365_connection_get_mail_message_sync
 						 const gchar *user_override, /* for which user, NULL to use the account user */
 						 const gchar *folder_id,
 						 const gchar *message_id,
+						 guint32 expected_size, /* 0 when not known; small messages can be fetched in a $batch with others */
 						 EM365ConnectionRawDataFunc func,
 						 gpointer func_user_data,
 						 GCancellable *cancellable,
@@ -0,0 +1,436 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* Reads the Microsoft Graph page, like the delta or the list response,
+   directly from the stream. Only one element of the "value" array is held
+   in memory at a time; it is given to the caller as soon as it's complete.
+   The "@odata.nextLink", the "@odata.deltaLink" and the "error" members
+   are recognized anywhere in the page, all the other members are skipped. */
+
+#include "evolution-ews-config.h"
+
+#include <string.h>
+#include <glib/gi18n-lib.h>
+
+#include "e-m365-json-stream.h"
+
+#define READ_BUFFER_SIZE 65536
+
+typedef struct _JsonStreamReader {
+	GInputStream *input_stream;
+	GCancellable *cancellable;
+	guchar *buffer;
+	gsize len;
+	gsize pos;
+	gboolean eof;
+	GString *capture; /* not NULL, when the read data is being stored */
+	gsize capture_from;
+} JsonStreamReader;
+
+static gboolean
+json_stream_reader_fill (JsonStreamReader *reader,
+			 GError **error)
+{
+	gssize n_read;
+
+	if (reader->eof)
+		return FALSE;
+
+	if (reader->capture && reader->capture_from < reader->len)
+		g_string_append_len (reader->capture, (const gchar *) reader->buffer + reader->capture_from, reader->len - reader->capture_from);
+
+	reader->capture_from = 0;
+	reader->pos = 0;
+	reader->len = 0;
+
+	n_read = g_input_stream_read (reader->input_stream, reader->buffer, READ_BUFFER_SIZE, reader->cancellable, error);
+
+	if (n_read <= 0) {
+		reader->eof = TRUE;
+		return FALSE;
+	}
+
+	reader->len = n_read;
+
+	return TRUE;
+}
+
+/* Returns the next byte without reading it, or -1 at the end of the data or on error */
+static gint
+json_stream_reader_peek (JsonStreamReader *reader,
+			 GError **error)
+{
+	if (reader->pos >= reader->len && !json_stream_reader_fill (reader, error))
+		return -1;
+
+	return reader->buffer[reader->pos];
+}
+
+static gint
+json_stream_reader_next (JsonStreamReader *reader,
+			 GError **error)
+{
+	gint chr;
+
+	chr = json_stream_reader_peek (reader, error);
+
+	if (chr != -1)
+		reader->pos++;
+
+	return chr;
+}
+
+/* Returns the first non-white-space byte, without reading it */
+static gint
+json_stream_reader_skip_ws (JsonStreamReader *reader,
+			    GError **error)
+{
+	gint chr;
+
+	while (chr = json_stream_reader_peek (reader, error), chr == ' ' || chr == '\t' || chr == '\n' || chr == '\r') {
+		reader->pos++;
+	}
+
+	return chr;
+}
+
+static void
+json_stream_reader_capture_begin (JsonStreamReader *reader,
+				  GString *capture)
+{
+	g_string_truncate (capture, 0);
+
+	reader->capture = capture;
+	reader->capture_from = reader->pos;
+}
+
+static void
+json_stream_reader_capture_end (JsonStreamReader *reader)
+{
+	if (reader->capture && reader->capture_from < reader->pos)
+		g_string_append_len (reader->capture, (const gchar *) reader->buffer + reader->capture_from, reader->pos - reader->capture_from);
+
+	reader->capture = NULL;
+}
+
+/* The opening quote is already read */
+static gboolean
+json_stream_reader_scan_string (JsonStreamReader *reader,
+				GError **error)
+{
+	gboolean escaped = FALSE;
+
+	while (reader->pos < reader->len || json_stream_reader_fill (reader, error)) {
+		while (reader->pos < reader->len) {
+			guchar chr = reader->buffer[reader->pos];
+
+			reader->pos++;
+
+			if (escaped)
+				escaped = FALSE;
+			else if (chr == '\\')
+				escaped = TRUE;
+			else if (chr == '"')
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Reads the whole value, starting at the current position */
+static gboolean
+json_stream_reader_scan_value (JsonStreamReader *reader,
+			       GError **error)
+{
+	gint chr, depth;
+
+	chr = json_stream_reader_next (reader, error);
+
+	if (chr == -1)
+		return FALSE;
+
+	if (chr == '"')
+		return json_stream_reader_scan_string (reader, error);
+
+	if (chr != '{' && chr != '[') {
+		/* A number, true, false or null */
+		while (chr = json_stream_reader_peek (reader, error), chr != -1 && chr != ',' && chr != '}' && chr != ']' &&
+		       chr != ' ' && chr != '\t' && chr != '\n' && chr != '\r') {
+			reader->pos++;
+		}
+
+		return !error || !*error;
+	}
+
+	depth = 1;
+
+	while (depth > 0) {
+		if (reader->pos >= reader->len && !json_stream_reader_fill (reader, error))
+			return FALSE;
+
+		while (depth > 0 && reader->pos < reader->len) {
+			chr = reader->buffer[reader->pos];
+
+			reader->pos++;
+
+			if (chr == '"') {
+				if (!json_stream_reader_scan_string (reader, error))
+					return FALSE;
+			} else if (chr == '{' || chr == '[') {
+				depth++;
+			} else if (chr == '}' || chr == ']') {
+				depth--;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/* The opening quote is already read; the member names are compared
+   as they are in the data, the recognized names contain no escapes */
+static gboolean
+json_stream_reader_read_key (JsonStreamReader *reader,
+			     GString *key,
+			     GError **error)
+{
+	gint chr;
+	gboolean escaped = FALSE;
+
+	g_string_truncate (key, 0);
+
+	while (chr = json_stream_reader_next (reader, error), chr != -1) {
+		if (!escaped && chr == '"')
+			return TRUE;
+
+		escaped = !escaped && chr == '\\';
+
+		g_string_append_c (key, (gchar) chr);
+	}
+
+	return FALSE;
+}
+
+/* The string value is parsed as the only element of an array, to have it unescaped */
+static gchar *
+json_stream_dup_string_value (JsonParser *parser,
+			      GString *capture)
+{
+	JsonNode *root;
+	gchar *value = NULL;
+
+	g_string_prepend_c (capture, '[');
+	g_string_append_c (capture, ']');
+
+	if (json_parser_load_from_data (parser, capture->str, capture->len, NULL)) {
+		root = json_parser_get_root (parser);
+
+		if (root && JSON_NODE_HOLDS_ARRAY (root) &&
+		    json_array_get_length (json_node_get_array (root)) == 1 &&
+		    JSON_NODE_HOLDS_VALUE (json_array_get_element (json_node_get_array (root), 0))) {
+			value = g_strdup (json_array_get_string_element (json_node_get_array (root), 0));
+		}
+	}
+
+	return value;
+}
+
+/* The reader is at the opening bracket */
+static gboolean
+json_stream_reader_read_elements (JsonStreamReader *reader,
+				  JsonParser *parser,
+				  GString *capture,
+				  EM365JsonStreamElementFunc element_func,
+				  gpointer user_data,
+				  gboolean *out_aborted,
+				  GError **error)
+{
+	gint chr;
+
+	json_stream_reader_next (reader, error);
+
+	chr = json_stream_reader_skip_ws (reader, error);
+
+	if (chr == ']') {
+		json_stream_reader_next (reader, error);
+		return TRUE;
+	}
+
+	while (chr != -1) {
+		JsonNode *root;
+		gboolean success;
+
+		json_stream_reader_capture_begin (reader, capture);
+		success = json_stream_reader_scan_value (reader, error);
+		json_stream_reader_capture_end (reader);
+
+		if (!success || !json_parser_load_from_data (parser, capture->str, capture->len, error))
+			return FALSE;
+
+		root = json_parser_get_root (parser);
+
+		g_warn_if_fail (root && JSON_NODE_HOLDS_OBJECT (root));
+
+		if (root && JSON_NODE_HOLDS_OBJECT (root) && json_node_get_object (root) &&
+		    !element_func (json_node_get_object (root), user_data, reader->cancellable, error)) {
+			*out_aborted = TRUE;
+			return FALSE;
+		}
+
+		chr = json_stream_reader_skip_ws (reader, error);
+
+		if (chr == ']') {
+			json_stream_reader_next (reader, error);
+			return TRUE;
+		}
+
+		if (chr != ',')
+			break;
+
+		json_stream_reader_next (reader, error);
+		chr = json_stream_reader_skip_ws (reader, error);
+	}
+
+	return FALSE;
+}
+
+/**
+ * e_m365_json_stream_read_page_sync:
+ * @input_stream: a #GInputStream with the page
+ * @element_func: (scope call): a function to call for each element of the "value" array
+ * @user_data: user data for the @element_func
+ * @out_next_link: (out) (optional) (transfer full): set to the "@odata.nextLink", if any
+ * @out_delta_link: (out) (optional) (transfer full): set to the "@odata.deltaLink", if any
+ * @out_error_node: (out) (optional) (transfer full): set to the "error" member, if any
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Reads the page from the @input_stream and calls the @element_func for each
+ * object of its "value" array, as soon as it is read. The object is valid only
+ * during the call; the @element_func should reference it, to keep it. Reading
+ * stops when the @element_func returns %FALSE.
+ *
+ * Returns: whether the whole page had been read
+ **/
+gboolean
+e_m365_json_stream_read_page_sync (GInputStream *input_stream,
+				   EM365JsonStreamElementFunc element_func,
+				   gpointer user_data,
+				   gchar **out_next_link,
+				   gchar **out_delta_link,
+				   JsonNode **out_error_node,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	JsonStreamReader reader;
+	JsonParser *parser;
+	GString *key, *capture;
+	GError *local_error = NULL;
+	gboolean aborted = FALSE;
+	gboolean success = FALSE;
+	gint chr;
+
+	g_return_val_if_fail (G_IS_INPUT_STREAM (input_stream), FALSE);
+	g_return_val_if_fail (element_func != NULL, FALSE);
+
+	if (out_next_link)
+		*out_next_link = NULL;
+	if (out_delta_link)
+		*out_delta_link = NULL;
+	if (out_error_node)
+		*out_error_node = NULL;
+
+	memset (&reader, 0, sizeof (JsonStreamReader));
+	reader.input_stream = input_stream;
+	reader.cancellable = cancellable;
+	reader.buffer = g_malloc (READ_BUFFER_SIZE);
+
+	parser = json_parser_new_immutable ();
+	key = g_string_sized_new (32);
+	capture = g_string_sized_new (READ_BUFFER_SIZE);
+
+	if (json_stream_reader_skip_ws (&reader, &local_error) != '{')
+		goto exit;
+
+	json_stream_reader_next (&reader, &local_error);
+
+	chr = json_stream_reader_skip_ws (&reader, &local_error);
+
+	while (chr == '"') {
+		json_stream_reader_next (&reader, &local_error);
+
+		if (!json_stream_reader_read_key (&reader, key, &local_error) ||
+		    json_stream_reader_skip_ws (&reader, &local_error) != ':')
+			goto exit;
+
+		json_stream_reader_next (&reader, &local_error);
+		chr = json_stream_reader_skip_ws (&reader, &local_error);
+
+		if (chr == '[' && g_strcmp0 (key->str, "value") == 0) {
+			if (!json_stream_reader_read_elements (&reader, parser, capture, element_func, user_data, &aborted, &local_error))
+				goto exit;
+		} else if (g_strcmp0 (key->str, "@odata.nextLink") == 0 ||
+			   g_strcmp0 (key->str, "@odata.deltaLink") == 0 ||
+			   g_strcmp0 (key->str, "error") == 0) {
+			gboolean scanned;
+
+			json_stream_reader_capture_begin (&reader, capture);
+			scanned = json_stream_reader_scan_value (&reader, &local_error);
+			json_stream_reader_capture_end (&reader);
+
+			if (!scanned)
+				goto exit;
+
+			if (g_strcmp0 (key->str, "error") == 0) {
+				if (out_error_node && !*out_error_node && json_parser_load_from_data (parser, capture->str, capture->len, NULL))
+					*out_error_node = json_parser_steal_root (parser);
+			} else if (g_strcmp0 (key->str, "@odata.nextLink") == 0) {
+				if (out_next_link) {
+					g_free (*out_next_link);
+					*out_next_link = json_stream_dup_string_value (parser, capture);
+				}
+			} else if (out_delta_link) {
+				g_free (*out_delta_link);
+				*out_delta_link = json_stream_dup_string_value (parser, capture);
+			}
+		} else if (!json_stream_reader_scan_value (&reader, &local_error)) {
+			goto exit;
+		}
+
+		chr = json_stream_reader_skip_ws (&reader, &local_error);
+
+		if (chr != ',')
+			break;
+
+		json_stream_reader_next (&reader, &local_error);
+		chr = json_stream_reader_skip_ws (&reader, &local_error);
+	}
+
+	success = chr == '}';
+
+ exit:
+	if (!success && !aborted && !local_error)
+		g_set_error_literal (&local_error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Invalid data"));
+
+	if (local_error)
+		g_propagate_error (error, local_error);
+
+	if (!success) {
+		if (out_next_link)
+			g_clear_pointer (out_next_link, g_free);
+		if (out_delta_link)
+			g_clear_pointer (out_delta_link, g_free);
+		if (out_error_node)
+			g_clear_pointer (out_error_node, json_node_unref);
+	}
+
+	g_string_free (capture, TRUE);
+	g_string_free (key, TRUE);
+	g_object_unref (parser);
+	g_free (reader.buffer);
+
+	return success;
+}
@@ -0,0 +1,30 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef E_M365_JSON_STREAM_H
+#define E_M365_JSON_STREAM_H
+
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+
+G_BEGIN_DECLS
+
+typedef gboolean (* EM365JsonStreamElementFunc)	(JsonObject *element,
+						 gpointer user_data,
+						 GCancellable *cancellable,
+						 GError **error);
+
+gboolean	e_m365_json_stream_read_page_sync	(GInputStream *input_stream,
+							 EM365JsonStreamElementFunc element_func,
+							 gpointer user_data,
+							 gchar **out_next_link,
+							 gchar **out_delta_link,
+							 JsonNode **out_error_node,
+							 GCancellable *cancellable,
+							 GError **error);
+
+G_END_DECLS
+
+#endif /* E_M365_JSON_STREAM_H */
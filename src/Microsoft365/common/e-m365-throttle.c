@@ -0,0 +1,367 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* Paces the requests to the Microsoft Graph. The server throttles per
+   resource and per mailbox, thus the requests are divided into buckets
+   by the mailbox and the resource family, each with its own token bucket.
+   The pace of the bucket decreases when the server throttles, or reports
+   the limit is near, and slowly increases again with the successful
+   requests. https://learn.microsoft.com/en-us/graph/throttling */
+
+#include "evolution-ews-config.h"
+
+#include <string.h>
+
+#include "e-m365-throttle.h"
+
+/* Outlook allows 10000 requests in 10 minutes per mailbox */
+#define M365_THROTTLE_MAX_RATE		16.0
+#define M365_THROTTLE_INITIAL_RATE	10.0
+#define M365_THROTTLE_MIN_RATE		0.2
+#define M365_THROTTLE_RATE_INCREASE	0.05
+#define M365_THROTTLE_BURST		20.0
+
+/* The server adds the "x-ms-throttle-limit-percentage" header, when
+   the usage is above 80% of the limit */
+#define M365_THROTTLE_LIMIT_PERCENTAGE	0.8
+
+typedef struct _ThrottleBucket {
+	gdouble rate; /* tokens per second */
+	gdouble tokens; /* can be negative, when the requests are already scheduled ahead */
+	gint64 updated; /* monotonic time of the last refill */
+	gint64 blocked_until; /* monotonic time, set by the Retry-After */
+	gint64 limit_decreased; /* monotonic time of the last decrease by the limit percentage */
+
+	guint64 n_requests;
+	guint64 n_throttled;
+	gint64 throttled_usec;
+} ThrottleBucket;
+
+struct _EM365Throttle {
+	GMutex lock;
+	GHashTable *buckets; /* gchar *bucket ~> ThrottleBucket * */
+};
+
+static const struct _Families {
+	const gchar *segment;
+	const gchar *family;
+} families[] = {
+	{ "messages", "mail" },
+	{ "mailfolders", "mail" },
+	{ "sendmail", "mail" },
+	{ "mailboxsettings", "mail" },
+	{ "inferenceclassification", "mail" },
+	{ "outlook", "mail" },
+	{ "events", "calendar" },
+	{ "calendar", "calendar" },
+	{ "calendars", "calendar" },
+	{ "calendargroups", "calendar" },
+	{ "calendarview", "calendar" },
+	{ "findmeetingtimes", "calendar" },
+	{ "contacts", "contacts" },
+	{ "contactfolders", "contacts" },
+	{ "todo", "tasks" },
+	{ "people", "people" },
+	{ "photo", "photo" },
+	{ "photos", "photo" }
+};
+
+EM365Throttle *
+e_m365_throttle_new (void)
+{
+	EM365Throttle *throttle;
+
+	throttle = g_new0 (EM365Throttle, 1);
+	g_mutex_init (&throttle->lock);
+	throttle->buckets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	return throttle;
+}
+
+void
+e_m365_throttle_free (EM365Throttle *throttle)
+{
+	if (throttle) {
+		g_hash_table_destroy (throttle->buckets);
+		g_mutex_clear (&throttle->lock);
+		g_free (throttle);
+	}
+}
+
+/**
+ * e_m365_throttle_dup_bucket:
+ * @uri: a #GUri of the Graph request
+ *
+ * Derives the throttle bucket of the request from its @uri. The bucket
+ * consists of the mailbox, like "me" or the user of the "users/{id}" path,
+ * and of the resource family, like "mail" or "calendar". The requests,
+ * which do not target a mailbox, use an empty mailbox.
+ *
+ * Returns: (transfer full): the bucket name; free it with g_free(), when no longer needed
+ **/
+gchar *
+e_m365_throttle_dup_bucket (GUri *uri)
+{
+	gchar **segments, *path, *bucket;
+	const gchar *mailbox = "", *family_segment = NULL, *family;
+	guint ii = 0, jj;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	path = g_ascii_strdown (g_uri_get_path (uri) ? g_uri_get_path (uri) : "", -1);
+	segments = g_strsplit (path, "/", -1);
+
+	/* skip the leading empty segment and the API version */
+	while (segments[ii] && !*segments[ii])
+		ii++;
+
+	if (segments[ii])
+		ii++;
+
+	if (g_strcmp0 (segments[ii], "me") == 0) {
+		mailbox = segments[ii];
+		family_segment = segments[ii + 1];
+	} else if ((g_strcmp0 (segments[ii], "users") == 0 || g_strcmp0 (segments[ii], "groups") == 0) &&
+		   segments[ii + 1] && segments[ii + 2]) {
+		mailbox = segments[ii + 1];
+		family_segment = segments[ii + 2];
+	} else {
+		/* directory-wide, like the "users", "contacts" or "$batch" */
+		family_segment = segments[ii];
+	}
+
+	family = family_segment && *family_segment ? family_segment : "other";
+
+	for (jj = 0; jj < G_N_ELEMENTS (families); jj++) {
+		if (g_strcmp0 (family, families[jj].segment) == 0) {
+			family = families[jj].family;
+			break;
+		}
+	}
+
+	/* the orgContacts share the segment name with the personal contacts */
+	if (!*mailbox && g_strcmp0 (family, "contacts") == 0)
+		family = "orgcontacts";
+
+	bucket = g_strconcat (mailbox, "/", family, NULL);
+
+	g_strfreev (segments);
+	g_free (path);
+
+	return bucket;
+}
+
+/* Call with the throttle->lock held */
+static ThrottleBucket *
+m365_throttle_get_bucket (EM365Throttle *throttle,
+			  const gchar *bucket,
+			  gint64 now)
+{
+	ThrottleBucket *tb;
+
+	tb = g_hash_table_lookup (throttle->buckets, bucket);
+
+	if (!tb) {
+		tb = g_new0 (ThrottleBucket, 1);
+		tb->rate = M365_THROTTLE_INITIAL_RATE;
+		tb->tokens = M365_THROTTLE_BURST;
+		tb->updated = now;
+
+		g_hash_table_insert (throttle->buckets, g_strdup (bucket), tb);
+	} else if (now > tb->updated) {
+		tb->tokens = MIN (M365_THROTTLE_BURST, tb->tokens + tb->rate * (now - tb->updated) / G_USEC_PER_SEC);
+		tb->updated = now;
+	}
+
+	return tb;
+}
+
+/**
+ * e_m365_throttle_reserve:
+ * @throttle: an #EM365Throttle
+ * @bucket: a bucket name, as returned by e_m365_throttle_dup_bucket()
+ *
+ * Reserves a place for one request in the @bucket. The caller should wait
+ * the returned time before sending the request.
+ *
+ * Returns: how many microseconds to wait, before sending the request
+ **/
+gint64
+e_m365_throttle_reserve (EM365Throttle *throttle,
+			 const gchar *bucket)
+{
+	ThrottleBucket *tb;
+	gint64 now, wait_usec = 0;
+
+	g_return_val_if_fail (throttle != NULL, 0);
+	g_return_val_if_fail (bucket != NULL, 0);
+
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&throttle->lock);
+
+	tb = m365_throttle_get_bucket (throttle, bucket, now);
+
+	tb->tokens -= 1.0;
+	tb->n_requests++;
+
+	if (tb->tokens < 0.0)
+		wait_usec = (gint64) (-tb->tokens * G_USEC_PER_SEC / tb->rate);
+
+	if (tb->blocked_until > now + wait_usec)
+		wait_usec = tb->blocked_until - now;
+
+	tb->throttled_usec += wait_usec;
+
+	g_mutex_unlock (&throttle->lock);
+
+	return wait_usec;
+}
+
+/**
+ * e_m365_throttle_learn:
+ * @throttle: an #EM365Throttle
+ * @bucket: a bucket name, as returned by e_m365_throttle_dup_bucket()
+ * @status_code: the HTTP status code of the response
+ * @response_headers: (nullable): the response headers
+ *
+ * Adjusts the pace of the @bucket according to the server response. The time
+ * to wait, like the Retry-After, is set with the e_m365_throttle_backoff().
+ **/
+void
+e_m365_throttle_learn (EM365Throttle *throttle,
+		       const gchar *bucket,
+		       guint status_code,
+		       SoupMessageHeaders *response_headers)
+{
+	ThrottleBucket *tb;
+	const gchar *limit_percentage_str;
+	gdouble limit_percentage = 0.0;
+	gint64 now;
+
+	g_return_if_fail (throttle != NULL);
+	g_return_if_fail (bucket != NULL);
+
+	limit_percentage_str = response_headers ? soup_message_headers_get_one (response_headers, "x-ms-throttle-limit-percentage") : NULL;
+
+	if (limit_percentage_str && *limit_percentage_str)
+		limit_percentage = g_ascii_strtod (limit_percentage_str, NULL);
+
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&throttle->lock);
+
+	tb = m365_throttle_get_bucket (throttle, bucket, now);
+
+	if (status_code == 429 || status_code == SOUP_STATUS_SERVICE_UNAVAILABLE) {
+		tb->n_throttled++;
+		tb->rate /= 2.0;
+
+		/* the requests scheduled ahead are sent after the Retry-After */
+		tb->tokens = MIN (tb->tokens, 0.0);
+	} else if (limit_percentage > M365_THROTTLE_LIMIT_PERCENTAGE) {
+		/* all the responses carry the header while the usage is high, thus decrease
+		   the rate at most once per the refill window, otherwise the decrease would
+		   compound with each response and collapse the rate to the minimum */
+		if (now - tb->limit_decreased >= (gint64) (M365_THROTTLE_BURST * G_USEC_PER_SEC / tb->rate)) {
+			tb->rate = tb->rate * M365_THROTTLE_LIMIT_PERCENTAGE / limit_percentage;
+			tb->limit_decreased = now;
+		}
+	} else if (SOUP_STATUS_IS_SUCCESSFUL (status_code)) {
+		tb->rate += M365_THROTTLE_RATE_INCREASE;
+	}
+
+	tb->rate = CLAMP (tb->rate, M365_THROTTLE_MIN_RATE, M365_THROTTLE_MAX_RATE);
+
+	g_mutex_unlock (&throttle->lock);
+}
+
+/**
+ * e_m365_throttle_backoff:
+ * @throttle: an #EM365Throttle
+ * @bucket: a bucket name, as returned by e_m365_throttle_dup_bucket()
+ * @seconds: for how long to not send any requests
+ *
+ * Blocks the @bucket for the @seconds, unless it is already blocked
+ * for a longer time.
+ **/
+void
+e_m365_throttle_backoff (EM365Throttle *throttle,
+			 const gchar *bucket,
+			 gint64 seconds)
+{
+	ThrottleBucket *tb;
+	gint64 now;
+
+	g_return_if_fail (throttle != NULL);
+	g_return_if_fail (bucket != NULL);
+
+	if (seconds <= 0)
+		return;
+
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&throttle->lock);
+
+	tb = m365_throttle_get_bucket (throttle, bucket, now);
+
+	if (tb->blocked_until < now + seconds * G_USEC_PER_SEC)
+		tb->blocked_until = now + seconds * G_USEC_PER_SEC;
+
+	g_mutex_unlock (&throttle->lock);
+}
+
+/**
+ * e_m365_throttle_dup_stats:
+ * @throttle: an #EM365Throttle
+ *
+ * Returns the counters of all the buckets used so far.
+ *
+ * Returns: (transfer full) (element-type EM365ThrottleStats): the counters;
+ *    free it with g_slist_free_full (stats, e_m365_throttle_stats_free);
+ *    when no longer needed
+ **/
+GSList *
+e_m365_throttle_dup_stats (EM365Throttle *throttle)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GSList *stats = NULL;
+
+	g_return_val_if_fail (throttle != NULL, NULL);
+
+	g_mutex_lock (&throttle->lock);
+
+	g_hash_table_iter_init (&iter, throttle->buckets);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		ThrottleBucket *tb = value;
+		EM365ThrottleStats *st;
+
+		st = g_new0 (EM365ThrottleStats, 1);
+		st->bucket = g_strdup (key);
+		st->n_requests = tb->n_requests;
+		st->n_throttled = tb->n_throttled;
+		st->throttled_usec = tb->throttled_usec;
+		st->rate = tb->rate;
+
+		stats = g_slist_prepend (stats, st);
+	}
+
+	g_mutex_unlock (&throttle->lock);
+
+	return stats;
+}
+
+void
+e_m365_throttle_stats_free (gpointer ptr)
+{
+	EM365ThrottleStats *st = ptr;
+
+	if (st) {
+		g_free (st->bucket);
+		g_free (st);
+	}
+}
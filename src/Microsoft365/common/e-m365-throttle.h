@@ -0,0 +1,41 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef E_M365_THROTTLE_H
+#define E_M365_THROTTLE_H
+
+#include <glib.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EM365Throttle EM365Throttle;
+
+typedef struct _EM365ThrottleStats {
+	gchar *bucket;		/* "mailbox/family", like "me/mail" */
+	guint64 n_requests;	/* how many requests had been sent */
+	guint64 n_throttled;	/* how many of them the server throttled */
+	gint64 throttled_usec;	/* how long the requests waited, in total */
+	gdouble rate;		/* the current pace, in requests per second */
+} EM365ThrottleStats;
+
+EM365Throttle *	e_m365_throttle_new		(void);
+void		e_m365_throttle_free		(EM365Throttle *throttle);
+gchar *		e_m365_throttle_dup_bucket	(GUri *uri);
+gint64		e_m365_throttle_reserve		(EM365Throttle *throttle,
+						 const gchar *bucket);
+void		e_m365_throttle_learn		(EM365Throttle *throttle,
+						 const gchar *bucket,
+						 guint status_code,
+						 SoupMessageHeaders *response_headers);
+void		e_m365_throttle_backoff		(EM365Throttle *throttle,
+						 const gchar *bucket,
+						 gint64 seconds);
+GSList *	e_m365_throttle_dup_stats	(EM365Throttle *throttle);
+void		e_m365_throttle_stats_free	(gpointer ptr); /* EM365ThrottleStats * */
+
+G_END_DECLS
+
+#endif /* E_M365_THROTTLE_H */
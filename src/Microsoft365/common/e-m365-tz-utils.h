@@ -11,8 +11,6 @@
 
 G_BEGIN_DECLS
 
-void		e_m365_tz_utils_ref_windows_zones	(void);
-void		e_m365_tz_utils_unref_windows_zones	(void);
 const gchar *	e_m365_tz_utils_get_msdn_equivalent	(const gchar *ical_tz_location);
 const gchar *	e_m365_tz_utils_get_ical_equivalent	(const gchar *msdn_tz_location);
 ICalTimezone *	e_m365_tz_utils_get_user_timezone	(void);
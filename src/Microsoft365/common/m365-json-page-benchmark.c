@@ -0,0 +1,270 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* Measures how quickly a recorded Microsoft Graph page (a delta or a list
+   response body) is read, element by element from the stream and into
+   the whole JsonParser tree, how much the peak memory use grows with each
+   of them, and verifies both read the same elements and links. The stream
+   runs first, because the peak memory use can only grow. */
+
+#include "evolution-ews-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "e-m365-json-stream.h"
+#include "e-m365-json-utils.h"
+
+typedef struct _PageData {
+	guint n_elements;
+	GChecksum *sums; /* of the element ID-s */
+	gchar *next_link;
+	gchar *delta_link;
+} PageData;
+
+static glong
+get_peak_rss_kb (void)
+{
+#ifdef G_OS_UNIX
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) == 0)
+		return usage.ru_maxrss;
+#endif
+
+	return 0;
+}
+
+static void
+page_data_add_element (PageData *pd,
+		       JsonObject *element)
+{
+	const gchar *id = e_m365_json_get_string_member (element, "id", "");
+
+	pd->n_elements++;
+
+	g_checksum_update (pd->sums, (const guchar *) id, strlen (id) + 1);
+}
+
+static gboolean
+benchmark_element_cb (JsonObject *element,
+		      gpointer user_data,
+		      GCancellable *cancellable,
+		      GError **error)
+{
+	page_data_add_element (user_data, element);
+
+	return TRUE;
+}
+
+static gboolean
+read_page_stream (const gchar *filename,
+		  PageData *pd,
+		  GError **error)
+{
+	GFile *file;
+	GFileInputStream *input_stream;
+	gboolean success;
+
+	file = g_file_new_for_path (filename);
+	input_stream = g_file_read (file, NULL, error);
+	g_object_unref (file);
+
+	if (!input_stream)
+		return FALSE;
+
+	success = e_m365_json_stream_read_page_sync (G_INPUT_STREAM (input_stream), benchmark_element_cb, pd,
+		&pd->next_link, &pd->delta_link, NULL, NULL, error);
+
+	g_object_unref (input_stream);
+
+	return success;
+}
+
+static gboolean
+read_page_tree (const gchar *filename,
+		PageData *pd,
+		GError **error)
+{
+	GFile *file;
+	GFileInputStream *input_stream;
+	JsonParser *parser;
+	JsonObject *object;
+	JsonArray *value;
+	gboolean success;
+
+	file = g_file_new_for_path (filename);
+	input_stream = g_file_read (file, NULL, error);
+	g_object_unref (file);
+
+	if (!input_stream)
+		return FALSE;
+
+	parser = json_parser_new_immutable ();
+	success = json_parser_load_from_stream (parser, G_INPUT_STREAM (input_stream), NULL, error);
+
+	g_object_unref (input_stream);
+
+	if (success && (!json_parser_get_root (parser) || !JSON_NODE_HOLDS_OBJECT (json_parser_get_root (parser)))) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "The page is not a JSON object");
+		success = FALSE;
+	}
+
+	if (success) {
+		guint ii, len;
+
+		object = json_node_get_object (json_parser_get_root (parser));
+		value = e_m365_json_get_array_member (object, "value");
+		len = value ? json_array_get_length (value) : 0;
+
+		for (ii = 0; ii < len; ii++) {
+			JsonNode *elem = json_array_get_element (value, ii);
+
+			if (JSON_NODE_HOLDS_OBJECT (elem))
+				page_data_add_element (pd, json_node_get_object (elem));
+		}
+
+		pd->next_link = g_strdup (e_m365_json_get_string_member (object, "@odata.nextLink", NULL));
+		pd->delta_link = g_strdup (e_m365_json_get_string_member (object, "@odata.deltaLink", NULL));
+	}
+
+	g_object_unref (parser);
+
+	return success;
+}
+
+static gboolean
+run_read (const gchar *filename,
+	  gboolean stream,
+	  guint iterations,
+	  gdouble *out_seconds,
+	  glong *out_peak_growth_kb,
+	  PageData *out_pd,
+	  GError **error)
+{
+	GTimer *timer;
+	glong peak_before;
+	guint ii;
+
+	peak_before = get_peak_rss_kb ();
+	timer = g_timer_new ();
+
+	for (ii = 0; ii < iterations; ii++) {
+		PageData pd;
+		gboolean success;
+
+		memset (&pd, 0, sizeof (PageData));
+		pd.sums = g_checksum_new (G_CHECKSUM_SHA1);
+
+		if (stream)
+			success = read_page_stream (filename, &pd, error);
+		else
+			success = read_page_tree (filename, &pd, error);
+
+		if (success && ii + 1 == iterations) {
+			*out_pd = pd;
+		} else {
+			g_checksum_free (pd.sums);
+			g_free (pd.next_link);
+			g_free (pd.delta_link);
+		}
+
+		if (!success) {
+			g_timer_destroy (timer);
+			return FALSE;
+		}
+	}
+
+	*out_seconds = g_timer_elapsed (timer, NULL) / iterations;
+	*out_peak_growth_kb = get_peak_rss_kb () - peak_before;
+
+	g_timer_destroy (timer);
+
+	return TRUE;
+}
+
+static void
+print_result (const gchar *name,
+	      gdouble seconds,
+	      glong peak_growth_kb,
+	      guint n_elements,
+	      goffset file_size)
+{
+	g_print ("%-8s %8.3f s  %10.0f elements/s  %8.2f MB/s  peak RSS +%.2f MB\n", name, seconds,
+		seconds > 0.0 ? n_elements / seconds : 0.0,
+		seconds > 0.0 ? file_size / seconds / (1024.0 * 1024.0) : 0.0,
+		peak_growth_kb / 1024.0);
+}
+
+static void
+page_data_clear (PageData *pd)
+{
+	g_clear_pointer (&pd->sums, g_checksum_free);
+	g_clear_pointer (&pd->next_link, g_free);
+	g_clear_pointer (&pd->delta_link, g_free);
+}
+
+gint
+main (gint argc,
+      gchar *argv[])
+{
+	GStatBuf st;
+	PageData stream_pd, tree_pd;
+	gdouble stream_seconds = 0.0, tree_seconds = 0.0;
+	glong stream_peak = 0, tree_peak = 0;
+	guint iterations;
+	GError *error = NULL;
+	gint res = 0;
+
+	if (argc < 2 || argc > 3) {
+		g_print ("Usage: %s PAGE.json [ITERATIONS]\n", argv[0]);
+		return 1;
+	}
+
+	if (g_stat (argv[1], &st) != 0) {
+		g_printerr ("Cannot stat '%s'\n", argv[1]);
+		return 1;
+	}
+
+	iterations = argc > 2 ? (guint) strtoul (argv[2], NULL, 10) : 10;
+	if (!iterations)
+		iterations = 1;
+
+	memset (&stream_pd, 0, sizeof (PageData));
+	memset (&tree_pd, 0, sizeof (PageData));
+
+	if (!run_read (argv[1], TRUE, iterations, &stream_seconds, &stream_peak, &stream_pd, &error) ||
+	    !run_read (argv[1], FALSE, iterations, &tree_seconds, &tree_peak, &tree_pd, &error)) {
+		g_printerr ("Reading failed: %s\n", error ? error->message : "Unknown error");
+		g_clear_error (&error);
+		res = 1;
+		goto exit;
+	}
+
+	g_print ("Read %u elements from %" G_GINT64_FORMAT " bytes, average of %u iterations\n",
+		stream_pd.n_elements, (gint64) st.st_size, iterations);
+	print_result ("stream", stream_seconds, stream_peak, stream_pd.n_elements, st.st_size);
+	print_result ("tree", tree_seconds, tree_peak, tree_pd.n_elements, st.st_size);
+
+	if (stream_pd.n_elements != tree_pd.n_elements ||
+	    g_strcmp0 (g_checksum_get_string (stream_pd.sums), g_checksum_get_string (tree_pd.sums)) != 0 ||
+	    g_strcmp0 (stream_pd.next_link, tree_pd.next_link) != 0 ||
+	    g_strcmp0 (stream_pd.delta_link, tree_pd.delta_link) != 0) {
+		g_printerr ("The read pages differ\n");
+		res = 1;
+	}
+
+ exit:
+	page_data_clear (&stream_pd);
+	page_data_clear (&tree_pd);
+
+	return res;
+}
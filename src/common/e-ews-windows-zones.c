@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "evolution-ews-config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "e-ews-windows-zones.h"
+
+typedef struct _EwsWindowsZone {
+	const gchar *key;
+	const gchar *value;
+} EwsWindowsZone;
+
+/* Generated by the gen-windows-zones from the windowsZones.xml */
+#include "e-ews-windows-zones-table.h"
+
+/* The tables are constant, thus there is no need for any lock */
+static const gchar *
+ews_windows_zones_lookup (const EwsWindowsZone *slots,
+			  guint n_slots,
+			  const guint16 *displacements,
+			  guint n_buckets,
+			  const gchar *key)
+{
+	const EwsWindowsZone *zone;
+	guint32 seed;
+
+	if (!key || !*key)
+		return NULL;
+
+	seed = displacements[ews_windows_zones_hash (key, 0) & (n_buckets - 1)];
+	zone = &slots[ews_windows_zones_hash (key, seed) & (n_slots - 1)];
+
+	/* A key not in the table can land on any slot */
+	if (!zone->key || strcmp (zone->key, key) != 0)
+		return NULL;
+
+	return zone->value;
+}
+
+/**
+ * e_ews_windows_zones_get_msdn_equivalent:
+ * @ical_tz_location: an IANA time zone location, like "Europe/Prague"
+ *
+ * Returns: (nullable): the Windows time zone name corresponding
+ *    to the @ical_tz_location, or %NULL, when not known
+ **/
+const gchar *
+e_ews_windows_zones_get_msdn_equivalent (const gchar *ical_tz_location)
+{
+	return ews_windows_zones_lookup (ews_ical_to_msdn_slots, EWS_ICAL_TO_MSDN_N_SLOTS,
+		ews_ical_to_msdn_displacements, EWS_ICAL_TO_MSDN_N_BUCKETS, ical_tz_location);
+}
+
+/**
+ * e_ews_windows_zones_get_ical_equivalent:
+ * @msdn_tz_location: a Windows time zone name, like "Central Europe Standard Time"
+ *
+ * Returns: (nullable): the IANA time zone location corresponding
+ *    to the @msdn_tz_location, or %NULL, when not known
+ **/
+const gchar *
+e_ews_windows_zones_get_ical_equivalent (const gchar *msdn_tz_location)
+{
+	return ews_windows_zones_lookup (ews_msdn_to_ical_slots, EWS_MSDN_TO_ICAL_N_SLOTS,
+		ews_msdn_to_ical_displacements, EWS_MSDN_TO_ICAL_N_BUCKETS, msdn_tz_location);
+}
@@ -0,0 +1,18 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef E_EWS_WINDOWS_ZONES_H
+#define E_EWS_WINDOWS_ZONES_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+const gchar *	e_ews_windows_zones_get_msdn_equivalent	(const gchar *ical_tz_location);
+const gchar *	e_ews_windows_zones_get_ical_equivalent	(const gchar *msdn_tz_location);
+
+G_END_DECLS
+
+#endif /* E_EWS_WINDOWS_ZONES_H */
@@ -0,0 +1,331 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* Generates the tables of the e-ews-windows-zones.c from the windowsZones.xml
+   at build time. Each direction of the mapping is stored as a perfect hash
+   table, using the hash and displace method: a key is hashed into a bucket
+   first and each bucket has its own seed, which places all the bucket's keys
+   into the free slots of the table. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+/* Keep in sync with the one written into the generated file */
+static guint32
+ews_windows_zones_hash (const gchar *str,
+			guint32 seed)
+{
+	guint32 hash = 2166136261u ^ (seed * 16777619u);
+
+	for (; *str; str++) {
+		hash ^= (guchar) *str;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static const gchar *hash_function_code =
+	"static guint32\n"
+	"ews_windows_zones_hash (const gchar *str,\n"
+	"\t\t\tguint32 seed)\n"
+	"{\n"
+	"\tguint32 hash = 2166136261u ^ (seed * 16777619u);\n"
+	"\n"
+	"\tfor (; *str; str++) {\n"
+	"\t\thash ^= (guchar) *str;\n"
+	"\t\thash *= 16777619u;\n"
+	"\t}\n"
+	"\n"
+	"\treturn hash;\n"
+	"}\n";
+
+typedef struct _ZonesMap {
+	GHashTable *values; /* gchar *key ~> gchar *value */
+	GPtrArray *keys; /* gchar *, in the order of the file */
+} ZonesMap;
+
+typedef struct _ParseData {
+	ZonesMap ical_to_msdn;
+	ZonesMap msdn_to_ical;
+} ParseData;
+
+static void
+zones_map_init (ZonesMap *map)
+{
+	map->values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	map->keys = g_ptr_array_new ();
+}
+
+static void
+zones_map_clear (ZonesMap *map)
+{
+	g_ptr_array_unref (map->keys);
+	g_hash_table_destroy (map->values);
+}
+
+/* The first value for the key wins */
+static void
+zones_map_add (ZonesMap *map,
+	       const gchar *key,
+	       const gchar *value)
+{
+	gchar *key_copy;
+
+	if (!key || !*key || !value || !*value || g_hash_table_contains (map->values, key))
+		return;
+
+	key_copy = g_strdup (key);
+
+	g_hash_table_insert (map->values, key_copy, g_strdup (value));
+	g_ptr_array_add (map->keys, key_copy);
+}
+
+static void
+parse_start_element_cb (GMarkupParseContext *context,
+			const gchar *element_name,
+			const gchar **attribute_names,
+			const gchar **attribute_values,
+			gpointer user_data,
+			GError **error)
+{
+	ParseData *pd = user_data;
+	const gchar *msdn = NULL, *ical = NULL;
+	gchar **tokens;
+	guint ii;
+
+	if (g_strcmp0 (element_name, "mapZone") != 0)
+		return;
+
+	for (ii = 0; attribute_names[ii]; ii++) {
+		if (g_strcmp0 (attribute_names[ii], "other") == 0)
+			msdn = attribute_values[ii];
+		else if (g_strcmp0 (attribute_names[ii], "type") == 0)
+			ical = attribute_values[ii];
+	}
+
+	if (!msdn || !ical)
+		return;
+
+	tokens = g_strsplit (ical, " ", 0);
+
+	for (ii = 0; tokens[ii]; ii++) {
+		zones_map_add (&pd->msdn_to_ical, msdn, tokens[ii]);
+		zones_map_add (&pd->ical_to_msdn, tokens[ii], msdn);
+	}
+
+	g_strfreev (tokens);
+}
+
+static guint
+next_power_of_two (guint value)
+{
+	guint res = 1;
+
+	while (res < value)
+		res <<= 1;
+
+	return res;
+}
+
+static gint
+compare_buckets_by_size_cb (gconstpointer ptr1,
+			    gconstpointer ptr2)
+{
+	const GPtrArray *bucket1 = *((const GPtrArray **) ptr1);
+	const GPtrArray *bucket2 = *((const GPtrArray **) ptr2);
+
+	return (gint) bucket2->len - (gint) bucket1->len;
+}
+
+static gboolean
+write_table (GString *out,
+	     const gchar *name,
+	     ZonesMap *map,
+	     GError **error)
+{
+	GPtrArray *buckets, *sorted;
+	guint n_buckets, n_slots, ii, jj;
+	guint16 *displacements;
+	const gchar **slots;
+	gchar *upper_name;
+	gboolean success = TRUE;
+
+	n_slots = next_power_of_two (MAX (map->keys->len + map->keys->len / 4, 2));
+	n_buckets = next_power_of_two (MAX (map->keys->len / 4, 1));
+
+	buckets = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+	for (ii = 0; ii < n_buckets; ii++) {
+		g_ptr_array_add (buckets, g_ptr_array_new ());
+	}
+
+	for (ii = 0; ii < map->keys->len; ii++) {
+		const gchar *key = map->keys->pdata[ii];
+
+		g_ptr_array_add (buckets->pdata[ews_windows_zones_hash (key, 0) & (n_buckets - 1)], (gpointer) key);
+	}
+
+	displacements = g_new0 (guint16, n_buckets);
+	slots = g_new0 (const gchar *, n_slots);
+
+	/* Place the biggest buckets first, while there are many free slots */
+	sorted = g_ptr_array_new ();
+	for (ii = 0; ii < n_buckets; ii++) {
+		g_ptr_array_add (sorted, buckets->pdata[ii]);
+	}
+	g_ptr_array_sort (sorted, compare_buckets_by_size_cb);
+
+	for (ii = 0; ii < sorted->len && success; ii++) {
+		GPtrArray *bucket = sorted->pdata[ii];
+		guint bucket_index = 0, seed;
+
+		if (!bucket->len)
+			continue;
+
+		while (buckets->pdata[bucket_index] != bucket)
+			bucket_index++;
+
+		for (seed = 1; seed <= G_MAXUINT16; seed++) {
+			for (jj = 0; jj < bucket->len; jj++) {
+				guint slot = ews_windows_zones_hash (bucket->pdata[jj], seed) & (n_slots - 1);
+				guint kk;
+
+				if (slots[slot])
+					break;
+
+				/* Also not colliding within the bucket itself */
+				for (kk = 0; kk < jj; kk++) {
+					if ((ews_windows_zones_hash (bucket->pdata[kk], seed) & (n_slots - 1)) == slot)
+						break;
+				}
+
+				if (kk < jj)
+					break;
+			}
+
+			if (jj == bucket->len)
+				break;
+		}
+
+		if (seed > G_MAXUINT16) {
+			g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "Cannot place %u keys of the %s table", bucket->len, name);
+			success = FALSE;
+			break;
+		}
+
+		displacements[bucket_index] = seed;
+
+		for (jj = 0; jj < bucket->len; jj++) {
+			slots[ews_windows_zones_hash (bucket->pdata[jj], seed) & (n_slots - 1)] = bucket->pdata[jj];
+		}
+	}
+
+	upper_name = g_ascii_strup (name, -1);
+
+	if (success) {
+		g_string_append_printf (out, "#define EWS_%s_N_BUCKETS %u\n", upper_name, n_buckets);
+		g_string_append_printf (out, "#define EWS_%s_N_SLOTS %u\n\n", upper_name, n_slots);
+
+		g_string_append_printf (out, "static const guint16 ews_%s_displacements[EWS_%s_N_BUCKETS] = {", name, upper_name);
+		for (ii = 0; ii < n_buckets; ii++) {
+			g_string_append_printf (out, "%s%u", ii % 16 ? ", " : (ii ? ",\n\t" : "\n\t"), displacements[ii]);
+		}
+		g_string_append (out, "\n};\n\n");
+
+		g_string_append_printf (out, "static const EwsWindowsZone ews_%s_slots[EWS_%s_N_SLOTS] = {\n", name, upper_name);
+		for (ii = 0; ii < n_slots; ii++) {
+			if (slots[ii]) {
+				gchar *key, *value;
+
+				key = g_strescape (slots[ii], NULL);
+				value = g_strescape (g_hash_table_lookup (map->values, slots[ii]), NULL);
+
+				g_string_append_printf (out, "\t{ \"%s\", \"%s\" }%s\n", key, value, ii + 1 < n_slots ? "," : "");
+
+				g_free (key);
+				g_free (value);
+			} else {
+				g_string_append_printf (out, "\t{ NULL, NULL }%s\n", ii + 1 < n_slots ? "," : "");
+			}
+		}
+		g_string_append (out, "};\n\n");
+	}
+
+	g_free (upper_name);
+	g_ptr_array_unref (sorted);
+	g_ptr_array_unref (buckets);
+	g_free (displacements);
+	g_free (slots);
+
+	return success;
+}
+
+gint
+main (gint argc,
+      gchar *argv[])
+{
+	GMarkupParser parser = { parse_start_element_cb, NULL, NULL, NULL, NULL };
+	GMarkupParseContext *context;
+	ParseData pd;
+	GString *out;
+	gchar *content = NULL;
+	gsize length = 0;
+	GError *error = NULL;
+	gint res = 0;
+
+	if (argc != 3) {
+		g_printerr ("Usage: %s windowsZones.xml OUTPUT.h\n", argv[0]);
+		return 1;
+	}
+
+	if (!g_file_get_contents (argv[1], &content, &length, &error)) {
+		g_printerr ("Failed to read '%s': %s\n", argv[1], error->message);
+		g_clear_error (&error);
+		return 1;
+	}
+
+	zones_map_init (&pd.ical_to_msdn);
+	zones_map_init (&pd.msdn_to_ical);
+
+	context = g_markup_parse_context_new (&parser, 0, &pd, NULL);
+
+	if (!g_markup_parse_context_parse (context, content, length, &error) ||
+	    !g_markup_parse_context_end_parse (context, &error)) {
+		g_printerr ("Failed to parse '%s': %s\n", argv[1], error->message);
+		g_clear_error (&error);
+		res = 1;
+	}
+
+	g_markup_parse_context_free (context);
+	g_free (content);
+
+	if (!res && (!pd.ical_to_msdn.keys->len || !pd.msdn_to_ical.keys->len)) {
+		g_printerr ("No time zones found in '%s'\n", argv[1]);
+		res = 1;
+	}
+
+	if (!res) {
+		out = g_string_new ("/* Generated by gen-windows-zones from windowsZones.xml, do not edit */\n\n");
+
+		g_string_append (out, hash_function_code);
+		g_string_append_c (out, '\n');
+
+		if (!write_table (out, "ical_to_msdn", &pd.ical_to_msdn, &error) ||
+		    !write_table (out, "msdn_to_ical", &pd.msdn_to_ical, &error) ||
+		    !g_file_set_contents (argv[2], out->str, out->len, &error)) {
+			g_printerr ("Failed to generate '%s': %s\n", argv[2], error ? error->message : "Unknown error");
+			g_clear_error (&error);
+			res = 1;
+		}
+
+		g_string_free (out, TRUE);
+	}
+
+	zones_map_clear (&pd.ical_to_msdn);
+	zones_map_clear (&pd.msdn_to_ical);
+
+	return res;
+}
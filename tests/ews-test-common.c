@@ -207,7 +207,6 @@ ews_test_init (gint argc,
 	g_test_bug_base ("http://bugzilla.gnome.org/show_bug.cgi?id=");
 
 	g_setenv ("EWS_DEBUG", "4", TRUE);
-	g_setenv ("EWS_TEST_WINDOWS_ZONES_XML_PATH", TEST_FILE_DIR "/../src/EWS/calendar/", TRUE);
 
 	mock_server = uhm_server_new ();
 	uhm_server_set_default_tls_certificate (mock_server);
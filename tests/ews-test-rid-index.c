@@ -0,0 +1,306 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Red Hat, Inc. (www.redhat.com)
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* Verifies the recurrence ID to instance index mapping of the calendar module
+   against the plain expansion of the rule and measures how long the lookups
+   take, for the simple rules computed directly and for the complex rules,
+   whose occurrences are remembered between the lookups. */
+
+#include "evolution-ews-config.h"
+
+#include <libecal/libecal.h>
+
+#include "calendar/e-cal-backend-ews-utils.h"
+
+ECalBackendEwsRidIndex * (* rid_index_new) (void);
+void (* rid_index_free) (ECalBackendEwsRidIndex *rid_index);
+guint (* rid_index_lookup) (ECalBackendEwsRidIndex *rid_index,
+			    ICalTimezone *timezone,
+			    const gchar *rid,
+			    ICalComponent *comp,
+			    GError **error);
+
+/* How many occurrences, from the start, are looked up */
+#define N_OCCURRENCES 1000
+
+const gchar *str_comp =
+	"BEGIN:VEVENT\n"
+	"UID:20140114T172626Z-2238-1000-5564-0@srv\n"
+	"DTSTAMP:20140114T172620Z\n"
+	"DTSTART;TZID=/freeassociation.sourceforge.net/Tzfile/Europe/Prague:\n"
+	" 20140114T160000\n"
+	"DTEND;TZID=/freeassociation.sourceforge.net/Tzfile/Europe/Prague:\n"
+	" 20140114T163000\n"
+	"RRULE:RRULE_VALUE\n"
+	"TRANSP:OPAQUE\n"
+	"SEQUENCE:2\n"
+	"SUMMARY:Test\n"
+	"CLASS:PUBLIC\n"
+	"END:VEVENT";
+
+typedef struct _RuleData {
+	const gchar *rrule;
+	gboolean closed_form; /* whether the index is computed without the expansion */
+} RuleData;
+
+static const RuleData rules[] = {
+	{ "FREQ=DAILY", TRUE },
+	{ "FREQ=DAILY;INTERVAL=3", TRUE },
+	{ "FREQ=DAILY;COUNT=1500", TRUE },
+	{ "FREQ=WEEKLY", TRUE },
+	{ "FREQ=WEEKLY;INTERVAL=2;BYDAY=TU,TH,FR", TRUE },
+	{ "FREQ=WEEKLY;INTERVAL=3;BYDAY=SU,TU;WKST=SU", TRUE },
+	{ "FREQ=MONTHLY", TRUE },
+	{ "FREQ=YEARLY;UNTIL=20400101T000000Z", TRUE },
+	{ "FREQ=MONTHLY;BYDAY=2TU", FALSE },
+	{ "FREQ=DAILY;BYDAY=MO,TU,WE,TH,FR", FALSE },
+	{ "FREQ=YEARLY;BYMONTH=1,7;BYDAY=TU", FALSE }
+};
+
+/* The plain expansion, one occurrence at a time, as the reference */
+static guint
+reference_rid_to_index (ICalTimezone *zone,
+			ICalTime *rid_time,
+			ICalComponent *icomp)
+{
+	ICalProperty *prop;
+	ICalRecurrence *rrule;
+	ICalRecurIterator *ritr;
+	ICalTime *dtstart, *next;
+	guint index = 1;
+
+	prop = i_cal_component_get_first_property (icomp, I_CAL_RRULE_PROPERTY);
+	rrule = i_cal_property_get_rrule (prop);
+	dtstart = i_cal_component_get_dtstart (icomp);
+	i_cal_time_set_timezone (dtstart, zone);
+
+	ritr = i_cal_recur_iterator_new (rrule, dtstart);
+
+	for (next = i_cal_recur_iterator_next (ritr);
+	     next && !i_cal_time_is_null_time (next);
+	     g_object_unref (next), next = i_cal_recur_iterator_next (ritr), index++) {
+		if (i_cal_time_compare (rid_time, next) == 0)
+			break;
+	}
+
+	/* if cannot find an exact time, try with the date part only */
+	if (!next || i_cal_time_is_null_time (next)) {
+		g_clear_object (&ritr);
+		g_clear_object (&next);
+		index = 1;
+		ritr = i_cal_recur_iterator_new (rrule, dtstart);
+		for (next = i_cal_recur_iterator_next (ritr);
+		     next && !i_cal_time_is_null_time (next);
+		     g_object_unref (next), next = i_cal_recur_iterator_next (ritr), index++) {
+			if (i_cal_time_compare_date_only_tz (rid_time, next, zone) == 0)
+				break;
+		}
+	}
+
+	if (!next || i_cal_time_is_null_time (next))
+		index = 0;
+
+	g_clear_object (&next);
+	g_clear_object (&ritr);
+	g_clear_object (&dtstart);
+	g_clear_object (&rrule);
+	g_clear_object (&prop);
+
+	return index;
+}
+
+static void
+test_rid_index (gconstpointer user_data)
+{
+	const RuleData *rd = user_data;
+	ECalBackendEwsRidIndex *rid_index;
+	ICalComponent *icomp;
+	ICalProperty *prop;
+	ICalRecurrence *rrule;
+	ICalRecurIterator *ritr;
+	ICalTimezone *zone;
+	ICalTime *dtstart, *next;
+	GPtrArray *rids;
+	GArray *expected;
+	GTimer *timer;
+	gdouble reference_seconds, uncached_seconds, cached_seconds;
+	gchar **tokens, *str;
+	guint ii;
+
+	zone = i_cal_timezone_get_builtin_timezone ("Europe/Prague");
+	g_assert_nonnull (zone);
+
+	tokens = g_strsplit (str_comp, "RRULE_VALUE", 0);
+	str = g_strconcat (tokens[0], rd->rrule, tokens[1], NULL);
+	icomp = i_cal_component_new_from_string (str);
+	g_strfreev (tokens);
+	g_free (str);
+
+	g_assert_nonnull (icomp);
+
+	/* Collect the occurrences to be looked up */
+	prop = i_cal_component_get_first_property (icomp, I_CAL_RRULE_PROPERTY);
+	rrule = i_cal_property_get_rrule (prop);
+	dtstart = i_cal_component_get_dtstart (icomp);
+	i_cal_time_set_timezone (dtstart, zone);
+
+	rids = g_ptr_array_new_with_free_func (g_free);
+	ritr = i_cal_recur_iterator_new (rrule, dtstart);
+
+	for (next = i_cal_recur_iterator_next (ritr);
+	     next && !i_cal_time_is_null_time (next) && rids->len < N_OCCURRENCES;
+	     g_object_unref (next), next = i_cal_recur_iterator_next (ritr)) {
+		g_ptr_array_add (rids, i_cal_time_as_ical_string (next));
+	}
+
+	g_clear_object (&next);
+	g_clear_object (&ritr);
+	g_clear_object (&dtstart);
+	g_clear_object (&rrule);
+	g_clear_object (&prop);
+
+	/* Also some, which are not occurrences */
+	g_ptr_array_add (rids, g_strdup ("20140113T160000"));
+	g_ptr_array_add (rids, g_strdup ("20140115T100000"));
+	g_ptr_array_add (rids, g_strdup ("20140116T000000"));
+
+	expected = g_array_sized_new (FALSE, FALSE, sizeof (guint), rids->len);
+	timer = g_timer_new ();
+
+	for (ii = 0; ii < rids->len; ii++) {
+		ICalTime *rid_time = i_cal_time_new_from_string (rids->pdata[ii]);
+		guint index;
+
+		index = reference_rid_to_index (zone, rid_time, icomp);
+		g_array_append_val (expected, index);
+
+		g_object_unref (rid_time);
+	}
+
+	reference_seconds = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+
+	for (ii = 0; ii < rids->len; ii++) {
+		rid_index_lookup (NULL, zone, rids->pdata[ii], icomp, NULL);
+	}
+
+	uncached_seconds = g_timer_elapsed (timer, NULL);
+
+	rid_index = rid_index_new ();
+
+	g_timer_start (timer);
+
+	for (ii = 0; ii < rids->len; ii++) {
+		rid_index_lookup (rid_index, zone, rids->pdata[ii], icomp, NULL);
+	}
+
+	cached_seconds = g_timer_elapsed (timer, NULL);
+
+	g_test_message ("%s: %u lookups, expansion %.3f s, without cache %.3f s, with cache %.3f s%s",
+		rd->rrule, rids->len, reference_seconds, uncached_seconds, cached_seconds,
+		rd->closed_form ? " (closed form)" : "");
+
+	/* Then verify the results, in reversed order, to not have the cache filled sequentially */
+	rid_index_free (rid_index);
+	rid_index = rid_index_new ();
+
+	for (ii = rids->len; ii > 0; ii--) {
+		const gchar *rid = rids->pdata[ii - 1];
+		GError *error = NULL;
+		guint index, expected_index;
+
+		expected_index = g_array_index (expected, guint, ii - 1);
+		index = rid_index_lookup (rid_index, zone, rid, icomp, &error);
+
+		if (index != expected_index)
+			g_printerr ("\n%s: rid:%s expected:%u got:%u\n", rd->rrule, rid, expected_index, index);
+
+		g_assert_cmpuint (index, ==, expected_index);
+
+		if (expected_index) {
+			g_assert_no_error (error);
+		} else {
+			g_assert_nonnull (error);
+			g_clear_error (&error);
+		}
+
+		g_assert_cmpuint (rid_index_lookup (NULL, zone, rid, icomp, NULL), ==, expected_index);
+	}
+
+	rid_index_free (rid_index);
+	g_array_unref (expected);
+	g_ptr_array_unref (rids);
+	g_timer_destroy (timer);
+	g_object_unref (icomp);
+}
+
+int main (int argc,
+	  char **argv)
+{
+	gint retval;
+	const gchar *module_path;
+	GModule *module = NULL;
+	gpointer symbol = NULL;
+	guint ii;
+
+	g_test_init (&argc, &argv, NULL);
+
+	if (!g_module_supported ()) {
+		g_printerr ("GModule not supported\n");
+		retval = 1;
+		goto exit;
+	}
+
+	module_path = CALENDAR_MODULE_DIR "libecalbackendews.so";
+	module = g_module_open (module_path, G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
+
+	if (module == NULL) {
+		g_printerr ("Failed to load module '%s': %s\n", module_path, g_module_error ());
+		retval = 2;
+		goto exit;
+	}
+
+	if (!g_module_symbol (module, "e_cal_backend_ews_rid_index_new", &symbol)) {
+		g_printerr ("\n%s\n", g_module_error ());
+		retval = 3;
+		goto exit;
+	}
+
+	rid_index_new = symbol;
+
+	if (!g_module_symbol (module, "e_cal_backend_ews_rid_index_free", &symbol)) {
+		g_printerr ("\n%s\n", g_module_error ());
+		retval = 4;
+		goto exit;
+	}
+
+	rid_index_free = symbol;
+
+	if (!g_module_symbol (module, "e_cal_backend_ews_rid_index_lookup", &symbol)) {
+		g_printerr ("\n%s\n", g_module_error ());
+		retval = 5;
+		goto exit;
+	}
+
+	rid_index_lookup = symbol;
+
+	for (ii = 0; ii < G_N_ELEMENTS (rules); ii++) {
+		gchar *message;
+
+		message = g_strdup_printf ("/calendar/rid_index/%u", ii);
+		g_test_add_data_func (message, &rules[ii], test_rid_index);
+		g_free (message);
+	}
+
+	retval = g_test_run ();
+
+ exit:
+	if (module != NULL)
+		g_module_close (module);
+	i_cal_timezone_free_builtin_timezones ();
+
+	return retval;
+}
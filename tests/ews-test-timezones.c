@@ -10,7 +10,6 @@
 
 #include "ews-test-common.h"
 
-void (* populate_windows_zones) (void);
 const gchar * (* ical_to_msdn_equivalent) (const gchar *);
 gboolean (* convert_calcomp_to_xml) (ESoapRequest *request,
 				     gpointer user_data,
@@ -380,17 +379,9 @@ int main (int argc,
 		goto exit;
 	}
 
-	if (!g_module_symbol (module, "e_cal_backend_ews_populate_windows_zones", &symbol)) {
-		g_printerr ("\n%s\n", g_module_error ());
-		retval = 3;
-		goto exit;
-	}
-
-	populate_windows_zones = symbol;
-
 	if (!g_module_symbol (module, "e_cal_backend_ews_tz_util_get_msdn_equivalent", &symbol)) {
 		g_printerr ("\n%s\n", g_module_error ());
-		retval = 4;
+		retval = 3;
 		goto exit;
 	}
 
@@ -398,7 +389,7 @@ int main (int argc,
 
 	if (!g_module_symbol (module, "e_cal_backend_ews_convert_calcomp_to_xml", &symbol)) {
 		g_printerr ("\n%s\n", g_module_error ());
-		retval = 5;
+		retval = 4;
 		goto exit;
 	}
 
@@ -406,7 +397,7 @@ int main (int argc,
 
 	if (!g_module_symbol (module, "e_cal_backend_ews_get_type_for_testing_sources", &symbol)) {
 		g_printerr ("\n%s\n", g_module_error ());
-		retval = 6;
+		retval = 5;
 		goto exit;
 	}
 
@@ -416,7 +407,6 @@ int main (int argc,
 	etds = ews_test_get_test_data_list ();
 
 	/* Set handler of debug information */
-	populate_windows_zones ();
 	builtin_timezones = i_cal_timezone_get_builtin_timezones ();
 
 	for (l = etds; l != NULL; l = l->next) {